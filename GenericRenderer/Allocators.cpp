@@ -0,0 +1,156 @@
+#include "Precompiled.h"
+
+#include "Allocators.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Engine::Memory
+{
+    std::atomic<u64> arenaAllocations = 0;
+    std::atomic<u64> arenaBytes = 0;
+    std::atomic<u64> heapAllocations = 0;
+    std::atomic<u64> heapFrees = 0;
+    std::atomic<u64> heapBytes = 0;
+    std::atomic<u64> frame = 0;
+
+    struct FrameArena
+    {
+        Arena arena;
+        u64 frame = 0;
+    };
+
+    thread_local FrameArena frameArena;
+
+    u8* alignUp(u8* data, size_t alignment)
+    {
+        auto address = (uintptr_t)data;
+        return (u8*)((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    void* heapAllocate(size_t bytes, size_t alignment)
+    {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        heapBytes.fetch_add(bytes, std::memory_order_relaxed);
+        return ::operator new(bytes, std::align_val_t(alignment));
+    }
+
+    void heapFree(void* data, size_t bytes, size_t alignment)
+    {
+        heapFrees.fetch_add(1, std::memory_order_relaxed);
+        ::operator delete(data, bytes, std::align_val_t(alignment));
+    }
+
+    void Arena::reset()
+    {
+        flushCounts();
+        // A round that outgrew its first region gets one chunk big enough for all of it.
+        if (overflowed) {
+            auto total = startedInBuffer ? bufferSize : 0;
+            for (auto chunk = chunks; chunk != nullptr; chunk = chunk->next)
+                total += chunk->size;
+            freeChunks();
+            addChunk(total);
+            overflowed = false;
+        }
+        startedInBuffer = chunks == nullptr;
+        if (startedInBuffer) {
+            head = buffer;
+            end = buffer + bufferSize;
+        } else {
+            head = (u8*)(chunks + 1);
+            end = head + chunks->size;
+        }
+        used = 0;
+    }
+
+    void* Arena::do_allocate(size_t bytes, size_t alignment)
+    {
+        auto data = alignUp(head, alignment);
+        if (head == nullptr || data + bytes > end) {
+            // Oversized requests get a chunk of their own size.
+            addChunk(std::max(chunkSize, bytes + alignment));
+            overflowed = true;
+            data = alignUp(head, alignment);
+        }
+        head = data + bytes;
+        used += bytes;
+        allocations++;
+        return data;
+    }
+
+    void Arena::addChunk(size_t minSize)
+    {
+        auto size = std::max(minSize, chunkSize);
+        auto chunk = (Chunk*)heapAllocate(sizeof(Chunk) + size, alignof(std::max_align_t));
+        chunk->next = chunks;
+        chunk->size = size;
+        chunks = chunk;
+        head = (u8*)(chunk + 1);
+        end = head + size;
+    }
+
+    void Arena::freeChunks()
+    {
+        while (chunks != nullptr) {
+            auto next = chunks->next;
+            heapFree(chunks, sizeof(Chunk) + chunks->size, alignof(std::max_align_t));
+            chunks = next;
+        }
+        head = nullptr;
+        end = nullptr;
+    }
+
+    void Arena::flushCounts()
+    {
+        if (allocations == 0) return;
+
+        arenaAllocations.fetch_add(allocations, std::memory_order_relaxed);
+        arenaBytes.fetch_add(used, std::memory_order_relaxed);
+        allocations = 0;
+    }
+
+    Arena::Arena(size_t chunkSize)
+        : chunkSize(chunkSize)
+    {
+    }
+
+    Arena::Arena(void* buffer, size_t bufferSize, size_t chunkSize)
+        : head((u8*)buffer), end((u8*)buffer + bufferSize), buffer((u8*)buffer),
+        bufferSize(bufferSize), chunkSize(chunkSize)
+    {
+    }
+
+    Arena::~Arena()
+    {
+        flushCounts();
+        freeChunks();
+    }
+
+    void nextFrame()
+    {
+        frame.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Arena& getFrameArena()
+    {
+        // Each thread only ever resets its own arena, so this needs no locking.
+        auto current = frame.load(std::memory_order_relaxed);
+        if (frameArena.frame != current) {
+            frameArena.arena.reset();
+            frameArena.frame = current;
+        }
+        return frameArena.arena;
+    }
+
+    Stats getStats()
+    {
+        auto stats = Stats();
+        stats.arenaAllocations = arenaAllocations.load(std::memory_order_relaxed);
+        stats.arenaBytes = arenaBytes.load(std::memory_order_relaxed);
+        stats.heapAllocations = heapAllocations.load(std::memory_order_relaxed);
+        stats.heapFrees = heapFrees.load(std::memory_order_relaxed);
+        stats.heapBytes = heapBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+} // namespace Engine::Memory
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+/// Allocators for transient and fixed-size CPU data, keeping it off the general heap.
+///
+/// Arenas bump-allocate from large chunks and free everything at once; after the first
+/// frames they settle into a single chunk, so steady-state use costs no heap traffic at all.
+/// Every thread has a frame arena that empties itself on the thread's first use each frame.
+/// Pools recycle fixed-size objects through a free list. Arenas are
+/// std::pmr::memory_resources, so PmrList and PmrString allocate from them directly.
+namespace Engine::Memory
+{
+    struct Stats
+    {
+        // Served by arenas; frame arenas report theirs when they reset.
+        u64 arenaAllocations = 0;
+        u64 arenaBytes = 0;
+        // What arenas and pools took from and returned to the heap.
+        u64 heapAllocations = 0;
+        u64 heapFrees = 0;
+        u64 heapBytes = 0;
+    };
+
+    class Arena : public std::pmr::memory_resource
+    {
+    private:
+        struct Chunk
+        {
+            Chunk* next = nullptr;
+            size_t size = 0;
+        };
+
+    public:
+        static constexpr size_t DefaultChunkSize = 64 * 1024;
+
+    private:
+        // Newest first. The caller's buffer, if any, isn't one of them.
+        Chunk* chunks = nullptr;
+        u8* head = nullptr;
+        u8* end = nullptr;
+        u8* buffer = nullptr;
+        size_t bufferSize = 0;
+        size_t chunkSize = DefaultChunkSize;
+        // Since the last reset.
+        size_t used = 0;
+        u64 allocations = 0;
+        bool startedInBuffer = true;
+        bool overflowed = false;
+
+    public:
+        size_t getUsed() const { return used; }
+        u64 getAllocationCount() const { return allocations; }
+
+        /// <summary>
+        /// Frees everything at once. Chunks merge into one holding all of this round's
+        /// allocations, so the next round of the same size needs no more.
+        /// </summary>
+        void reset();
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        // Memory only comes back on reset().
+        void do_deallocate(void*, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+        {
+            return this == &other;
+        }
+
+        void addChunk(size_t minSize);
+        void freeChunks();
+        void flushCounts();
+
+    public:
+        explicit Arena(size_t chunkSize = DefaultChunkSize);
+        // Allocates from buffer first, only going to the heap once it's full.
+        Arena(void* buffer, size_t bufferSize, size_t chunkSize = DefaultChunkSize);
+        ~Arena();
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+    };
+
+    // Starts a frame: each thread's frame arena resets on its next use. Called by
+    // Frame::begin().
+    void nextFrame();
+    // This thread's arena for data that may be dropped at the next frame.
+    Arena& getFrameArena();
+
+    Stats getStats();
+
+    // Heap traffic behind arenas and pools, for getStats().
+    void* heapAllocate(size_t bytes, size_t alignment);
+    void heapFree(void* data, size_t bytes, size_t alignment);
+
+    /// <summary>
+    /// Fixed-size objects recycled through a free list, allocated in blocks of BlockSize.
+    /// Not thread-safe; destroy() every object before the pool goes.
+    /// </summary>
+    template<class T, u32 BlockSize = 64>
+    class Pool
+    {
+    private:
+        union Node
+        {
+            Node* next;
+            alignas(T) u8 storage[sizeof(T)];
+        };
+
+        List<Node*> blocks;
+        Node* freeList = nullptr;
+        u32 liveCount = 0;
+
+    public:
+        u32 getLiveCount() const { return liveCount; }
+        u32 getCapacity() const { return (u32)blocks.size() * BlockSize; }
+
+        template<class... Args>
+        T* create(Args&&... args)
+        {
+            if (freeList == nullptr) {
+                addBlock();
+            }
+            auto node = freeList;
+            freeList = node->next;
+            liveCount++;
+            return new (node->storage) T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* object)
+        {
+            if (object == nullptr) return;
+
+            object->~T();
+            auto node = reinterpret_cast<Node*>(object);
+            node->next = freeList;
+            freeList = node;
+            liveCount--;
+        }
+
+    private:
+        void addBlock()
+        {
+            auto block = (Node*)heapAllocate(sizeof(Node) * BlockSize, alignof(Node));
+            for (auto i = 0u; i < BlockSize; i++)
+                block[i].next = i + 1 < BlockSize ? &block[i + 1] : freeList;
+            freeList = block;
+            blocks.push_back(block);
+        }
+
+    public:
+        Pool() = default;
+        ~Pool()
+        {
+            for (auto block : blocks)
+                heapFree(block, sizeof(Node) * BlockSize, alignof(Node));
+        }
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+    };
+} // namespace Engine::Memory
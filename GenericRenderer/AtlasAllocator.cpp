@@ -0,0 +1,114 @@
+#include "Precompiled.h"
+
+#include "AtlasAllocator.h"
+
+#include <algorithm>
+
+namespace Engine
+{
+    void AtlasAllocator::reset(u32 atlasSize, u32 minSize)
+    {
+        this->atlasSize = atlasSize;
+        this->minSize = std::min(minSize, atlasSize);
+        levels = 1;
+        for (auto size = atlasSize; size > this->minSize; size >>= 1)
+            levels++;
+
+        levelStart.assign(levels + 1, 0);
+        for (auto level = 0u; level < levels; level++)
+            levelStart[level + 1] = levelStart[level] + (1u << (2 * level));
+        nodes.assign(levelStart[levels], State::Absent);
+        freeCounts.assign(levels, 0);
+        nodes[0] = State::Free;
+        freeCounts[0] = 1;
+        usedArea = 0;
+    }
+
+    AtlasAllocator::Tile AtlasAllocator::allocate(u32 size)
+    {
+        // Level 0 is the whole atlas; each level down halves the size.
+        auto level = levels - 1;
+        while (level > 0 && (atlasSize >> level) < size)
+            level--;
+        if ((atlasSize >> level) < size) return Tile();
+
+        auto node = allocateAt(level);
+        if (node == UINT32_MAX) return Tile();
+        nodes[levelStart[level] + node] = State::Used;
+        freeCounts[level]--;
+        auto span = 1u << (levels - 1 - level);
+        usedArea += span * span;
+        return makeTile(level, node);
+    }
+
+    // A free node at level, splitting a larger one when needed; UINT32_MAX when full.
+    u32 AtlasAllocator::allocateAt(u32 level)
+    {
+        auto start = levelStart[level];
+        auto count = 1u << (2 * level);
+        if (freeCounts[level] > 0) {
+            for (auto node = 0u; node < count; node++) {
+                if (nodes[start + node] == State::Free) return node;
+            }
+        }
+        if (level == 0) return UINT32_MAX;
+
+        auto parent = allocateAt(level - 1);
+        if (parent == UINT32_MAX) return UINT32_MAX;
+        nodes[levelStart[level - 1] + parent] = State::Split;
+        freeCounts[level - 1]--;
+        // Children in Morton order, so a parent's four are contiguous.
+        auto first = parent * 4;
+        for (auto child = 0u; child < 4; child++)
+            nodes[start + first + child] = State::Free;
+        freeCounts[level] += 4;
+        return first;
+    }
+
+    void AtlasAllocator::free(const Tile& tile)
+    {
+        if (!tile.isValid()) return;
+
+        auto level = levels - 1;
+        while (level > 0 && (atlasSize >> level) < tile.size)
+            level--;
+        auto node = tile.node;
+        if (nodes[levelStart[level] + node] != State::Used) return;
+
+        nodes[levelStart[level] + node] = State::Free;
+        freeCounts[level]++;
+        auto span = 1u << (levels - 1 - level);
+        usedArea -= span * span;
+        // Merge upwards while all four quadrants are free.
+        while (level > 0) {
+            auto first = levelStart[level] + (node & ~3u);
+            auto merge = true;
+            for (auto child = 0u; child < 4; child++)
+                merge = merge && nodes[first + child] == State::Free;
+            if (!merge) break;
+
+            std::fill(&nodes[first], &nodes[first] + 4, State::Absent);
+            freeCounts[level] -= 4;
+            level--;
+            node >>= 2;
+            nodes[levelStart[level] + node] = State::Free;
+            freeCounts[level]++;
+        }
+    }
+
+    AtlasAllocator::Tile AtlasAllocator::makeTile(u32 level, u32 node) const
+    {
+        auto tile = Tile();
+        tile.size = atlasSize >> level;
+        tile.node = node;
+        // De-interleave the Morton index into quadrant coordinates.
+        auto x = 0u, y = 0u;
+        for (auto bit = 0u; bit < level; bit++) {
+            x |= ((node >> (2 * bit)) & 1) << bit;
+            y |= ((node >> (2 * bit + 1)) & 1) << bit;
+        }
+        tile.x = x * tile.size;
+        tile.y = y * tile.size;
+        return tile;
+    }
+} // namespace Engine
@@ -0,0 +1,62 @@
+#pragma once
+
+/// Square power-of-two tiles packed into a square atlas.
+///
+/// A quadtree buddy allocator: the atlas is the root, each node splits into four quadrants
+/// down to the smallest tile size, and a tile is one node. Allocating takes the first free
+/// node of the requested size, splitting a larger one when none is left; freeing merges the
+/// four quadrants back into their parent once all are free, so the atlas doesn't fragment
+/// into small tiles over time. Node state is a flat array, a few thousand entries for
+/// typical atlases.
+namespace Engine
+{
+    class AtlasAllocator
+    {
+    public:
+        struct Tile
+        {
+            u32 x = 0;
+            u32 y = 0;
+            u32 size = 0;
+            // Identifies the node for free().
+            u32 node = UINT32_MAX;
+
+            bool isValid() const { return node != UINT32_MAX; }
+        };
+
+    private:
+        enum class State : u8
+        {
+            // Inside a larger free or used node.
+            Absent,
+            Free,
+            Split,
+            Used,
+        };
+
+        u32 atlasSize = 0;
+        u32 minSize = 0;
+        u32 levels = 0;
+        List<State> nodes;
+        // Per level: the index of its first node, and its free node count.
+        List<u32> levelStart;
+        List<u32> freeCounts;
+        u32 usedArea = 0;
+
+    public:
+        u32 getAtlasSize() const { return atlasSize; }
+        u32 getMinSize() const { return minSize; }
+        // In texels, of allocated tiles.
+        u64 getUsedArea() const { return (u64)usedArea * minSize * minSize; }
+
+        // Both powers of two, minSize <= atlasSize.
+        void reset(u32 atlasSize, u32 minSize);
+        // size is rounded up to a power of two of at least the minimum. Invalid when full.
+        Tile allocate(u32 size);
+        void free(const Tile&);
+
+    private:
+        u32 allocateAt(u32 level);
+        Tile makeTile(u32 level, u32 node) const;
+    };
+} // namespace Engine
@@ -0,0 +1,155 @@
+#include "Precompiled.h"
+
+#include "Benchmark.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace Engine::Bench
+{
+    void summarize(Measurement& m, List<double>& samples)
+    {
+        m.iterations = (u32)samples.size();
+        if (samples.empty()) return;
+
+        std::sort(samples.begin(), samples.end());
+        auto sum = 0.0;
+        for (auto s : samples) {
+            sum += s;
+        }
+        m.mean = sum / samples.size();
+        m.min = samples.front();
+        m.max = samples.back();
+        auto mid = samples.size() / 2;
+        m.median = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2.0;
+    }
+
+    Config parseArgs(int argc, char** argv)
+    {
+        auto config = Config();
+        for (auto i = 1; i + 1 < argc; i += 2) {
+            auto key = argv[i];
+            auto value = argv[i + 1];
+            if (strcmp(key, "--iterations") == 0) {
+                config.iterations = (u32)std::max(1, atoi(value));
+            } else if (strcmp(key, "--warmup") == 0) {
+                config.warmup = (u32)std::max(0, atoi(value));
+            } else if (strcmp(key, "--tolerance") == 0) {
+                config.tolerance = atof(value);
+            } else if (strcmp(key, "--out") == 0) {
+                config.outPath = value;
+            } else if (strcmp(key, "--baseline") == 0) {
+                config.baselinePath = value;
+            } else if (strcmp(key, "--instances") == 0) {
+                config.instances = (u32)std::max(1, atoi(value));
+            } else if (strcmp(key, "--suite") == 0) {
+                config.suite = value;
+            } else if (strcmp(key, "--capture") == 0) {
+                config.capturePath = value;
+            } else {
+                fprintf(stderr, "Unknown argument: %s\n", key);
+            }
+        }
+        return config;
+    }
+
+    // Reads the median of the named case from a results file written by write().
+    // The format is our own, so a scan for the name/median keys is all that's needed.
+    bool findBaseline(const SString& json, const SString& name, double& out)
+    {
+        auto key = SString("\"name\": \"") + name + "\"";
+        auto at = json.find(key);
+        if (at == SString::npos) return false;
+
+        auto medianKey = SString("\"median\": ");
+        auto medianAt = json.find(medianKey, at);
+        auto nextCase = json.find("\"name\": ", at + key.size());
+        if (medianAt == SString::npos || (nextCase != SString::npos && medianAt > nextCase)) {
+            return false;
+        }
+        out = strtod(json.c_str() + medianAt + medianKey.size(), nullptr);
+        return true;
+    }
+
+    Result compare(const Config& config, List<Measurement>& results, u32& regressions)
+    {
+        regressions = 0;
+        if (config.baselinePath.empty()) return Result::Success;
+
+        auto file = std::ifstream(config.baselinePath);
+        if (!file) {
+            fprintf(stderr, "Baseline not found: %s\n", config.baselinePath.c_str());
+            return Result::Failed;
+        }
+        auto buffer = std::stringstream();
+        buffer << file.rdbuf();
+        if (file.bad()) {
+            fprintf(stderr, "Unable to read baseline: %s\n", config.baselinePath.c_str());
+            return Result::Failed;
+        }
+        auto json = buffer.str();
+
+        for (auto& m : results) {
+            if (!findBaseline(json, m.name, m.baseline) || m.baseline <= 0.0) continue;
+
+            if (m.metric == Metric::Latency) {
+                m.regressed = m.median > m.baseline * (1.0 + config.tolerance);
+            } else {
+                m.regressed = m.median < m.baseline * (1.0 - config.tolerance);
+            }
+            if (m.regressed) {
+                regressions++;
+            }
+        }
+        return Result::Success;
+    }
+
+    Result write(const Config& config, sstr suite, sstr device, const List<Measurement>& results)
+    {
+        auto file = fopen(config.outPath.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Unable to write results: %s\n", config.outPath.c_str());
+            return Result::Failed;
+        }
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"suite\": \"%s\",\n", suite);
+        fprintf(file, "  \"device\": \"%s\",\n", device);
+        fprintf(file, "  \"tolerance\": %.3f,\n", config.tolerance);
+        fprintf(file, "  \"results\": [\n");
+        for (auto i = 0u; i < results.size(); i++) {
+            auto& m = results[i];
+            auto unit = m.metric == Metric::Latency ? "ns/op" : "B/s";
+            fprintf(file, "    {\n");
+            fprintf(file, "      \"name\": \"%s\",\n", m.name.c_str());
+            fprintf(file, "      \"unit\": \"%s\",\n", unit);
+            fprintf(file, "      \"iterations\": %u,\n", m.iterations);
+            fprintf(file, "      \"median\": %.3f,\n", m.median);
+            fprintf(file, "      \"mean\": %.3f,\n", m.mean);
+            fprintf(file, "      \"min\": %.3f,\n", m.min);
+            fprintf(file, "      \"max\": %.3f,\n", m.max);
+            fprintf(file, "      \"baseline\": %.3f,\n", m.baseline);
+            fprintf(file, "      \"regressed\": %s\n", m.regressed ? "true" : "false");
+            fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n");
+        fprintf(file, "}\n");
+        fclose(file);
+
+        return Result::Success;
+    }
+
+    void print(const List<Measurement>& results)
+    {
+        printf("%-36s %16s %16s %16s %s\n", "case", "median", "min", "baseline", "");
+        for (auto& m : results) {
+            auto unit = m.metric == Metric::Latency ? "ns/op" : "B/s";
+            printf("%-36s %16.1f %16.1f %16.1f %s%s\n",
+                m.name.c_str(), m.median, m.min, m.baseline, unit,
+                m.regressed ? "  REGRESSED" : "");
+        }
+    }
+} // namespace Engine::Bench
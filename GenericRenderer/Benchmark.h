@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Precompiled.h"
+
+#include <algorithm>
+#include <chrono>
+
+/// A small headless microbenchmark harness.
+///
+/// Each case is timed per iteration, summarized, and written out as JSON. Results can be
+/// compared against a previous results file so regressions fail the run.
+namespace Engine::Bench
+{
+    enum class Metric
+    {
+        // Nanoseconds per operation; lower is better.
+        Latency,
+        // Bytes per second; higher is better.
+        Throughput
+    };
+
+    struct Measurement
+    {
+        SString name;
+        Metric metric = Metric::Latency;
+        u32 iterations = 0;
+        double median = 0.0;
+        double mean = 0.0;
+        double min = 0.0;
+        double max = 0.0;
+        // Value from the baseline file, or 0 if the case has no baseline.
+        double baseline = 0.0;
+        bool regressed = false;
+    };
+
+    struct Config
+    {
+        u32 iterations = 20;
+        u32 warmup = 2;
+        // Allowed relative slowdown against the baseline before a case counts as regressed.
+        double tolerance = 0.15;
+        SString outPath = "bench_output.json";
+        SString baselinePath;
+        // Object count for the CPU visibility cases.
+        u32 instances = 1000000;
+        // "cpu" runs only the cases that need no Vulkan device, "gpu" only those that do.
+        SString suite = "all";
+        // Capture file for DaedalusReplay.
+        SString capturePath;
+    };
+
+    inline u64 now()
+    {
+        using namespace std::chrono;
+        return (u64)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void summarize(Measurement&, List<double>&);
+
+    /// <summary>
+    /// Times fn over config.iterations runs, after warmup, and reports nanoseconds per op.
+    /// fn returns the number of operations it performed, so batched cases report unit cost.
+    /// </summary>
+    template<class Fn>
+    Measurement measureLatency(sstr name, const Config& config, Fn&& fn)
+    {
+        for (auto i = 0u; i < config.warmup; i++) {
+            fn();
+        }
+        auto samples = List<double>();
+        samples.reserve(config.iterations);
+        for (auto i = 0u; i < config.iterations; i++) {
+            auto start = now();
+            u64 ops = fn();
+            auto elapsed = now() - start;
+            samples.push_back((double)elapsed / (double)std::max<u64>(ops, 1));
+        }
+        auto m = Measurement();
+        m.name = name;
+        m.metric = Metric::Latency;
+        summarize(m, samples);
+        return m;
+    }
+
+    /// <summary>
+    /// Times fn over config.iterations runs, after warmup, and reports bytes per second.
+    /// fn returns the number of bytes it moved.
+    /// </summary>
+    template<class Fn>
+    Measurement measureThroughput(sstr name, const Config& config, Fn&& fn)
+    {
+        for (auto i = 0u; i < config.warmup; i++) {
+            fn();
+        }
+        auto samples = List<double>();
+        samples.reserve(config.iterations);
+        for (auto i = 0u; i < config.iterations; i++) {
+            auto start = now();
+            u64 bytes = fn();
+            auto elapsed = std::max<u64>(now() - start, 1);
+            samples.push_back((double)bytes * 1e9 / (double)elapsed);
+        }
+        auto m = Measurement();
+        m.name = name;
+        m.metric = Metric::Throughput;
+        summarize(m, samples);
+        return m;
+    }
+
+    Config parseArgs(int argc, char** argv);
+
+    // Loads the baseline named in config, marks regressed cases, and counts them. Fails when a
+    // baseline was given but can't be read, so a broken path can't pass the regression gate.
+    Result compare(const Config&, List<Measurement>&, u32& regressions);
+
+    Result write(const Config&, sstr suite, sstr device, const List<Measurement>&);
+
+    // Prints a human-readable table to stdout.
+    void print(const List<Measurement>&);
+} // namespace Engine::Bench
@@ -0,0 +1,564 @@
+#include "Precompiled.h"
+
+#if defined(_BENCHMARK)
+
+#include "Benchmark.h"
+#include "DaedalusCore.h"
+#include "DaedalusInternal.h"
+#include "DaedalusUploadRing.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "MathKernels.h"
+#include "Scene.h"
+#include "Visibility.h"
+#include "VulkanUtils.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+/// Headless Daedalus microbenchmarks.
+///
+/// Runs against whichever ICD the loader provides, e.g. a software ICD on Linux CI:
+///     VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./DaedalusBench
+///         --out bench_output.json --baseline bench_baseline.json --tolerance 0.15
+/// Exits non-zero when any case regresses past the tolerance.
+namespace Engine::Daedalus::Bench
+{
+    using namespace Engine::Bench;
+
+    struct Buffer
+    {
+        vk::Buffer buffer;
+        vk::DeviceMemory memory;
+    };
+
+    Buffer createBuffer(
+        vk::DeviceSize size,
+        vk::BufferUsageFlags usage,
+        vk::MemoryPropertyFlags props)
+    {
+        auto result = Buffer();
+        auto info = vk::BufferCreateInfo();
+        info.size = size;
+        info.usage = usage;
+        info.sharingMode = vk::SharingMode::eExclusive;
+        result.buffer = context.device.createBuffer(info);
+
+        auto reqs = context.device.getBufferMemoryRequirements(result.buffer);
+        auto memProps = activeProfile().gpu.getMemoryProperties();
+        auto allocInfo = vk::MemoryAllocateInfo();
+        allocInfo.allocationSize = reqs.size;
+        allocInfo.memoryTypeIndex = VkUtil::findMemoryType(memProps, reqs.memoryTypeBits, props);
+        result.memory = context.device.allocateMemory(allocInfo);
+        context.device.bindBufferMemory(result.buffer, result.memory, 0);
+        return result;
+    }
+
+    void destroyBuffer(Buffer& buffer)
+    {
+        context.device.destroyBuffer(buffer.buffer);
+        context.device.freeMemory(buffer.memory);
+        buffer = Buffer();
+    }
+
+    void submitAndWait(vk::Queue queue, const List<vk::CommandBuffer>& cmds, vk::Fence fence)
+    {
+        auto submit = vk::SubmitInfo();
+        submit.commandBufferCount = (u32)cmds.size();
+        submit.pCommandBuffers = cmds.data();
+        queue.submit(submit, fence);
+        (void)context.device.waitForFences(fence, VK_TRUE, UINT64_MAX);
+        context.device.resetFences(fence);
+    }
+
+    /// <summary>
+    /// Times only the timed call, which returns a Result; setup and teardown run outside the
+    /// measured region. A failing timed call aborts the case with no iterations, so a broken
+    /// path isn't reported as a fast one.
+    /// </summary>
+    template<class Setup, class Timed, class Teardown>
+    Measurement measureSection(
+        sstr name, const Config& config, Setup&& setup, Timed&& timed, Teardown&& teardown)
+    {
+        auto samples = List<double>();
+        for (auto i = 0u; i < config.warmup + config.iterations; i++) {
+            setup();
+            auto start = now();
+            auto result = timed();
+            auto elapsed = now() - start;
+            teardown();
+            if (result != Result::Success) {
+                fprintf(stderr, "%s failed; aborting the case.\n", name);
+                samples.clear();
+                break;
+            }
+            if (i >= config.warmup) {
+                samples.push_back((double)elapsed);
+            }
+        }
+        auto m = Measurement();
+        m.name = name;
+        summarize(m, samples);
+        return m;
+    }
+
+    Measurement benchInitialize(const Config& config)
+    {
+        return measureSection("initialize", config,
+            []() {},
+            []() { return initialize(); },
+            []() { terminate(); });
+    }
+
+    Measurement benchCreateDevice(const Config& config)
+    {
+        return measureSection("createDevice", config,
+            []() { initialize(); },
+            []() { return createHeadlessDevice(); },
+            []() { terminate(); });
+    }
+
+    Measurement benchRecordSubmit(const Config& config, vk::Fence fence)
+    {
+        const auto cmdCount = 256u;
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = context.gfxCmdPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = cmdCount;
+        auto cmds = context.device.allocateCommandBuffers(allocInfo);
+
+        auto m = measureLatency("cmd_record_submit", config, [&]() {
+            context.device.resetCommandPool(context.gfxCmdPool);
+            auto beginInfo = vk::CommandBufferBeginInfo();
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            for (auto& cmd : cmds) {
+                cmd.begin(beginInfo);
+                cmd.end();
+            }
+            submitAndWait(context.gfxQueue, cmds, fence);
+            return (u64)cmdCount;
+        });
+
+        context.device.freeCommandBuffers(context.gfxCmdPool, cmds);
+        context.device.resetCommandPool(context.gfxCmdPool);
+        return m;
+    }
+
+    Measurement benchAllocFree(const Config& config)
+    {
+        const auto allocCount = 64u;
+        const auto allocSize = (vk::DeviceSize)64 * 1024;
+        auto memProps = activeProfile().gpu.getMemoryProperties();
+        auto typeIdx = VkUtil::findMemoryType(
+            memProps, UINT32_MAX, vk::MemoryPropertyFlagBits::eDeviceLocal);
+        if (typeIdx == UINT32_MAX) {
+            typeIdx = 0;
+        }
+
+        auto memories = List<vk::DeviceMemory>(allocCount);
+        return measureLatency("memory_alloc_free", config, [&]() {
+            auto info = vk::MemoryAllocateInfo();
+            info.allocationSize = allocSize;
+            info.memoryTypeIndex = typeIdx;
+            for (auto& memory : memories) {
+                memory = context.device.allocateMemory(info);
+            }
+            for (auto& memory : memories) {
+                context.device.freeMemory(memory);
+            }
+            return (u64)allocCount;
+        });
+    }
+
+    Measurement benchStagingUpload(const Config& config, vk::Fence fence)
+    {
+        const auto size = (vk::DeviceSize)64 * 1024 * 1024;
+        using mem = vk::MemoryPropertyFlagBits;
+        using usage = vk::BufferUsageFlagBits;
+        auto staging = createBuffer(
+            size, usage::eTransferSrc, mem::eHostVisible | mem::eHostCoherent);
+        auto target = createBuffer(size, usage::eTransferDst, mem::eDeviceLocal);
+        auto source = List<u32>(size / sizeof(u32), 0xDAEDA105u);
+
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = context.tfrCmdPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+        auto cmds = context.device.allocateCommandBuffers(allocInfo);
+
+        auto mapped = context.device.mapMemory(staging.memory, 0, size);
+        auto m = measureThroughput("staging_upload", config, [&]() {
+            memcpy(mapped, source.data(), size);
+
+            context.device.resetCommandPool(context.tfrCmdPool);
+            auto beginInfo = vk::CommandBufferBeginInfo();
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            cmds[0].begin(beginInfo);
+            cmds[0].copyBuffer(staging.buffer, target.buffer, vk::BufferCopy(0, 0, size));
+            cmds[0].end();
+            submitAndWait(context.tfrQueue, cmds, fence);
+            return (u64)size;
+        });
+        context.device.unmapMemory(staging.memory);
+
+        context.device.freeCommandBuffers(context.tfrCmdPool, cmds);
+        destroyBuffer(staging);
+        destroyBuffer(target);
+        return m;
+    }
+
+    // Per-draw constants through the upload ring, written from every job thread at once.
+    Measurement benchUploadRing(const Config& config)
+    {
+        const auto pushCount = 8192u;
+        const auto constantSize = (vk::DeviceSize)256;
+        auto constants = List<u8>(constantSize, 0xA5);
+        Engine::Jobs::setup();
+        auto m = measureLatency("upload_ring_push", config, [&]() {
+            UploadRing::begin(0);
+            Engine::Jobs::parallelFor(pushCount, 256, [&](u32 begin, u32 end) {
+                for (auto i = begin; i < end; i++)
+                    UploadRing::push(constants.data(), constantSize, constantSize);
+            });
+            return (u64)pushCount;
+        });
+        Engine::Jobs::cleanup();
+        return m;
+    }
+
+    Measurement benchBarriers(const Config& config, vk::Fence fence)
+    {
+        const auto barrierCount = 4096u;
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = context.gfxCmdPool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = 1;
+        auto cmds = context.device.allocateCommandBuffers(allocInfo);
+
+        auto m = measureLatency("pipeline_barrier", config, [&]() {
+            context.device.resetCommandPool(context.gfxCmdPool);
+            auto beginInfo = vk::CommandBufferBeginInfo();
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            auto barrier = vk::MemoryBarrier();
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmds[0].begin(beginInfo);
+            for (auto i = 0u; i < barrierCount; i++) {
+                cmds[0].pipelineBarrier(
+                    vk::PipelineStageFlagBits::eTransfer,
+                    vk::PipelineStageFlagBits::eTransfer,
+                    {}, barrier, nullptr, nullptr);
+            }
+            cmds[0].end();
+            submitAndWait(context.gfxQueue, cmds, fence);
+            return (u64)barrierCount;
+        });
+
+        context.device.freeCommandBuffers(context.gfxCmdPool, cmds);
+        return m;
+    }
+
+    // CPU-side math kernels at the given SIMD level, named e.g. "mat4_multiply_avx2".
+    void benchMath(const Config& config, Math::SimdLevel level, List<Measurement>& results)
+    {
+        using namespace Engine::Math;
+        const auto count = 16384u;
+        setSimdLevel(level);
+        auto suffix = SString("_") + to_sstr(getSimdLevel());
+
+        // Deterministic pseudo-random scene, so runs are comparable.
+        auto seed = 1u;
+        auto next = [&seed](float range) {
+            seed = seed * 1664525u + 1013904223u;
+            return ((float)(seed >> 8) / (float)(1u << 24) * 2.0f - 1.0f) * range;
+        };
+        auto world = List<Mat4>(count);
+        auto local = List<Mat4>(count);
+        auto boxes = List<AABB>(count);
+        for (auto i = 0u; i < count; i++) {
+            auto rotation = normalize(Quat{ next(1.0f), next(1.0f), next(1.0f), next(1.0f) });
+            world[i] = Mat4::compose({ next(100.0f), next(100.0f), next(100.0f) }, rotation,
+                { 1.0f, 1.0f, 1.0f });
+            local[i] = Mat4::translation({ next(1.0f), next(1.0f), next(1.0f) });
+            auto extent = Vec3{ 1.0f + next(0.5f), 1.0f + next(0.5f), 1.0f + next(0.5f) };
+            boxes[i] = { extent * -1.0f, extent };
+        }
+        auto out = List<Mat4>(count);
+        auto components = List<float>(count * 6);
+        auto bounds = BoundsSoA();
+        bounds.centerX = components.data();
+        bounds.centerY = bounds.centerX + count;
+        bounds.centerZ = bounds.centerY + count;
+        bounds.extentX = bounds.centerZ + count;
+        bounds.extentY = bounds.extentX + count;
+        bounds.extentZ = bounds.extentY + count;
+        auto spheres = SpheresSoA{ bounds.centerX, bounds.centerY, bounds.centerZ, bounds.extentX };
+        auto visible = List<u32>(count);
+        // Kept so the cull calls aren't discarded.
+        auto visibleCount = 0u;
+        auto view = Mat4::lookAt({ 0.0f, 0.0f, 150.0f }, {}, { 0.0f, 1.0f, 0.0f });
+        auto frustum = Frustum::fromMatrix(
+            Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 300.0f) * view);
+
+        results.push_back(measureLatency(("mat4_multiply" + suffix).c_str(), config, [&]() {
+            multiplyMatrices(world.data(), local.data(), out.data(), count);
+            return (u64)count;
+        }));
+        results.push_back(measureLatency(("transform_bounds" + suffix).c_str(), config, [&]() {
+            transformBounds(world.data(), boxes.data(), bounds, count);
+            return (u64)count;
+        }));
+        results.push_back(measureLatency(("cull_bounds" + suffix).c_str(), config, [&]() {
+            visibleCount = cullBounds(frustum, bounds, count, visible.data());
+            return (u64)count;
+        }));
+        results.push_back(measureLatency(("cull_spheres" + suffix).c_str(), config, [&]() {
+            visibleCount = cullSpheres(frustum, spheres, count, visible.data());
+            return (u64)count;
+        }));
+        if (visibleCount == 0) {
+            Engine::Debug::Log("Math benchmark: nothing visible, the scene setup is off.\n");
+        }
+        setSimdLevel(detectSimdLevel());
+    }
+
+    // Transform propagation over a 100k-node hierarchy, after sparse and after full edits.
+    void benchScene(const Config& config, List<Measurement>& results)
+    {
+        using namespace Engine::Math;
+        const auto count = 100000u;
+        const auto roots = 64u;
+        auto scene = Scene();
+        auto nodes = List<NodeHandle>();
+        auto seed = 7u;
+        auto next = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 8;
+        };
+        for (auto i = 0u; i < count; i++) {
+            auto transform = Transform();
+            transform.position = { (float)(next() % 16), 0.0f, (float)(next() % 16) };
+            auto parent = i < roots ? NodeHandle() : nodes[next() % i];
+            nodes.push_back(scene.create(transform, parent));
+            scene.setLocalBounds(nodes.back(), { { -1.0f, -1.0f, -1.0f }, { 1.0f, 1.0f, 1.0f } });
+        }
+        scene.update();
+
+        auto frame = 0u;
+        auto touch = [&](u32 stride) {
+            frame++;
+            auto transform = Transform();
+            transform.rotation = Quat::fromAxisAngle({ 0.0f, 1.0f, 0.0f }, 0.01f * (float)frame);
+            for (auto i = frame % stride; i < count; i += stride)
+                scene.setTransform(nodes[i], transform);
+        };
+        results.push_back(measureSection("scene_update_sparse", config,
+            [&]() { touch(1000); },
+            [&]() { scene.update(); },
+            []() {}));
+        results.push_back(measureSection("scene_update_full", config,
+            [&]() { touch(1); },
+            [&]() { scene.update(); },
+            []() {}));
+    }
+
+    // BVH build, refit and cull over config.instances objects, with a linear frustum test
+    // over the same objects for reference.
+    void benchVisibility(const Config& config, List<Measurement>& results)
+    {
+        using namespace Engine::Math;
+        using namespace Engine::Visibility;
+        const auto count = config.instances;
+        auto seed = 11u;
+        auto next = [&seed](float range) {
+            seed = seed * 1664525u + 1013904223u;
+            return ((float)(seed >> 8) / (float)(1u << 24) * 2.0f - 1.0f) * range;
+        };
+
+        // Constant density, so the visible fraction doesn't depend on the count.
+        auto range = 10.0f * std::cbrt((float)count);
+        auto components = List<float>((size_t)count * 6);
+        auto bounds = BoundsSoA();
+        bounds.centerX = components.data();
+        bounds.centerY = bounds.centerX + count;
+        bounds.centerZ = bounds.centerY + count;
+        bounds.extentX = bounds.centerZ + count;
+        bounds.extentY = bounds.extentX + count;
+        bounds.extentZ = bounds.extentY + count;
+        auto coneComponents = List<float>((size_t)count * 4);
+        auto cones = ConesSoA();
+        cones.axisX = coneComponents.data();
+        cones.axisY = cones.axisX + count;
+        cones.axisZ = cones.axisY + count;
+        cones.cutoff = cones.axisZ + count;
+        auto renderData = List<RenderData>(count);
+        for (auto i = 0u; i < count; i++) {
+            bounds.centerX[i] = next(range);
+            bounds.centerY[i] = next(range);
+            bounds.centerZ[i] = next(range);
+            bounds.extentX[i] = 1.0f + next(0.5f);
+            bounds.extentY[i] = 1.0f + next(0.5f);
+            bounds.extentZ[i] = 1.0f + next(0.5f);
+            auto axis = normalize(Vec3{ next(1.0f), next(1.0f), next(1.0f) });
+            cones.axisX[i] = axis.x;
+            cones.axisY[i] = axis.y;
+            cones.axisZ[i] = axis.z;
+            // Half the objects are closed meshes that can't be cone culled.
+            cones.cutoff[i] = i % 2 ? 1.0f : 0.3f;
+            renderData[i].mesh = i % 4;
+        }
+        LodChain chains[4];
+        for (auto& chain : chains) {
+            chain.count = 4;
+            for (auto k = 1u; k < chain.count; k++)
+                chain.error[k] = 0.005f * (float)(1u << (2 * k));
+        }
+
+        auto objects = Objects();
+        objects.count = count;
+        objects.bounds = bounds;
+        objects.renderData = renderData.data();
+        objects.chains = chains;
+        objects.chainCount = 4;
+        objects.cones = cones;
+        auto eye = Vec3{ 0.0f, 0.0f, range * 1.2f };
+        auto view = View::fromCamera(Mat4::lookAt(eye, {}, { 0.0f, 1.0f, 0.0f }),
+            Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, range * 3.0f), eye, 1080.0f);
+
+        auto bvh = Bvh();
+        results.push_back(measureSection("bvh_build", config,
+            []() {},
+            [&]() { bvh.build(objects); },
+            []() {}));
+
+        // A tenth of the objects move each frame.
+        auto flags = List<u8>(count, 0);
+        auto frame = 0u;
+        results.push_back(measureSection("bvh_refit", config,
+            [&]() {
+                frame++;
+                std::fill(flags.begin(), flags.end(), 0);
+                for (auto i = frame % 10; i < count; i += 10) {
+                    bounds.centerX[i] += next(1.0f);
+                    bounds.centerY[i] += next(1.0f);
+                    flags[i] = Scene::Changed;
+                }
+            },
+            [&]() { bvh.refit(objects, flags.data(), Scene::Changed); },
+            []() {}));
+
+        auto visible = VisibleList();
+        results.push_back(measureSection("visibility_cull", config,
+            []() {},
+            [&]() { bvh.cull(view, objects, visible); },
+            []() {}));
+        auto linear = List<u32>(count);
+        auto linearCount = 0u;
+        results.push_back(measureSection("visibility_cull_linear", config,
+            []() {},
+            [&]() { linearCount = cullBounds(view.frustum, bounds, count, linear.data()); },
+            []() {}));
+        if (visible.size() == 0 || linearCount == 0) {
+            Engine::Debug::Log("Visibility benchmark: nothing visible, the scene setup is off.\n");
+        }
+    }
+
+    // Keying, sorting and batching config.instances draws over a few pipelines, materials
+    // and meshes, as a frame's visible list would.
+    void benchDraws(const Config& config, List<Measurement>& results)
+    {
+        const auto count = config.instances;
+        auto seed = 13u;
+        auto next = [&seed](u32 range) {
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) % range;
+        };
+        auto draws = List<DrawList::Draw>(count);
+        auto depths = List<float>(count);
+        for (auto i = 0u; i < count; i++) {
+            draws[i].pipeline = next(16);
+            draws[i].material = next(256);
+            draws[i].mesh = next(1024);
+            draws[i].instance = i;
+            depths[i] = 0.1f + (float)next(100000) * 0.01f;
+        }
+
+        auto list = DrawList();
+        results.push_back(measureSection("draw_list_build", config,
+            []() {},
+            [&]() {
+                list.resize(count);
+                Jobs::parallelFor(count, 4096, [&](u32 begin, u32 end) {
+                    for (auto i = begin; i < end; i++) {
+                        auto& draw = draws[i];
+                        auto depth = DrawList::quantizeDepth(depths[i], 0.1f, 1000.0f);
+                        list.set(i, DrawList::makeKey(0, draw.pipeline, draw.material,
+                            draw.mesh, depth), draw);
+                    }
+                });
+                list.build(256);
+            },
+            []() {}));
+        if (list.getBatches().empty()) {
+            Engine::Debug::Log("Draw list benchmark: no batches, the setup is off.\n");
+        }
+    }
+} // namespace Engine::Daedalus::Bench
+
+int main(int argc, char** argv)
+{
+    using namespace Engine::Daedalus;
+    using namespace Engine::Daedalus::Bench;
+
+    auto config = Engine::Bench::parseArgs(argc, argv);
+    auto results = List<Engine::Bench::Measurement>();
+
+    if (config.suite != "gpu") {
+        // Scalar first, as the reference the SIMD level is compared against.
+        benchMath(config, Engine::Math::SimdLevel::Scalar, results);
+        benchMath(config, Engine::Math::detectSimdLevel(), results);
+        Engine::Jobs::setup();
+        benchScene(config, results);
+        benchVisibility(config, results);
+        benchDraws(config, results);
+        Engine::Jobs::cleanup();
+    }
+
+    auto deviceName = SString("cpu");
+    if (config.suite != "cpu") {
+        results.push_back(benchInitialize(config));
+        results.push_back(benchCreateDevice(config));
+        auto initFailed = results[results.size() - 2].iterations == 0 ||
+            results.back().iterations == 0;
+
+        if (initFailed || initialize() != Result::Success ||
+            createHeadlessDevice() != Result::Success) {
+            fprintf(stderr, "Daedalus failed to create a headless device.\n");
+            terminate();
+            return 2;
+        }
+        deviceName = activeProfile().gpu.getProperties().deviceName.data();
+        auto fence = context.device.createFence(vk::FenceCreateInfo());
+
+        results.push_back(benchRecordSubmit(config, fence));
+        results.push_back(benchAllocFree(config));
+        results.push_back(benchStagingUpload(config, fence));
+        results.push_back(benchUploadRing(config));
+        results.push_back(benchBarriers(config, fence));
+
+        context.device.destroyFence(fence);
+        terminate();
+    }
+
+    auto regressions = 0u;
+    auto compared = Engine::Bench::compare(config, results, regressions);
+    Engine::Bench::print(results);
+    if (Engine::Bench::write(config, "daedalus", deviceName.c_str(), results) != Result::Success ||
+        compared != Result::Success) {
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+#endif // _BENCHMARK
@@ -0,0 +1,273 @@
+#include "Precompiled.h"
+
+#include "DaedalusCapabilities.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace Engine::Daedalus::Caps
+{
+    const u32 SnapshotMagic = 0x50414344; // "DCAP"
+    const u32 SnapshotVersion = 2;
+    const sstr SnapshotName = "daedalus_caps.bin";
+
+    // The loader version and installed layers and extensions the snapshot is valid for.
+    u64 instanceKey = 0;
+    List<SString> instanceLayers;
+    List<SString> instanceExtensions;
+    List<DeviceCaps> devices;
+    bool dirty = false;
+
+    /*
+    * Snapshot serialization. Everything is written little-endian-as-is; the snapshot is a
+    * per-machine cache, not an interchange format.
+    */
+
+    void writeU32(FILE* file, u32 value)
+    {
+        fwrite(&value, sizeof(value), 1, file);
+    }
+    void writeString(FILE* file, const SString& str)
+    {
+        writeU32(file, (u32)str.size());
+        fwrite(str.data(), 1, str.size(), file);
+    }
+    void writeStrings(FILE* file, const List<SString>& strs)
+    {
+        writeU32(file, (u32)strs.size());
+        for (auto& str : strs) {
+            writeString(file, str);
+        }
+    }
+
+    bool readU32(FILE* file, u32& value)
+    {
+        return fread(&value, sizeof(value), 1, file) == 1;
+    }
+    bool readString(FILE* file, SString& str)
+    {
+        auto size = 0u;
+        if (!readU32(file, size) || size > VK_MAX_EXTENSION_NAME_SIZE) return false;
+        str.resize(size);
+        return fread(str.data(), 1, size, file) == size;
+    }
+    bool readStrings(FILE* file, List<SString>& strs)
+    {
+        auto count = 0u;
+        if (!readU32(file, count) || count > 4096) return false;
+        strs.resize(count);
+        for (auto& str : strs) {
+            if (!readString(file, str)) return false;
+        }
+        return true;
+    }
+
+    // False for unreadable snapshots; a stale one reads fine but yields nothing.
+    bool readSnapshot(FILE* file)
+    {
+        auto magic = 0u;
+        auto version = 0u;
+        auto keyLow = 0u;
+        auto keyHigh = 0u;
+        if (!readU32(file, magic) || magic != SnapshotMagic) return false;
+        if (!readU32(file, version) || version != SnapshotVersion) return false;
+        if (!readU32(file, keyLow) || !readU32(file, keyHigh)) return false;
+        // Layers and ICDs can add device extensions, so any change re-probes devices too.
+        if ((((u64)keyHigh << 32) | keyLow) != instanceKey) {
+            dirty = true;
+            return true;
+        }
+
+        auto deviceCount = 0u;
+        if (!readU32(file, deviceCount) || deviceCount > 64) return false;
+        for (auto i = 0u; i < deviceCount; i++) {
+            auto caps = DeviceCaps();
+            auto familyCount = 0u;
+            if (fread(caps.uuid, 1, VK_UUID_SIZE, file) != VK_UUID_SIZE) return false;
+            if (!readU32(file, caps.driverVersion)) return false;
+            if (!readU32(file, familyCount) || familyCount > 64) return false;
+            caps.queueFamilies.resize(familyCount);
+            auto familyBytes = sizeof(vk::QueueFamilyProperties) * familyCount;
+            if (fread(caps.queueFamilies.data(), 1, familyBytes, file) != familyBytes) return false;
+            if (!readStrings(file, caps.extensions)) return false;
+            caps.extensionsProbed = true;
+            devices.push_back(std::move(caps));
+        }
+        return true;
+    }
+
+    // FNV-1a.
+    void hashInto(u64& hash, const void* data, size_t size)
+    {
+        for (auto i = (size_t)0; i < size; i++) {
+            hash ^= ((const u8*)data)[i];
+            hash *= 0x100000001B3ull;
+        }
+    }
+
+    // Only the loader and the layer and ICD manifests are consulted; no device is created.
+    void probeInstance()
+    {
+        instanceLayers.clear();
+        instanceExtensions.clear();
+        instanceKey = 0xCBF29CE484222325ull;
+        auto version = vk::enumerateInstanceVersion();
+        hashInto(instanceKey, &version, sizeof(version));
+        for (auto& layer : vk::enumerateInstanceLayerProperties()) {
+            instanceLayers.push_back(layer.layerName.data());
+            hashInto(instanceKey, layer.layerName.data(), instanceLayers.back().size() + 1);
+            hashInto(instanceKey, &layer.specVersion, sizeof(layer.specVersion));
+            hashInto(instanceKey, &layer.implementationVersion,
+                sizeof(layer.implementationVersion));
+        }
+        for (auto& ext : vk::enumerateInstanceExtensionProperties()) {
+            instanceExtensions.push_back(ext.extensionName.data());
+            hashInto(instanceKey, ext.extensionName.data(), instanceExtensions.back().size() + 1);
+            hashInto(instanceKey, &ext.specVersion, sizeof(ext.specVersion));
+        }
+    }
+
+    SString getCachePath(sstr fileName)
+    {
+        auto path = SString();
+#if defined(_WINDOWS)
+        char buffer[MAX_PATH];
+        auto length = GetModuleFileNameA(nullptr, buffer, MAX_PATH);
+        if (length > 0 && length < MAX_PATH) {
+            path.assign(buffer, length);
+        }
+#elif defined(__linux__)
+        char buffer[4096];
+        auto length = readlink("/proc/self/exe", buffer, sizeof(buffer));
+        if (length > 0 && length < (ssize_t)sizeof(buffer)) {
+            path.assign(buffer, (size_t)length);
+        }
+#endif
+        auto separator = path.find_last_of("/\\");
+        path.resize(separator == SString::npos ? 0 : separator + 1);
+        return path + fileName;
+    }
+
+    void load()
+    {
+        devices.clear();
+        dirty = false;
+        probeInstance();
+
+        auto file = fopen(getCachePath(SnapshotName).c_str(), "rb");
+        if (file == nullptr) {
+            dirty = true;
+            return;
+        }
+
+        if (!readSnapshot(file)) {
+            Engine::Debug::Log(u"Capability snapshot is unreadable; re-probing.\n");
+            devices.clear();
+            dirty = true;
+        }
+        fclose(file);
+    }
+
+    Result save()
+    {
+        if (!dirty) return Result::Success;
+
+        auto file = fopen(getCachePath(SnapshotName).c_str(), "wb");
+        if (file == nullptr) return Result::Failed;
+
+        writeU32(file, SnapshotMagic);
+        writeU32(file, SnapshotVersion);
+        writeU32(file, (u32)instanceKey);
+        writeU32(file, (u32)(instanceKey >> 32));
+
+        // Devices whose extensions were never requested aren't worth persisting.
+        auto persisted = 0u;
+        for (auto& caps : devices) {
+            persisted += caps.extensionsProbed ? 1 : 0;
+        }
+        writeU32(file, persisted);
+        for (auto& caps : devices) {
+            if (!caps.extensionsProbed) continue;
+            fwrite(caps.uuid, 1, VK_UUID_SIZE, file);
+            writeU32(file, caps.driverVersion);
+            writeU32(file, (u32)caps.queueFamilies.size());
+            fwrite(caps.queueFamilies.data(),
+                sizeof(vk::QueueFamilyProperties), caps.queueFamilies.size(), file);
+            writeStrings(file, caps.extensions);
+        }
+        fclose(file);
+
+        dirty = false;
+        return Result::Success;
+    }
+
+    bool contains(const List<SString>& list, sstr name)
+    {
+        for (auto& item : list) {
+            if (strcmp(item.c_str(), name) == 0) return true;
+        }
+        return false;
+    }
+
+    bool hasInstanceLayer(sstr name)
+    {
+        return contains(instanceLayers, name);
+    }
+
+    bool hasInstanceExtension(sstr name)
+    {
+        return contains(instanceExtensions, name);
+    }
+
+    DeviceCaps& getDevice(vk::PhysicalDevice gpu)
+    {
+        auto chain = gpu.getProperties2<
+            vk::PhysicalDeviceProperties2,
+            vk::PhysicalDeviceIDProperties>();
+        auto& properties = chain.get<vk::PhysicalDeviceProperties2>().properties;
+        auto& ids = chain.get<vk::PhysicalDeviceIDProperties>();
+
+        for (auto& caps : devices) {
+            auto sameDevice = memcmp(caps.uuid, ids.deviceUUID.data(), VK_UUID_SIZE) == 0;
+            if (sameDevice && caps.driverVersion == properties.driverVersion) {
+                caps.properties = properties;
+                return caps;
+            }
+            if (sameDevice) {
+                // Driver update; the cached entry is stale.
+                caps = DeviceCaps();
+                memcpy(caps.uuid, ids.deviceUUID.data(), VK_UUID_SIZE);
+                caps.driverVersion = properties.driverVersion;
+                caps.properties = properties;
+                caps.queueFamilies = gpu.getQueueFamilyProperties();
+                dirty = true;
+                return caps;
+            }
+        }
+
+        auto caps = DeviceCaps();
+        memcpy(caps.uuid, ids.deviceUUID.data(), VK_UUID_SIZE);
+        caps.driverVersion = properties.driverVersion;
+        caps.properties = properties;
+        caps.queueFamilies = gpu.getQueueFamilyProperties();
+        devices.push_back(std::move(caps));
+        dirty = true;
+        return devices.back();
+    }
+
+    bool hasDeviceExtension(vk::PhysicalDevice gpu, DeviceCaps& caps, sstr name)
+    {
+        if (!caps.extensionsProbed) {
+            for (auto& ext : gpu.enumerateDeviceExtensionProperties()) {
+                caps.extensions.push_back(ext.extensionName.data());
+            }
+            caps.extensionsProbed = true;
+            dirty = true;
+        }
+        return contains(caps.extensions, name);
+    }
+} // namespace Engine::Daedalus::Caps
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+/// Instance and device capability snapshot.
+///
+/// Device extension and queue family enumeration goes through every ICD, and is a measurable
+/// share of cold start. Results are probed once, written to disk next to the executable, and
+/// reused on the next launch. Instance layers and extensions are enumerated on every load();
+/// the snapshot is keyed by a fingerprint of them and the loader version, so installing a
+/// layer or ICD re-probes. Device data is further keyed by device UUID and driver version.
+/// Anything not in the snapshot is enumerated only when first asked for.
+namespace Engine::Daedalus::Caps
+{
+    struct DeviceCaps
+    {
+        u8 uuid[VK_UUID_SIZE] = {};
+        u32 driverVersion = 0;
+        vk::PhysicalDeviceProperties properties;
+        List<vk::QueueFamilyProperties> queueFamilies;
+        // Empty until first requested through hasDeviceExtension().
+        List<SString> extensions;
+        bool extensionsProbed = false;
+    };
+
+    // Enumerates instance layers and extensions, then reads the snapshot from disk if one
+    // exists and matches them. No device is queried here.
+    void load();
+    // Writes the snapshot back to disk if anything was probed since load().
+    Result save();
+
+    // fileName in the executable's directory, or the working directory when that's unknown.
+    // Where Daedalus keeps its caches.
+    SString getCachePath(sstr fileName);
+
+    bool hasInstanceLayer(sstr);
+    bool hasInstanceExtension(sstr);
+
+    // Returns capabilities for gpu, from the snapshot when the UUID and driver version match.
+    // The reference is only valid until the next call.
+    DeviceCaps& getDevice(vk::PhysicalDevice);
+    bool hasDeviceExtension(vk::PhysicalDevice, DeviceCaps&, sstr);
+} // namespace Engine::Daedalus::Caps
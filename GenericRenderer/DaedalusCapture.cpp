@@ -0,0 +1,319 @@
+#include "Precompiled.h"
+
+#include "DaedalusCapture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace Engine::Daedalus::Capture
+{
+    // Larger uploads are split, keeping record sizes within u32.
+    const u64 MaxUploadChunk = 256ull << 20;
+
+    SString path;
+    // Set by start(); recording begins at the next frame.
+    bool armed = false;
+    bool recording = false;
+    u32 framesLeft = 0;
+    // Draws can be recorded on any thread.
+    std::mutex streamMutex;
+    List<u8> stream;
+    u32 commandCount = 0;
+    u32 frameCount = 0;
+
+    void append(Op op, const void* cmd, u32 cmdSize, const void* data = nullptr, u32 dataSize = 0)
+    {
+        auto lock = std::unique_lock(streamMutex);
+        auto header = RecordHeader();
+        header.op = op;
+        header.size = cmdSize + dataSize;
+        auto at = stream.size();
+        stream.resize(at + sizeof(header) + header.size);
+        memcpy(&stream[at], &header, sizeof(header));
+        memcpy(&stream[at + sizeof(header)], cmd, cmdSize);
+        if (dataSize > 0) {
+            memcpy(&stream[at + sizeof(header) + cmdSize], data, dataSize);
+        }
+        commandCount++;
+    }
+
+    template<class T>
+    void append(Op op, const T& cmd)
+    {
+        append(op, &cmd, sizeof(cmd));
+    }
+
+    Result start(sstr path, u32 frameCount)
+    {
+        if (isCapturing()) {
+            Engine::Debug::Log("Capture: a capture is already running.\n");
+            return Result::Failed;
+        }
+        if (frameCount == 0) return Result::Failed;
+
+        Capture::path = path;
+        framesLeft = frameCount;
+        Capture::frameCount = 0;
+        commandCount = 0;
+        stream.clear();
+        armed = true;
+        return Result::Success;
+    }
+
+    Result stop()
+    {
+        if (!isCapturing()) return Result::Failed;
+        armed = false;
+        recording = false;
+
+        auto header = FileHeader();
+        header.commandCount = commandCount;
+        header.frameCount = frameCount;
+        auto file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            Engine::Debug::Log("Capture: unable to write {}.\n", path.c_str());
+            List<u8>().swap(stream);
+            return Result::Failed;
+        }
+        auto written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(stream.data(), 1, stream.size(), file) == stream.size();
+        fclose(file);
+        Engine::Debug::Log("Capture: wrote {} commands over {} frames to {}.\n",
+            commandCount, frameCount, path.c_str());
+        // Captures can be large; don't hold on to the memory.
+        List<u8>().swap(stream);
+        return written ? Result::Success : Result::Failed;
+    }
+
+    bool isCapturing()
+    {
+        return armed || recording;
+    }
+
+    Result load(sstr path, List<u8>& out)
+    {
+        auto file = fopen(path, "rb");
+        if (file == nullptr) return Result::Failed;
+        fseek(file, 0, SEEK_END);
+        auto size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        out.resize(size > 0 ? (size_t)size : 0);
+        auto read = fread(out.data(), 1, out.size(), file) == out.size();
+        fclose(file);
+
+        auto header = FileHeader();
+        if (!read || out.size() < sizeof(header)) return Result::Failed;
+        memcpy(&header, out.data(), sizeof(header));
+        if (header.magic != Magic || header.version > Version) {
+            Engine::Debug::Log("Capture: {} is not a capture this build can read.\n", path);
+            return Result::Failed;
+        }
+        return Result::Success;
+    }
+
+    bool next(const List<u8>& file, u64& cursor, RecordHeader& header, const u8*& payload)
+    {
+        cursor = std::max<u64>(cursor, sizeof(FileHeader));
+        if (cursor + sizeof(header) > file.size()) return false;
+        memcpy(&header, &file[cursor], sizeof(header));
+        if (cursor + sizeof(header) + header.size > file.size()) return false;
+        payload = &file[cursor + sizeof(header)];
+        cursor += sizeof(header) + header.size;
+        return true;
+    }
+
+    void recordFrameBegin(u64 frame)
+    {
+        if (armed) {
+            armed = false;
+            recording = true;
+            for (auto handle : Resources::getBufferHandles())
+                recordCreateBuffer(handle, Resources::getBuffer(handle)->desc);
+            for (auto handle : Resources::getImageHandles())
+                recordCreateImage(handle, Resources::getImage(handle)->desc);
+            Pipelines::captureLive();
+        }
+        if (!recording) return;
+
+        auto cmd = FrameCmd();
+        cmd.frame = frame;
+        append(Op::FrameBegin, cmd);
+    }
+
+    void recordFrameEnd(u64 frame)
+    {
+        if (!recording) return;
+
+        auto cmd = FrameCmd();
+        cmd.frame = frame;
+        append(Op::FrameEnd, cmd);
+        frameCount++;
+        if (--framesLeft == 0) {
+            stop();
+        }
+    }
+
+    void recordCreateBuffer(Resources::BufferHandle handle, const Resources::BufferDesc& desc)
+    {
+        if (!recording) return;
+
+        auto cmd = CreateBufferCmd();
+        cmd.id = toId(handle);
+        cmd.size = desc.size;
+        cmd.usage = (u32)desc.usage;
+        cmd.properties = (u32)desc.properties;
+        cmd.priority = (u32)desc.priority;
+        append(Op::CreateBuffer, cmd);
+    }
+
+    void recordCreateImage(Resources::ImageHandle handle, const Resources::ImageDesc& desc)
+    {
+        if (!recording) return;
+
+        auto& info = desc.info;
+        auto cmd = CreateImageCmd();
+        cmd.id = toId(handle);
+        cmd.flags = (u32)info.flags;
+        cmd.imageType = (u32)info.imageType;
+        cmd.format = (u32)info.format;
+        cmd.width = info.extent.width;
+        cmd.height = info.extent.height;
+        cmd.depth = info.extent.depth;
+        cmd.mipLevels = info.mipLevels;
+        cmd.arrayLayers = info.arrayLayers;
+        cmd.samples = (u32)info.samples;
+        cmd.tiling = (u32)info.tiling;
+        cmd.usage = (u32)info.usage;
+        cmd.aspect = (u32)desc.aspect;
+        cmd.priority = (u32)desc.priority;
+        append(Op::CreateImage, cmd);
+    }
+
+    void recordDestroyBuffer(Resources::BufferHandle handle)
+    {
+        if (!recording) return;
+
+        auto cmd = DestroyCmd();
+        cmd.id = toId(handle);
+        append(Op::DestroyBuffer, cmd);
+    }
+
+    void recordDestroyImage(Resources::ImageHandle handle)
+    {
+        if (!recording) return;
+
+        auto cmd = DestroyCmd();
+        cmd.id = toId(handle);
+        append(Op::DestroyImage, cmd);
+    }
+
+    void recordUpload(Resources::BufferHandle handle,
+        vk::DeviceSize offset, const void* data, vk::DeviceSize size)
+    {
+        if (!recording) return;
+
+        for (auto done = (u64)0; done < size; done += MaxUploadChunk) {
+            auto cmd = UploadBufferCmd();
+            cmd.id = toId(handle);
+            cmd.offset = offset + done;
+            cmd.size = std::min<u64>(size - done, MaxUploadChunk);
+            append(Op::UploadBuffer, &cmd, sizeof(cmd), (const u8*)data + done, (u32)cmd.size);
+        }
+    }
+    void recordCreateShader(vk::ShaderModule module, const u32* code, size_t size)
+    {
+        if (!recording) return;
+
+        auto cmd = CreateShaderCmd();
+        cmd.id = (u64)(VkShaderModule)module;
+        cmd.size = size;
+        append(Op::CreateShader, &cmd, sizeof(cmd), code, (u32)size);
+    }
+
+    void recordCreateLayout(vk::PipelineLayout layout, u32 setLayoutCount,
+        const vk::PushConstantRange* ranges, u32 rangeCount)
+    {
+        if (!recording) return;
+
+        auto cmd = CreateLayoutCmd();
+        cmd.id = (u64)(VkPipelineLayout)layout;
+        cmd.setLayoutCount = setLayoutCount;
+        cmd.rangeCount = rangeCount;
+        append(Op::CreateLayout, &cmd, sizeof(cmd), ranges,
+            rangeCount * (u32)sizeof(vk::PushConstantRange));
+    }
+
+    // The description with its handles zeroed, as they mean nothing in another process.
+    Pipelines::GraphicsDesc withoutHandles(const Pipelines::GraphicsDesc& desc)
+    {
+        auto result = desc;
+        result.layout = vk::PipelineLayout();
+        result.vertex = vk::ShaderModule();
+        result.fragment = vk::ShaderModule();
+        return result;
+    }
+
+    void recordCreatePipeline(Pipelines::PipelineHandle handle, const Pipelines::GraphicsDesc& desc)
+    {
+        if (!recording) return;
+
+        auto cmd = CreatePipelineCmd();
+        cmd.id = toId(handle);
+        cmd.layout = (u64)(VkPipelineLayout)desc.layout;
+        cmd.vertex = (u64)(VkShaderModule)desc.vertex;
+        cmd.fragment = (u64)(VkShaderModule)desc.fragment;
+        auto stripped = withoutHandles(desc);
+        append(Op::CreatePipeline, &cmd, sizeof(cmd), &stripped, sizeof(stripped));
+    }
+
+    void recordBindPipeline(Pipelines::PipelineHandle handle, const Pipelines::GraphicsDesc& state)
+    {
+        if (!recording) return;
+
+        auto cmd = BindPipelineCmd();
+        cmd.id = toId(handle);
+        auto stripped = withoutHandles(state);
+        append(Op::BindPipeline, &cmd, sizeof(cmd), &stripped, sizeof(stripped));
+    }
+
+    // Draws name raw buffers.
+    ResourceId findBuffer(vk::Buffer buffer)
+    {
+        auto handle = Resources::findBuffer(buffer);
+        return handle.isValid() ? toId(handle) : 0;
+    }
+
+    void recordDrawIndexed(const Draws::Geometry& geometry, const Draws::MeshRange& range,
+        u32 instanceCount, u32 firstInstance)
+    {
+        if (!recording) return;
+
+        auto cmd = DrawIndexedCmd();
+        cmd.vertices = findBuffer(geometry.vertices);
+        cmd.indices = findBuffer(geometry.indices);
+        cmd.indexType = (u32)geometry.indexType;
+        cmd.indexCount = range.indexCount;
+        cmd.instanceCount = instanceCount;
+        cmd.firstIndex = range.firstIndex;
+        cmd.vertexOffset = range.vertexOffset;
+        cmd.firstInstance = firstInstance;
+        append(Op::DrawIndexed, cmd);
+    }
+
+    void recordDrawMulti(const Draws::Geometry& geometry, const vk::MultiDrawIndexedInfoEXT* draws,
+        u32 count, u32 firstInstance)
+    {
+        if (!recording) return;
+
+        auto cmd = DrawMultiCmd();
+        cmd.vertices = findBuffer(geometry.vertices);
+        cmd.indices = findBuffer(geometry.indices);
+        cmd.indexType = (u32)geometry.indexType;
+        cmd.drawCount = count;
+        cmd.firstInstance = firstInstance;
+        append(Op::DrawMulti, &cmd, sizeof(cmd), draws,
+            count * (u32)sizeof(vk::MultiDrawIndexedInfoEXT));
+    }
+} // namespace Engine::Daedalus::Capture
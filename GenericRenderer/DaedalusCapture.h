@@ -0,0 +1,205 @@
+#pragma once
+
+#include "DaedalusDraws.h"
+#include "DaedalusResources.h"
+
+/// Frame capture: Daedalus commands serialized to a compact binary file.
+///
+/// While a capture runs, Daedalus modules report resource creation and destruction, buffer
+/// uploads (with their data, including what the upload ring handed out), pipeline creation
+/// and binds, the draws Draws records, and frame boundaries here, and the stream is written
+/// out once the requested frames have ended. DaedalusReplay.cpp re-executes a capture on a
+/// headless device with timing, so a frame can be reproduced on any machine without a window
+/// or the assets that produced it.
+namespace Engine::Daedalus::Capture
+{
+    // "DCAP", little-endian.
+    const u32 Magic = 0x50414344;
+    const u32 Version = 1;
+
+    enum class Op : u32
+    {
+        FrameBegin,
+        FrameEnd,
+        CreateBuffer,
+        CreateImage,
+        DestroyBuffer,
+        DestroyImage,
+        UploadBuffer,
+        CreateShader,
+        CreateLayout,
+        CreatePipeline,
+        BindPipeline,
+        DrawIndexed,
+        DrawMulti
+    };
+
+    // A file is a FileHeader followed by commandCount records, each a RecordHeader and size
+    // bytes of payload. Readers skip records with ops they don't know.
+    struct FileHeader
+    {
+        u32 magic = Magic;
+        u32 version = Version;
+        u32 commandCount = 0;
+        u32 frameCount = 0;
+    };
+
+    struct RecordHeader
+    {
+        Op op = Op::FrameBegin;
+        u32 size = 0;
+    };
+
+    // Resources and pipelines are named by their handle at capture time, as
+    // generation << 32 | index; shader modules and layouts by their Vulkan handle. 0 is none.
+    using ResourceId = u64;
+
+    struct FrameCmd
+    {
+        u64 frame = 0;
+    };
+
+    struct CreateBufferCmd
+    {
+        ResourceId id = 0;
+        u64 size = 0;
+        u32 usage = 0;
+        u32 properties = 0;
+        u32 priority = 0;
+        u32 padding = 0;
+    };
+
+    struct CreateImageCmd
+    {
+        ResourceId id = 0;
+        u32 flags = 0;
+        u32 imageType = 0;
+        u32 format = 0;
+        u32 width = 0;
+        u32 height = 0;
+        u32 depth = 0;
+        u32 mipLevels = 0;
+        u32 arrayLayers = 0;
+        u32 samples = 0;
+        u32 tiling = 0;
+        u32 usage = 0;
+        u32 aspect = 0;
+        u32 priority = 0;
+        u32 padding = 0;
+    };
+
+    struct DestroyCmd
+    {
+        ResourceId id = 0;
+    };
+
+    // Followed by size bytes of data.
+    struct UploadBufferCmd
+    {
+        ResourceId id = 0;
+        u64 offset = 0;
+        u64 size = 0;
+    };
+
+    // Followed by size bytes of SPIR-V.
+    struct CreateShaderCmd
+    {
+        ResourceId id = 0;
+        u64 size = 0;
+    };
+
+    // Followed by rangeCount vk::PushConstantRange. Descriptor set layouts aren't captured,
+    // only how many the layout had.
+    struct CreateLayoutCmd
+    {
+        ResourceId id = 0;
+        u32 setLayoutCount = 0;
+        u32 rangeCount = 0;
+    };
+
+    // Followed by the pipeline's Pipelines::GraphicsDesc, as laid out by the capturing build,
+    // with its handles zeroed.
+    struct CreatePipelineCmd
+    {
+        ResourceId id = 0;
+        ResourceId layout = 0;
+        ResourceId vertex = 0;
+        ResourceId fragment = 0;
+    };
+
+    // Followed by the Pipelines::GraphicsDesc the pipeline is bound with, as above.
+    struct BindPipelineCmd
+    {
+        ResourceId id = 0;
+    };
+
+    // Geometry buffers are named by the resource owning them, 0 when it isn't one.
+    struct DrawIndexedCmd
+    {
+        ResourceId vertices = 0;
+        ResourceId indices = 0;
+        u32 indexType = 0;
+        u32 indexCount = 0;
+        u32 instanceCount = 0;
+        u32 firstIndex = 0;
+        i32 vertexOffset = 0;
+        u32 firstInstance = 0;
+    };
+
+    // Followed by drawCount vk::MultiDrawIndexedInfoEXT.
+    struct DrawMultiCmd
+    {
+        ResourceId vertices = 0;
+        ResourceId indices = 0;
+        u32 indexType = 0;
+        u32 drawCount = 0;
+        u32 firstInstance = 0;
+        u32 padding = 0;
+    };
+
+    template<class T>
+    ResourceId toId(Handle<T> handle)
+    {
+        return ((u64)handle.generation << 32) | handle.index;
+    }
+
+    /// <summary>
+    /// Captures the next frameCount frames to path, starting at the next Frame::begin().
+    /// Resources alive at that point are recorded as created at the start of the capture,
+    /// without their contents.
+    /// </summary>
+    Result start(sstr path, u32 frameCount = 1);
+    // Writes whatever has been captured and stops. Called by the last captured Frame::end().
+    Result stop();
+    bool isCapturing();
+
+    // Reads a whole capture file and checks its header.
+    Result load(sstr path, List<u8>& out);
+    /// <summary>
+    /// Steps through the records of a loaded capture. Start with cursor at 0; each call
+    /// returns the next record and its payload, or false at the end or on a truncated record.
+    /// </summary>
+    bool next(const List<u8>& file, u64& cursor, RecordHeader& header, const u8*& payload);
+
+    // Hooks for Daedalus modules; they do nothing unless a capture is running. Binds and draws
+    // may be reported from any thread, but those of command buffers recorded at the same time
+    // interleave, so record captured frames from one thread.
+    void recordFrameBegin(u64 frame);
+    void recordFrameEnd(u64 frame);
+    void recordCreateBuffer(Resources::BufferHandle, const Resources::BufferDesc&);
+    void recordCreateImage(Resources::ImageHandle, const Resources::ImageDesc&);
+    void recordDestroyBuffer(Resources::BufferHandle);
+    void recordDestroyImage(Resources::ImageHandle);
+    void recordUpload(
+        Resources::BufferHandle, vk::DeviceSize offset, const void* data, vk::DeviceSize size);
+    // size in bytes.
+    void recordCreateShader(vk::ShaderModule, const u32* code, size_t size);
+    void recordCreateLayout(vk::PipelineLayout, u32 setLayoutCount,
+        const vk::PushConstantRange* ranges, u32 rangeCount);
+    void recordCreatePipeline(Pipelines::PipelineHandle, const Pipelines::GraphicsDesc&);
+    void recordBindPipeline(Pipelines::PipelineHandle, const Pipelines::GraphicsDesc& state);
+    void recordDrawIndexed(const Draws::Geometry&, const Draws::MeshRange&, u32 instanceCount,
+        u32 firstInstance);
+    void recordDrawMulti(const Draws::Geometry&, const vk::MultiDrawIndexedInfoEXT* draws,
+        u32 count, u32 firstInstance);
+} // namespace Engine::Daedalus::Capture
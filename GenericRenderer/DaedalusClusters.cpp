@@ -0,0 +1,359 @@
+#include "Precompiled.h"
+
+#include "DaedalusClusters.h"
+#include "DaedalusInternal.h"
+#include "DaedalusResources.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Engine::Daedalus::Clusters
+{
+    // Mirror ClusteredLighting.glsl.
+    struct GpuHeader
+    {
+        u32 grid[4];
+        float view[4];
+        float screen[4];
+        u32 lightCount[4];
+    };
+    struct GpuLight
+    {
+        float position[3];
+        float range;
+        float color[3];
+        u32 type;
+        float direction[3];
+        float cosOuter;
+        float cosInner;
+        float pad[3];
+    };
+    static_assert(sizeof(GpuHeader) == 64 && sizeof(GpuLight) == 64,
+        "Cluster buffers must match the std430 layouts in ClusteredLighting.glsl.");
+
+    // Covers any minStorageBufferOffsetAlignment.
+    const vk::DeviceSize SegmentAlignment = 256;
+
+    Config config;
+    Stats stats;
+    vk::DescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    vk::PipelineLayout layout = VK_NULL_HANDLE;
+    vk::Pipeline pipeline = VK_NULL_HANDLE;
+    vk::DescriptorPool descriptorPool = VK_NULL_HANDLE;
+    vk::DescriptorSet sets[Frame::FramesInFlight];
+
+    // Per frame slot: the header and lights, written by the host.
+    Resources::BufferHandle lightsHandle;
+    u8* lightsMapped = nullptr;
+    vk::DeviceSize lightsSegment = 0;
+    // Per frame slot: the list counts, then the lists, written by binning.
+    Resources::BufferHandle listsHandle;
+    vk::DeviceSize countsSize = 0;
+    vk::DeviceSize listsSegment = 0;
+
+    // Async compute only.
+    vk::CommandPool computePools[Frame::FramesInFlight];
+    vk::CommandBuffer computeCmds[Frame::FramesInFlight];
+    vk::Semaphore binned = VK_NULL_HANDLE;
+    u64 binnedValue = 0;
+
+    vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    Resources::BufferHandle createBuffer(vk::DeviceSize size, vk::MemoryPropertyFlags properties)
+    {
+        auto desc = Resources::BufferDesc();
+        desc.size = size;
+        desc.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        desc.properties = properties;
+        desc.priority = Residency::Priority::Critical;
+        desc.concurrent = true;
+        return Resources::createBuffer(desc);
+    }
+
+    Result createDescriptors()
+    {
+        auto stages = vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eFragment;
+        vk::DescriptorSetLayoutBinding bindings[3];
+        for (auto i = 0u; i < 3; i++)
+            bindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer,
+                1, stages);
+        auto layoutInfo = vk::DescriptorSetLayoutCreateInfo();
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        if (context.device.createDescriptorSetLayout(&layoutInfo, nullptr, &setLayout) !=
+            vk::Result::eSuccess) return Result::Failed;
+
+        auto poolSize = vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer,
+            3 * Frame::FramesInFlight);
+        auto poolInfo = vk::DescriptorPoolCreateInfo();
+        poolInfo.maxSets = Frame::FramesInFlight;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        if (context.device.createDescriptorPool(&poolInfo, nullptr, &descriptorPool) !=
+            vk::Result::eSuccess) return Result::Failed;
+
+        vk::DescriptorSetLayout setLayouts[Frame::FramesInFlight];
+        std::fill(setLayouts, setLayouts + Frame::FramesInFlight, setLayout);
+        auto allocInfo = vk::DescriptorSetAllocateInfo();
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = Frame::FramesInFlight;
+        allocInfo.pSetLayouts = setLayouts;
+        if (context.device.allocateDescriptorSets(&allocInfo, sets) != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+
+        auto lights = Resources::getBuffer(lightsHandle)->buffer;
+        auto lists = Resources::getBuffer(listsHandle)->buffer;
+        auto listsSize = listsSegment - countsSize;
+        for (auto slot = 0u; slot < Frame::FramesInFlight; slot++) {
+            vk::DescriptorBufferInfo infos[] = {
+                { lights, slot * lightsSegment, lightsSegment },
+                { lists, slot * listsSegment, countsSize },
+                { lists, slot * listsSegment + countsSize, listsSize },
+            };
+            vk::WriteDescriptorSet writes[3];
+            for (auto i = 0u; i < 3; i++) {
+                writes[i].dstSet = sets[slot];
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+                writes[i].pBufferInfo = &infos[i];
+            }
+            context.device.updateDescriptorSets(3, writes, 0, nullptr);
+        }
+        return Result::Success;
+    }
+
+    Result createPipeline(vk::ShaderModule binning)
+    {
+        auto layoutInfo = vk::PipelineLayoutCreateInfo();
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &setLayout;
+        auto created = context.device.createPipelineLayout(&layoutInfo, nullptr, &layout);
+        if (created != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+        auto info = vk::ComputePipelineCreateInfo();
+        info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+        info.stage.module = binning;
+        info.stage.pName = "main";
+        info.layout = layout;
+        auto result = context.device.createComputePipelines(VK_NULL_HANDLE, 1, &info, nullptr,
+            &pipeline);
+        return result == vk::Result::eSuccess ? Result::Success : Result::Failed;
+    }
+
+    Result createAsync()
+    {
+        auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        poolInfo.queueFamilyIndex = activeProfile().cmpFamilyIdx;
+        for (auto slot = 0u; slot < Frame::FramesInFlight; slot++) {
+            if (context.device.createCommandPool(&poolInfo, nullptr, &computePools[slot]) !=
+                vk::Result::eSuccess) return Result::Failed;
+            auto allocInfo = vk::CommandBufferAllocateInfo(computePools[slot],
+                vk::CommandBufferLevel::ePrimary, 1);
+            if (context.device.allocateCommandBuffers(&allocInfo, &computeCmds[slot]) !=
+                vk::Result::eSuccess) return Result::Failed;
+        }
+        auto typeInfo = vk::SemaphoreTypeCreateInfo();
+        typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        auto info = vk::SemaphoreCreateInfo();
+        info.pNext = &typeInfo;
+        if (context.device.createSemaphore(&info, nullptr, &binned) != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+        binnedValue = 0;
+        return Result::Success;
+    }
+
+    Result setup(vk::ShaderModule binning, const Config& config)
+    {
+        if (pipeline != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup clusters twice.\n");
+            return Result::Failed;
+        }
+        Clusters::config = config;
+        stats = Stats();
+        stats.asyncCompute = activeProfile().cmpFamilyIdx != UINT32_MAX;
+
+        auto clusterCount = (vk::DeviceSize)config.gridX * config.gridY * config.gridZ;
+        lightsSegment = alignUp(sizeof(GpuHeader) + sizeof(GpuLight) * config.maxLights,
+            SegmentAlignment);
+        countsSize = alignUp(clusterCount * sizeof(u32), SegmentAlignment);
+        listsSegment = countsSize + alignUp(clusterCount * config.maxLightsPerCluster *
+            sizeof(u32), SegmentAlignment);
+
+        using mem = vk::MemoryPropertyFlagBits;
+        lightsHandle = createBuffer(lightsSegment * Frame::FramesInFlight,
+            mem::eHostVisible | mem::eHostCoherent);
+        listsHandle = createBuffer(listsSegment * Frame::FramesInFlight, mem::eDeviceLocal);
+        auto lights = Resources::getBuffer(lightsHandle);
+        if (lights == nullptr || Resources::getBuffer(listsHandle) == nullptr) {
+            Engine::Debug::Log("Clusters: unable to allocate the light and cluster buffers.\n");
+            cleanup();
+            return Result::Failed;
+        }
+        lightsMapped = (u8*)Resources::map(lightsHandle);
+        if (lightsMapped == nullptr) {
+            cleanup();
+            return Result::Failed;
+        }
+
+        if (createDescriptors() != Result::Success || createPipeline(binning) != Result::Success ||
+            (stats.asyncCompute && createAsync() != Result::Success)) {
+            Engine::Debug::Log("Clusters: unable to create the binning pass.\n");
+            cleanup();
+            return Result::Failed;
+        }
+        return Result::Success;
+    }
+
+    void cleanup()
+    {
+        if (context.device == VK_NULL_HANDLE) return;
+
+        // Binning may still be running on either queue.
+        context.device.waitIdle();
+        for (auto slot = 0u; slot < Frame::FramesInFlight; slot++) {
+            if (computePools[slot] != VK_NULL_HANDLE) {
+                context.device.destroyCommandPool(computePools[slot]);
+            }
+            computePools[slot] = VK_NULL_HANDLE;
+            computeCmds[slot] = VK_NULL_HANDLE;
+            sets[slot] = VK_NULL_HANDLE;
+        }
+        context.device.destroySemaphore(binned);
+        context.device.destroyPipeline(pipeline);
+        context.device.destroyPipelineLayout(layout);
+        context.device.destroyDescriptorPool(descriptorPool);
+        context.device.destroyDescriptorSetLayout(setLayout);
+        binned = VK_NULL_HANDLE;
+        pipeline = VK_NULL_HANDLE;
+        layout = VK_NULL_HANDLE;
+        descriptorPool = VK_NULL_HANDLE;
+        setLayout = VK_NULL_HANDLE;
+
+        // Freeing the memory drops the mapping.
+        lightsMapped = nullptr;
+        Resources::destroyBuffer(lightsHandle);
+        Resources::destroyBuffer(listsHandle);
+        lightsHandle = Resources::BufferHandle();
+        listsHandle = Resources::BufferHandle();
+    }
+
+    void writeLights(u32 slot, const View& view, const Light* lights, u32 count)
+    {
+        auto segment = lightsMapped + slot * lightsSegment;
+        auto tanHalfY = std::tan(view.fovY * 0.5f);
+        auto sliceScale = (float)config.gridZ / std::log(view.farZ / view.nearZ);
+
+        auto header = GpuHeader();
+        header.grid[0] = config.gridX;
+        header.grid[1] = config.gridY;
+        header.grid[2] = config.gridZ;
+        header.grid[3] = config.maxLightsPerCluster;
+        header.view[0] = tanHalfY * view.aspect;
+        header.view[1] = tanHalfY;
+        header.view[2] = view.nearZ;
+        header.view[3] = view.farZ;
+        header.screen[0] = (float)view.width;
+        header.screen[1] = (float)view.height;
+        header.screen[2] = sliceScale;
+        header.screen[3] = -std::log(view.nearZ) * sliceScale;
+        header.lightCount[0] = count;
+        memcpy(segment, &header, sizeof(header));
+
+        // Written out whole, as the memory may be uncached.
+        auto out = (GpuLight*)(segment + sizeof(GpuHeader));
+        for (auto i = 0u; i < count; i++) {
+            auto& light = lights[i];
+            auto position = (view.view * Math::Vec4{ light.position.x, light.position.y,
+                light.position.z, 1.0f }).xyz();
+            auto direction = Math::normalize((view.view * Math::Vec4{ light.direction.x,
+                light.direction.y, light.direction.z, 0.0f }).xyz());
+            auto gpu = GpuLight{ { position.x, position.y, position.z }, light.range,
+                { light.color.x, light.color.y, light.color.z }, (u32)light.type,
+                { direction.x, direction.y, direction.z }, light.cosOuter, light.cosInner };
+            memcpy(&out[i], &gpu, sizeof(gpu));
+        }
+    }
+
+    void record(vk::CommandBuffer cmd, u32 slot)
+    {
+        cmd.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, sets[slot], nullptr);
+        cmd.dispatch(config.gridX, config.gridY, config.gridZ);
+    }
+
+    Frame::Wait bin(vk::CommandBuffer cmd, const View& view, const Light* lights, u32 count)
+    {
+        auto wait = Frame::Wait();
+        if (pipeline == VK_NULL_HANDLE) return wait;
+
+        stats.lights = std::min(count, config.maxLights);
+        stats.dropped = count - stats.lights;
+        // The slot's previous frame has completed, binning included, as its graphics
+        // submission waited for it.
+        auto slot = Frame::getFrameSlot();
+        writeLights(slot, view, lights, stats.lights);
+
+        if (!stats.asyncCompute) {
+            record(cmd, slot);
+            auto barrier = vk::MemoryBarrier();
+            barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                vk::PipelineStageFlagBits::eFragmentShader, {}, barrier, nullptr, nullptr);
+            return wait;
+        }
+
+        context.device.resetCommandPool(computePools[slot]);
+        auto computeCmd = computeCmds[slot];
+        computeCmd.begin(vk::CommandBufferBeginInfo(
+            vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        record(computeCmd, slot);
+        computeCmd.end();
+
+        // The graphics queue waits on the semaphore, which also makes the lists visible to it;
+        // the buffers are concurrent, so no ownership transfer is needed.
+        auto value = binnedValue + 1;
+        auto timelineInfo = vk::TimelineSemaphoreSubmitInfo();
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &value;
+        auto submit = vk::SubmitInfo();
+        submit.pNext = &timelineInfo;
+        submit.commandBufferCount = 1;
+        submit.pCommandBuffers = &computeCmd;
+        submit.signalSemaphoreCount = 1;
+        submit.pSignalSemaphores = &binned;
+        if (context.cmpQueue.submit(1, &submit, VK_NULL_HANDLE) != vk::Result::eSuccess) {
+            Engine::Debug::Log("Clusters: binning submission failed.\n");
+            return wait;
+        }
+        binnedValue = value;
+        wait.semaphore = binned;
+        wait.value = value;
+        wait.stages = vk::PipelineStageFlagBits::eFragmentShader;
+        return wait;
+    }
+
+    vk::DescriptorSetLayout getSetLayout()
+    {
+        return setLayout;
+    }
+
+    vk::DescriptorSet getSet()
+    {
+        return sets[Frame::getFrameSlot()];
+    }
+
+    const Stats& getStats()
+    {
+        return stats;
+    }
+} // namespace Engine::Daedalus::Clusters
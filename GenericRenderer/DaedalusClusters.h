@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusFrame.h"
+#include "Math.h"
+
+/// Clustered forward lighting.
+///
+/// The view frustum is divided into a grid of clusters, screen tiles by exponential depth
+/// slices. Every frame a compute pass bins the frame's point and spot lights into the clusters
+/// they touch, and forward shading then loops over only its cluster's list, so the cost per
+/// pixel follows the lights nearby rather than the lights in the scene. Binning runs on the
+/// async compute queue when the device has a separate compute family, overlapping whatever
+/// the graphics queue records before the lit passes, and inline in the frame otherwise.
+///
+/// Shaders/ClusterBinning.comp is the binning pass; lit shaders include
+/// Shaders/ClusteredLighting.glsl and bind getSet() at the set it names.
+namespace Engine::Daedalus::Clusters
+{
+    struct Config
+    {
+        u32 gridX = 16;
+        u32 gridY = 9;
+        u32 gridZ = 24;
+        u32 maxLights = 16384;
+        // Lights past this in one cluster are dropped from it.
+        u32 maxLightsPerCluster = 256;
+    };
+
+    enum class LightType : u32
+    {
+        Point = 0,
+        Spot = 1,
+    };
+
+    // World space.
+    struct Light
+    {
+        Math::Vec3 position;
+        // Where the light fades out entirely.
+        float range = 1.0f;
+        // Linear, premultiplied by intensity.
+        Math::Vec3 color = { 1.0f, 1.0f, 1.0f };
+        LightType type = LightType::Point;
+        // Spots only: the normalized axis and the cosines of the cone's outer and inner angles.
+        Math::Vec3 direction = { 0.0f, 0.0f, -1.0f };
+        float cosOuter = 0.7f;
+        float cosInner = 0.8f;
+    };
+
+    // The camera the frame is rendered with, as in Math::Mat4::lookAt and perspective.
+    struct View
+    {
+        Math::Mat4 view;
+        float fovY = 1.0f;
+        float aspect = 16.0f / 9.0f;
+        float nearZ = 0.1f;
+        float farZ = 1000.0f;
+        u32 width = 1920;
+        u32 height = 1080;
+    };
+
+    struct Stats
+    {
+        u32 lights = 0;
+        // Lights beyond Config::maxLights in the last bin() call.
+        u32 dropped = 0;
+        bool asyncCompute = false;
+    };
+
+    /// <summary>
+    /// Creates the binning pipeline from the compiled Shaders/ClusterBinning.comp, and the
+    /// per-frame light and cluster buffers. Call after the device is created, and cleanup()
+    /// before terminate().
+    /// </summary>
+    Result setup(vk::ShaderModule binning, const Config& = Config());
+    void cleanup();
+
+    /// <summary>
+    /// Bins lights for the current frame, after Frame::begin(). With async compute the pass
+    /// is submitted to the compute queue and the returned wait must go to Frame::end();
+    /// otherwise it is recorded into cmd, which must be submitted before the lit passes,
+    /// and the wait is invalid.
+    /// </summary>
+    Frame::Wait bin(vk::CommandBuffer cmd, const View&, const Light* lights, u32 count);
+
+    // For lit pipelines' layouts, with the fragment stage.
+    vk::DescriptorSetLayout getSetLayout();
+    // The current frame's lights and cluster lists.
+    vk::DescriptorSet getSet();
+    const Stats& getStats();
+} // namespace Engine::Daedalus::Clusters
@@ -5,36 +5,41 @@
 #include "DaedalusDebug.h"
 #endif
 
+#include <cstring>
+
 #include <vulkan/vulkan.hpp>
+#include "Allocators.h"
+#include "DaedalusCapabilities.h"
+#include "DaedalusDraws.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+#include "DaedalusPipelines.h"
+#include "DaedalusResidency.h"
+#include "DaedalusResources.h"
+#include "DaedalusSurfaces.h"
+#include "DaedalusUploadRing.h"
 #include "VulkanUtils.h"
 
 namespace Engine::Daedalus
 {
-    struct GPUProfile
-    {
-        vk::PhysicalDevice gpu;
-        bool isDiscrete = false;
-        u32 gfxFamilyIdx = UINT32_MAX;
-        u32 cmpFamilyIdx = UINT32_MAX;
-        u32 presentFamilyIdx = UINT32_MAX;
-        u32 dedicatedTfrFamilyIdx = UINT32_MAX;
-    };
-
-    vk::Instance instance = VK_NULL_HANDLE;
-    vk::SurfaceKHR surface = VK_NULL_HANDLE;
-    List<GPUProfile> gpuProfiles;
-    u32 activeGPUIdx = UINT32_MAX;
-    vk::Device device = VK_NULL_HANDLE;
-    vk::CommandPool gfxCmdPool = VK_NULL_HANDLE;
-    vk::CommandPool presentCmdPool = VK_NULL_HANDLE;
-    vk::CommandPool tfrCmdPool = VK_NULL_HANDLE;
-    vk::DispatchLoaderDynamic loader;
+    Context context;
+    // For renderFrame(); a pool per frame slot, so each is reset whole.
+    vk::CommandPool framePools[Frame::FramesInFlight];
+    vk::CommandBuffer frameCmds[Frame::FramesInFlight];
 
     inline bool success(vk::Result res) { return res == vk::Result::eSuccess; }
 
+    bool isDeviceExtensionEnabled(sstr name)
+    {
+        for (auto ext : context.enabledDeviceExts) {
+            if (strcmp(ext, name) == 0) return true;
+        }
+        return false;
+    }
+
     Result initialize()
     {
-        if (instance != VK_NULL_HANDLE) {
+        if (context.instance != VK_NULL_HANDLE) {
             return Result::Failed;
         }
 
@@ -42,32 +47,35 @@ namespace Engine::Daedalus
         // unavailable items in the enabled* vectors are considered required,
         // and available items in the optional* vectors will be pushed onto the enabled* vectors.
 
+        // Enumerates layers and extensions, and loads the device capability snapshot.
+        Caps::load();
+
         auto enabledLayers = List<sstr>();
 #if defined(_DEBUG)
-        auto validationLayer = SString("VK_LAYER_KHRONOS_validation");
-        enabledLayers.push_back(validationLayer.c_str());
+        auto validationLayer = "VK_LAYER_KHRONOS_validation";
+        if (Caps::hasInstanceLayer(validationLayer)) {
+            enabledLayers.push_back(validationLayer);
+        }
 #endif
 
         auto enabledExts = List<sstr>();
 #if defined(_DEBUG)
         enabledExts.push_back(vk::EXTDebugUtilsExtensionName);
 #endif
-#if defined(_WINDOWS)
+#if defined(_WINDOWS) && !defined(_HEADLESS)
         enabledExts.push_back(vk::KHRWin32SurfaceExtensionName);
 #endif
 #if defined(_SPATIAL)
         extensions.push_back(VK_KHR_MULTIVIEW_EXTENSION_NAME);
 #endif
+#if !defined(_HEADLESS)
         enabledExts.push_back(vk::KHRSurfaceExtensionName);
         enabledExts.push_back(vk::KHRGetSurfaceCapabilities2ExtensionName);
+#endif
         // Should be obsoleted with vulkan api version 1.1
         enabledExts.push_back(vk::KHRGetPhysicalDeviceProperties2ExtensionName);
         //enabledExtensions.push_back(VK_KHR_GET_DISPLAY_PROPERTIES_2_EXTENSION_NAME);
-        //enabledExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
-
-        auto supportedLayers = vk::enumerateInstanceLayerProperties();
-        auto supportedExtensions = vk::enumerateInstanceExtensionProperties();
-        auto supportedKhronosExts = vk::enumerateInstanceExtensionProperties(validationLayer);
+        // No render pass objects: Daedalus uses dynamic rendering, core in 1.3.
 
         auto appInfo = vk::ApplicationInfo();
         appInfo.pEngineName = "Generic Renderer";
@@ -89,87 +97,132 @@ namespace Engine::Daedalus
         instanceCI.pNext = &debugUtilsMessengerCI;
 #endif
 
-        instance = vk::createInstance(instanceCI);
+        auto res = vk::createInstance(&instanceCI, nullptr, &context.instance);
+        if (!success(res)) {
+            for (auto ext : enabledExts) {
+                if (!Caps::hasInstanceExtension(ext)) {
+                    Engine::Debug::Log(u"Instance extension missing: {}\n", ext);
+                }
+            }
+            context.instance = VK_NULL_HANDLE;
+            return Result::Failed;
+        }
 
 #if defined(_DEBUG)
-        Debug::setup(instance);
+        Debug::setup(context.instance);
 #endif
 
         return Result::Success;
     }
 
-    Result terminate()
+    // Tears down the device and everything made on it, keeping the instance.
+    void destroyDevice()
     {
-        if (gfxCmdPool != VK_NULL_HANDLE) {
-            device.destroyCommandPool(gfxCmdPool);
-            if (presentCmdPool != gfxCmdPool) {
-                device.destroyCommandPool(presentCmdPool);
+        // Releases its buffer through the frame, so it goes first.
+        UploadRing::cleanup();
+        Surfaces::cleanup();
+        // Flushes deferred destruction, which may still reference any of the below.
+        Frame::cleanup();
+        Pipelines::cleanup();
+        Resources::cleanup();
+
+        if (context.gfxCmdPool != VK_NULL_HANDLE) {
+            for (auto& pool : framePools) {
+                context.device.destroyCommandPool(pool);
+                pool = VK_NULL_HANDLE;
             }
-            if (tfrCmdPool != gfxCmdPool) {
-                device.destroyCommandPool(tfrCmdPool);
+            context.device.destroyCommandPool(context.gfxCmdPool);
+            if (context.tfrCmdPool != context.gfxCmdPool) {
+                context.device.destroyCommandPool(context.tfrCmdPool);
             }
-            gfxCmdPool = VK_NULL_HANDLE;
-            presentCmdPool = VK_NULL_HANDLE;
-            tfrCmdPool = VK_NULL_HANDLE;
+            context.gfxCmdPool = VK_NULL_HANDLE;
+            context.tfrCmdPool = VK_NULL_HANDLE;
         }
 
-        if (device != VK_NULL_HANDLE) {
-            device.destroy();
+        if (context.device != VK_NULL_HANDLE) {
+            Residency::cleanup();
+            context.device.destroy();
+            context.device = VK_NULL_HANDLE;
+            context.gfxQueue = VK_NULL_HANDLE;
+            context.tfrQueue = VK_NULL_HANDLE;
+            context.cmpQueue = VK_NULL_HANDLE;
+            context.presentQueue = VK_NULL_HANDLE;
         }
-        if (surface != VK_NULL_HANDLE) {
-            instance.destroy(surface);
-        }
-        if (instance != VK_NULL_HANDLE) {
+        // Filled in before the device exists, so failed creations leave them too.
+        context.enabledDeviceExts.clear();
+        context.gpuProfiles.clear();
+        context.activeGPUIdx = UINT32_MAX;
+    }
+
+    Result terminate()
+    {
+        destroyDevice();
+        if (context.instance != VK_NULL_HANDLE) {
+#if defined(_DEBUG)
             Debug::cleanup();
-            instance.destroy();
+#endif
+            context.instance.destroy();
+            context.instance = VK_NULL_HANDLE;
         }
 
         return Result::Success;
     }
 
-    Result createDevice()
+    // surface, if any, is the first the device presents to; it picks the GPU and queues.
+    Result createDevice(vk::SurfaceKHR surface)
     {
-        auto physicalDevices = instance.enumeratePhysicalDevices();
+        // Setup temporaries, all freed on return; this covers most devices without the heap.
+        alignas(16) u8 scratchBuffer[4096];
+        auto scratch = Memory::Arena(scratchBuffer, sizeof(scratchBuffer));
+        auto physicalDevices = context.instance.enumeratePhysicalDevices();
 
         // Acquire a GPU with both present and graphics capabilities.
         // If multiple GPUs support graphics and present, select:
         //physicalDeviceProperties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu;
         Engine::Debug::Log(u"============Physical Device Info============\n");
         for (auto gpu : physicalDevices) {
-#if defined(_DEBUG)
-            // A helpful visualization of queue family properties.
-            Engine::Debug::Log(VkUtil::to_prettyString(gpu, surface).c_str());
-#endif
             auto profile = GPUProfile();
             profile.gpu = gpu;
 
-            auto queueFamilyProperties = gpu.getQueueFamilyProperties();
-            auto properties = gpu.getProperties();
+            auto& caps = Caps::getDevice(gpu);
+            auto& queueFamilyProperties = caps.queueFamilies;
+            auto& properties = caps.properties;
 
             profile.isDiscrete = properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu;
 
-            List<vk::Bool32> supportsPresent(queueFamilyProperties.size());
+            // Without a surface (headless), no family is required to support present.
+            auto supportsPresent = PmrList<vk::Bool32>(queueFamilyProperties.size(), &scratch);
             for (auto i = 0; i < queueFamilyProperties.size(); i++) {
+                if (surface == VK_NULL_HANDLE) continue;
                 supportsPresent[i] = gpu.getSurfaceSupportKHR(i, surface);
                 if (profile.presentFamilyIdx == UINT32_MAX && supportsPresent[i]) {
                     profile.presentFamilyIdx = i;
                 }
             }
+#if defined(_DEBUG)
+            // A helpful visualization of queue family properties.
+            auto pretty = Format::StackBuffer<char16_t, 8192>();
+            VkUtil::writePrettyString(pretty, properties, queueFamilyProperties,
+                surface != VK_NULL_HANDLE ? supportsPresent.data() : nullptr);
+            Engine::Debug::Log(pretty.c_str());
+#endif
             // For now, like with most Vulkan samples, we'll try to get a family
             // that supports both graphics and present.
             // Later, we might also pick a queue that can focus exclusively on
             // transfer operations for moving local<->device data.
+            auto gfxSharesPresent = false;
             for (auto i = 0; i < queueFamilyProperties.size(); i++) {
                 auto& flags = queueFamilyProperties[i].queueFlags;
                 auto gfxFlag = vk::QueueFlagBits::eGraphics;
                 auto cmpFlag = vk::QueueFlagBits::eCompute;
                 auto tfrFlag = vk::QueueFlagBits::eTransfer;
 
+                // Keeps scanning after a graphics and present family, for the families below.
                 if (flags & gfxFlag) {
-                    if (supportsPresent[i]) {
+                    if (supportsPresent[i] && !gfxSharesPresent) {
                         profile.gfxFamilyIdx = i;
                         profile.presentFamilyIdx = i;
-                        break;
+                        gfxSharesPresent = true;
                     } else if (profile.gfxFamilyIdx == UINT32_MAX) {
                         profile.gfxFamilyIdx = i;
                     }
@@ -177,50 +230,74 @@ namespace Engine::Daedalus
                 if ((flags & tfrFlag) && !(flags & gfxFlag) && !(flags & cmpFlag)) {
                     profile.dedicatedTfrFamilyIdx = i;
                 }
+                // A compute-only family runs alongside graphics (async compute).
+                if ((flags & cmpFlag) && !(flags & gfxFlag) &&
+                    profile.cmpFamilyIdx == UINT32_MAX) {
+                    profile.cmpFamilyIdx = i;
+                }
             }
             if (profile.gfxFamilyIdx == UINT32_MAX ||
-                profile.presentFamilyIdx == UINT32_MAX) {
+                (profile.presentFamilyIdx == UINT32_MAX && surface != VK_NULL_HANDLE)) {
                 continue;
             }
-            gpuProfiles.push_back(profile);
+            context.gpuProfiles.push_back(profile);
         }
         Engine::Debug::Log(u"============================================\n");
 
-        if (gpuProfiles.size() < 1) {
-            OutputDebugString(L"Unable to find a GPU with graphics and present capabilities.");
+        if (context.gpuProfiles.size() < 1) {
+            Engine::Debug::Log(u"Unable to find a GPU with graphics and present capabilities.\n");
             return Result::Failed;
         }
 
-        for (auto i = 0; i < gpuProfiles.size(); i++) {
-            if (gpuProfiles[i].gfxFamilyIdx == gpuProfiles[i].presentFamilyIdx &&
-                gpuProfiles[i].isDiscrete) {
-                activeGPUIdx = i;
+        for (auto i = 0; i < context.gpuProfiles.size(); i++) {
+            auto& candidate = context.gpuProfiles[i];
+            auto sharesPresent = candidate.gfxFamilyIdx == candidate.presentFamilyIdx ||
+                surface == VK_NULL_HANDLE;
+            if (sharesPresent && candidate.isDiscrete) {
+                context.activeGPUIdx = i;
                 break;
             }
         }
-        if (activeGPUIdx == UINT32_MAX) {
-            OutputDebugString(L"GPU is not ideal.");
+        if (context.activeGPUIdx == UINT32_MAX) {
+            Engine::Debug::Log(u"GPU is not ideal.\n");
+            context.activeGPUIdx = 0;
         }
 
         // Select a favored GPU or let the user decide.
-        auto profile = gpuProfiles[activeGPUIdx];
-        auto supportedLayers = profile.gpu.enumerateDeviceLayerProperties();
-        auto supportedExtensions = profile.gpu.enumerateDeviceExtensionProperties();
+        auto profile = context.gpuProfiles[context.activeGPUIdx];
+        auto& caps = Caps::getDevice(profile.gpu);
 
         auto queuePriorities = 0.0f;
-        auto queueCreateInfos = List<vk::DeviceQueueCreateInfo>();
+        auto queueCreateInfos = PmrList<vk::DeviceQueueCreateInfo>(&scratch);
         auto graphicsQueueCI = vk::DeviceQueueCreateInfo();
         graphicsQueueCI.queueFamilyIndex = profile.gfxFamilyIdx;
         graphicsQueueCI.queueCount = 1;
         graphicsQueueCI.pQueuePriorities = &queuePriorities;
         queueCreateInfos.push_back(graphicsQueueCI);
-        if (profile.gfxFamilyIdx != profile.presentFamilyIdx) {
+        if (profile.presentFamilyIdx != UINT32_MAX &&
+            profile.gfxFamilyIdx != profile.presentFamilyIdx) {
             auto presentQueueCI = vk::DeviceQueueCreateInfo();
             presentQueueCI.queueFamilyIndex = profile.presentFamilyIdx;
             presentQueueCI.queueCount = 1;
             presentQueueCI.pQueuePriorities = &queuePriorities;
             queueCreateInfos.push_back(presentQueueCI);
         }
+        if (profile.dedicatedTfrFamilyIdx != UINT32_MAX &&
+            profile.dedicatedTfrFamilyIdx != profile.presentFamilyIdx) {
+            auto transferQueueCI = vk::DeviceQueueCreateInfo();
+            transferQueueCI.queueFamilyIndex = profile.dedicatedTfrFamilyIdx;
+            transferQueueCI.queueCount = 1;
+            transferQueueCI.pQueuePriorities = &queuePriorities;
+            queueCreateInfos.push_back(transferQueueCI);
+        }
+        if (profile.cmpFamilyIdx != UINT32_MAX &&
+            profile.cmpFamilyIdx != profile.presentFamilyIdx) {
+            auto computeQueueCI = vk::DeviceQueueCreateInfo();
+            computeQueueCI.queueFamilyIndex = profile.cmpFamilyIdx;
+            computeQueueCI.queueCount = 1;
+            computeQueueCI.pQueuePriorities = &queuePriorities;
+            queueCreateInfos.push_back(computeQueueCI);
+        }
 
         auto deviceFeatures = vk::PhysicalDeviceFeatures();
 
@@ -232,13 +309,24 @@ namespace Engine::Daedalus
         // Create Extension Lists
         {
             // Core rendering feature.
-            extensions.push_back(vk::KHRSwapchainExtensionName);
+            if (surface != VK_NULL_HANDLE) {
+                extensions.push_back(vk::KHRSwapchainExtensionName);
+            }
             // Variable rate shading
             optExtensions.push_back(vk::KHRFragmentShadingRateExtensionName);
+            // Per-heap budget and usage, for residency management.
+            optExtensions.push_back(vk::EXTMemoryBudgetExtensionName);
+            // Lets the driver know which allocations to keep resident under pressure.
+            optExtensions.push_back(vk::EXTMemoryPriorityExtensionName);
             // Intended for optimization of Pipeline Cache compilation during an app's runtime.
             optExtensions.push_back(vk::EXTPipelineCreationCacheControlExtensionName);
             // Speeds up sequences of draw commands by loading them all and obviating state checks.
             optExtensions.push_back(vk::EXTMultiDrawExtensionName);
+            // Dynamic blend and polygon mode, so they stop multiplying pipelines.
+            optExtensions.push_back(vk::EXTExtendedDynamicState3ExtensionName);
+            // Shaders compile once into libraries that new pipelines link against.
+            optExtensions.push_back(vk::KHRPipelineLibraryExtensionName);
+            optExtensions.push_back(vk::EXTGraphicsPipelineLibraryExtensionName);
             // [Obsolete] This extension enables GPU culling
             //optExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
             // This extension may help optimize framebuffer attachments that are also used as inputs.
@@ -304,18 +392,103 @@ namespace Engine::Daedalus
 #endif
 
             for (auto& eExt : extensions) {
-                auto found = false;
-                for (auto& sExt : supportedExtensions) {
-                    found |= strcmp(eExt, sExt.extensionName) == 0;
+                if (!Caps::hasDeviceExtension(profile.gpu, caps, eExt)) {
+                    Engine::Debug::Log(u"Extension missing: {}\n", eExt);
                 }
-                if (!found) {
-                    OutputDebugString(L"Extension missing: ");
-                    OutputDebugStringA(eExt);
-                    OutputDebugString(L"\n");
+            }
+            for (auto& oExt : optExtensions) {
+                if (Caps::hasDeviceExtension(profile.gpu, caps, oExt)) {
+                    extensions.push_back(oExt);
                 }
             }
+            context.enabledDeviceExts = extensions;
         }
         
+        // Features are chained through PhysicalDeviceFeatures2 so extension feature structs
+        // can be enabled alongside the core ones. Each is only chained when its extension is
+        // enabled, then filled with the device's support, which is exactly what we enable.
+        auto features = vk::PhysicalDeviceFeatures2();
+        auto chainFeature = [&features](auto& feature, sstr ext) {
+            if (!isDeviceExtensionEnabled(ext)) return;
+            feature.pNext = features.pNext;
+            features.pNext = &feature;
+        };
+        // Core in 1.2; the frame timeline depends on timeline semaphores.
+        auto vulkan12Features = vk::PhysicalDeviceVulkan12Features();
+        vulkan12Features.pNext = features.pNext;
+        features.pNext = &vulkan12Features;
+        // Core in 1.3; pipelines depend on dynamic rendering and extended dynamic state.
+        // Pipeline creation cache control is enabled through here rather than its extension.
+        if (caps.properties.apiVersion < VK_API_VERSION_1_3) {
+            Engine::Debug::Log(u"Vulkan 1.3 is not supported.\n");
+            destroyDevice();
+            return Result::Failed;
+        }
+        auto vulkan13Features = vk::PhysicalDeviceVulkan13Features();
+        vulkan13Features.pNext = features.pNext;
+        features.pNext = &vulkan13Features;
+        auto memoryPriorityFeatures = vk::PhysicalDeviceMemoryPriorityFeaturesEXT();
+        chainFeature(memoryPriorityFeatures, vk::EXTMemoryPriorityExtensionName);
+        auto dynamicState3Features = vk::PhysicalDeviceExtendedDynamicState3FeaturesEXT();
+        chainFeature(dynamicState3Features, vk::EXTExtendedDynamicState3ExtensionName);
+        auto libraryFeatures = vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT();
+        if (isDeviceExtensionEnabled(vk::KHRPipelineLibraryExtensionName)) {
+            chainFeature(libraryFeatures, vk::EXTGraphicsPipelineLibraryExtensionName);
+        }
+        auto multiDrawFeatures = vk::PhysicalDeviceMultiDrawFeaturesEXT();
+        chainFeature(multiDrawFeatures, vk::EXTMultiDrawExtensionName);
+#if defined(_DEBUG)
+        auto memoryReportFeatures = vk::PhysicalDeviceDeviceMemoryReportFeaturesEXT();
+        chainFeature(memoryReportFeatures, vk::EXTDeviceMemoryReportExtensionName);
+#endif
+        profile.gpu.getFeatures2(&features);
+        features.features = deviceFeatures;
+        if (!vulkan12Features.timelineSemaphore) {
+            Engine::Debug::Log(u"Timeline semaphores are not supported.\n");
+            destroyDevice();
+            return Result::Failed;
+        }
+
+        if (!vulkan13Features.dynamicRendering) {
+            Engine::Debug::Log(u"Dynamic rendering is not supported.\n");
+            destroyDevice();
+            return Result::Failed;
+        }
+        // Robust access bounds-checks every image access, which nothing here needs.
+        vulkan13Features.robustImageAccess = VK_FALSE;
+
+        auto memoryPriority = (bool)memoryPriorityFeatures.memoryPriority;
+        auto pipelineFeatures = Pipelines::Features();
+        pipelineFeatures.cacheControl = vulkan13Features.pipelineCreationCacheControl;
+        pipelineFeatures.libraries = libraryFeatures.graphicsPipelineLibrary;
+        if (pipelineFeatures.libraries) {
+            auto libraryProperties = vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT();
+            auto properties = vk::PhysicalDeviceProperties2();
+            properties.pNext = &libraryProperties;
+            profile.gpu.getProperties2(&properties);
+            pipelineFeatures.fastLinking = libraryProperties.graphicsPipelineLibraryFastLinking;
+        }
+        auto& dynamicState3 = dynamicState3Features;
+        pipelineFeatures.dynamicBlend = dynamicState3.extendedDynamicState3ColorBlendEnable &&
+            dynamicState3.extendedDynamicState3ColorBlendEquation &&
+            dynamicState3.extendedDynamicState3ColorWriteMask;
+        pipelineFeatures.dynamicPolygonMode = dynamicState3.extendedDynamicState3PolygonMode;
+        auto maxMultiDrawCount = 0u;
+        if (multiDrawFeatures.multiDraw) {
+            auto multiDrawProperties = vk::PhysicalDeviceMultiDrawPropertiesEXT();
+            auto properties = vk::PhysicalDeviceProperties2();
+            properties.pNext = &multiDrawProperties;
+            profile.gpu.getProperties2(&properties);
+            maxMultiDrawCount = multiDrawProperties.maxMultiDrawCount;
+        }
+#if defined(_DEBUG)
+        auto memoryReportCI = Residency::getMemoryReportCreateInfo();
+        if (memoryReportFeatures.deviceMemoryReport) {
+            memoryReportCI.pNext = features.pNext;
+            features.pNext = &memoryReportCI;
+        }
+#endif
+
         // Create Device
         {
             auto info = vk::DeviceCreateInfo();
@@ -325,41 +498,147 @@ namespace Engine::Daedalus
             info.ppEnabledLayerNames = layers.data();
             info.enabledExtensionCount = (u32)extensions.size();
             info.ppEnabledExtensionNames = extensions.data();
-            info.pEnabledFeatures = &deviceFeatures;
-            device = profile.gpu.createDevice(info);
+            info.pNext = &features;
+            context.device = profile.gpu.createDevice(info);
+            context.loader.init(context.instance, context.device);
+            context.gfxQueue = context.device.getQueue(profile.gfxFamilyIdx, 0);
+            context.tfrQueue = profile.dedicatedTfrFamilyIdx != UINT32_MAX ?
+                context.device.getQueue(profile.dedicatedTfrFamilyIdx, 0) : context.gfxQueue;
+            context.cmpQueue = profile.cmpFamilyIdx != UINT32_MAX ?
+                context.device.getQueue(profile.cmpFamilyIdx, 0) : context.gfxQueue;
+            context.presentQueue = profile.presentFamilyIdx != UINT32_MAX ?
+                context.device.getQueue(profile.presentFamilyIdx, 0) : context.gfxQueue;
+
+            Residency::setup(context.device, profile.gpu,
+                isDeviceExtensionEnabled(vk::EXTMemoryBudgetExtensionName), memoryPriority);
+            Frame::setup(context.device, context.gfxQueue);
+            Resources::setup(context.device);
+            Pipelines::setup(context.device, pipelineFeatures);
+            Draws::setup(maxMultiDrawCount);
+            if (UploadRing::setup() != Result::Success) {
+                // Also drops the profiles, so a later attempt starts over.
+                destroyDevice();
+                return Result::Failed;
+            }
         }
         
         // Create Command Pools
         {
             auto info = vk::CommandPoolCreateInfo();
             info.queueFamilyIndex = profile.gfxFamilyIdx;
-            gfxCmdPool = device.createCommandPool(info);
-            if (profile.presentFamilyIdx != profile.gfxFamilyIdx) {
-                info.queueFamilyIndex = profile.presentFamilyIdx;
-                presentCmdPool = device.createCommandPool(info);
-            } else {
-                presentCmdPool = gfxCmdPool;
-            }
+            context.gfxCmdPool = context.device.createCommandPool(info);
             if (profile.dedicatedTfrFamilyIdx != UINT32_MAX) {
                 info.queueFamilyIndex = profile.dedicatedTfrFamilyIdx;
-                tfrCmdPool = device.createCommandPool(info);
+                context.tfrCmdPool = context.device.createCommandPool(info);
             } else {
-                tfrCmdPool = gfxCmdPool;
+                context.tfrCmdPool = context.gfxCmdPool;
+            }
+
+            info.queueFamilyIndex = profile.gfxFamilyIdx;
+            info.flags = vk::CommandPoolCreateFlagBits::eTransient;
+            for (auto slot = 0u; slot < Frame::FramesInFlight; slot++) {
+                framePools[slot] = context.device.createCommandPool(info);
+                auto allocInfo = vk::CommandBufferAllocateInfo(framePools[slot],
+                    vk::CommandBufferLevel::ePrimary, 1);
+                frameCmds[slot] = context.device.allocateCommandBuffers(allocInfo)[0];
             }
         }
 
+        if (Caps::save() != Result::Success) {
+            Engine::Debug::Log(u"Unable to write the capability snapshot.\n");
+        }
+
         return Result::Success;
     }
 
+    // Clears a surface's image and leaves it ready to present.
+    void clearTarget(vk::CommandBuffer cmd, const Surfaces::Target& target)
+    {
+        if (!target.isValid()) return;
+
+        using layout = vk::ImageLayout;
+        using stage = vk::PipelineStageFlagBits;
+        // Chains onto the acquire's wait, which is at color attachment output.
+        auto barrier = vk::ImageMemoryBarrier();
+        barrier.dstAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barrier.oldLayout = layout::eUndefined;
+        barrier.newLayout = layout::eColorAttachmentOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = target.image;
+        barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,
+            0, 1, 0, 1);
+        cmd.pipelineBarrier(stage::eColorAttachmentOutput, stage::eColorAttachmentOutput, {},
+            nullptr, nullptr, barrier);
+
+        auto color = vk::RenderingAttachmentInfo();
+        color.imageView = target.view;
+        color.imageLayout = layout::eColorAttachmentOptimal;
+        color.loadOp = vk::AttachmentLoadOp::eClear;
+        color.storeOp = vk::AttachmentStoreOp::eStore;
+        auto info = vk::RenderingInfo();
+        info.renderArea = vk::Rect2D({ 0, 0 }, target.extent);
+        info.layerCount = 1;
+        info.colorAttachmentCount = 1;
+        info.pColorAttachments = &color;
+        cmd.beginRendering(info);
+        cmd.endRendering();
+
+        barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
+        barrier.dstAccessMask = {};
+        barrier.oldLayout = layout::eColorAttachmentOptimal;
+        barrier.newLayout = layout::ePresentSrcKHR;
+        cmd.pipelineBarrier(stage::eColorAttachmentOutput, stage::eBottomOfPipe, {}, nullptr,
+            nullptr, barrier);
+    }
+
+    Result renderFrame(bool& presented)
+    {
+        presented = false;
+        if (context.device == VK_NULL_HANDLE) return Result::Failed;
+        if (Frame::begin() != Result::Success) return Result::Failed;
+
+        auto slot = Frame::getFrameSlot();
+        context.device.resetCommandPool(framePools[slot]);
+        auto cmd = frameCmds[slot];
+        cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+        // Surfaces that are minimized or failed to acquire have no target this frame.
+        context.surfaces.forEach([cmd, &presented](SurfaceHandle handle, Surface&) {
+            auto target = Surfaces::getTarget(handle);
+            presented |= target.isValid();
+            clearTarget(cmd, target);
+        });
+        cmd.end();
+        return Frame::end({ cmd });
+    }
+
+    Result createHeadlessDevice()
+    {
+        if (context.instance == VK_NULL_HANDLE || context.device != VK_NULL_HANDLE) {
+            return Result::Failed;
+        }
+        return createDevice(VK_NULL_HANDLE);
+    }
+
 #if defined(_WINDOWS)
-    Result createSurface(HINSTANCE hInstance, HWND hWnd)
+    SurfaceHandle createSurface(HINSTANCE hInstance, HWND hWnd)
     {
+        if (context.instance == VK_NULL_HANDLE) return SurfaceHandle();
+
         auto createInfo = vk::Win32SurfaceCreateInfoKHR();
         createInfo.hinstance = hInstance;
         createInfo.hwnd = hWnd;
-        surface = instance.createWin32SurfaceKHR(createInfo);
+        auto surface = vk::SurfaceKHR();
+        if (!success(context.instance.createWin32SurfaceKHR(&createInfo, nullptr, &surface))) {
+            return SurfaceHandle();
+        }
 
-        return createDevice();
+        // The first surface creates the device; every later one shares it.
+        if (context.device == VK_NULL_HANDLE && createDevice(surface) != Result::Success) {
+            context.instance.destroySurfaceKHR(surface);
+            return SurfaceHandle();
+        }
+        return Surfaces::create(surface);
     }
 #endif
 
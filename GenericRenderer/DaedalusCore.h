@@ -1,6 +1,7 @@
 #pragma once
 
 #include "stdinc.h"
+#include "DaedalusSurfaces.h"
 
 #if defined (_WINDOWS)
 #include <Windows.h>
@@ -11,7 +12,17 @@ namespace Engine::Daedalus
     Result initialize();
     Result terminate();
 
+    // Creates a device without a presentation surface, i.e. for offscreen work and benchmarks.
+    Result createHeadlessDevice();
+
+    // Runs one frame through Frame::begin() and Frame::end() that clears every surface and
+    // presents it, standing in until a renderer records real passes. presented is false when
+    // no surface had an image to render into, e.g. while every window is minimized.
+    Result renderFrame(bool& presented);
+
 #if defined(_WINDOWS)
-    Result createSurface(HINSTANCE, HWND);
+    // The first surface creates the device, which every later surface shares. Invalid when
+    // the device can't present to the window. Release with Surfaces::destroy().
+    SurfaceHandle createSurface(HINSTANCE, HWND);
 #endif
 }
\ No newline at end of file
@@ -93,22 +93,22 @@ namespace Engine::Daedalus::Debug
         const VkDebugUtilsMessengerCallbackDataEXT* data,
         void* userData)
     {
-        auto pre = SString("");
-        auto tag = SString("Vulkan Debug");
-
-        auto severityLabel = SString(translateSeverityFlagBits(severityFlag));
-        auto typeLabel = SString(translateTypeFlags(typeFlags));
-
-        auto msg = pre + tag + " ";
+        auto severityLabel = translateSeverityFlagBits(severityFlag);
+        auto typeLabel = translateTypeFlags(typeFlags);
 
+        // Validation messages can run long, so the message body is logged directly rather
+        // than through a fixed-size format buffer.
         if ((typeFlags & VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT) != 0) {
-            msg += data->pMessage;
-            if (msg.back() != '\n') msg.push_back('\n');
+            Engine::Debug::Log("Vulkan Debug ");
         } else {
-            msg += severityLabel + " " + typeLabel + ": [" + data->pMessageIdName + "] " +
-                data->pMessage + "\n";
+            Engine::Debug::Log("Vulkan Debug {} {}: [{}] ",
+                severityLabel, typeLabel, data->pMessageIdName);
+        }
+        Engine::Debug::Log(data->pMessage);
+        auto length = Format::length(data->pMessage);
+        if (length == 0 || data->pMessage[length - 1] != '\n') {
+            Engine::Debug::Log("\n");
         }
-        Engine::Debug::Log((msg).c_str());
 
         return VK_TRUE;
     }
@@ -0,0 +1,110 @@
+#include "Precompiled.h"
+
+#include "DaedalusDraws.h"
+#include "DaedalusCapture.h"
+#include "DaedalusInternal.h"
+
+#include <algorithm>
+
+namespace Engine::Daedalus::Draws
+{
+    u32 maxMultiDrawCount = 0;
+    // Only touched by the thread recording, as with the command buffer itself.
+    thread_local List<vk::MultiDrawIndexedInfoEXT> multiDraws;
+
+    void setup(u32 maxMultiDrawCount)
+    {
+        Draws::maxMultiDrawCount = maxMultiDrawCount;
+    }
+
+    u32 getMaxMultiDraw()
+    {
+        return std::max(maxMultiDrawCount, 1u);
+    }
+
+    u32 drawMulti(vk::CommandBuffer cmd, const vk::MultiDrawIndexedInfoEXT* draws, u32 count,
+        u32 firstInstance)
+    {
+        if (maxMultiDrawCount == 0) {
+            for (auto i = 0u; i < count; i++)
+                cmd.drawIndexed(draws[i].indexCount, 1, draws[i].firstIndex, draws[i].vertexOffset,
+                    firstInstance + i);
+            return count;
+        }
+
+        // Shaders add gl_DrawID, which restarts with every command, to reach the draw's instance.
+        auto commands = 0u;
+        for (auto done = 0u; done < count; done += maxMultiDrawCount) {
+            cmd.drawMultiIndexedEXT(std::min(count - done, maxMultiDrawCount), draws + done, 1,
+                firstInstance + done, sizeof(vk::MultiDrawIndexedInfoEXT), nullptr,
+                context.loader);
+            commands++;
+        }
+        return commands;
+    }
+
+    RecordStats record(vk::CommandBuffer cmd, Pipelines::BindState& bindState,
+        const DrawList& list, u32 pass, const Geometry& geometry, const Bindings& bindings)
+    {
+        auto stats = RecordStats();
+        auto& batches = list.getBatches();
+        auto& meshes = list.getBatchMeshes();
+        // Batches are in key order, which starts with the pass.
+        auto first = std::partition_point(batches.begin(), batches.end(),
+            [pass](const DrawList::Batch& batch) { return batch.pass < pass; });
+        if (first == batches.end() || first->pass != pass) return stats;
+
+        cmd.bindVertexBuffers(0, geometry.vertices, (vk::DeviceSize)0);
+        cmd.bindIndexBuffer(geometry.indices, 0, geometry.indexType);
+        auto material = UINT32_MAX;
+        for (auto it = first; it != batches.end() && it->pass == pass; it++) {
+            auto& batch = *it;
+            stats.batches++;
+            if (batch.pipeline >= bindings.pipelineCount) {
+                stats.skipped++;
+                continue;
+            }
+            auto bound = bindState.pipeline;
+            if (!Pipelines::bind(cmd, bindState, bindings.pipelines[batch.pipeline],
+                bindings.states[batch.pipeline])) {
+                stats.skipped++;
+                continue;
+            }
+            if (bindState.pipeline != bound) {
+                stats.pipelineChanges++;
+            }
+            if (batch.material != material && bindings.bindMaterial != nullptr) {
+                bindings.bindMaterial(cmd, batch.material, bindings.user);
+                material = batch.material;
+                stats.materialChanges++;
+            }
+
+            if (batch.meshCount == 1) {
+                auto mesh = meshes[batch.firstMesh];
+                if (mesh >= geometry.meshCount) {
+                    stats.skipped++;
+                    continue;
+                }
+                auto& range = geometry.meshes[mesh];
+                cmd.drawIndexed(range.indexCount, batch.instanceCount, range.firstIndex,
+                    range.vertexOffset, batch.firstInstance);
+                Capture::recordDrawIndexed(geometry, range, batch.instanceCount,
+                    batch.firstInstance);
+                stats.commands++;
+                continue;
+            }
+
+            multiDraws.clear();
+            for (auto m = 0u; m < batch.meshCount; m++) {
+                auto mesh = meshes[batch.firstMesh + m];
+                auto range = mesh < geometry.meshCount ? geometry.meshes[mesh] : MeshRange();
+                multiDraws.push_back({ range.firstIndex, range.indexCount, range.vertexOffset });
+            }
+            stats.commands += drawMulti(cmd, multiDraws.data(), (u32)multiDraws.size(),
+                batch.firstInstance);
+            Capture::recordDrawMulti(geometry, multiDraws.data(), (u32)multiDraws.size(),
+                batch.firstInstance);
+        }
+        return stats;
+    }
+} // namespace Engine::Daedalus::Draws
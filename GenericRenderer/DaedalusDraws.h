@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusPipelines.h"
+#include "DrawList.h"
+
+/// Records a sorted DrawList into a command buffer.
+///
+/// Batches arrive in key order, so pipelines and materials are bound only where they change.
+/// Instanced batches are one drawIndexed each; multi-draw batches are one
+/// vkCmdDrawMultiIndexedEXT with VK_EXT_multi_draw, and a drawIndexed per mesh without it.
+/// Every draw's firstInstance points into DrawList::getInstances(), which the caller uploads
+/// for shaders to index.
+namespace Engine::Daedalus::Draws
+{
+    // Where a mesh lives in the shared vertex and index buffers.
+    struct MeshRange
+    {
+        u32 firstIndex = 0;
+        u32 indexCount = 0;
+        i32 vertexOffset = 0;
+    };
+
+    struct Geometry
+    {
+        vk::Buffer vertices;
+        vk::Buffer indices;
+        vk::IndexType indexType = vk::IndexType::eUint32;
+        // By the mesh ids in draw keys.
+        const MeshRange* meshes = nullptr;
+        u32 meshCount = 0;
+    };
+
+    // Binds whatever a material needs, typically its descriptor set.
+    using MaterialFn = void (*)(vk::CommandBuffer, u32 material, void* user);
+
+    struct Bindings
+    {
+        // By the pipeline ids in draw keys, with the state each is drawn with.
+        const Pipelines::PipelineHandle* pipelines = nullptr;
+        const Pipelines::GraphicsDesc* states = nullptr;
+        u32 pipelineCount = 0;
+        MaterialFn bindMaterial = nullptr;
+        void* user = nullptr;
+    };
+
+    struct RecordStats
+    {
+        u32 batches = 0;
+        // Draw commands, counting each mesh of an emulated multi-draw.
+        u32 commands = 0;
+        u32 pipelineChanges = 0;
+        u32 materialChanges = 0;
+        // Batches dropped for unknown ids or pipelines with nothing to draw with yet.
+        u32 skipped = 0;
+    };
+
+    // 0 without VK_EXT_multi_draw.
+    void setup(u32 maxMultiDrawCount);
+    // What to pass DrawList::build(): at least 1.
+    u32 getMaxMultiDraw();
+
+    // vkCmdDrawMultiIndexedEXT, split at the device's limit, or a drawIndexed per draw without
+    // VK_EXT_multi_draw; one instance per draw. Returns the number of draw commands recorded.
+    u32 drawMulti(vk::CommandBuffer, const vk::MultiDrawIndexedInfoEXT* draws, u32 count,
+        u32 firstInstance);
+
+    /// <summary>
+    /// Records the batches of one pass, in a command buffer that is rendering. Binds the
+    /// geometry buffers and tracks bound state in bindState, which may carry over between
+    /// passes recorded into the same command buffer.
+    /// </summary>
+    RecordStats record(vk::CommandBuffer, Pipelines::BindState& bindState, const DrawList&,
+        u32 pass, const Geometry&, const Bindings&);
+} // namespace Engine::Daedalus::Draws
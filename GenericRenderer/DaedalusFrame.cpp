@@ -0,0 +1,303 @@
+#include "Precompiled.h"
+
+#include "DaedalusFrame.h"
+#include "Allocators.h"
+#include "DaedalusCapture.h"
+#include "DaedalusPipelines.h"
+#include "DaedalusReadback.h"
+#include "DaedalusResolution.h"
+#include "DaedalusSurfaces.h"
+#include "DaedalusUploadRing.h"
+
+namespace Engine::Daedalus::Frame
+{
+    enum class Kind : u8
+    {
+        Buffer,
+        Image,
+        ImageView,
+        Sampler,
+        Pipeline,
+        PipelineLayout,
+        DescriptorSetLayout,
+        DescriptorPool,
+        ShaderModule,
+        QueryPool,
+        Semaphore,
+        Allocation,
+        Callback
+    };
+
+    // Pointer-free and trivially copyable, so the queue is a flat array of these.
+    struct Deferred
+    {
+        u64 frame = 0;
+        u64 handle = 0;
+        void* user = nullptr;
+        Kind kind = Kind::Buffer;
+    };
+
+    vk::Device device = VK_NULL_HANDLE;
+    vk::Queue queue = VK_NULL_HANDLE;
+    vk::Semaphore timeline = VK_NULL_HANDLE;
+    // Frame 0 is "before the first frame"; the first begin() moves to frame 1.
+    u64 currentFrame = 0;
+    // Appended in non-decreasing frame order; retired from head.
+    List<Deferred> deferred;
+    u64 deferredHead = 0;
+
+    void setup(vk::Device device, vk::Queue queue)
+    {
+        if (Frame::device != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup the frame timeline twice.\n");
+            return;
+        }
+        Frame::device = device;
+        Frame::queue = queue;
+
+        auto typeInfo = vk::SemaphoreTypeCreateInfo();
+        typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        typeInfo.initialValue = 0;
+        auto info = vk::SemaphoreCreateInfo();
+        info.pNext = &typeInfo;
+        timeline = device.createSemaphore(info);
+        currentFrame = 0;
+    }
+
+    void destroy(const Deferred& item)
+    {
+        switch (item.kind) {
+        case Kind::Buffer:
+            device.destroyBuffer(vk::Buffer((VkBuffer)item.handle));
+            break;
+        case Kind::Image:
+            device.destroyImage(vk::Image((VkImage)item.handle));
+            break;
+        case Kind::ImageView:
+            device.destroyImageView(vk::ImageView((VkImageView)item.handle));
+            break;
+        case Kind::Sampler:
+            device.destroySampler(vk::Sampler((VkSampler)item.handle));
+            break;
+        case Kind::Pipeline:
+            device.destroyPipeline(vk::Pipeline((VkPipeline)item.handle));
+            break;
+        case Kind::PipelineLayout:
+            device.destroyPipelineLayout(vk::PipelineLayout((VkPipelineLayout)item.handle));
+            break;
+        case Kind::DescriptorSetLayout:
+            device.destroyDescriptorSetLayout(
+                vk::DescriptorSetLayout((VkDescriptorSetLayout)item.handle));
+            break;
+        case Kind::DescriptorPool:
+            device.destroyDescriptorPool(vk::DescriptorPool((VkDescriptorPool)item.handle));
+            break;
+        case Kind::ShaderModule:
+            device.destroyShaderModule(vk::ShaderModule((VkShaderModule)item.handle));
+            break;
+        case Kind::QueryPool:
+            device.destroyQueryPool(vk::QueryPool((VkQueryPool)item.handle));
+            break;
+        case Kind::Semaphore:
+            device.destroySemaphore(vk::Semaphore((VkSemaphore)item.handle));
+            break;
+        case Kind::Allocation: {
+            auto id = Residency::AllocationId();
+            id.index = (u32)(item.handle >> 32);
+            id.generation = (u32)item.handle;
+            Residency::free(id);
+            break;
+        }
+        case Kind::Callback:
+            reinterpret_cast<DestroyFn>((uintptr_t)item.handle)(item.user);
+            break;
+        }
+    }
+
+    void retireUpTo(u64 completed)
+    {
+        while (deferredHead < deferred.size() && deferred[deferredHead].frame <= completed) {
+            destroy(deferred[deferredHead]);
+            deferredHead++;
+        }
+        // Compact once the retired prefix dominates, keeping the queue one flat allocation.
+        if (deferredHead == deferred.size()) {
+            deferred.clear();
+            deferredHead = 0;
+        } else if (deferredHead > 256 && deferredHead * 2 > deferred.size()) {
+            deferred.erase(deferred.begin(), deferred.begin() + deferredHead);
+            deferredHead = 0;
+        }
+    }
+
+    void cleanup()
+    {
+        if (device == VK_NULL_HANDLE) return;
+
+        // Shutdown is the one place a full idle is fine.
+        device.waitIdle();
+        retireUpTo(UINT64_MAX);
+        device.destroySemaphore(timeline);
+        timeline = VK_NULL_HANDLE;
+        device = VK_NULL_HANDLE;
+        queue = VK_NULL_HANDLE;
+    }
+
+    vk::Semaphore getTimeline()
+    {
+        return timeline;
+    }
+
+    u64 getCurrentFrame()
+    {
+        return currentFrame;
+    }
+
+    u64 getCompletedFrame()
+    {
+        return device.getSemaphoreCounterValue(timeline);
+    }
+
+    u32 getFrameSlot()
+    {
+        return (u32)(currentFrame % FramesInFlight);
+    }
+
+    void retire()
+    {
+        retireUpTo(getCompletedFrame());
+    }
+
+    Result begin()
+    {
+        currentFrame++;
+        Memory::nextFrame();
+        if (currentFrame > FramesInFlight) {
+            // Wait for the frame that last used this frame's slot.
+            auto waitValue = currentFrame - FramesInFlight;
+            auto waitInfo = vk::SemaphoreWaitInfo();
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &timeline;
+            waitInfo.pValues = &waitValue;
+            if (device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) {
+                return Result::Failed;
+            }
+        }
+        retire();
+        Residency::update();
+        Pipelines::update();
+        UploadRing::begin(getFrameSlot());
+        Resolution::update(getFrameSlot());
+        Readback::update();
+        Surfaces::acquire(getFrameSlot());
+        Capture::recordFrameBegin(currentFrame);
+        return Result::Success;
+    }
+
+    Result end(const List<vk::CommandBuffer>& cmds, const List<Wait>& waits)
+    {
+        auto& arena = Memory::getFrameArena();
+        auto waitSemaphores = PmrList<vk::Semaphore>(&arena);
+        auto waitValues = PmrList<u64>(&arena);
+        auto waitStages = PmrList<vk::PipelineStageFlags>(&arena);
+        for (auto& wait : waits) {
+            if (!wait.isValid()) continue;
+            waitSemaphores.push_back(wait.semaphore);
+            waitValues.push_back(wait.value);
+            waitStages.push_back(wait.stages);
+        }
+        // Earlier frames' captures may still be copying out of images this frame overwrites.
+        auto readback = Readback::getWait();
+        if (readback.isValid()) {
+            waitSemaphores.push_back(readback.semaphore);
+            waitValues.push_back(readback.value);
+            waitStages.push_back(readback.stages);
+        }
+
+        // Every surface's acquire and present go through this one submit. Their semaphores
+        // are binary, so their values are ignored.
+        auto signalSemaphores = PmrList<vk::Semaphore>({ timeline }, &arena);
+        Surfaces::getSemaphores(waitSemaphores, signalSemaphores);
+        // Images are first written by rendering, or by the upscaling blit.
+        using stage = vk::PipelineStageFlagBits;
+        waitValues.resize(waitSemaphores.size(), 0);
+        waitStages.resize(waitSemaphores.size(), stage::eColorAttachmentOutput | stage::eTransfer);
+        auto signalValues = PmrList<u64>(signalSemaphores.size(), 0, &arena);
+        signalValues[0] = currentFrame;
+
+        // The signal's scope covers all earlier submissions to this queue, so work submitted
+        // elsewhere in the frame is covered without listing it here. Other queues' work is
+        // covered through the waits.
+        auto timelineInfo = vk::TimelineSemaphoreSubmitInfo();
+        timelineInfo.waitSemaphoreValueCount = (u32)waitValues.size();
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+        timelineInfo.signalSemaphoreValueCount = (u32)signalValues.size();
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+        auto submit = vk::SubmitInfo();
+        submit.pNext = &timelineInfo;
+        submit.waitSemaphoreCount = (u32)waitSemaphores.size();
+        submit.pWaitSemaphores = waitSemaphores.data();
+        submit.pWaitDstStageMask = waitStages.data();
+        submit.commandBufferCount = (u32)cmds.size();
+        submit.pCommandBuffers = cmds.data();
+        submit.signalSemaphoreCount = (u32)signalSemaphores.size();
+        submit.pSignalSemaphores = signalSemaphores.data();
+        auto result = queue.submit(1, &submit, VK_NULL_HANDLE);
+        if (result == vk::Result::eSuccess) {
+            Readback::submit(currentFrame);
+            Surfaces::present();
+        } else {
+            Readback::discard();
+        }
+        UploadRing::capture();
+        Capture::recordFrameEnd(currentFrame);
+        return result == vk::Result::eSuccess ? Result::Success : Result::Failed;
+    }
+
+    void enqueue(Kind kind, u64 handle, void* user = nullptr)
+    {
+        if (handle == 0) return;
+
+        auto item = Deferred();
+        item.frame = currentFrame;
+        item.handle = handle;
+        item.user = user;
+        item.kind = kind;
+        deferred.push_back(item);
+    }
+
+    void destroyLater(vk::Buffer obj) { enqueue(Kind::Buffer, (u64)(VkBuffer)obj); }
+    void destroyLater(vk::Image obj) { enqueue(Kind::Image, (u64)(VkImage)obj); }
+    void destroyLater(vk::ImageView obj) { enqueue(Kind::ImageView, (u64)(VkImageView)obj); }
+    void destroyLater(vk::Sampler obj) { enqueue(Kind::Sampler, (u64)(VkSampler)obj); }
+    void destroyLater(vk::Pipeline obj) { enqueue(Kind::Pipeline, (u64)(VkPipeline)obj); }
+    void destroyLater(vk::PipelineLayout obj)
+    {
+        enqueue(Kind::PipelineLayout, (u64)(VkPipelineLayout)obj);
+    }
+    void destroyLater(vk::DescriptorSetLayout obj)
+    {
+        enqueue(Kind::DescriptorSetLayout, (u64)(VkDescriptorSetLayout)obj);
+    }
+    void destroyLater(vk::DescriptorPool obj)
+    {
+        enqueue(Kind::DescriptorPool, (u64)(VkDescriptorPool)obj);
+    }
+    void destroyLater(vk::ShaderModule obj)
+    {
+        enqueue(Kind::ShaderModule, (u64)(VkShaderModule)obj);
+    }
+    void destroyLater(vk::QueryPool obj) { enqueue(Kind::QueryPool, (u64)(VkQueryPool)obj); }
+    void destroyLater(vk::Semaphore obj) { enqueue(Kind::Semaphore, (u64)(VkSemaphore)obj); }
+
+    void destroyLater(Residency::AllocationId id)
+    {
+        if (!id.isValid()) return;
+        enqueue(Kind::Allocation, ((u64)id.index << 32) | id.generation);
+    }
+
+    void destroyLater(DestroyFn fn, void* user)
+    {
+        enqueue(Kind::Callback, (u64)reinterpret_cast<uintptr_t>(fn), user);
+    }
+} // namespace Engine::Daedalus::Frame
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusResidency.h"
+
+/// The frame timeline and deferred destruction.
+///
+/// Every frame signals a timeline semaphore with its frame number when its work completes.
+/// Objects released during a frame are queued with that number and destroyed once the
+/// timeline passes it, so releasing something the GPU may still be using never needs a
+/// vkDeviceWaitIdle.
+namespace Engine::Daedalus::Frame
+{
+    const u32 FramesInFlight = 2;
+
+    using DestroyFn = void (*)(void* user);
+
+    // Work the frame's submission waits for, e.g. another queue's timeline.
+    struct Wait
+    {
+        vk::Semaphore semaphore;
+        // Ignored for binary semaphores.
+        u64 value = 0;
+        vk::PipelineStageFlags stages = vk::PipelineStageFlagBits::eAllCommands;
+
+        bool isValid() const { return semaphore != VK_NULL_HANDLE; }
+    };
+
+    void setup(vk::Device, vk::Queue);
+    // Waits for the device, destroys everything still queued, and releases the timeline.
+    void cleanup();
+
+    vk::Semaphore getTimeline();
+    // The timeline value the current frame signals when its work completes.
+    u64 getCurrentFrame();
+    // The last timeline value the GPU has reached.
+    u64 getCompletedFrame();
+    // Index of the current frame's per-frame resources, in [0, FramesInFlight).
+    u32 getFrameSlot();
+
+    // Waits until the frame that last used this slot has completed, then retires
+    // deferred destruction, refreshes residency, publishes finished pipelines, resets
+    // the slot's upload ring segment, reads its GPU time for dynamic resolution, hands
+    // finished readbacks to the encoders and acquires every surface's next image.
+    Result begin();
+    // Submits cmds on the frame queue once the valid waits and the surfaces' acquires are met,
+    // then signals the timeline with the current frame. The frame's captures are copied out
+    // after it, and every surface is presented.
+    Result end(const List<vk::CommandBuffer>& cmds = {}, const List<Wait>& waits = {});
+
+    // Destroy or free once the GPU is done with the current frame.
+    void destroyLater(vk::Buffer);
+    void destroyLater(vk::Image);
+    void destroyLater(vk::ImageView);
+    void destroyLater(vk::Sampler);
+    void destroyLater(vk::Pipeline);
+    void destroyLater(vk::PipelineLayout);
+    void destroyLater(vk::DescriptorSetLayout);
+    void destroyLater(vk::DescriptorPool);
+    void destroyLater(vk::ShaderModule);
+    void destroyLater(vk::QueryPool);
+    void destroyLater(vk::Semaphore);
+    void destroyLater(Residency::AllocationId);
+    void destroyLater(DestroyFn, void* user);
+
+    // Destroys everything whose frame has completed. Called by begin().
+    void retire();
+} // namespace Engine::Daedalus::Frame
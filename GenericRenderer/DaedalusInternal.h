@@ -0,0 +1,77 @@
+#pragma once
+
+/// Engine-internal view of Daedalus core state, for Daedalus modules and tools
+/// (benchmarks, capture, etc). Not part of the public engine interface.
+
+#include <vulkan/vulkan.hpp>
+
+#include "HandleTable.h"
+
+namespace Engine::Daedalus
+{
+    struct GPUProfile
+    {
+        vk::PhysicalDevice gpu;
+        bool isDiscrete = false;
+        u32 gfxFamilyIdx = UINT32_MAX;
+        u32 cmpFamilyIdx = UINT32_MAX;
+        // Presents to the surface the device was created for, when there was one.
+        u32 presentFamilyIdx = UINT32_MAX;
+        u32 dedicatedTfrFamilyIdx = UINT32_MAX;
+    };
+
+    // A window's surface and its swapchain, owned by the context.
+    struct Surface
+    {
+        vk::SurfaceKHR surface;
+        vk::SwapchainKHR swapchain;
+        // The graphics queue, unless only the device's present queue can present here.
+        vk::Queue presentQueue;
+        u32 presentFamilyIdx = UINT32_MAX;
+        vk::SurfaceFormatKHR format;
+        vk::Extent2D extent;
+        List<vk::Image> images;
+        List<vk::ImageView> views;
+        // Signaled by acquires, one per frame slot; a slot's is free again once its frame is.
+        List<vk::Semaphore> acquired;
+        // Signaled by the frame for present, one per image, reused once the image is acquired.
+        List<vk::Semaphore> rendered;
+        // The image acquired this frame, if any.
+        u32 imageIndex = UINT32_MAX;
+        // Recreate the swapchain at the next acquire.
+        bool stale = true;
+    };
+
+    /// <summary>
+    /// The instance, the one device every surface shares, and what hangs off them. Everything
+    /// created on the device (allocations, pipelines, the pipeline cache) is shared too.
+    /// </summary>
+    struct Context
+    {
+        vk::Instance instance;
+        List<GPUProfile> gpuProfiles;
+        u32 activeGPUIdx = UINT32_MAX;
+        vk::Device device;
+        vk::Queue gfxQueue;
+        vk::Queue tfrQueue;
+        // On cmpFamilyIdx when the device has one, else the graphics queue.
+        vk::Queue cmpQueue;
+        // On presentFamilyIdx, else the graphics queue.
+        vk::Queue presentQueue;
+        vk::CommandPool gfxCmdPool;
+        vk::CommandPool tfrCmdPool;
+        List<sstr> enabledDeviceExts;
+        // For device extension commands, which the loader library doesn't export.
+        vk::DispatchLoaderDynamic loader;
+        HandleTable<Surface> surfaces;
+    };
+
+    extern Context context;
+
+    bool isDeviceExtensionEnabled(sstr);
+
+    inline const GPUProfile& activeProfile()
+    {
+        return context.gpuProfiles[context.activeGPUIdx];
+    }
+} // namespace Engine::Daedalus
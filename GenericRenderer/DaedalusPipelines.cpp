@@ -0,0 +1,731 @@
+#include "Precompiled.h"
+
+#include "DaedalusPipelines.h"
+#include "DaedalusCapabilities.h"
+#include "DaedalusCapture.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+#include "JobSystem.h"
+
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+namespace Engine::Daedalus::Pipelines
+{
+    static_assert(std::has_unique_object_representations_v<GraphicsDesc>,
+        "GraphicsDesc is compared and hashed bytewise, so it can't have padding.");
+    static_assert(sizeof(GraphicsDesc) % sizeof(u64) == 0);
+
+    // The driver checks the header and ignores data from another device or driver version.
+    const sstr CacheName = "daedalus_pipelines.bin";
+
+    // The state subsets of a graphics pipeline library.
+    enum class Part : u32
+    {
+        VertexInput,
+        PreRasterization,
+        FragmentShader,
+        FragmentOutput,
+        Count
+    };
+    const u32 PartCount = (u32)Part::Count;
+
+    const vk::GraphicsPipelineLibraryFlagsEXT PartFlags[PartCount] = {
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader,
+        vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface,
+    };
+
+    struct Library
+    {
+        GraphicsDesc desc;
+        vk::Pipeline pipeline;
+    };
+
+    struct LayoutInfo
+    {
+        u32 setLayoutCount = 0;
+        List<vk::PushConstantRange> ranges;
+    };
+
+    struct Finished
+    {
+        PipelineHandle handle;
+        vk::Pipeline pipeline;
+        vk::Result result = vk::Result::eSuccess;
+    };
+
+    vk::Device device = VK_NULL_HANDLE;
+    vk::PipelineCache cache = VK_NULL_HANDLE;
+    Features features;
+    List<vk::DynamicState> dynamicStates;
+    HandleTable<Pipeline> pipelines;
+    std::unordered_multimap<u64, PipelineHandle> byHash;
+    Stats stats;
+    // Jobs only touch these; everything else belongs to the render thread.
+    Jobs::Counter compiling;
+    std::mutex finishedMutex;
+    List<Finished> finished;
+    // Shared by every pipeline linked from them, so they live until cleanup().
+    std::mutex librariesMutex;
+    std::unordered_multimap<u64, Library> libraries[PartCount];
+    // What createShader() and createLayout() made their objects from, for captures.
+    std::unordered_map<VkShaderModule, List<u32>> shaderCode;
+    std::unordered_map<VkPipelineLayout, LayoutInfo> layoutInfos;
+
+    void setup(vk::Device device, const Features& features)
+    {
+        if (Pipelines::device != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup pipelines twice.\n");
+            return;
+        }
+        Pipelines::device = device;
+        Pipelines::features = features;
+        stats = Stats();
+
+        // Extended dynamic state 1 and 2 are core in 1.3.
+        dynamicStates = {
+            vk::DynamicState::eViewport,
+            vk::DynamicState::eScissor,
+            vk::DynamicState::eCullMode,
+            vk::DynamicState::eFrontFace,
+            vk::DynamicState::ePrimitiveTopology,
+            vk::DynamicState::eDepthTestEnable,
+            vk::DynamicState::eDepthWriteEnable,
+            vk::DynamicState::eDepthCompareOp,
+            vk::DynamicState::ePrimitiveRestartEnable,
+        };
+        if (features.dynamicPolygonMode) {
+            dynamicStates.push_back(vk::DynamicState::ePolygonModeEXT);
+        }
+        if (features.dynamicBlend) {
+            dynamicStates.push_back(vk::DynamicState::eColorBlendEnableEXT);
+            dynamicStates.push_back(vk::DynamicState::eColorBlendEquationEXT);
+            dynamicStates.push_back(vk::DynamicState::eColorWriteMaskEXT);
+        }
+
+        auto data = List<u8>();
+        auto file = fopen(Caps::getCachePath(CacheName).c_str(), "rb");
+        if (file != nullptr) {
+            fseek(file, 0, SEEK_END);
+            auto size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            data.resize(size > 0 ? (size_t)size : 0);
+            if (fread(data.data(), 1, data.size(), file) != data.size()) {
+                data.clear();
+            }
+            fclose(file);
+        }
+        auto info = vk::PipelineCacheCreateInfo();
+        info.initialDataSize = data.size();
+        info.pInitialData = data.data();
+        cache = device.createPipelineCache(info);
+    }
+
+    void save()
+    {
+        auto size = (size_t)0;
+        if (device.getPipelineCacheData(cache, &size, nullptr) != vk::Result::eSuccess) return;
+        auto data = List<u8>(size);
+        if (device.getPipelineCacheData(cache, &size, data.data()) != vk::Result::eSuccess) {
+            return;
+        }
+        auto path = Caps::getCachePath(CacheName);
+        auto file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            Engine::Debug::Log("Pipelines: unable to write {}.\n", path);
+            return;
+        }
+        fwrite(data.data(), 1, size, file);
+        fclose(file);
+    }
+
+    void cleanup()
+    {
+        if (device == VK_NULL_HANDLE) return;
+
+        Jobs::wait(compiling);
+        for (auto& result : finished)
+            device.destroyPipeline(result.pipeline);
+        finished.clear();
+        pipelines.forEach([](PipelineHandle, Pipeline& entry) {
+            device.destroyPipeline(entry.pipeline);
+        });
+        pipelines.clear();
+        byHash.clear();
+        shaderCode.clear();
+        layoutInfos.clear();
+        // After the pipelines linked from them.
+        for (auto& part : libraries) {
+            for (auto& [key, library] : part)
+                device.destroyPipeline(library.pipeline);
+            part.clear();
+        }
+
+        save();
+        device.destroyPipelineCache(cache);
+        cache = VK_NULL_HANDLE;
+        device = VK_NULL_HANDLE;
+    }
+
+    u64 hash(const GraphicsDesc& desc)
+    {
+        // FNV-1a over 64-bit words, folding high bits down each step so they reach the bucket.
+        auto bytes = (const u8*)&desc;
+        auto h = 0xcbf29ce484222325ull;
+        for (auto i = 0u; i < sizeof(desc); i += sizeof(u64)) {
+            auto word = (u64)0;
+            memcpy(&word, bytes + i, sizeof(word));
+            h = (h ^ word) * 0x100000001b3ull;
+            h ^= h >> 32;
+        }
+        return h;
+    }
+
+    // Set dynamically, the topology only has to match in class.
+    vk::PrimitiveTopology topologyClass(vk::PrimitiveTopology topology)
+    {
+        switch (topology) {
+        case vk::PrimitiveTopology::ePointList:
+            return vk::PrimitiveTopology::ePointList;
+        case vk::PrimitiveTopology::eLineList:
+        case vk::PrimitiveTopology::eLineStrip:
+        case vk::PrimitiveTopology::eLineListWithAdjacency:
+        case vk::PrimitiveTopology::eLineStripWithAdjacency:
+            return vk::PrimitiveTopology::eLineList;
+        case vk::PrimitiveTopology::ePatchList:
+            return vk::PrimitiveTopology::ePatchList;
+        default:
+            return vk::PrimitiveTopology::eTriangleList;
+        }
+    }
+
+    // The description with dynamic state reset, identifying the pipeline itself.
+    GraphicsDesc canonical(const GraphicsDesc& desc)
+    {
+        auto defaults = GraphicsDesc();
+        auto key = desc;
+        key.topology = topologyClass(desc.topology);
+        key.cullMode = defaults.cullMode;
+        key.frontFace = defaults.frontFace;
+        key.depthTest = defaults.depthTest;
+        key.depthWrite = defaults.depthWrite;
+        key.depthCompare = defaults.depthCompare;
+        key.primitiveRestart = defaults.primitiveRestart;
+        if (features.dynamicPolygonMode) {
+            key.polygonMode = defaults.polygonMode;
+        }
+        if (features.dynamicBlend) {
+            for (auto& blend : key.blend)
+                blend = BlendAttachment();
+        }
+        return key;
+    }
+
+    // The fields of a canonical description one library part is built from.
+    GraphicsDesc partOf(const GraphicsDesc& key, Part part)
+    {
+        auto desc = GraphicsDesc();
+        switch (part) {
+        case Part::VertexInput:
+            desc.bindingCount = key.bindingCount;
+            desc.attributeCount = key.attributeCount;
+            memcpy(desc.bindings, key.bindings, sizeof(key.bindings));
+            memcpy(desc.attributes, key.attributes, sizeof(key.attributes));
+            desc.topology = key.topology;
+            break;
+        case Part::PreRasterization:
+            desc.layout = key.layout;
+            desc.vertex = key.vertex;
+            desc.polygonMode = key.polygonMode;
+            break;
+        case Part::FragmentShader:
+            desc.layout = key.layout;
+            desc.fragment = key.fragment;
+            desc.samples = key.samples;
+            break;
+        case Part::FragmentOutput:
+            desc.colorCount = key.colorCount;
+            memcpy(desc.colorFormats, key.colorFormats, sizeof(key.colorFormats));
+            desc.depthFormat = key.depthFormat;
+            desc.stencilFormat = key.stencilFormat;
+            memcpy(desc.blend, key.blend, sizeof(key.blend));
+            desc.samples = key.samples;
+            break;
+        default:
+            break;
+        }
+        return desc;
+    }
+
+    // Creates a complete pipeline, or with parts, a library of those state subsets.
+    vk::Result create(const GraphicsDesc& desc, vk::PipelineCreateFlags flags,
+        vk::GraphicsPipelineLibraryFlagsEXT parts, vk::Pipeline& out)
+    {
+        vk::PipelineShaderStageCreateInfo stages[2];
+        auto stageCount = 0u;
+        if (desc.vertex != VK_NULL_HANDLE) {
+            stages[stageCount].stage = vk::ShaderStageFlagBits::eVertex;
+            stages[stageCount].module = desc.vertex;
+            stages[stageCount++].pName = "main";
+        }
+        if (desc.fragment != VK_NULL_HANDLE) {
+            stages[stageCount].stage = vk::ShaderStageFlagBits::eFragment;
+            stages[stageCount].module = desc.fragment;
+            stages[stageCount++].pName = "main";
+        }
+
+        vk::VertexInputBindingDescription bindings[MaxVertexBindings];
+        for (auto i = 0u; i < desc.bindingCount; i++)
+            bindings[i] = vk::VertexInputBindingDescription(
+                i, desc.bindings[i].stride, desc.bindings[i].inputRate);
+        vk::VertexInputAttributeDescription attributes[MaxVertexAttributes];
+        for (auto i = 0u; i < desc.attributeCount; i++) {
+            auto& attribute = desc.attributes[i];
+            attributes[i] = vk::VertexInputAttributeDescription(
+                attribute.location, attribute.binding, attribute.format, attribute.offset);
+        }
+        auto vertexInput = vk::PipelineVertexInputStateCreateInfo();
+        vertexInput.vertexBindingDescriptionCount = desc.bindingCount;
+        vertexInput.pVertexBindingDescriptions = bindings;
+        vertexInput.vertexAttributeDescriptionCount = desc.attributeCount;
+        vertexInput.pVertexAttributeDescriptions = attributes;
+
+        auto inputAssembly = vk::PipelineInputAssemblyStateCreateInfo();
+        inputAssembly.topology = desc.topology;
+
+        auto viewport = vk::PipelineViewportStateCreateInfo();
+        viewport.viewportCount = 1;
+        viewport.scissorCount = 1;
+
+        auto raster = vk::PipelineRasterizationStateCreateInfo();
+        raster.polygonMode = desc.polygonMode;
+        raster.cullMode = desc.cullMode;
+        raster.frontFace = desc.frontFace;
+        raster.lineWidth = 1.0f;
+
+        auto multisample = vk::PipelineMultisampleStateCreateInfo();
+        multisample.rasterizationSamples = desc.samples;
+
+        auto depth = vk::PipelineDepthStencilStateCreateInfo();
+        depth.depthTestEnable = desc.depthTest;
+        depth.depthWriteEnable = desc.depthWrite;
+        depth.depthCompareOp = desc.depthCompare;
+
+        vk::PipelineColorBlendAttachmentState blendAttachments[MaxColorAttachments];
+        for (auto i = 0u; i < desc.colorCount; i++) {
+            auto& blend = desc.blend[i];
+            auto& attachment = blendAttachments[i];
+            attachment.blendEnable = blend.enable;
+            attachment.srcColorBlendFactor = blend.srcColor;
+            attachment.dstColorBlendFactor = blend.dstColor;
+            attachment.colorBlendOp = blend.colorOp;
+            attachment.srcAlphaBlendFactor = blend.srcAlpha;
+            attachment.dstAlphaBlendFactor = blend.dstAlpha;
+            attachment.alphaBlendOp = blend.alphaOp;
+            attachment.colorWriteMask = blend.writeMask;
+        }
+        auto blend = vk::PipelineColorBlendStateCreateInfo();
+        blend.attachmentCount = desc.colorCount;
+        blend.pAttachments = blendAttachments;
+
+        auto dynamic = vk::PipelineDynamicStateCreateInfo();
+        dynamic.dynamicStateCount = (u32)dynamicStates.size();
+        dynamic.pDynamicStates = dynamicStates.data();
+
+        auto rendering = vk::PipelineRenderingCreateInfo();
+        rendering.colorAttachmentCount = desc.colorCount;
+        rendering.pColorAttachmentFormats = desc.colorFormats;
+        rendering.depthAttachmentFormat = desc.depthFormat;
+        rendering.stencilAttachmentFormat = desc.stencilFormat;
+
+        auto info = vk::GraphicsPipelineCreateInfo();
+        info.pNext = &rendering;
+        auto libraryInfo = vk::GraphicsPipelineLibraryCreateInfoEXT();
+        if (parts) {
+            libraryInfo.flags = parts;
+            libraryInfo.pNext = &rendering;
+            info.pNext = &libraryInfo;
+            flags |= vk::PipelineCreateFlagBits::eLibraryKHR |
+                vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+        }
+        info.flags = flags;
+        info.stageCount = stageCount;
+        info.pStages = stages;
+        info.pVertexInputState = &vertexInput;
+        info.pInputAssemblyState = &inputAssembly;
+        info.pViewportState = &viewport;
+        info.pRasterizationState = &raster;
+        info.pMultisampleState = &multisample;
+        info.pDepthStencilState = &depth;
+        info.pColorBlendState = &blend;
+        info.pDynamicState = &dynamic;
+        info.layout = desc.layout;
+        out = VK_NULL_HANDLE;
+        // The cache is internally synchronized, so jobs compile into it concurrently.
+        return device.createGraphicsPipelines(cache, 1, &info, nullptr, &out);
+    }
+
+    /// <summary>
+    /// Finds or creates the library for one part of a canonical description. Unless
+    /// mayCompile, returns ePipelineCompileRequiredEXT rather than compiling shaders.
+    /// Called from jobs too.
+    /// </summary>
+    vk::Result library(const GraphicsDesc& key, Part part, bool mayCompile, vk::Pipeline& out)
+    {
+        auto desc = partOf(key, part);
+        auto h = hash(desc);
+        auto& found = libraries[(u32)part];
+        auto lookup = [&]() {
+            auto [begin, end] = found.equal_range(h);
+            for (auto it = begin; it != end; ++it) {
+                if (memcmp(&it->second.desc, &desc, sizeof(desc)) == 0) return it;
+            }
+            return found.end();
+        };
+        {
+            auto lock = std::unique_lock(librariesMutex);
+            auto it = lookup();
+            if (it != found.end()) {
+                out = it->second.pipeline;
+                return vk::Result::eSuccess;
+            }
+        }
+        if (!mayCompile && !features.cacheControl) return vk::Result::ePipelineCompileRequiredEXT;
+
+        auto flags = mayCompile ? vk::PipelineCreateFlags() :
+            vk::PipelineCreateFlags(vk::PipelineCreateFlagBits::eFailOnPipelineCompileRequiredEXT);
+        auto result = create(desc, flags, PartFlags[(u32)part], out);
+        if (result != vk::Result::eSuccess) return result;
+
+        auto lock = std::unique_lock(librariesMutex);
+        // Another job may have built the same part meanwhile.
+        auto it = lookup();
+        if (it != found.end()) {
+            device.destroyPipeline(out);
+            out = it->second.pipeline;
+        } else {
+            auto entry = Library();
+            entry.desc = desc;
+            entry.pipeline = out;
+            found.emplace(h, entry);
+        }
+        return vk::Result::eSuccess;
+    }
+
+    // Links a pipeline from the libraries for a canonical description.
+    vk::Result link(const GraphicsDesc& key, bool optimize, bool mayCompile, vk::Pipeline& out)
+    {
+        vk::Pipeline parts[PartCount];
+        for (auto i = 0u; i < PartCount; i++) {
+            auto result = library(key, (Part)i, mayCompile, parts[i]);
+            if (result != vk::Result::eSuccess) return result;
+        }
+        auto libraryInfo = vk::PipelineLibraryCreateInfoKHR();
+        libraryInfo.libraryCount = PartCount;
+        libraryInfo.pLibraries = parts;
+        auto info = vk::GraphicsPipelineCreateInfo();
+        info.pNext = &libraryInfo;
+        if (optimize) {
+            info.flags = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+        }
+        if (!mayCompile && features.cacheControl) {
+            info.flags |= vk::PipelineCreateFlagBits::eFailOnPipelineCompileRequiredEXT;
+        }
+        info.layout = key.layout;
+        out = VK_NULL_HANDLE;
+        return device.createGraphicsPipelines(cache, 1, &info, nullptr, &out);
+    }
+
+    // The pipeline as it is finally drawn with: monolithic, or optimized from libraries.
+    vk::Result build(const GraphicsDesc& key, bool mayCompile, vk::Pipeline& out)
+    {
+        if (features.libraries) return link(key, true, mayCompile, out);
+        auto flags = mayCompile ? vk::PipelineCreateFlags() :
+            vk::PipelineCreateFlags(vk::PipelineCreateFlagBits::eFailOnPipelineCompileRequiredEXT);
+        return create(key, flags, {}, out);
+    }
+
+    vk::ShaderModule createShader(const u32* code, size_t size)
+    {
+        auto info = vk::ShaderModuleCreateInfo();
+        info.codeSize = size;
+        info.pCode = code;
+        auto module = vk::ShaderModule();
+        if (device.createShaderModule(&info, nullptr, &module) != vk::Result::eSuccess) {
+            return vk::ShaderModule();
+        }
+        shaderCode[(VkShaderModule)module] = List<u32>(code, code + size / sizeof(u32));
+        Capture::recordCreateShader(module, code, size);
+        return module;
+    }
+
+    vk::PipelineLayout createLayout(const vk::PipelineLayoutCreateInfo& info)
+    {
+        auto layout = vk::PipelineLayout();
+        if (device.createPipelineLayout(&info, nullptr, &layout) != vk::Result::eSuccess) {
+            return vk::PipelineLayout();
+        }
+        auto& layoutInfo = layoutInfos[(VkPipelineLayout)layout];
+        layoutInfo.setLayoutCount = info.setLayoutCount;
+        layoutInfo.ranges.assign(info.pPushConstantRanges,
+            info.pPushConstantRanges + info.pushConstantRangeCount);
+        Capture::recordCreateLayout(layout, info.setLayoutCount, info.pPushConstantRanges,
+            info.pushConstantRangeCount);
+        return layout;
+    }
+
+    void destroyShader(vk::ShaderModule module)
+    {
+        shaderCode.erase((VkShaderModule)module);
+        Frame::destroyLater(module);
+    }
+
+    void destroyLayout(vk::PipelineLayout layout)
+    {
+        layoutInfos.erase((VkPipelineLayout)layout);
+        Frame::destroyLater(layout);
+    }
+
+    PipelineHandle find(const GraphicsDesc& key, u64 h)
+    {
+        auto [begin, end] = byHash.equal_range(h);
+        for (auto it = begin; it != end; ++it) {
+            auto entry = pipelines.get(it->second);
+            if (entry != nullptr && memcmp(&entry->desc, &key, sizeof(key)) == 0) {
+                return it->second;
+            }
+        }
+        return PipelineHandle();
+    }
+
+    void fail(const Pipeline& entry, vk::Result result)
+    {
+        stats.failures++;
+        Engine::Debug::Log("Pipelines: creating pipeline {} failed ({}).\n",
+            entry.hash, (i32)result);
+    }
+
+    PipelineHandle add(const GraphicsDesc& desc, PipelineHandle fallback, bool background)
+    {
+        stats.requests++;
+        auto key = canonical(desc);
+        auto h = hash(key);
+        auto existing = find(key, h);
+        if (existing.isValid()) {
+            pipelines.get(existing)->refs++;
+            stats.shared++;
+            return existing;
+        }
+
+        auto entry = Pipeline();
+        entry.desc = key;
+        entry.hash = h;
+        entry.refs = 1;
+        if (auto held = pipelines.get(fallback)) {
+            held->refs++;
+            entry.fallback = fallback;
+        }
+        auto result = vk::Result::ePipelineCompileRequiredEXT;
+        // A cache hit costs about as much as a lookup, so it never needs a job.
+        if (features.cacheControl) {
+            result = build(key, false, entry.pipeline);
+            stats.cacheHits += result == vk::Result::eSuccess ? 1 : 0;
+        }
+        auto compile = result == vk::Result::ePipelineCompileRequiredEXT;
+        if (compile) {
+            stats.compiles++;
+            if (!background) {
+                result = build(key, true, entry.pipeline);
+                compile = false;
+            } else if (features.libraries && features.fastLinking) {
+                // Shaders other pipelines already compiled only need linking; draw with that
+                // unoptimized link until the job's optimized one replaces it.
+                result = link(key, false, false, entry.pipeline);
+                stats.fastLinks += result == vk::Result::eSuccess ? 1 : 0;
+            }
+        }
+        if (result == vk::Result::eSuccess) {
+            entry.state = State::Ready;
+        } else if (result != vk::Result::ePipelineCompileRequiredEXT) {
+            entry.state = State::Failed;
+            compile = false;
+            fail(entry, result);
+        }
+
+        auto handle = pipelines.insert(entry);
+        byHash.emplace(h, handle);
+        Capture::recordCreatePipeline(handle, key);
+        if (compile) {
+            Jobs::submit([handle, key]() {
+                auto done = Finished();
+                done.handle = handle;
+                done.result = build(key, true, done.pipeline);
+                auto lock = std::unique_lock(finishedMutex);
+                finished.push_back(done);
+            }, &compiling);
+        }
+        return handle;
+    }
+
+    PipelineHandle request(const GraphicsDesc& desc, PipelineHandle fallback)
+    {
+        return add(desc, fallback, true);
+    }
+
+    PipelineHandle compile(const GraphicsDesc& desc)
+    {
+        auto handle = add(desc, PipelineHandle(), false);
+        // Matched a pipeline a job is still compiling.
+        if (getState(handle) == State::Compiling) {
+            Jobs::wait(compiling);
+            update();
+        }
+        return handle;
+    }
+
+    void release(PipelineHandle handle)
+    {
+        auto entry = pipelines.get(handle);
+        if (entry == nullptr || --entry->refs > 0) return;
+
+        auto [begin, end] = byHash.equal_range(entry->hash);
+        for (auto it = begin; it != end; ++it) {
+            if (it->second == handle) {
+                byHash.erase(it);
+                break;
+            }
+        }
+        // Still compiling: update() destroys the job's result when it finds the handle stale.
+        if (entry->pipeline != VK_NULL_HANDLE) {
+            Frame::destroyLater(entry->pipeline);
+        }
+        auto fallback = entry->fallback;
+        pipelines.remove(handle);
+        release(fallback);
+    }
+
+    vk::Pipeline get(PipelineHandle handle)
+    {
+        auto entry = pipelines.get(handle);
+        if (entry == nullptr) return vk::Pipeline();
+        if (entry->state == State::Ready) return entry->pipeline;
+
+        auto fallback = pipelines.get(entry->fallback);
+        return fallback != nullptr && fallback->state == State::Ready ?
+            fallback->pipeline : vk::Pipeline();
+    }
+
+    bool bind(vk::CommandBuffer cmd, BindState& bound, PipelineHandle handle,
+        const GraphicsDesc& state)
+    {
+        auto pipeline = get(handle);
+        if (pipeline == VK_NULL_HANDLE) return false;
+        if (pipeline != bound.pipeline || !bound.hasState ||
+            memcmp(&state, &bound.state, sizeof(state)) != 0) {
+            Capture::recordBindPipeline(handle, state);
+        }
+        if (pipeline != bound.pipeline) {
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            bound.pipeline = pipeline;
+        }
+
+        // Every pipeline here has the same dynamic state, so it survives pipeline binds.
+        auto& last = bound.state;
+        auto all = !bound.hasState;
+        if (all || state.cullMode != last.cullMode) cmd.setCullMode(state.cullMode);
+        if (all || state.frontFace != last.frontFace) cmd.setFrontFace(state.frontFace);
+        if (all || state.topology != last.topology) cmd.setPrimitiveTopology(state.topology);
+        if (all || state.depthTest != last.depthTest) cmd.setDepthTestEnable(state.depthTest);
+        if (all || state.depthWrite != last.depthWrite) {
+            cmd.setDepthWriteEnable(state.depthWrite);
+        }
+        if (all || state.depthCompare != last.depthCompare) {
+            cmd.setDepthCompareOp(state.depthCompare);
+        }
+        if (all || state.primitiveRestart != last.primitiveRestart) {
+            cmd.setPrimitiveRestartEnable(state.primitiveRestart);
+        }
+        if (features.dynamicPolygonMode && (all || state.polygonMode != last.polygonMode)) {
+            cmd.setPolygonModeEXT(state.polygonMode, context.loader);
+        }
+        // Depth-only passes have no attachments to set, and a count of 0 is invalid.
+        if (features.dynamicBlend && state.colorCount > 0 && (all ||
+            state.colorCount != last.colorCount ||
+            memcmp(state.blend, last.blend, sizeof(state.blend)) != 0)) {
+            vk::Bool32 enables[MaxColorAttachments];
+            vk::ColorBlendEquationEXT equations[MaxColorAttachments];
+            vk::ColorComponentFlags writeMasks[MaxColorAttachments];
+            for (auto i = 0u; i < state.colorCount; i++) {
+                auto& blend = state.blend[i];
+                enables[i] = blend.enable;
+                equations[i] = vk::ColorBlendEquationEXT(blend.srcColor, blend.dstColor,
+                    blend.colorOp, blend.srcAlpha, blend.dstAlpha, blend.alphaOp);
+                writeMasks[i] = blend.writeMask;
+            }
+            cmd.setColorBlendEnableEXT(0, state.colorCount, enables, context.loader);
+            cmd.setColorBlendEquationEXT(0, state.colorCount, equations, context.loader);
+            cmd.setColorWriteMaskEXT(0, state.colorCount, writeMasks, context.loader);
+        }
+        last = state;
+        bound.hasState = true;
+        return true;
+    }
+
+    State getState(PipelineHandle handle)
+    {
+        auto entry = pipelines.get(handle);
+        return entry != nullptr ? entry->state : State::Failed;
+    }
+
+    const Stats& getStats()
+    {
+        return stats;
+    }
+
+    void update()
+    {
+        auto done = List<Finished>();
+        {
+            auto lock = std::unique_lock(finishedMutex);
+            done.swap(finished);
+        }
+        for (auto& result : done) {
+            auto entry = pipelines.get(result.handle);
+            if (entry == nullptr) {
+                // Released while compiling, so the GPU never saw it.
+                device.destroyPipeline(result.pipeline);
+                continue;
+            }
+            if (result.result != vk::Result::eSuccess) {
+                // A fast-linked pipeline stays usable; it just never gets optimized.
+                entry->state = entry->pipeline != VK_NULL_HANDLE ? State::Ready : State::Failed;
+                fail(*entry, result.result);
+                continue;
+            }
+            // Replacing a fast link, which frames in flight may still be drawing with.
+            if (entry->pipeline != VK_NULL_HANDLE) {
+                Frame::destroyLater(entry->pipeline);
+            }
+            entry->pipeline = result.pipeline;
+            entry->state = State::Ready;
+        }
+    }
+
+    void captureLive()
+    {
+        for (auto& [module, code] : shaderCode)
+            Capture::recordCreateShader(vk::ShaderModule(module), code.data(),
+                code.size() * sizeof(u32));
+        for (auto& [layout, info] : layoutInfos)
+            Capture::recordCreateLayout(vk::PipelineLayout(layout), info.setLayoutCount,
+                info.ranges.data(), (u32)info.ranges.size());
+        pipelines.forEach([](PipelineHandle handle, Pipeline& entry) {
+            Capture::recordCreatePipeline(handle, entry.desc);
+        });
+    }
+} // namespace Engine::Daedalus::Pipelines
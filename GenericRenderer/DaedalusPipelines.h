@@ -0,0 +1,194 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "HandleTable.h"
+
+/// Graphics pipelines, compiled off the render thread.
+///
+/// Pipelines are requested by a description of their full state. Identical requests share one
+/// pipeline, found by hashing the description. A request the pipeline cache can't satisfy
+/// without compiling is handed to a job, and until the job finishes get() returns the
+/// request's fallback, e.g. a simpler pipeline compiled up front, so no frame stalls on the
+/// shader compiler. The cache persists across runs, so warm starts compile nothing.
+///
+/// Pipelines render with dynamic rendering, so they name attachment formats rather than
+/// render passes. State the device can set dynamically (cull mode, depth, topology within its
+/// class, and with extended dynamic state 3 polygon mode and blending) is left out of the
+/// pipeline and set by bind(), so descriptions differing only there share one pipeline. With
+/// graphics pipeline libraries, shaders are compiled once into libraries that new
+/// combinations link against quickly, then relink with full optimization in a job.
+namespace Engine::Daedalus::Pipelines
+{
+    const u32 MaxVertexBindings = 4;
+    const u32 MaxVertexAttributes = 16;
+    const u32 MaxColorAttachments = 8;
+
+    // Binding i of a description is vertex binding i.
+    struct VertexBinding
+    {
+        u32 stride = 0;
+        vk::VertexInputRate inputRate = vk::VertexInputRate::eVertex;
+    };
+
+    struct VertexAttribute
+    {
+        u32 location = 0;
+        u32 binding = 0;
+        vk::Format format = vk::Format::eUndefined;
+        u32 offset = 0;
+    };
+
+    struct BlendAttachment
+    {
+        vk::Bool32 enable = VK_FALSE;
+        vk::BlendFactor srcColor = vk::BlendFactor::eOne;
+        vk::BlendFactor dstColor = vk::BlendFactor::eZero;
+        vk::BlendOp colorOp = vk::BlendOp::eAdd;
+        vk::BlendFactor srcAlpha = vk::BlendFactor::eOne;
+        vk::BlendFactor dstAlpha = vk::BlendFactor::eZero;
+        vk::BlendOp alphaOp = vk::BlendOp::eAdd;
+        vk::ColorComponentFlags writeMask = vk::ColorComponentFlagBits::eR |
+            vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB |
+            vk::ColorComponentFlagBits::eA;
+    };
+
+    /// <summary>
+    /// Everything that determines a graphics pipeline and the state it is drawn with. Compared
+    /// and hashed bytewise, so it has no padding and entries past the counts must keep their
+    /// defaults. Viewport and scissor are always dynamic, and shaders are entered at "main".
+    /// </summary>
+    struct GraphicsDesc
+    {
+        // Not owned; they must stay alive until the pipeline is ready or released.
+        vk::PipelineLayout layout;
+        vk::ShaderModule vertex;
+        // Optional, e.g. for depth-only passes.
+        vk::ShaderModule fragment;
+        u32 bindingCount = 0;
+        u32 attributeCount = 0;
+        u32 colorCount = 1;
+        // Attachment formats of the vkCmdBeginRendering the pipeline is drawn in.
+        vk::Format colorFormats[MaxColorAttachments] = {};
+        vk::Format depthFormat = vk::Format::eUndefined;
+        vk::Format stencilFormat = vk::Format::eUndefined;
+        VertexBinding bindings[MaxVertexBindings];
+        VertexAttribute attributes[MaxVertexAttributes];
+        BlendAttachment blend[MaxColorAttachments];
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+        vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace frontFace = vk::FrontFace::eCounterClockwise;
+        vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+        vk::Bool32 depthTest = VK_TRUE;
+        vk::Bool32 depthWrite = VK_TRUE;
+        vk::CompareOp depthCompare = vk::CompareOp::eLessOrEqual;
+        vk::Bool32 primitiveRestart = VK_FALSE;
+    };
+
+    enum class State : u32
+    {
+        Compiling,
+        Ready,
+        Failed
+    };
+
+    struct Pipeline;
+    using PipelineHandle = Handle<Pipeline>;
+
+    struct Pipeline
+    {
+        vk::Pipeline pipeline;
+        GraphicsDesc desc;
+        u64 hash = 0;
+        // Drawn with while this one compiles, or if it fails. Held until this is destroyed.
+        PipelineHandle fallback;
+        State state = State::Compiling;
+        u32 refs = 0;
+    };
+
+    // What the device supports, from createDevice().
+    struct Features
+    {
+        // pipelineCreationCacheControl: cache lookups that fail instead of compiling. Without
+        // it every new pipeline goes to a job, even if the cache could have created it.
+        bool cacheControl = false;
+        // graphicsPipelineLibrary, and whether linking libraries is cheap enough to do on
+        // the render thread.
+        bool libraries = false;
+        bool fastLinking = false;
+        // Extended dynamic state 3: blend enable, equation and write mask together.
+        bool dynamicBlend = false;
+        bool dynamicPolygonMode = false;
+    };
+
+    // What a command buffer last had bound, so bind() skips redundant binds and state.
+    // Reset it for every new command buffer.
+    struct BindState
+    {
+        vk::Pipeline pipeline;
+        GraphicsDesc state;
+        bool hasState = false;
+    };
+
+    struct Stats
+    {
+        u32 requests = 0;
+        // Requests answered by an existing pipeline.
+        u32 shared = 0;
+        // New pipelines the pipeline cache had, created without compiling.
+        u32 cacheHits = 0;
+        // New pipelines that needed compiling, in a job or by compile().
+        u32 compiles = 0;
+        // Of those, how many were drawable at once from already compiled libraries.
+        u32 fastLinks = 0;
+        u32 failures = 0;
+    };
+
+    void setup(vk::Device, const Features&);
+    // Waits for compiling jobs, destroys every pipeline immediately, and saves the cache.
+    // Call after Frame::cleanup().
+    void cleanup();
+
+    u64 hash(const GraphicsDesc&);
+
+    /// <summary>
+    /// Shader modules (size in bytes) and pipeline layouts for descriptions. What they were
+    /// made from is remembered until they are destroyed, so captures can recreate them.
+    /// Destroying defers to the end of the current frame, like Frame::destroyLater().
+    /// </summary>
+    vk::ShaderModule createShader(const u32* code, size_t size);
+    vk::PipelineLayout createLayout(const vk::PipelineLayoutCreateInfo&);
+    void destroyShader(vk::ShaderModule);
+    void destroyLayout(vk::PipelineLayout);
+
+    /// <summary>
+    /// Returns the pipeline for desc, adding a reference. New pipelines are created on the
+    /// spot when the cache has them, or linked from existing libraries, and compiled by a job
+    /// otherwise; get() resolves to fallback until then. A request matching an existing
+    /// pipeline keeps that one's fallback.
+    /// </summary>
+    PipelineHandle request(const GraphicsDesc&, PipelineHandle fallback = PipelineHandle());
+    // Like request(), but compiles on the calling thread and returns once the pipeline is
+    // ready or has failed. Meant for fallbacks and loading screens.
+    PipelineHandle compile(const GraphicsDesc&);
+    // Drops a reference; the last one destroys the pipeline once the current frame completes.
+    void release(PipelineHandle);
+
+    // The pipeline to draw with: the requested one when ready, else its fallback's, else null.
+    vk::Pipeline get(PipelineHandle);
+    /// <summary>
+    /// Binds get(handle) and sets the dynamic part of state, the description the pipeline was
+    /// requested with or any differing only in dynamic state. Returns false, binding nothing,
+    /// when there's nothing to draw with yet.
+    /// </summary>
+    bool bind(vk::CommandBuffer, BindState&, PipelineHandle, const GraphicsDesc& state);
+    State getState(PipelineHandle);
+    const Stats& getStats();
+
+    // Publishes pipelines finished by jobs since the last call. Called by Frame::begin().
+    void update();
+    // Reports every remembered shader and layout and every pipeline to a capture that is
+    // starting. Called by Capture.
+    void captureLive();
+} // namespace Engine::Daedalus::Pipelines
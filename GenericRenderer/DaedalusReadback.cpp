@@ -0,0 +1,491 @@
+#include "Precompiled.h"
+
+#include "DaedalusReadback.h"
+#include "DaedalusInternal.h"
+#include "DaedalusResources.h"
+#include "ImageFile.h"
+#include "JobSystem.h"
+
+#include <map>
+#include <mutex>
+
+namespace Engine::Daedalus::Readback
+{
+    enum class State : u8
+    {
+        Free,
+        // capture() recorded its barrier; the copy goes in with the frame's submit().
+        Recorded,
+        // The copy is submitted and signals value.
+        Copying,
+        // A worker owns the slot until it is encoded.
+        Encoding,
+    };
+
+    struct Slot
+    {
+        Resources::BufferHandle handle;
+        vk::Buffer buffer = VK_NULL_HANDLE;
+        const u8* mapped = nullptr;
+        vk::CommandBuffer cmd = VK_NULL_HANDLE;
+        // Guarded by slotsMutex, as workers free their slots.
+        State state = State::Free;
+        u64 value = 0;
+        // Capture order, which files are written in.
+        u64 sequence = 0;
+        vk::Image image = VK_NULL_HANDLE;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::Extent2D extent;
+        ImageFile::PixelFormat format = ImageFile::PixelFormat::RGBA8;
+        Encoding encoding = Encoding::Raw;
+        SString path;
+    };
+
+    struct Encoded
+    {
+        List<u8> bytes;
+        SString path;
+        bool ok = false;
+    };
+
+    Config config;
+    List<Slot> slots;
+    // Guards every slot's state: workers free slots while the main thread reads and moves
+    // the others along.
+    std::mutex slotsMutex;
+    vk::CommandPool pool = VK_NULL_HANDLE;
+    u32 gfxFamily = UINT32_MAX;
+    u32 tfrFamily = UINT32_MAX;
+    // Signaled by each submit() of copies with the next value.
+    vk::Semaphore copied = VK_NULL_HANDLE;
+    u64 copiedValue = 0;
+    u64 nextSequence = 0;
+    Jobs::Counter encoding;
+
+    // Encoded captures wait here until every earlier one is written.
+    std::mutex writeMutex;
+    std::map<u64, Encoded> pending;
+    u64 nextWrite = 0;
+    Stats stats;
+
+    bool formatOf(vk::Format format, ImageFile::PixelFormat& out)
+    {
+        switch (format) {
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+            out = ImageFile::PixelFormat::RGBA8;
+            return true;
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eB8G8R8A8Srgb:
+            out = ImageFile::PixelFormat::BGRA8;
+            return true;
+        case vk::Format::eR16G16B16A16Sfloat:
+            out = ImageFile::PixelFormat::RGBA16F;
+            return true;
+        case vk::Format::eR32G32B32A32Sfloat:
+            out = ImageFile::PixelFormat::RGBA32F;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool isFloat(ImageFile::PixelFormat format)
+    {
+        return format == ImageFile::PixelFormat::RGBA16F ||
+            format == ImageFile::PixelFormat::RGBA32F;
+    }
+
+    Result createSlot(Slot& slot)
+    {
+        using mem = vk::MemoryPropertyFlagBits;
+        auto desc = Resources::BufferDesc();
+        desc.size = config.slotSize;
+        desc.usage = vk::BufferUsageFlagBits::eTransferDst;
+        // Pinned by Resources, so the mapping stays valid.
+        desc.priority = Residency::Priority::Critical;
+        // Cached memory makes the encoders' reads fast; uncached reads crawl.
+        desc.properties = mem::eHostVisible | mem::eHostCoherent | mem::eHostCached;
+        slot.handle = Resources::createBuffer(desc);
+        if (!slot.handle.isValid()) {
+            desc.properties = mem::eHostVisible | mem::eHostCoherent;
+            slot.handle = Resources::createBuffer(desc);
+        }
+        auto created = Resources::getBuffer(slot.handle);
+        if (created == nullptr) return Result::Failed;
+
+        slot.buffer = created->buffer;
+        slot.mapped = (const u8*)Resources::map(slot.handle);
+        if (slot.mapped == nullptr) return Result::Failed;
+        return Result::Success;
+    }
+
+    Result setup(const Config& config)
+    {
+        if (pool != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup readback twice.\n");
+            return Result::Failed;
+        }
+        Readback::config = config;
+        auto& profile = activeProfile();
+        gfxFamily = profile.gfxFamilyIdx;
+        tfrFamily = profile.dedicatedTfrFamilyIdx != UINT32_MAX ?
+            profile.dedicatedTfrFamilyIdx : profile.gfxFamilyIdx;
+
+        auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        poolInfo.queueFamilyIndex = tfrFamily;
+        if (context.device.createCommandPool(&poolInfo, nullptr, &pool) != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+
+        auto typeInfo = vk::SemaphoreTypeCreateInfo();
+        typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        auto semaphoreInfo = vk::SemaphoreCreateInfo();
+        semaphoreInfo.pNext = &typeInfo;
+        auto created = context.device.createSemaphore(&semaphoreInfo, nullptr, &copied);
+        if (created != vk::Result::eSuccess) {
+            cleanup();
+            return Result::Failed;
+        }
+
+        auto cmds = List<vk::CommandBuffer>(config.slots);
+        auto allocInfo = vk::CommandBufferAllocateInfo();
+        allocInfo.commandPool = pool;
+        allocInfo.level = vk::CommandBufferLevel::ePrimary;
+        allocInfo.commandBufferCount = config.slots;
+        if (config.slots == 0 || context.device.allocateCommandBuffers(&allocInfo,
+            cmds.data()) != vk::Result::eSuccess) {
+            cleanup();
+            return Result::Failed;
+        }
+
+        slots.resize(config.slots);
+        for (auto i = 0u; i < config.slots; i++) {
+            slots[i].cmd = cmds[i];
+            if (createSlot(slots[i]) != Result::Success) {
+                Engine::Debug::Log("Readback: unable to allocate {} slots of {} bytes.\n",
+                    config.slots, config.slotSize);
+                cleanup();
+                return Result::Failed;
+            }
+        }
+        copiedValue = 0;
+        nextSequence = 0;
+        nextWrite = 0;
+        stats = Stats();
+        return Result::Success;
+    }
+
+    void cleanup()
+    {
+        if (pool == VK_NULL_HANDLE) return;
+
+        flush();
+        auto lock = std::unique_lock(slotsMutex);
+        // Anything still recorded never had its frame submitted.
+        for (auto& slot : slots) {
+            if (slot.state == State::Recorded) {
+                auto statsLock = std::lock_guard(writeMutex);
+                stats.dropped++;
+            }
+            // Freeing the memory drops the mapping.
+            Resources::destroyBuffer(slot.handle);
+        }
+        slots.clear();
+        lock.unlock();
+        pending.clear();
+        context.device.destroySemaphore(copied);
+        context.device.destroyCommandPool(pool);
+        copied = VK_NULL_HANDLE;
+        pool = VK_NULL_HANDLE;
+    }
+
+    // Finds a free slot and marks it recorded.
+    Slot* claimFree()
+    {
+        auto lock = std::lock_guard(slotsMutex);
+        for (auto& slot : slots) {
+            if (slot.state == State::Free) {
+                slot.state = State::Recorded;
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    bool capture(vk::CommandBuffer cmd, vk::Image image, vk::ImageLayout layout,
+        vk::Format format, vk::Extent2D extent, Encoding encoding, const SString& path)
+    {
+        if (pool == VK_NULL_HANDLE) return false;
+
+        auto pixelFormat = ImageFile::PixelFormat();
+        auto size = (vk::DeviceSize)extent.width * extent.height;
+        auto supported = formatOf(format, pixelFormat);
+        if (!supported || size * ImageFile::bytesPerPixel(pixelFormat) > config.slotSize ||
+            (encoding == Encoding::Png && isFloat(pixelFormat)) ||
+            (encoding == Encoding::Exr && !isFloat(pixelFormat))) {
+            Engine::Debug::Log("Readback: unable to capture {}x{} in format {} to {}.\n",
+                extent.width, extent.height, (u32)format, path);
+            auto lock = std::lock_guard(writeMutex);
+            stats.dropped++;
+            return false;
+        }
+
+        auto* slot = claimFree();
+        if (slot == nullptr) {
+            flush();
+            slot = claimFree();
+        }
+        // Every slot is waiting on this frame's submit().
+        if (slot == nullptr) {
+            auto lock = std::lock_guard(writeMutex);
+            stats.dropped++;
+            return false;
+        }
+
+        // On another family, this releases the image to the transfer queue, and the acquire
+        // in submit() performs the same transition.
+        auto barrier = vk::ImageMemoryBarrier();
+        barrier.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+        barrier.oldLayout = layout;
+        barrier.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        auto dstStage = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer);
+        if (tfrFamily != gfxFamily) {
+            barrier.srcQueueFamilyIndex = gfxFamily;
+            barrier.dstQueueFamilyIndex = tfrFamily;
+            dstStage = vk::PipelineStageFlagBits::eBottomOfPipe;
+        } else {
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+        }
+        barrier.image = image;
+        barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor,
+            0, 1, 0, 1);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, dstStage, {}, nullptr,
+            nullptr, barrier);
+
+        slot->sequence = nextSequence++;
+        slot->image = image;
+        slot->layout = layout;
+        slot->extent = extent;
+        slot->format = pixelFormat;
+        slot->encoding = encoding;
+        slot->path = path;
+        // Workers update the rest of the stats under the same lock.
+        auto lock = std::lock_guard(writeMutex);
+        stats.captured++;
+        return true;
+    }
+
+    // Writes result once every earlier capture is written, along with any later ones
+    // already waiting on it.
+    void finish(u64 sequence, Encoded&& result)
+    {
+        auto lock = std::lock_guard(writeMutex);
+        pending.emplace(sequence, std::move(result));
+        for (auto it = pending.begin(); it != pending.end() && it->first == nextWrite;) {
+            auto& encoded = it->second;
+            if (encoded.ok && ImageFile::write(encoded.path.c_str(), encoded.bytes) ==
+                Result::Success) {
+                stats.written++;
+                stats.bytesWritten += encoded.bytes.size();
+            } else {
+                Engine::Debug::Log("Readback: unable to write {}.\n", encoded.path);
+                stats.failed++;
+            }
+            it = pending.erase(it);
+            nextWrite++;
+        }
+    }
+
+    void encode(Slot& slot)
+    {
+        auto pixels = ImageFile::Pixels();
+        pixels.data = slot.mapped;
+        pixels.width = slot.extent.width;
+        pixels.height = slot.extent.height;
+        pixels.format = slot.format;
+
+        auto result = Encoded();
+        result.path = slot.path;
+        result.ok = true;
+        switch (slot.encoding) {
+        case Encoding::Raw:
+            ImageFile::encodeRaw(pixels, result.bytes);
+            break;
+        case Encoding::Png:
+            result.ok = ImageFile::encodePng(pixels, result.bytes) == Result::Success;
+            break;
+        case Encoding::Exr:
+            result.ok = ImageFile::encodeExr(pixels, result.bytes) == Result::Success;
+            break;
+        }
+
+        auto sequence = slot.sequence;
+        {
+            auto lock = std::lock_guard(slotsMutex);
+            slot.state = State::Free;
+        }
+        finish(sequence, std::move(result));
+    }
+
+    Frame::Wait getWait()
+    {
+        auto wait = Frame::Wait();
+        if (copied == VK_NULL_HANDLE || copiedValue == 0 ||
+            context.device.getSemaphoreCounterValue(copied) >= copiedValue) return wait;
+
+        wait.semaphore = copied;
+        wait.value = copiedValue;
+        wait.stages = vk::PipelineStageFlagBits::eAllCommands;
+        return wait;
+    }
+
+    void record(const Slot& slot)
+    {
+        auto cmd = slot.cmd;
+        cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+
+        if (tfrFamily != gfxFamily) {
+            auto acquire = vk::ImageMemoryBarrier();
+            acquire.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            acquire.oldLayout = slot.layout;
+            acquire.newLayout = vk::ImageLayout::eTransferSrcOptimal;
+            acquire.srcQueueFamilyIndex = gfxFamily;
+            acquire.dstQueueFamilyIndex = tfrFamily;
+            acquire.image = slot.image;
+            acquire.subresourceRange = vk::ImageSubresourceRange(
+                vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, acquire);
+        }
+
+        auto region = vk::BufferImageCopy();
+        region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor,
+            0, 0, 1);
+        region.imageExtent = vk::Extent3D(slot.extent.width, slot.extent.height, 1);
+        cmd.copyImageToBuffer(slot.image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer, 1,
+            &region);
+
+        auto toHost = vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite,
+            vk::AccessFlagBits::eHostRead);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eHost, {}, toHost, nullptr, nullptr);
+        cmd.end();
+    }
+
+    void submit(u64 frame)
+    {
+        auto recorded = List<Slot*>();
+        auto cmds = List<vk::CommandBuffer>();
+        {
+            auto lock = std::lock_guard(slotsMutex);
+            for (auto& slot : slots) {
+                if (slot.state == State::Recorded) {
+                    recorded.push_back(&slot);
+                }
+            }
+        }
+        if (recorded.empty()) return;
+        // Only this thread moves slots on from Recorded.
+        for (auto* slot : recorded) {
+            record(*slot);
+            cmds.push_back(slot->cmd);
+        }
+
+        // The copies start once the frame's graphics work, the capture barriers included,
+        // is done; nothing waits on the CPU.
+        auto frameTimeline = Frame::getTimeline();
+        auto waitStage = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer);
+        auto signalValue = copiedValue + 1;
+        auto timelineInfo = vk::TimelineSemaphoreSubmitInfo();
+        timelineInfo.waitSemaphoreValueCount = 1;
+        timelineInfo.pWaitSemaphoreValues = &frame;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+        auto info = vk::SubmitInfo();
+        info.pNext = &timelineInfo;
+        info.waitSemaphoreCount = 1;
+        info.pWaitSemaphores = &frameTimeline;
+        info.pWaitDstStageMask = &waitStage;
+        info.commandBufferCount = (u32)cmds.size();
+        info.pCommandBuffers = cmds.data();
+        info.signalSemaphoreCount = 1;
+        info.pSignalSemaphores = &copied;
+        if (context.tfrQueue.submit(1, &info, VK_NULL_HANDLE) != vk::Result::eSuccess) {
+            Engine::Debug::Log("Readback: unable to submit {} copies.\n", recorded.size());
+            for (auto* slot : recorded) {
+                auto sequence = slot->sequence;
+                {
+                    auto lock = std::lock_guard(slotsMutex);
+                    slot->state = State::Free;
+                }
+                finish(sequence, Encoded());
+            }
+            return;
+        }
+        copiedValue = signalValue;
+        auto lock = std::lock_guard(slotsMutex);
+        for (auto* slot : recorded) {
+            slot->state = State::Copying;
+            slot->value = signalValue;
+        }
+    }
+
+    void discard()
+    {
+        auto sequences = List<u64>();
+        {
+            auto lock = std::lock_guard(slotsMutex);
+            for (auto& slot : slots) {
+                if (slot.state == State::Recorded) {
+                    sequences.push_back(slot.sequence);
+                    slot.state = State::Free;
+                }
+            }
+        }
+        // Counted as failed through finish(), so the writes after them aren't held up.
+        for (auto sequence : sequences)
+            finish(sequence, Encoded());
+    }
+
+    void update()
+    {
+        if (copiedValue == 0) return;
+
+        auto done = context.device.getSemaphoreCounterValue(copied);
+        auto copiedOut = List<Slot*>();
+        {
+            auto lock = std::lock_guard(slotsMutex);
+            for (auto& slot : slots) {
+                if (slot.state != State::Copying || slot.value > done) continue;
+                slot.state = State::Encoding;
+                copiedOut.push_back(&slot);
+            }
+        }
+        // Outside the lock, which the jobs take when they finish.
+        for (auto* target : copiedOut)
+            Jobs::submit([target] { encode(*target); }, &encoding);
+    }
+
+    void flush()
+    {
+        if (copiedValue > 0) {
+            auto waitInfo = vk::SemaphoreWaitInfo();
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &copied;
+            waitInfo.pValues = &copiedValue;
+            if (context.device.waitSemaphores(waitInfo, UINT64_MAX) != vk::Result::eSuccess) return;
+        }
+        update();
+        Jobs::wait(encoding);
+    }
+
+    Stats getStats()
+    {
+        auto lock = std::lock_guard(writeMutex);
+        return stats;
+    }
+} // namespace Engine::Daedalus::Readback
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusFrame.h"
+
+/// Streaming rendered frames out to disk without stalling the GPU or the frame loop.
+///
+/// capture() queues an image for readback. Once the frame is submitted, the transfer queue
+/// copies it into a slot of a ring of host-visible buffers, waiting on the frame's timeline
+/// value so nothing blocks on the CPU. Frame::begin() hands slots whose copies have finished
+/// to the job workers, which encode them (raw, PNG or EXR) and write them out in capture
+/// order, however the encoding jobs finish. The ring only stalls the caller when it is full.
+namespace Engine::Daedalus::Readback
+{
+    enum class Encoding : u8
+    {
+        // The pixels as copied, rows top to bottom.
+        Raw,
+        // 8-bit RGBA or BGRA images only.
+        Png,
+        // Half or float RGBA images only.
+        Exr,
+    };
+
+    struct Config
+    {
+        u32 slots = 4;
+        // The largest image to capture, in bytes; 4K in RGBA16F by default.
+        vk::DeviceSize slotSize = 3840ull * 2160 * 8;
+    };
+
+    struct Stats
+    {
+        u64 captured = 0;
+        // Captures refused for their format, size or encoding, or with every slot busy.
+        u64 dropped = 0;
+        u64 written = 0;
+        // Captures that failed to copy, encode or write.
+        u64 failed = 0;
+        u64 bytesWritten = 0;
+    };
+
+    Result setup(const Config& = Config());
+    // Writes out every submitted capture, then releases the ring. Call before terminate().
+    void cleanup();
+
+    /// <summary>
+    /// Queues image, currently in layout, to be copied once the frame's graphics work is
+    /// done and written to path. Records a barrier into cmd, which must be submitted with the
+    /// frame, and leaves the image in eTransferSrcOptimal; its contents are undefined after
+    /// the copy. Later frames wait for the copy before touching it, through Frame::end().
+    /// Blocks while the ring is full; returns false when the capture is dropped.
+    /// </summary>
+    bool capture(vk::CommandBuffer cmd, vk::Image image, vk::ImageLayout layout,
+        vk::Format format, vk::Extent2D extent, Encoding encoding, const SString& path);
+
+    // Waits until every capture in submitted frames is written.
+    void flush();
+    Stats getStats();
+
+    // Used by Frame::end(): the wait for copies queued by earlier frames, to submit the frame
+    // with, and then the submission of this frame's copies.
+    Frame::Wait getWait();
+    void submit(u64 frame);
+    // Fails this frame's captures when the frame couldn't be submitted, as their barriers
+    // never ran.
+    void discard();
+    // Hands finished copies to the workers. Called by Frame::begin().
+    void update();
+} // namespace Engine::Daedalus::Readback
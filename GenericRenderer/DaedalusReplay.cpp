@@ -0,0 +1,598 @@
+#include "Precompiled.h"
+
+#if defined(_REPLAY)
+
+#include "Benchmark.h"
+#include "DaedalusCapture.h"
+#include "DaedalusCore.h"
+#include "DaedalusDraws.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+#include "DaedalusPipelines.h"
+#include "DaedalusResources.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+
+/// Headless replay of Daedalus captures.
+///
+/// Re-executes a file written by Capture on whichever device the loader provides, warmup plus
+/// iterations times, and reports the time of every captured frame:
+///     ./DaedalusReplay --capture frame.dcap --iterations 50 --out replay_output.json
+///         --baseline replay_baseline.json --tolerance 0.05
+/// Each frame is waited on before the next one starts, so its time covers the GPU work too
+/// and runs of two builds compare frame for frame. Exits non-zero when a frame regresses.
+///
+/// Attachments and descriptor sets aren't captured. Draws render into replay-owned targets
+/// with the formats their pipelines name, and pipelines whose layouts have descriptor sets,
+/// or whose shaders weren't made through Pipelines, are skipped along with their draws.
+namespace Engine::Daedalus::Replay
+{
+    using namespace Engine::Bench;
+    using namespace Engine::Daedalus::Capture;
+
+    const vk::Extent2D TargetExtent = { 1920, 1080 };
+
+    struct ReplayPipeline
+    {
+        Pipelines::PipelineHandle handle;
+        Pipelines::GraphicsDesc desc;
+    };
+
+    // Attachments for the pipelines whose formats match desc's.
+    struct Target
+    {
+        Pipelines::GraphicsDesc desc;
+        List<Resources::ImageHandle> colors;
+        Resources::ImageHandle depth;
+    };
+
+    struct State
+    {
+        // Capture-time ids to the objects recreated for them.
+        std::unordered_map<ResourceId, Resources::BufferHandle> buffers;
+        std::unordered_map<ResourceId, Resources::ImageHandle> images;
+        std::unordered_map<ResourceId, vk::ShaderModule> shaders;
+        std::unordered_map<ResourceId, vk::PipelineLayout> layouts;
+        std::unordered_map<ResourceId, ReplayPipeline> pipelines;
+        List<Target> targets;
+        vk::CommandPool pools[Frame::FramesInFlight];
+        vk::CommandBuffer cmds[Frame::FramesInFlight];
+        // The current frame's command buffer and what is bound in it.
+        vk::CommandBuffer cmd;
+        Pipelines::BindState bound;
+        vk::Buffer vertices;
+        vk::Buffer indices;
+        vk::IndexType indexType = vk::IndexType::eUint32;
+        // The target being rendered to, or null outside rendering.
+        const Target* rendering = nullptr;
+        // False after a bind that couldn't be replayed, until the next one that could.
+        bool drawable = false;
+        u64 frameStart = 0;
+        // Records with ops this build doesn't know, payloads too short for their op, and
+        // pipelines and draws that can't be replayed.
+        u32 skipped = 0;
+    };
+
+    template<class T>
+    bool readCmd(const RecordHeader& header, const u8* payload, T& cmd)
+    {
+        if (header.size < sizeof(T)) return false;
+        memcpy(&cmd, payload, sizeof(T));
+        return true;
+    }
+
+    // For records followed by a GraphicsDesc, which must be laid out as in this build.
+    template<class T>
+    bool readCmd(const RecordHeader& header, const u8* payload, T& cmd,
+        Pipelines::GraphicsDesc& desc)
+    {
+        if (header.size != sizeof(T) + sizeof(desc)) return false;
+        memcpy(&cmd, payload, sizeof(T));
+        memcpy(&desc, payload + sizeof(T), sizeof(desc));
+        return true;
+    }
+
+    // Trailing arrays, copied out as payloads aren't aligned.
+    template<class T>
+    bool readArray(const RecordHeader& header, const u8* payload, u64 offset, u64 count,
+        List<T>& out)
+    {
+        if (offset > header.size || count > (header.size - offset) / sizeof(T)) return false;
+        out.resize((size_t)count);
+        memcpy(out.data(), payload + offset, (size_t)(count * sizeof(T)));
+        return true;
+    }
+
+    Result setup(State& state)
+    {
+        auto poolInfo = vk::CommandPoolCreateInfo();
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        poolInfo.queueFamilyIndex = activeProfile().gfxFamilyIdx;
+        for (auto slot = 0u; slot < Frame::FramesInFlight; slot++) {
+            state.pools[slot] = context.device.createCommandPool(poolInfo);
+            auto allocInfo = vk::CommandBufferAllocateInfo();
+            allocInfo.commandPool = state.pools[slot];
+            allocInfo.level = vk::CommandBufferLevel::ePrimary;
+            allocInfo.commandBufferCount = 1;
+            if (context.device.allocateCommandBuffers(&allocInfo, &state.cmds[slot]) !=
+                vk::Result::eSuccess) {
+                return Result::Failed;
+            }
+        }
+        return Result::Success;
+    }
+
+    void cleanup(State& state)
+    {
+        context.device.waitIdle();
+        for (auto pool : state.pools)
+            context.device.destroyCommandPool(pool);
+    }
+
+    bool sameTarget(const Pipelines::GraphicsDesc& a, const Pipelines::GraphicsDesc& b)
+    {
+        return a.colorCount == b.colorCount && a.depthFormat == b.depthFormat &&
+            a.stencilFormat == b.stencilFormat && a.samples == b.samples &&
+            memcmp(a.colorFormats, b.colorFormats, sizeof(a.colorFormats)) == 0;
+    }
+
+    Resources::ImageHandle createAttachment(vk::Format format, vk::SampleCountFlagBits samples,
+        vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect)
+    {
+        auto desc = Resources::ImageDesc();
+        desc.info.imageType = vk::ImageType::e2D;
+        desc.info.format = format;
+        desc.info.extent = vk::Extent3D(TargetExtent.width, TargetExtent.height, 1);
+        desc.info.mipLevels = 1;
+        desc.info.arrayLayers = 1;
+        desc.info.samples = samples;
+        desc.info.usage = usage;
+        desc.aspect = aspect;
+        desc.priority = Residency::Priority::Critical;
+        return Resources::createImage(desc);
+    }
+
+    const Target& findTarget(State& state, const Pipelines::GraphicsDesc& desc)
+    {
+        for (auto& target : state.targets) {
+            if (sameTarget(target.desc, desc)) return target;
+        }
+        auto target = Target();
+        target.desc = desc;
+        for (auto i = 0u; i < desc.colorCount; i++)
+            target.colors.push_back(createAttachment(desc.colorFormats[i], desc.samples,
+                vk::ImageUsageFlagBits::eColorAttachment, vk::ImageAspectFlagBits::eColor));
+        auto depthFormat = desc.depthFormat != vk::Format::eUndefined ? desc.depthFormat :
+            desc.stencilFormat;
+        if (depthFormat != vk::Format::eUndefined) {
+            auto aspect = vk::ImageAspectFlags();
+            if (desc.depthFormat != vk::Format::eUndefined) {
+                aspect |= vk::ImageAspectFlagBits::eDepth;
+            }
+            if (desc.stencilFormat != vk::Format::eUndefined) {
+                aspect |= vk::ImageAspectFlagBits::eStencil;
+            }
+            target.depth = createAttachment(depthFormat, desc.samples,
+                vk::ImageUsageFlagBits::eDepthStencilAttachment, aspect);
+        }
+        state.targets.push_back(target);
+        return state.targets.back();
+    }
+
+    void endRendering(State& state)
+    {
+        if (state.rendering == nullptr) return;
+        state.cmd.endRendering();
+        state.rendering = nullptr;
+    }
+
+    /// <summary>
+    /// Starts rendering into the target for desc's formats, unless already rendering there.
+    /// Every pass clears its target; what earlier passes drew into it isn't kept.
+    /// </summary>
+    void beginRendering(State& state, const Pipelines::GraphicsDesc& desc)
+    {
+        if (state.rendering != nullptr && sameTarget(state.rendering->desc, desc)) return;
+        endRendering(state);
+        // Uploads can't be recorded while rendering.
+        Resources::recordUploads(state.cmd);
+
+        using layout = vk::ImageLayout;
+        auto& target = findTarget(state, desc);
+        auto depth = Resources::getImage(target.depth);
+        auto barriers = List<vk::ImageMemoryBarrier>();
+        auto colors = List<vk::RenderingAttachmentInfo>();
+        auto addAttachment = [&](const Resources::Image& image, layout to) {
+            auto barrier = vk::ImageMemoryBarrier();
+            barrier.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite |
+                vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+            barrier.dstAccessMask = barrier.srcAccessMask;
+            barrier.oldLayout = layout::eUndefined;
+            barrier.newLayout = to;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.image;
+            barrier.subresourceRange = vk::ImageSubresourceRange(image.desc.aspect, 0, 1, 0, 1);
+            barriers.push_back(barrier);
+        };
+        for (auto handle : target.colors) {
+            auto image = Resources::getImage(handle);
+            if (image == nullptr) continue;
+            addAttachment(*image, layout::eColorAttachmentOptimal);
+            auto color = vk::RenderingAttachmentInfo();
+            color.imageView = image->view;
+            color.imageLayout = layout::eColorAttachmentOptimal;
+            color.loadOp = vk::AttachmentLoadOp::eClear;
+            color.storeOp = vk::AttachmentStoreOp::eStore;
+            colors.push_back(color);
+        }
+        auto depthStencil = vk::RenderingAttachmentInfo();
+        if (depth != nullptr) {
+            addAttachment(*depth, layout::eDepthStencilAttachmentOptimal);
+            depthStencil.imageView = depth->view;
+            depthStencil.imageLayout = layout::eDepthStencilAttachmentOptimal;
+            depthStencil.loadOp = vk::AttachmentLoadOp::eClear;
+            depthStencil.storeOp = vk::AttachmentStoreOp::eStore;
+            depthStencil.clearValue.depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+        }
+        using stage = vk::PipelineStageFlagBits;
+        auto stages = stage::eColorAttachmentOutput | stage::eEarlyFragmentTests |
+            stage::eLateFragmentTests;
+        state.cmd.pipelineBarrier(stages, stages, {}, nullptr, nullptr, barriers);
+
+        auto info = vk::RenderingInfo();
+        info.renderArea = vk::Rect2D({ 0, 0 }, TargetExtent);
+        info.layerCount = 1;
+        info.colorAttachmentCount = (u32)colors.size();
+        info.pColorAttachments = colors.data();
+        if (depth != nullptr) {
+            if (desc.depthFormat != vk::Format::eUndefined) {
+                info.pDepthAttachment = &depthStencil;
+            }
+            if (desc.stencilFormat != vk::Format::eUndefined) {
+                info.pStencilAttachment = &depthStencil;
+            }
+        }
+        state.cmd.beginRendering(info);
+        state.cmd.setViewport(0, vk::Viewport(0.0f, 0.0f, (float)TargetExtent.width,
+            (float)TargetExtent.height, 0.0f, 1.0f));
+        state.cmd.setScissor(0, vk::Rect2D({ 0, 0 }, TargetExtent));
+        state.rendering = &target;
+    }
+
+    void beginFrame(State& state)
+    {
+        auto slot = Frame::getFrameSlot();
+        context.device.resetCommandPool(state.pools[slot]);
+        state.cmd = state.cmds[slot];
+        auto beginInfo = vk::CommandBufferBeginInfo();
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        state.cmd.begin(beginInfo);
+        state.bound = Pipelines::BindState();
+        state.vertices = vk::Buffer();
+        state.indices = vk::Buffer();
+        state.drawable = false;
+        Resources::recordUploads(state.cmd);
+    }
+
+    Result endFrame(State& state)
+    {
+        endRendering(state);
+        Resources::recordUploads(state.cmd);
+        state.cmd.end();
+        auto submitted = Frame::end({ state.cmd });
+        // Binds and draws between frames have nothing to record into.
+        state.cmd = vk::CommandBuffer();
+        if (submitted != Result::Success) return Result::Failed;
+
+        auto timeline = Frame::getTimeline();
+        auto value = Frame::getCurrentFrame();
+        auto waitInfo = vk::SemaphoreWaitInfo();
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline;
+        waitInfo.pValues = &value;
+        return context.device.waitSemaphores(waitInfo, UINT64_MAX) == vk::Result::eSuccess ?
+            Result::Success : Result::Failed;
+    }
+
+    // Binds the draw's geometry, returning false when it can't be drawn.
+    bool bindGeometry(State& state, ResourceId vertices, ResourceId indices, u32 indexType)
+    {
+        auto v = state.buffers.find(vertices);
+        auto i = state.buffers.find(indices);
+        if (!state.drawable || state.rendering == nullptr || v == state.buffers.end() ||
+            i == state.buffers.end()) return false;
+        auto vertexBuffer = Resources::getBuffer(v->second);
+        auto indexBuffer = Resources::getBuffer(i->second);
+        if (vertexBuffer == nullptr || indexBuffer == nullptr) return false;
+
+        if (vertexBuffer->buffer != state.vertices) {
+            state.cmd.bindVertexBuffers(0, vertexBuffer->buffer, (vk::DeviceSize)0);
+            state.vertices = vertexBuffer->buffer;
+        }
+        if (indexBuffer->buffer != state.indices || (vk::IndexType)indexType != state.indexType) {
+            state.cmd.bindIndexBuffer(indexBuffer->buffer, 0, (vk::IndexType)indexType);
+            state.indices = indexBuffer->buffer;
+            state.indexType = (vk::IndexType)indexType;
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Executes the capture once, appending the time of its k-th frame to frameTimes[k].
+    /// Resources the capture leaves alive are destroyed at the end, so passes start alike.
+    /// </summary>
+    Result run(const List<u8>& file, State& state, List<List<double>>& frameTimes)
+    {
+        auto cursor = (u64)0;
+        auto header = RecordHeader();
+        const u8* payload = nullptr;
+        auto frame = 0u;
+        while (next(file, cursor, header, payload)) {
+            switch (header.op) {
+            case Op::FrameBegin:
+                state.frameStart = now();
+                if (Frame::begin() != Result::Success) return Result::Failed;
+                beginFrame(state);
+                break;
+            case Op::FrameEnd:
+                if (endFrame(state) != Result::Success) return Result::Failed;
+                if (frameTimes.size() <= frame) {
+                    frameTimes.resize(frame + 1);
+                }
+                frameTimes[frame++].push_back((double)(now() - state.frameStart));
+                break;
+            case Op::CreateBuffer: {
+                auto cmd = CreateBufferCmd();
+                if (!readCmd(header, payload, cmd)) {
+                    state.skipped++;
+                    break;
+                }
+                auto desc = Resources::BufferDesc();
+                desc.size = cmd.size;
+                desc.usage = (vk::BufferUsageFlags)cmd.usage;
+                desc.properties = (vk::MemoryPropertyFlags)cmd.properties;
+                desc.priority = (Residency::Priority)cmd.priority;
+                state.buffers[cmd.id] = Resources::createBuffer(desc);
+                break;
+            }
+            case Op::CreateImage: {
+                auto cmd = CreateImageCmd();
+                if (!readCmd(header, payload, cmd)) {
+                    state.skipped++;
+                    break;
+                }
+                auto desc = Resources::ImageDesc();
+                desc.info.flags = (vk::ImageCreateFlags)cmd.flags;
+                desc.info.imageType = (vk::ImageType)cmd.imageType;
+                desc.info.format = (vk::Format)cmd.format;
+                desc.info.extent = vk::Extent3D(cmd.width, cmd.height, cmd.depth);
+                desc.info.mipLevels = cmd.mipLevels;
+                desc.info.arrayLayers = cmd.arrayLayers;
+                desc.info.samples = (vk::SampleCountFlagBits)cmd.samples;
+                desc.info.tiling = (vk::ImageTiling)cmd.tiling;
+                desc.info.usage = (vk::ImageUsageFlags)cmd.usage;
+                desc.aspect = (vk::ImageAspectFlags)cmd.aspect;
+                desc.priority = (Residency::Priority)cmd.priority;
+                state.images[cmd.id] = Resources::createImage(desc);
+                break;
+            }
+            case Op::DestroyBuffer: {
+                auto cmd = DestroyCmd();
+                auto it = readCmd(header, payload, cmd) ? state.buffers.find(cmd.id) :
+                    state.buffers.end();
+                if (it != state.buffers.end()) {
+                    Resources::destroyBuffer(it->second);
+                    state.buffers.erase(it);
+                }
+                break;
+            }
+            case Op::DestroyImage: {
+                auto cmd = DestroyCmd();
+                auto it = readCmd(header, payload, cmd) ? state.images.find(cmd.id) :
+                    state.images.end();
+                if (it != state.images.end()) {
+                    Resources::destroyImage(it->second);
+                    state.images.erase(it);
+                }
+                break;
+            }
+            case Op::UploadBuffer: {
+                auto cmd = UploadBufferCmd();
+                if (!readCmd(header, payload, cmd) || header.size < sizeof(cmd) + cmd.size) {
+                    state.skipped++;
+                    break;
+                }
+                auto it = state.buffers.find(cmd.id);
+                if (it != state.buffers.end()) {
+                    Resources::upload(it->second, cmd.offset, payload + sizeof(cmd), cmd.size);
+                }
+                break;
+            }
+            case Op::CreateShader: {
+                auto cmd = CreateShaderCmd();
+                auto code = List<u32>();
+                if (!readCmd(header, payload, cmd) ||
+                    !readArray(header, payload, sizeof(cmd), cmd.size / sizeof(u32), code)) {
+                    state.skipped++;
+                    break;
+                }
+                auto& shader = state.shaders[cmd.id];
+                if (shader != VK_NULL_HANDLE) {
+                    Pipelines::destroyShader(shader);
+                }
+                shader = Pipelines::createShader(code.data(), code.size() * sizeof(u32));
+                break;
+            }
+            case Op::CreateLayout: {
+                auto cmd = CreateLayoutCmd();
+                auto ranges = List<vk::PushConstantRange>();
+                if (!readCmd(header, payload, cmd) ||
+                    !readArray(header, payload, sizeof(cmd), cmd.rangeCount, ranges)) {
+                    state.skipped++;
+                    break;
+                }
+                // Its descriptor set layouts weren't captured, so neither are its pipelines.
+                if (cmd.setLayoutCount > 0) break;
+                auto& layout = state.layouts[cmd.id];
+                if (layout != VK_NULL_HANDLE) {
+                    Pipelines::destroyLayout(layout);
+                }
+                auto info = vk::PipelineLayoutCreateInfo();
+                info.pushConstantRangeCount = (u32)ranges.size();
+                info.pPushConstantRanges = ranges.data();
+                layout = Pipelines::createLayout(info);
+                break;
+            }
+            case Op::CreatePipeline: {
+                auto cmd = CreatePipelineCmd();
+                auto desc = Pipelines::GraphicsDesc();
+                if (!readCmd(header, payload, cmd, desc)) {
+                    state.skipped++;
+                    break;
+                }
+                auto layout = state.layouts.find(cmd.layout);
+                auto vertex = state.shaders.find(cmd.vertex);
+                auto fragment = state.shaders.find(cmd.fragment);
+                if (layout == state.layouts.end() || vertex == state.shaders.end() ||
+                    (cmd.fragment != 0 && fragment == state.shaders.end())) {
+                    state.skipped++;
+                    break;
+                }
+                desc.layout = layout->second;
+                desc.vertex = vertex->second;
+                desc.fragment = cmd.fragment != 0 ? fragment->second : vk::ShaderModule();
+                auto& pipeline = state.pipelines[cmd.id];
+                Pipelines::release(pipeline.handle);
+                // Compiled on the spot rather than by a job, so replayed draws never fall back.
+                pipeline.handle = Pipelines::compile(desc);
+                pipeline.desc = desc;
+                break;
+            }
+            case Op::BindPipeline: {
+                auto cmd = BindPipelineCmd();
+                auto desc = Pipelines::GraphicsDesc();
+                auto it = readCmd(header, payload, cmd, desc) ? state.pipelines.find(cmd.id) :
+                    state.pipelines.end();
+                state.drawable = false;
+                if (it == state.pipelines.end() || state.cmd == VK_NULL_HANDLE) {
+                    state.skipped++;
+                    break;
+                }
+                beginRendering(state, it->second.desc);
+                state.drawable = Pipelines::bind(state.cmd, state.bound, it->second.handle, desc);
+                break;
+            }
+            case Op::DrawIndexed: {
+                auto cmd = DrawIndexedCmd();
+                if (!readCmd(header, payload, cmd) ||
+                    !bindGeometry(state, cmd.vertices, cmd.indices, cmd.indexType)) {
+                    state.skipped++;
+                    break;
+                }
+                state.cmd.drawIndexed(cmd.indexCount, cmd.instanceCount, cmd.firstIndex,
+                    cmd.vertexOffset, cmd.firstInstance);
+                break;
+            }
+            case Op::DrawMulti: {
+                auto cmd = DrawMultiCmd();
+                auto draws = List<vk::MultiDrawIndexedInfoEXT>();
+                if (!readCmd(header, payload, cmd) ||
+                    !readArray(header, payload, sizeof(cmd), cmd.drawCount, draws) ||
+                    !bindGeometry(state, cmd.vertices, cmd.indices, cmd.indexType)) {
+                    state.skipped++;
+                    break;
+                }
+                Draws::drawMulti(state.cmd, draws.data(), cmd.drawCount, cmd.firstInstance);
+                break;
+            }
+            default:
+                state.skipped++;
+                break;
+            }
+        }
+
+        for (auto& [id, handle] : state.buffers)
+            Resources::destroyBuffer(handle);
+        for (auto& [id, handle] : state.images)
+            Resources::destroyImage(handle);
+        for (auto& [id, pipeline] : state.pipelines)
+            Pipelines::release(pipeline.handle);
+        for (auto& [id, shader] : state.shaders)
+            Pipelines::destroyShader(shader);
+        for (auto& [id, layout] : state.layouts)
+            Pipelines::destroyLayout(layout);
+        for (auto& target : state.targets) {
+            for (auto handle : target.colors)
+                Resources::destroyImage(handle);
+            Resources::destroyImage(target.depth);
+        }
+        state.buffers.clear();
+        state.images.clear();
+        state.pipelines.clear();
+        state.shaders.clear();
+        state.layouts.clear();
+        state.targets.clear();
+        return Result::Success;
+    }
+} // namespace Engine::Daedalus::Replay
+
+int main(int argc, char** argv)
+{
+    using namespace Engine::Daedalus;
+
+    auto config = Engine::Bench::parseArgs(argc, argv);
+    if (config.capturePath.empty()) {
+        fprintf(stderr, "Usage: DaedalusReplay --capture <file> [--iterations n] [--warmup n]\n"
+            "    [--out results.json] [--baseline baseline.json] [--tolerance t]\n");
+        return 2;
+    }
+    auto file = List<u8>();
+    if (Capture::load(config.capturePath.c_str(), file) != Result::Success) {
+        fprintf(stderr, "Unable to read capture: %s\n", config.capturePath.c_str());
+        return 2;
+    }
+    if (initialize() != Result::Success || createHeadlessDevice() != Result::Success) {
+        fprintf(stderr, "Daedalus failed to create a headless device.\n");
+        terminate();
+        return 2;
+    }
+    auto deviceName = SString(activeProfile().gpu.getProperties().deviceName.data());
+
+    auto state = Replay::State();
+    auto frameTimes = List<List<double>>();
+    auto warmupTimes = List<List<double>>();
+    auto result = Replay::setup(state);
+    for (auto i = 0u; i < config.warmup + config.iterations && result == Result::Success; i++)
+        result = Replay::run(file, state, i < config.warmup ? warmupTimes : frameTimes);
+    Replay::cleanup(state);
+    terminate();
+    if (result != Result::Success) {
+        fprintf(stderr, "Replay failed.\n");
+        return 2;
+    }
+    if (state.skipped > 0) {
+        fprintf(stderr, "Skipped %u records this build can't replay.\n", state.skipped);
+    }
+
+    auto results = List<Engine::Bench::Measurement>();
+    for (auto k = 0u; k < frameTimes.size(); k++) {
+        auto m = Engine::Bench::Measurement();
+        m.name = "frame_" + std::to_string(k);
+        Engine::Bench::summarize(m, frameTimes[k]);
+        results.push_back(m);
+    }
+    auto regressions = 0u;
+    auto compared = Engine::Bench::compare(config, results, regressions);
+    Engine::Bench::print(results);
+    if (Engine::Bench::write(config, "replay", deviceName.c_str(), results) != Result::Success ||
+        compared != Result::Success) {
+        return 2;
+    }
+    return regressions > 0 ? 1 : 0;
+}
+
+#endif // _REPLAY
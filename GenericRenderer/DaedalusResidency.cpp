@@ -0,0 +1,359 @@
+#include "Precompiled.h"
+
+#include "DaedalusResidency.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Engine::Daedalus::Residency
+{
+    struct Allocation
+    {
+        vk::DeviceMemory memory;
+        void* mapped = nullptr;
+        vk::DeviceSize size = 0;
+        u32 heapIdx = 0;
+        // The device heap this allocation is counted as demoted from, if any.
+        u32 demotedFrom = UINT32_MAX;
+        Priority priority = Priority::Normal;
+        DemoteFn onDemote = nullptr;
+        void* user = nullptr;
+        bool deviceLocal = false;
+        bool demoting = false;
+    };
+
+    // Demotion starts above HighWater of the budget and stops once usage is under LowWater,
+    // so a heap hovering near its budget doesn't demote something every frame.
+    const double HighWater = 0.95;
+    const double LowWater = 0.85;
+    // Budget estimate when VK_EXT_memory_budget is unavailable.
+    const double DefaultBudget = 0.8;
+
+    vk::Device device = VK_NULL_HANDLE;
+    vk::PhysicalDevice gpu = VK_NULL_HANDLE;
+    vk::PhysicalDeviceMemoryProperties memProps;
+    HandleTable<Allocation> allocations;
+    Telemetry telemetry;
+    // Per heap, the size of allocations handed to their owners for demotion but not yet freed.
+    // Usage keeps counting them until the owners free them a few frames later.
+    vk::DeviceSize pendingDemotion[VK_MAX_MEMORY_HEAPS] = {};
+    // The report callback may be invoked from any driver thread.
+    std::atomic<u64> reportedAllocated = 0;
+    std::atomic<u64> reportedFreed = 0;
+
+    float toDriverPriority(Priority priority)
+    {
+        switch (priority) {
+        case Priority::Low:
+            return 0.1f;
+        case Priority::High:
+            return 0.75f;
+        case Priority::Critical:
+            return 1.0f;
+        default:
+            return 0.5f;
+        }
+    }
+
+    VKAPI_ATTR void VKAPI_CALL memoryReport(
+        const VkDeviceMemoryReportCallbackDataEXT* data,
+        void* userData)
+    {
+        switch (data->type) {
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_ALLOCATE_EXT:
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_IMPORT_EXT:
+            reportedAllocated.fetch_add(data->size, std::memory_order_relaxed);
+            break;
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_FREE_EXT:
+        case VK_DEVICE_MEMORY_REPORT_EVENT_TYPE_UNIMPORT_EXT:
+            reportedFreed.fetch_add(data->size, std::memory_order_relaxed);
+            break;
+        default:
+            break;
+        }
+    }
+
+    vk::DeviceDeviceMemoryReportCreateInfoEXT getMemoryReportCreateInfo()
+    {
+        auto info = vk::DeviceDeviceMemoryReportCreateInfoEXT();
+        info.pfnUserCallback = memoryReport;
+        return info;
+    }
+
+    void refreshBudgets()
+    {
+        for (auto i = 0u; i < telemetry.heapCount; i++) {
+            auto& heap = telemetry.heaps[i];
+            heap.budget = (vk::DeviceSize)(heap.size * DefaultBudget);
+            heap.usage = heap.tracked;
+        }
+        if (!telemetry.budgetSupported) return;
+
+        auto chain = gpu.getMemoryProperties2<
+            vk::PhysicalDeviceMemoryProperties2,
+            vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        auto& budget = chain.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+        for (auto i = 0u; i < telemetry.heapCount; i++) {
+            telemetry.heaps[i].budget = budget.heapBudget[i];
+            telemetry.heaps[i].usage = budget.heapUsage[i];
+        }
+    }
+
+    void setup(vk::Device device, vk::PhysicalDevice gpu, bool budgetEnabled, bool priorityEnabled)
+    {
+        if (Residency::device != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup residency twice.\n");
+            return;
+        }
+        Residency::device = device;
+        Residency::gpu = gpu;
+        memProps = gpu.getMemoryProperties();
+
+        telemetry = Telemetry();
+        std::fill(std::begin(pendingDemotion), std::end(pendingDemotion), 0);
+        telemetry.budgetSupported = budgetEnabled;
+        telemetry.prioritySupported = priorityEnabled;
+        telemetry.heapCount = memProps.memoryHeapCount;
+        for (auto i = 0u; i < memProps.memoryHeapCount; i++) {
+            auto& heap = telemetry.heaps[i];
+            heap.size = memProps.memoryHeaps[i].size;
+            heap.deviceLocal =
+                (bool)(memProps.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        }
+        refreshBudgets();
+    }
+
+    void cleanup()
+    {
+        allocations.forEach([](AllocationId, Allocation& allocation) {
+            Engine::Debug::Log("Residency: freeing a leaked allocation of {} bytes.\n",
+                (u64)allocation.size);
+            device.freeMemory(allocation.memory);
+        });
+        allocations.clear();
+        device = VK_NULL_HANDLE;
+        gpu = VK_NULL_HANDLE;
+    }
+
+    // Usage without allocations already on their way out, so nothing is demoted twice over.
+    vk::DeviceSize projectedUsage(u32 heapIdx)
+    {
+        auto usage = telemetry.heaps[heapIdx].usage;
+        return usage - std::min(usage, pendingDemotion[heapIdx]);
+    }
+
+    bool overBudget(u32 heapIdx, vk::DeviceSize extra, double fraction)
+    {
+        auto& heap = telemetry.heaps[heapIdx];
+        return (double)(projectedUsage(heapIdx) + extra) > (double)heap.budget * fraction;
+    }
+
+    AllocationId allocate(const Request& request)
+    {
+        using mem = vk::MemoryPropertyFlagBits;
+        auto& reqs = request.requirements;
+        auto properties = request.properties;
+        auto typeIdx = VkUtil::findMemoryType(memProps, reqs.memoryTypeBits, properties);
+        if (typeIdx == UINT32_MAX) {
+            telemetry.failures++;
+            return AllocationId();
+        }
+
+        // Demotable allocations go straight to host memory when the device heap is already
+        // near its budget, rather than pushing the driver into paging.
+        auto demotable = request.onDemote != nullptr;
+        auto heapIdx = memProps.memoryTypes[typeIdx].heapIndex;
+        auto hostProps = (properties & ~vk::MemoryPropertyFlags(mem::eDeviceLocal)) |
+            mem::eHostVisible | mem::eHostCoherent;
+        if (demotable && (properties & mem::eDeviceLocal) &&
+            overBudget(heapIdx, reqs.size, HighWater)) {
+            auto hostType = VkUtil::findMemoryType(memProps, reqs.memoryTypeBits, hostProps);
+            if (hostType != UINT32_MAX) {
+                typeIdx = hostType;
+                telemetry.fallbacks++;
+            }
+        }
+
+        auto priorityInfo = vk::MemoryPriorityAllocateInfoEXT();
+        priorityInfo.priority = toDriverPriority(request.priority);
+        auto info = vk::MemoryAllocateInfo();
+        info.allocationSize = reqs.size;
+        info.memoryTypeIndex = typeIdx;
+        if (telemetry.prioritySupported) {
+            info.pNext = &priorityInfo;
+        }
+
+        auto memory = vk::DeviceMemory();
+        auto res = device.allocateMemory(&info, nullptr, &memory);
+        if (res == vk::Result::eErrorOutOfDeviceMemory && demotable) {
+            auto hostType = VkUtil::findMemoryType(memProps, reqs.memoryTypeBits, hostProps);
+            if (hostType != UINT32_MAX && hostType != typeIdx) {
+                info.memoryTypeIndex = typeIdx = hostType;
+                res = device.allocateMemory(&info, nullptr, &memory);
+                telemetry.fallbacks++;
+            }
+        }
+        if (res != vk::Result::eSuccess) {
+            telemetry.failures++;
+            return AllocationId();
+        }
+
+        auto allocation = Allocation();
+        allocation.memory = memory;
+        allocation.size = reqs.size;
+        allocation.heapIdx = memProps.memoryTypes[typeIdx].heapIndex;
+        allocation.priority = request.priority;
+        allocation.onDemote = request.onDemote;
+        allocation.user = request.user;
+        allocation.deviceLocal =
+            (bool)(memProps.memoryTypes[typeIdx].propertyFlags & mem::eDeviceLocal);
+
+        if ((properties & mem::eDeviceLocal) && !allocation.deviceLocal) {
+            allocation.demotedFrom = heapIdx;
+        } else if (auto replaced = allocations.get(request.demotes)) {
+            allocation.demotedFrom = replaced->heapIdx;
+        }
+        if (allocation.demotedFrom != UINT32_MAX) {
+            telemetry.heaps[allocation.demotedFrom].demoted += allocation.size;
+        }
+
+        auto& heap = telemetry.heaps[allocation.heapIdx];
+        heap.tracked += allocation.size;
+        if (!telemetry.budgetSupported) {
+            heap.usage += allocation.size;
+        }
+        telemetry.allocations++;
+        return allocations.insert(allocation);
+    }
+
+    void free(AllocationId id)
+    {
+        auto allocation = Allocation();
+        if (!allocations.remove(id, &allocation)) return;
+
+        // Also drops the mapping, if any.
+        device.freeMemory(allocation.memory);
+        auto& heap = telemetry.heaps[allocation.heapIdx];
+        heap.tracked -= allocation.size;
+        if (!telemetry.budgetSupported) {
+            heap.usage -= allocation.size;
+        }
+        if (allocation.demotedFrom != UINT32_MAX) {
+            telemetry.heaps[allocation.demotedFrom].demoted -= allocation.size;
+        }
+        if (allocation.demoting) {
+            pendingDemotion[allocation.heapIdx] -= allocation.size;
+        }
+        telemetry.frees++;
+    }
+
+    vk::DeviceMemory getMemory(AllocationId id)
+    {
+        auto allocation = allocations.get(id);
+        return allocation ? allocation->memory : vk::DeviceMemory();
+    }
+
+    void* map(AllocationId id)
+    {
+        auto allocation = allocations.get(id);
+        if (allocation == nullptr) return nullptr;
+
+        if (allocation->mapped == nullptr) {
+            auto res = device.mapMemory(allocation->memory, 0, VK_WHOLE_SIZE, {},
+                &allocation->mapped);
+            if (res != vk::Result::eSuccess) {
+                allocation->mapped = nullptr;
+            }
+        }
+        return allocation->mapped;
+    }
+
+    bool isDeviceLocal(AllocationId id)
+    {
+        auto allocation = allocations.get(id);
+        return allocation && allocation->deviceLocal;
+    }
+
+    void setPriority(AllocationId id, Priority priority)
+    {
+        if (auto allocation = allocations.get(id)) {
+            allocation->priority = priority;
+        }
+    }
+
+    void demote(u32 heapIdx)
+    {
+        // Candidates: demotable, device-local, and not already on their way out.
+        auto candidates = List<AllocationId>();
+        allocations.forEach([&](AllocationId id, Allocation& a) {
+            if (a.heapIdx == heapIdx && a.deviceLocal && a.onDemote && !a.demoting &&
+                a.priority != Priority::Critical) {
+                candidates.push_back(id);
+            }
+        });
+        // Lowest priority first; within a priority, largest first to free the most memory
+        // with the fewest moves.
+        std::sort(candidates.begin(), candidates.end(), [](AllocationId l, AllocationId r) {
+            auto& a = *allocations.get(l);
+            auto& b = *allocations.get(r);
+            return a.priority != b.priority ? a.priority < b.priority : a.size > b.size;
+        });
+
+        auto& heap = telemetry.heaps[heapIdx];
+        auto projected = projectedUsage(heapIdx);
+        for (auto id : candidates) {
+            if ((double)projected <= (double)heap.budget * LowWater) break;
+
+            auto& allocation = *allocations.get(id);
+            allocation.demoting = true;
+            projected -= std::min(projected, allocation.size);
+            pendingDemotion[heapIdx] += allocation.size;
+            telemetry.demotions++;
+            // May allocate (and grow allocations); don't hold references across this call.
+            auto onDemote = allocation.onDemote;
+            onDemote(id, allocation.user);
+        }
+    }
+
+    void update()
+    {
+        if (device == VK_NULL_HANDLE) return;
+
+        telemetry.frame++;
+        refreshBudgets();
+        telemetry.reportedAllocated = reportedAllocated.load(std::memory_order_relaxed);
+        telemetry.reportedFreed = reportedFreed.load(std::memory_order_relaxed);
+
+        for (auto i = 0u; i < telemetry.heapCount; i++) {
+            if (telemetry.heaps[i].deviceLocal && overBudget(i, 0, HighWater)) {
+                demote(i);
+            }
+        }
+    }
+
+    const Telemetry& getTelemetry()
+    {
+        return telemetry;
+    }
+
+    void writeTelemetry(Format::Buffer<char16_t>& out)
+    {
+        const auto MiB = 1024.0 * 1024.0;
+        Format::formatTo(out, u"Residency (frame {}): {} allocs, {} frees, {} demoted, "
+            u"{} host fallbacks, {} failed\n",
+            telemetry.frame, telemetry.allocations, telemetry.frees, telemetry.demotions,
+            telemetry.fallbacks, telemetry.failures);
+        for (auto i = 0u; i < telemetry.heapCount; i++) {
+            auto& heap = telemetry.heaps[i];
+            Format::formatTo(out,
+                u"  heap {} [{}]: {:.1f} / {:.1f} MiB budget, {:.1f} tracked, {:.1f} demoted\n",
+                i, heap.deviceLocal ? u"device" : u"host",
+                heap.usage / MiB, heap.budget / MiB, heap.tracked / MiB, heap.demoted / MiB);
+        }
+        if (telemetry.reportedAllocated > 0) {
+            Format::formatTo(out, u"  device memory report: {:.1f} MiB live\n",
+                (telemetry.reportedAllocated - telemetry.reportedFreed) / MiB);
+        }
+    }
+} // namespace Engine::Daedalus::Residency
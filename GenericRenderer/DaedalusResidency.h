@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "HandleTable.h"
+
+/// Memory-budget-aware residency management.
+///
+/// Device memory allocations made through here are tracked per heap and checked against the
+/// driver's budget (VK_EXT_memory_budget) every frame. When a device-local heap approaches its
+/// budget, the lowest-priority demotable allocations are handed back to their owners to be
+/// moved to host-visible memory, before the driver starts paging on its own. Allocation
+/// priorities are also passed to the driver through VK_EXT_memory_priority.
+namespace Engine::Daedalus::Residency
+{
+    struct Allocation;
+    // Default-constructed ids are invalid; ids of freed allocations are detected as stale.
+    using AllocationId = Handle<Allocation>;
+
+    enum class Priority : u8
+    {
+        // First to be demoted. Streaming mips, cold caches.
+        Low,
+        Normal,
+        High,
+        // Render targets and anything else that must stay device-local.
+        Critical
+    };
+
+    /// <summary>
+    /// Called at most once per allocation when it should leave device-local memory.
+    /// The owner allocates a host-visible replacement, moves its data, and calls free() on the
+    /// old allocation once the GPU is done with it.
+    /// </summary>
+    using DemoteFn = void (*)(AllocationId, void* user);
+
+    struct Request
+    {
+        vk::MemoryRequirements requirements;
+        vk::MemoryPropertyFlags properties;
+        Priority priority = Priority::Normal;
+        // Null pins the allocation: it is never demoted and never placed outside
+        // the requested properties.
+        DemoteFn onDemote = nullptr;
+        void* user = nullptr;
+        // Set on the host-visible replacement of a demoted allocation, so its size is counted
+        // as demoted from the old allocation's heap.
+        AllocationId demotes;
+    };
+
+    struct HeapTelemetry
+    {
+        vk::DeviceSize size = 0;
+        vk::DeviceSize budget = 0;
+        // Process-wide usage as reported by the driver (or tracked usage without the budget ext).
+        vk::DeviceSize usage = 0;
+        // Usage from allocations made through the residency manager.
+        vk::DeviceSize tracked = 0;
+        // Live allocations that asked for this heap but were placed in host memory instead,
+        // either up front or by demotion.
+        vk::DeviceSize demoted = 0;
+        bool deviceLocal = false;
+    };
+
+    struct Telemetry
+    {
+        HeapTelemetry heaps[VK_MAX_MEMORY_HEAPS];
+        u32 heapCount = 0;
+        u64 frame = 0;
+        u64 allocations = 0;
+        u64 frees = 0;
+        u64 demotions = 0;
+        // Allocations placed in host memory up front because the device heap was over budget.
+        u64 fallbacks = 0;
+        u64 failures = 0;
+        // Totals from VK_EXT_device_memory_report, which also sees driver-internal memory.
+        u64 reportedAllocated = 0;
+        u64 reportedFreed = 0;
+        bool budgetSupported = false;
+        bool prioritySupported = false;
+    };
+
+    // Chained into device creation (debug builds) to collect device memory reports.
+    vk::DeviceDeviceMemoryReportCreateInfoEXT getMemoryReportCreateInfo();
+
+    void setup(vk::Device, vk::PhysicalDevice, bool budgetEnabled, bool priorityEnabled);
+    void cleanup();
+
+    AllocationId allocate(const Request&);
+    void free(AllocationId);
+    vk::DeviceMemory getMemory(AllocationId);
+    // Maps the whole allocation on first use and keeps it mapped until it is freed, so every
+    // writer shares one mapping. Null for memory that isn't host-visible, or on failure.
+    void* map(AllocationId);
+    bool isDeviceLocal(AllocationId);
+    // Changes demotion order. The driver-side priority is fixed at allocation time.
+    void setPriority(AllocationId, Priority);
+
+    // Refreshes budgets and demotes allocations from over-budget heaps. Call once per frame.
+    void update();
+
+    const Telemetry& getTelemetry();
+    void writeTelemetry(Format::Buffer<char16_t>&);
+} // namespace Engine::Daedalus::Residency
@@ -0,0 +1,128 @@
+#include "Precompiled.h"
+
+#include "DaedalusResolution.h"
+#include "DaedalusCapabilities.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Engine::Daedalus::Resolution
+{
+    ResolutionController controller;
+    Stats stats;
+    float fixedScale = 0.0f;
+    vk::QueryPool queries = VK_NULL_HANDLE;
+    // Nanoseconds per timestamp tick, and the bits timestamps wrap at.
+    double period = 0.0;
+    u64 validMask = 0;
+    // Slots whose timestamps were written and not yet read.
+    bool written[Frame::FramesInFlight] = {};
+
+    Result setup(const ResolutionController::Config& config)
+    {
+        if (queries != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup dynamic resolution twice.\n");
+            return Result::Failed;
+        }
+        controller.reset(config);
+        stats = Stats();
+        stats.scale = controller.getScale();
+        fixedScale = 0.0f;
+
+        auto& profile = activeProfile();
+        auto& caps = Caps::getDevice(profile.gpu);
+        auto validBits = caps.queueFamilies[profile.gfxFamilyIdx].timestampValidBits;
+        period = caps.properties.limits.timestampPeriod;
+        if (validBits == 0 || period <= 0.0) {
+            Engine::Debug::Log("Dynamic resolution: no graphics timestamps, scale is fixed.\n");
+            return Result::Success;
+        }
+        validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+
+        auto info = vk::QueryPoolCreateInfo();
+        info.queryType = vk::QueryType::eTimestamp;
+        info.queryCount = 2 * Frame::FramesInFlight;
+        if (context.device.createQueryPool(&info, nullptr, &queries) != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+        std::fill(written, written + Frame::FramesInFlight, false);
+        stats.timestamps = true;
+        return Result::Success;
+    }
+
+    void cleanup()
+    {
+        Frame::destroyLater(queries);
+        queries = VK_NULL_HANDLE;
+        stats.timestamps = false;
+    }
+
+    void beginFrame(vk::CommandBuffer cmd)
+    {
+        if (queries == VK_NULL_HANDLE) return;
+
+        auto first = Frame::getFrameSlot() * 2;
+        cmd.resetQueryPool(queries, first, 2);
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, queries, first);
+    }
+
+    void endFrame(vk::CommandBuffer cmd)
+    {
+        if (queries == VK_NULL_HANDLE) return;
+
+        auto slot = Frame::getFrameSlot();
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, queries, slot * 2 + 1);
+        written[slot] = true;
+    }
+
+    vk::Extent2D getRenderExtent(vk::Extent2D output)
+    {
+        auto scale = fixedScale > 0.0f ? fixedScale : controller.getScale();
+        auto size = [scale](u32 full) {
+            auto scaled = (u32)std::lround((double)full * scale) & ~7u;
+            return std::clamp(scaled, std::min(full, 8u), full);
+        };
+        return vk::Extent2D(size(output.width), size(output.height));
+    }
+
+    void setFixedScale(float scale)
+    {
+        fixedScale = scale;
+        stats.scale = scale > 0.0f ? scale : controller.getScale();
+    }
+
+    void upscale(vk::CommandBuffer cmd, vk::Image src, vk::Extent2D renderExtent, vk::Image dst,
+        vk::Extent2D output)
+    {
+        auto layers = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+        auto blit = vk::ImageBlit();
+        blit.srcSubresource = layers;
+        blit.srcOffsets[1] = vk::Offset3D((i32)renderExtent.width, (i32)renderExtent.height, 1);
+        blit.dstSubresource = layers;
+        blit.dstOffsets[1] = vk::Offset3D((i32)output.width, (i32)output.height, 1);
+        cmd.blitImage(src, vk::ImageLayout::eTransferSrcOptimal, dst,
+            vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
+    }
+
+    const Stats& getStats()
+    {
+        return stats;
+    }
+
+    void update(u32 slot)
+    {
+        if (queries == VK_NULL_HANDLE || !written[slot]) return;
+        written[slot] = false;
+
+        u64 ticks[2] = {};
+        auto result = context.device.getQueryPoolResults(queries, slot * 2, 2, sizeof(ticks), ticks,
+            sizeof(u64), vk::QueryResultFlagBits::e64);
+        if (result != vk::Result::eSuccess) return;
+
+        stats.gpuMs = (float)((double)((ticks[1] - ticks[0]) & validMask) * period * 1e-6);
+        controller.update(stats.gpuMs);
+        stats.scale = fixedScale > 0.0f ? fixedScale : controller.getScale();
+    }
+} // namespace Engine::Daedalus::Resolution
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "ResolutionController.h"
+
+/// Dynamic resolution: trading render resolution for a steady GPU frame time.
+///
+/// Timestamps around each frame's graphics work measure its GPU time, read back once the
+/// frame's slot comes around again (so never stalling), and feed a ResolutionController.
+/// Scenes render into targets allocated once at full size, using only the top-left
+/// getRenderExtent() of them, and upscale() stretches that into the output, so changing
+/// scale never reallocates anything.
+namespace Engine::Daedalus::Resolution
+{
+    struct Stats
+    {
+        // Of the last frame measured; 0 when timestamps are unsupported.
+        float gpuMs = 0.0f;
+        float scale = 1.0f;
+        bool timestamps = false;
+    };
+
+    Result setup(const ResolutionController::Config& = ResolutionController::Config());
+    // Call before terminate().
+    void cleanup();
+
+    // Record first and last in the frame's graphics work, on the graphics queue.
+    void beginFrame(vk::CommandBuffer);
+    void endFrame(vk::CommandBuffer);
+
+    // output scaled by the current scale, in multiples of 8 texels.
+    vk::Extent2D getRenderExtent(vk::Extent2D output);
+    // Pins the scale, e.g. for captures; 0 hands it back to the controller.
+    void setFixedScale(float);
+
+    /// <summary>
+    /// Bilinearly stretches the top-left renderExtent of src, in eTransferSrcOptimal, over
+    /// dst, in eTransferDstOptimal. The format of src needs linear filtering for blits.
+    /// </summary>
+    void upscale(vk::CommandBuffer, vk::Image src, vk::Extent2D renderExtent, vk::Image dst,
+        vk::Extent2D output);
+
+    const Stats& getStats();
+
+    // Reads the slot's timestamps, from the frame that last used it, into the controller.
+    // Called by Frame::begin() once that frame has completed.
+    void update(u32 slot);
+} // namespace Engine::Daedalus::Resolution
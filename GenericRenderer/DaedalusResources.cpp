@@ -0,0 +1,491 @@
+#include "Precompiled.h"
+
+#include "DaedalusResources.h"
+#include "DaedalusCapture.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace Engine::Daedalus::Resources
+{
+    struct PendingUpload
+    {
+        // The staging ring, or a dedicated buffer released once the copy is recorded.
+        BufferHandle staging;
+        vk::DeviceSize stagingOffset = 0;
+        BufferHandle target;
+        vk::DeviceSize offset = 0;
+        vk::DeviceSize size = 0;
+    };
+
+    // A demoted buffer's old storage, copied into its replacement by the next recordUploads().
+    struct PendingMove
+    {
+        vk::Buffer from;
+        Residency::AllocationId allocation;
+        BufferHandle target;
+        vk::DeviceSize size = 0;
+    };
+
+    // Staging for uploads to device-local buffers: one persistently mapped buffer, handed out
+    // at the head and given back at the tail once the frame copying out of it has completed.
+    // Uploads that don't fit get a dedicated buffer instead.
+    const vk::DeviceSize StagingSize = 16ull << 20;
+    const vk::DeviceSize StagingAlignment = 16;
+
+    vk::Device device = VK_NULL_HANDLE;
+    HandleTable<Buffer> buffers;
+    HandleTable<Image> images;
+    // Live buffer objects to their handles, for findBuffer().
+    std::unordered_map<VkBuffer, BufferHandle> bufferHandles;
+    List<PendingUpload> pendingUploads;
+    List<PendingMove> pendingMoves;
+    BufferHandle staging;
+    u8* stagingMapped = nullptr;
+    // Positions only ever grow; the offset into the ring is the position modulo its size.
+    u64 stagingHead = 0;
+    u64 stagingTail = 0;
+
+    void setup(vk::Device device)
+    {
+        if (Resources::device != VK_NULL_HANDLE) {
+            Engine::Debug::Log("Attempting to setup resources twice.\n");
+            return;
+        }
+        Resources::device = device;
+    }
+
+    void cleanup()
+    {
+        if (device == VK_NULL_HANDLE) return;
+
+        // Staging buffers aren't the caller's leaks.
+        for (auto& upload : pendingUploads) {
+            auto dedicated = Buffer();
+            if (upload.staging != staging && buffers.remove(upload.staging, &dedicated)) {
+                device.destroyBuffer(dedicated.buffer);
+                Residency::free(dedicated.allocation);
+            }
+        }
+        pendingUploads.clear();
+        auto ring = Buffer();
+        if (buffers.remove(staging, &ring)) {
+            device.destroyBuffer(ring.buffer);
+            Residency::free(ring.allocation);
+        }
+        staging = BufferHandle();
+        stagingMapped = nullptr;
+        stagingHead = 0;
+        stagingTail = 0;
+        for (auto& move : pendingMoves) {
+            device.destroyBuffer(move.from);
+            Residency::free(move.allocation);
+        }
+        pendingMoves.clear();
+        buffers.forEach([](BufferHandle, Buffer& buffer) {
+            device.destroyBuffer(buffer.buffer);
+            Residency::free(buffer.allocation);
+        });
+        images.forEach([](ImageHandle, Image& image) {
+            device.destroyImageView(image.view);
+            device.destroyImage(image.image);
+            Residency::free(image.allocation);
+        });
+        if (buffers.size() + images.size() > 0) {
+            Engine::Debug::Log("Resources: destroyed {} leaked buffers and {} leaked images.\n",
+                buffers.size(), images.size());
+        }
+        buffers.clear();
+        images.clear();
+        bufferHandles.clear();
+        device = VK_NULL_HANDLE;
+    }
+
+    // Creates the buffer and its memory into result.buffer and result.allocation.
+    Result createObjects(Buffer& result, vk::BufferUsageFlags usage, Residency::Request request)
+    {
+        auto info = vk::BufferCreateInfo();
+        info.size = result.desc.size;
+        info.usage = usage;
+        info.sharingMode = vk::SharingMode::eExclusive;
+        auto& profile = activeProfile();
+        u32 families[] = { profile.gfxFamilyIdx, profile.cmpFamilyIdx };
+        if (result.desc.concurrent && profile.cmpFamilyIdx != UINT32_MAX) {
+            info.sharingMode = vk::SharingMode::eConcurrent;
+            info.queueFamilyIndexCount = 2;
+            info.pQueueFamilyIndices = families;
+        }
+        if (device.createBuffer(&info, nullptr, &result.buffer) != vk::Result::eSuccess) {
+            return Result::Failed;
+        }
+
+        request.requirements = device.getBufferMemoryRequirements(result.buffer);
+        result.allocation = Residency::allocate(request);
+        if (!result.allocation.isValid()) {
+            device.destroyBuffer(result.buffer);
+            return Result::Failed;
+        }
+        device.bindBufferMemory(result.buffer, Residency::getMemory(result.allocation), 0);
+        return Result::Success;
+    }
+
+    // Residency's user pointer for a buffer's allocation carries its handle.
+    void* toUser(BufferHandle handle)
+    {
+        static_assert(sizeof(void*) >= sizeof(u64), "Buffer handles don't fit a user pointer.");
+        return (void*)(uintptr_t)(((u64)handle.index << 32) | handle.generation);
+    }
+
+    BufferHandle fromUser(void* user)
+    {
+        auto bits = (u64)(uintptr_t)user;
+        auto handle = BufferHandle();
+        handle.index = (u32)(bits >> 32);
+        handle.generation = (u32)bits;
+        return handle;
+    }
+
+    /// <summary>
+    /// Residency's demote callback. Moves the buffer into host-visible memory behind the same
+    /// handle: the replacement is swapped in now, the contents are copied over by the next
+    /// recordUploads(), and the old buffer is freed once the frame recording that copy is done.
+    /// </summary>
+    void demoteBuffer(Residency::AllocationId id, void* user)
+    {
+        auto handle = fromUser(user);
+        auto buffer = buffers.get(handle);
+        if (buffer == nullptr || buffer->allocation != id) return;
+
+        auto replacement = Buffer();
+        replacement.desc = buffer->desc;
+        auto request = Residency::Request();
+        request.properties =
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        request.priority = buffer->desc.priority;
+        request.demotes = id;
+        auto usage = buffer->desc.usage | vk::BufferUsageFlagBits::eTransferDst;
+        if (createObjects(replacement, usage, request) != Result::Success) {
+            Engine::Debug::Log("Resources: failed to demote a buffer of {} bytes.\n",
+                (u64)buffer->desc.size);
+            return;
+        }
+
+        auto move = PendingMove();
+        move.from = buffer->buffer;
+        move.allocation = buffer->allocation;
+        move.target = handle;
+        move.size = buffer->desc.size;
+        pendingMoves.push_back(move);
+        bufferHandles.erase((VkBuffer)buffer->buffer);
+        bufferHandles[(VkBuffer)replacement.buffer] = handle;
+        buffer->buffer = replacement.buffer;
+        buffer->allocation = replacement.allocation;
+    }
+
+    // Creates without reporting to capture, for internal buffers such as staging.
+    BufferHandle create(const BufferDesc& desc)
+    {
+        auto result = Buffer();
+        result.desc = desc;
+        auto usage = desc.usage;
+        auto request = Residency::Request();
+        request.properties = desc.properties;
+        request.priority = desc.priority;
+        // Critical buffers stay pinned in device memory.
+        if ((desc.properties & vk::MemoryPropertyFlagBits::eDeviceLocal) &&
+            desc.priority != Residency::Priority::Critical) {
+            // Demotion copies out of the buffer.
+            usage |= vk::BufferUsageFlagBits::eTransferSrc;
+            request.onDemote = demoteBuffer;
+        }
+        // Inserted first, so the allocation can carry the handle for demoteBuffer().
+        auto handle = buffers.insert(result);
+        request.user = toUser(handle);
+        if (createObjects(*buffers.get(handle), usage, request) != Result::Success) {
+            buffers.remove(handle);
+            return BufferHandle();
+        }
+        bufferHandles[(VkBuffer)buffers.get(handle)->buffer] = handle;
+        return handle;
+    }
+
+    BufferHandle createBuffer(const BufferDesc& desc)
+    {
+        auto handle = create(desc);
+        if (handle.isValid()) {
+            Capture::recordCreateBuffer(handle, desc);
+        }
+        return handle;
+    }
+
+    vk::ImageViewType toViewType(const vk::ImageCreateInfo& info)
+    {
+        switch (info.imageType) {
+        case vk::ImageType::e1D:
+            return info.arrayLayers > 1 ? vk::ImageViewType::e1DArray : vk::ImageViewType::e1D;
+        case vk::ImageType::e3D:
+            return vk::ImageViewType::e3D;
+        default:
+            break;
+        }
+        if (info.flags & vk::ImageCreateFlagBits::eCubeCompatible) {
+            return info.arrayLayers > 6 ? vk::ImageViewType::eCubeArray : vk::ImageViewType::eCube;
+        }
+        return info.arrayLayers > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D;
+    }
+
+    ImageHandle createImage(const ImageDesc& desc)
+    {
+        auto result = Image();
+        result.desc = desc;
+        if (device.createImage(&desc.info, nullptr, &result.image) != vk::Result::eSuccess) {
+            return ImageHandle();
+        }
+
+        auto request = Residency::Request();
+        request.requirements = device.getImageMemoryRequirements(result.image);
+        request.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        request.priority = desc.priority;
+        result.allocation = Residency::allocate(request);
+        if (!result.allocation.isValid()) {
+            device.destroyImage(result.image);
+            return ImageHandle();
+        }
+        device.bindImageMemory(result.image, Residency::getMemory(result.allocation), 0);
+
+        auto viewInfo = vk::ImageViewCreateInfo();
+        viewInfo.image = result.image;
+        viewInfo.viewType = toViewType(desc.info);
+        viewInfo.format = desc.info.format;
+        viewInfo.subresourceRange.aspectMask = desc.aspect;
+        viewInfo.subresourceRange.levelCount = desc.info.mipLevels;
+        viewInfo.subresourceRange.layerCount = desc.info.arrayLayers;
+        if (device.createImageView(&viewInfo, nullptr, &result.view) != vk::Result::eSuccess) {
+            device.destroyImage(result.image);
+            Residency::free(result.allocation);
+            return ImageHandle();
+        }
+        auto handle = images.insert(result);
+        Capture::recordCreateImage(handle, desc);
+        return handle;
+    }
+
+    const Buffer* getBuffer(BufferHandle handle)
+    {
+        return buffers.get(handle);
+    }
+
+    const Image* getImage(ImageHandle handle)
+    {
+        return images.get(handle);
+    }
+
+    List<BufferHandle> getBufferHandles()
+    {
+        auto handles = List<BufferHandle>();
+        buffers.forEach([&handles](BufferHandle handle, Buffer&) { handles.push_back(handle); });
+        return handles;
+    }
+
+    BufferHandle findBuffer(vk::Buffer buffer)
+    {
+        auto it = bufferHandles.find((VkBuffer)buffer);
+        return it != bufferHandles.end() ? it->second : BufferHandle();
+    }
+
+    List<ImageHandle> getImageHandles()
+    {
+        auto handles = List<ImageHandle>();
+        images.forEach([&handles](ImageHandle handle, Image&) { handles.push_back(handle); });
+        return handles;
+    }
+
+    void* map(BufferHandle handle)
+    {
+        auto buffer = buffers.get(handle);
+        return buffer ? Residency::map(buffer->allocation) : nullptr;
+    }
+
+    // Destroys without reporting to capture.
+    void release(BufferHandle handle)
+    {
+        auto buffer = Buffer();
+        if (!buffers.remove(handle, &buffer)) return;
+        bufferHandles.erase((VkBuffer)buffer.buffer);
+
+        Frame::destroyLater(buffer.buffer);
+        Frame::destroyLater(buffer.allocation);
+    }
+
+    Result write(const Buffer& buffer, vk::DeviceSize offset, const void* data, vk::DeviceSize size)
+    {
+        // Shares the persistent mapping with the upload ring, readback and the like, as
+        // memory can't be mapped twice.
+        auto mapped = (u8*)Residency::map(buffer.allocation);
+        if (mapped == nullptr) return Result::Failed;
+
+        memcpy(mapped + offset, data, (size_t)size);
+        if (!(buffer.desc.properties & vk::MemoryPropertyFlagBits::eHostCoherent)) {
+            auto range = vk::MappedMemoryRange();
+            range.memory = Residency::getMemory(buffer.allocation);
+            range.size = VK_WHOLE_SIZE;
+            (void)device.flushMappedMemoryRanges(1, &range);
+        }
+        return Result::Success;
+    }
+
+    BufferDesc stagingDesc(vk::DeviceSize size)
+    {
+        auto desc = BufferDesc();
+        desc.size = size;
+        desc.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        desc.properties =
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        return desc;
+    }
+
+    // Frame::destroyLater callback; user is the ring position the completed copies ended at.
+    void releaseStaging(void* user)
+    {
+        stagingTail = std::max(stagingTail, (u64)(uintptr_t)user);
+    }
+
+    /// <summary>
+    /// Reserves size bytes of the staging ring, creating it on first use. Never wraps an
+    /// allocation around the end of the ring. Null when the ring is too full or can't be
+    /// created, for the caller to fall back to a dedicated buffer.
+    /// </summary>
+    u8* allocateStaging(vk::DeviceSize size, vk::DeviceSize& offset)
+    {
+        if (size > StagingSize) return nullptr;
+        if (stagingMapped == nullptr) {
+            staging = create(stagingDesc(StagingSize));
+            stagingMapped = (u8*)map(staging);
+            if (stagingMapped == nullptr) {
+                release(staging);
+                staging = BufferHandle();
+                return nullptr;
+            }
+        }
+
+        auto start = stagingHead;
+        if (start % StagingSize + size > StagingSize) {
+            start += StagingSize - start % StagingSize;
+        }
+        auto end = start + (size + StagingAlignment - 1) / StagingAlignment * StagingAlignment;
+        if (end - stagingTail > StagingSize) return nullptr;
+
+        stagingHead = end;
+        offset = start % StagingSize;
+        return stagingMapped + offset;
+    }
+
+    Result upload(BufferHandle handle, vk::DeviceSize offset, const void* data, vk::DeviceSize size)
+    {
+        auto buffer = buffers.get(handle);
+        if (buffer == nullptr || offset + size > buffer->desc.size) return Result::Failed;
+
+        Capture::recordUpload(handle, offset, data, size);
+        if (buffer->desc.properties & vk::MemoryPropertyFlagBits::eHostVisible) {
+            return write(*buffer, offset, data, size);
+        }
+
+        auto pending = PendingUpload();
+        pending.target = handle;
+        pending.offset = offset;
+        pending.size = size;
+        if (auto mapped = allocateStaging(size, pending.stagingOffset)) {
+            memcpy(mapped, data, (size_t)size);
+            pending.staging = staging;
+        } else {
+            pending.staging = create(stagingDesc(size));
+            if (!pending.staging.isValid()) return Result::Failed;
+            if (write(*buffers.get(pending.staging), 0, data, size) != Result::Success) {
+                release(pending.staging);
+                return Result::Failed;
+            }
+        }
+        pendingUploads.push_back(pending);
+        return Result::Success;
+    }
+
+    void recordUploads(vk::CommandBuffer cmd)
+    {
+        if (pendingMoves.empty() && pendingUploads.empty()) return;
+
+        if (!pendingMoves.empty()) {
+            // Earlier frames may still have been writing the demoted buffers.
+            auto barrier = vk::MemoryBarrier();
+            barrier.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands,
+                vk::PipelineStageFlagBits::eTransfer, {}, barrier, nullptr, nullptr);
+        }
+        for (auto& move : pendingMoves) {
+            // Buffers destroyed since the demotion just free their old storage.
+            auto target = buffers.get(move.target);
+            if (target != nullptr) {
+                cmd.copyBuffer(move.from, target->buffer, vk::BufferCopy(0, 0, move.size));
+            }
+            Frame::destroyLater(move.from);
+            Frame::destroyLater(move.allocation);
+        }
+        if (!pendingMoves.empty() && !pendingUploads.empty()) {
+            // Uploads land on top of the moved contents.
+            auto barrier = vk::MemoryBarrier();
+            barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+            barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                vk::PipelineStageFlagBits::eTransfer, {}, barrier, nullptr, nullptr);
+        }
+        pendingMoves.clear();
+
+        auto usedRing = false;
+        for (auto& upload : pendingUploads) {
+            // Copies into buffers destroyed since the upload are dropped.
+            auto target = buffers.get(upload.target);
+            if (target != nullptr) {
+                auto region = vk::BufferCopy(upload.stagingOffset, upload.offset, upload.size);
+                cmd.copyBuffer(buffers.get(upload.staging)->buffer, target->buffer, region);
+            }
+            if (upload.staging == staging) {
+                usedRing = true;
+            } else {
+                release(upload.staging);
+            }
+        }
+        pendingUploads.clear();
+        // Everything up to the head was copied in this frame, or earlier.
+        if (usedRing) {
+            Frame::destroyLater(releaseStaging, (void*)(uintptr_t)stagingHead);
+        }
+
+        auto barrier = vk::MemoryBarrier();
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+            vk::PipelineStageFlagBits::eAllCommands, {}, barrier, nullptr, nullptr);
+    }
+
+    void destroyBuffer(BufferHandle handle)
+    {
+        if (buffers.contains(handle)) {
+            Capture::recordDestroyBuffer(handle);
+        }
+        release(handle);
+    }
+
+    void destroyImage(ImageHandle handle)
+    {
+        auto image = Image();
+        if (!images.remove(handle, &image)) return;
+        Capture::recordDestroyImage(handle);
+
+        Frame::destroyLater(image.view);
+        Frame::destroyLater(image.image);
+        Frame::destroyLater(image.allocation);
+    }
+} // namespace Engine::Daedalus::Resources
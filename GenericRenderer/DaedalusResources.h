@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusResidency.h"
+#include "HandleTable.h"
+
+/// Handle-based registry for GPU buffers and images.
+///
+/// Callers hold generational handles instead of raw Vulkan objects, so a handle kept past its
+/// resource's destruction resolves to nothing rather than to a dangling or reused object.
+/// Destruction is deferred through the frame timeline: the handle dies immediately, the
+/// Vulkan objects and memory once the GPU has finished the frame that released them.
+///
+/// Device-local buffers below Critical priority can be demoted by the residency manager when
+/// their heap runs over budget. The buffer is recreated in host-visible memory behind the same
+/// handle, so the raw vk::Buffer changes; resolve it through the handle each frame rather than
+/// caching it (e.g. in descriptor sets) unless the buffer is Critical.
+namespace Engine::Daedalus::Resources
+{
+    struct BufferDesc
+    {
+        vk::DeviceSize size = 0;
+        vk::BufferUsageFlags usage;
+        vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        Residency::Priority priority = Residency::Priority::Normal;
+        // Shared by the graphics and async compute queues without ownership transfers.
+        // Ignored when the device has no separate compute family.
+        bool concurrent = false;
+    };
+
+    struct Buffer
+    {
+        vk::Buffer buffer;
+        Residency::AllocationId allocation;
+        BufferDesc desc;
+    };
+    using BufferHandle = Handle<Buffer>;
+
+    struct ImageDesc
+    {
+        vk::ImageCreateInfo info;
+        vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+        Residency::Priority priority = Residency::Priority::Normal;
+    };
+
+    struct Image
+    {
+        vk::Image image;
+        // Covers every mip and layer.
+        vk::ImageView view;
+        Residency::AllocationId allocation;
+        ImageDesc desc;
+    };
+    using ImageHandle = Handle<Image>;
+
+    void setup(vk::Device);
+    // Destroys everything still registered, immediately. Call after Frame::cleanup().
+    void cleanup();
+
+    // Default-constructed (invalid) handles are returned on failure.
+    BufferHandle createBuffer(const BufferDesc&);
+    ImageHandle createImage(const ImageDesc&);
+
+    // Null for stale or invalid handles. Valid until the next create call or demotion.
+    const Buffer* getBuffer(BufferHandle);
+    const Image* getImage(ImageHandle);
+    // Every live handle, e.g. to snapshot the registry.
+    List<BufferHandle> getBufferHandles();
+    List<ImageHandle> getImageHandles();
+    // The handle owning a live buffer object, e.g. to name raw buffers in a capture.
+    BufferHandle findBuffer(vk::Buffer);
+    // The buffer's persistent mapping (see Residency::map). Null unless it is host-visible.
+    void* map(BufferHandle);
+
+    /// <summary>
+    /// Writes data into the buffer at offset. Host-visible buffers are written immediately;
+    /// others (which need TransferDst usage) get a staging copy that the next recordUploads()
+    /// records, so the data lands in the frame that call is submitted with. Staging comes
+    /// from a persistent ring, or a dedicated buffer for uploads the ring has no room for.
+    /// </summary>
+    Result upload(BufferHandle, vk::DeviceSize offset, const void* data, vk::DeviceSize size);
+    // Records the demotion moves and staging copies queued since the last call, followed by a
+    // barrier making them visible to the rest of the command buffer. Record it first in the
+    // frame's first command buffer, before anything reads the buffers.
+    void recordUploads(vk::CommandBuffer);
+
+    // Invalidates the handle now; the objects are destroyed once the current frame completes.
+    void destroyBuffer(BufferHandle);
+    void destroyImage(ImageHandle);
+} // namespace Engine::Daedalus::Resources
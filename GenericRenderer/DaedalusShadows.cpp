@@ -0,0 +1,326 @@
+#include "Precompiled.h"
+
+#include "DaedalusShadows.h"
+#include "AtlasAllocator.h"
+#include "DaedalusInternal.h"
+#include "DaedalusResources.h"
+
+#include <algorithm>
+
+namespace Engine::Daedalus::Shadows
+{
+    struct Shadow
+    {
+        AtlasAllocator::Tile tile;
+        // The cache holds this tile's static casters.
+        bool staticValid = false;
+        bool dynamicNow = false;
+        bool dynamicLast = false;
+    };
+
+    struct Image
+    {
+        Resources::ImageHandle handle;
+        vk::Image image;
+        vk::ImageView view;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+
+    Config config;
+    Stats stats;
+    AtlasAllocator allocator;
+    HandleTable<Shadow> shadows;
+    Image atlas;
+    // Static casters only, in the same tiles as the atlas.
+    Image cache;
+
+    Result createImage(Image& out, vk::ImageUsageFlags usage)
+    {
+        auto desc = Resources::ImageDesc();
+        desc.info.imageType = vk::ImageType::e2D;
+        desc.info.format = config.format;
+        desc.info.extent = vk::Extent3D(config.atlasSize, config.atlasSize, 1);
+        desc.info.mipLevels = 1;
+        desc.info.arrayLayers = 1;
+        desc.info.samples = vk::SampleCountFlagBits::e1;
+        desc.info.tiling = vk::ImageTiling::eOptimal;
+        desc.info.usage = usage | vk::ImageUsageFlagBits::eDepthStencilAttachment;
+        desc.aspect = vk::ImageAspectFlagBits::eDepth;
+        desc.priority = Residency::Priority::Critical;
+        out.handle = Resources::createImage(desc);
+        auto image = Resources::getImage(out.handle);
+        if (image == nullptr) return Result::Failed;
+        out.image = image->image;
+        out.view = image->view;
+        out.layout = vk::ImageLayout::eUndefined;
+        return Result::Success;
+    }
+
+    Result setup(const Config& config)
+    {
+        if (atlas.handle.isValid()) {
+            Engine::Debug::Log("Attempting to setup shadows twice.\n");
+            return Result::Failed;
+        }
+        Shadows::config = config;
+        Shadows::config.maxTile = std::min(config.maxTile, config.atlasSize);
+        allocator.reset(config.atlasSize, config.minTile);
+        stats = Stats();
+
+        using usage = vk::ImageUsageFlagBits;
+        if (createImage(atlas, usage::eSampled | usage::eTransferDst) != Result::Success ||
+            createImage(cache, usage::eTransferSrc) != Result::Success) {
+            Engine::Debug::Log("Shadows: unable to create a {}x{} atlas.\n", config.atlasSize,
+                config.atlasSize);
+            cleanup();
+            return Result::Failed;
+        }
+        return Result::Success;
+    }
+
+    void cleanup()
+    {
+        Resources::destroyImage(atlas.handle);
+        Resources::destroyImage(cache.handle);
+        atlas = Image();
+        cache = Image();
+        shadows.clear();
+        allocator.reset(config.atlasSize, config.minTile);
+    }
+
+    ShadowHandle create()
+    {
+        return shadows.insert(Shadow());
+    }
+
+    void destroy(ShadowHandle handle)
+    {
+        auto shadow = Shadow();
+        if (!shadows.remove(handle, &shadow)) return;
+        allocator.free(shadow.tile);
+    }
+
+    u32 tileSizeFor(float screenCoverage)
+    {
+        auto wanted = std::clamp(screenCoverage, 0.0f, 1.0f) * (float)config.maxTile;
+        auto size = config.minTile;
+        while (size < config.maxTile && (float)size < wanted)
+            size <<= 1;
+        return size;
+    }
+
+    void update(ShadowHandle handle, float screenCoverage, bool hasDynamicCasters)
+    {
+        auto shadow = shadows.get(handle);
+        if (shadow == nullptr) return;
+
+        shadow->dynamicNow = hasDynamicCasters;
+        auto size = tileSizeFor(screenCoverage);
+        auto current = shadow->tile.size;
+        if (shadow->tile.isValid() && size <= current && size * 4 > current) return;
+
+        // Grow into a new tile before giving up the current one. Under atlas pressure the
+        // shadow keeps its tile, and the cached static depth in it, until space frees up.
+        if (shadow->tile.isValid() && size > current) {
+            auto grown = AtlasAllocator::Tile();
+            for (; !grown.isValid() && size > current; size >>= 1)
+                grown = allocator.allocate(size);
+            if (!grown.isValid()) return;
+
+            allocator.free(shadow->tile);
+            shadow->tile = grown;
+            shadow->staticValid = false;
+            return;
+        }
+
+        // Free first, so a shrinking tile can reuse its own space.
+        allocator.free(shadow->tile);
+        shadow->tile = AtlasAllocator::Tile();
+        shadow->staticValid = false;
+        for (; !shadow->tile.isValid() && size >= config.minTile; size >>= 1)
+            shadow->tile = allocator.allocate(size);
+    }
+
+    void invalidate(ShadowHandle handle)
+    {
+        auto shadow = shadows.get(handle);
+        if (shadow != nullptr) {
+            shadow->staticValid = false;
+        }
+    }
+
+    void invalidateAll()
+    {
+        shadows.forEach([](ShadowHandle, Shadow& shadow) { shadow.staticValid = false; });
+    }
+
+    Tile getTile(ShadowHandle handle)
+    {
+        auto result = Tile();
+        auto shadow = shadows.get(handle);
+        if (shadow == nullptr || !shadow->tile.isValid()) return result;
+
+        auto& tile = shadow->tile;
+        result.rect = vk::Rect2D({ (i32)tile.x, (i32)tile.y }, { tile.size, tile.size });
+        auto scale = 1.0f / (float)config.atlasSize;
+        result.uvTransform = { tile.size * scale, tile.size * scale, tile.x * scale,
+            tile.y * scale };
+        return result;
+    }
+
+    // Where an image in this layout was last used, for the barrier leaving it.
+    void usageOf(vk::ImageLayout layout, vk::PipelineStageFlags& stages,
+        vk::AccessFlags& access)
+    {
+        using stage = vk::PipelineStageFlagBits;
+        using flag = vk::AccessFlagBits;
+        switch (layout) {
+        case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+            stages = stage::eEarlyFragmentTests | stage::eLateFragmentTests;
+            access = flag::eDepthStencilAttachmentRead | flag::eDepthStencilAttachmentWrite;
+            break;
+        case vk::ImageLayout::eTransferSrcOptimal:
+            stages = stage::eTransfer;
+            access = flag::eTransferRead;
+            break;
+        case vk::ImageLayout::eTransferDstOptimal:
+            stages = stage::eTransfer;
+            access = flag::eTransferWrite;
+            break;
+        case vk::ImageLayout::eDepthStencilReadOnlyOptimal:
+            stages = stage::eFragmentShader;
+            access = flag::eShaderRead;
+            break;
+        default:
+            stages = stage::eTopOfPipe;
+            access = {};
+            break;
+        }
+    }
+
+    void transition(vk::CommandBuffer cmd, Image& image, vk::ImageLayout layout)
+    {
+        if (image.layout == layout) return;
+
+        auto barrier = vk::ImageMemoryBarrier();
+        auto srcStages = vk::PipelineStageFlags();
+        auto dstStages = vk::PipelineStageFlags();
+        usageOf(image.layout, srcStages, barrier.srcAccessMask);
+        usageOf(layout, dstStages, barrier.dstAccessMask);
+        barrier.oldLayout = image.layout;
+        barrier.newLayout = layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.image;
+        barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eDepth,
+            0, 1, 0, 1);
+        cmd.pipelineBarrier(srcStages, dstStages, {}, nullptr, nullptr, barrier);
+        image.layout = layout;
+    }
+
+    void beginRendering(vk::CommandBuffer cmd, const Image& image)
+    {
+        auto depth = vk::RenderingAttachmentInfo();
+        depth.imageView = image.view;
+        depth.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        depth.loadOp = vk::AttachmentLoadOp::eLoad;
+        depth.storeOp = vk::AttachmentStoreOp::eStore;
+        auto info = vk::RenderingInfo();
+        info.renderArea = vk::Rect2D({ 0, 0 }, { config.atlasSize, config.atlasSize });
+        info.layerCount = 1;
+        info.pDepthAttachment = &depth;
+        cmd.beginRendering(info);
+    }
+
+    void setTile(vk::CommandBuffer cmd, const AtlasAllocator::Tile& tile)
+    {
+        auto size = (float)tile.size;
+        cmd.setViewport(0, vk::Viewport((float)tile.x, (float)tile.y, size, size, 0.0f, 1.0f));
+        cmd.setScissor(0, vk::Rect2D({ (i32)tile.x, (i32)tile.y }, { tile.size, tile.size }));
+    }
+
+    void record(vk::CommandBuffer cmd, DrawFn draw, void* user)
+    {
+        stats.staticRenders = 0;
+        stats.dynamicRenders = 0;
+        stats.copies = 0;
+        stats.unallocated = 0;
+        stats.shadows = shadows.size();
+        stats.usedTexels = allocator.getUsedArea();
+        if (!atlas.handle.isValid()) return;
+
+        auto refresh = List<ShadowHandle>();
+        auto copies = List<vk::ImageCopy>();
+        auto dynamic = List<ShadowHandle>();
+        shadows.forEach([&](ShadowHandle handle, Shadow& shadow) {
+            if (!shadow.tile.isValid()) {
+                stats.unallocated++;
+                return;
+            }
+            if (!shadow.staticValid) {
+                refresh.push_back(handle);
+            }
+            // Last frame's dynamic casters have to be cleared out too.
+            if (!shadow.staticValid || shadow.dynamicNow || shadow.dynamicLast) {
+                auto& tile = shadow.tile;
+                auto layers = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eDepth, 0, 0,
+                    1);
+                auto offset = vk::Offset3D((i32)tile.x, (i32)tile.y, 0);
+                copies.push_back(vk::ImageCopy(layers, offset, layers, offset,
+                    vk::Extent3D(tile.size, tile.size, 1)));
+            }
+            if (shadow.dynamicNow) {
+                dynamic.push_back(handle);
+            }
+            shadow.dynamicLast = shadow.dynamicNow;
+        });
+
+        if (!refresh.empty()) {
+            transition(cmd, cache, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+            beginRendering(cmd, cache);
+            for (auto handle : refresh) {
+                auto shadow = shadows.get(handle);
+                setTile(cmd, shadow->tile);
+                auto clear = vk::ClearAttachment(vk::ImageAspectFlagBits::eDepth, 0,
+                    vk::ClearDepthStencilValue(config.clearDepth, 0));
+                auto rect = vk::ClearRect(vk::Rect2D({ (i32)shadow->tile.x, (i32)shadow->tile.y },
+                    { shadow->tile.size, shadow->tile.size }), 0, 1);
+                cmd.clearAttachments(clear, rect);
+                draw(cmd, handle, true, user);
+                shadow->staticValid = true;
+            }
+            cmd.endRendering();
+            stats.staticRenders = (u32)refresh.size();
+        }
+
+        if (!copies.empty()) {
+            transition(cmd, cache, vk::ImageLayout::eTransferSrcOptimal);
+            transition(cmd, atlas, vk::ImageLayout::eTransferDstOptimal);
+            cmd.copyImage(cache.image, vk::ImageLayout::eTransferSrcOptimal, atlas.image,
+                vk::ImageLayout::eTransferDstOptimal, (u32)copies.size(), copies.data());
+            stats.copies = (u32)copies.size();
+        }
+
+        if (!dynamic.empty()) {
+            transition(cmd, atlas, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+            beginRendering(cmd, atlas);
+            for (auto handle : dynamic) {
+                setTile(cmd, shadows.get(handle)->tile);
+                draw(cmd, handle, false, user);
+            }
+            cmd.endRendering();
+            stats.dynamicRenders = (u32)dynamic.size();
+        }
+        transition(cmd, atlas, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+    }
+
+    vk::ImageView getAtlasView()
+    {
+        return atlas.view;
+    }
+
+    const Stats& getStats()
+    {
+        return stats;
+    }
+} // namespace Engine::Daedalus::Shadows
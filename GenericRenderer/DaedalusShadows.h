@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "HandleTable.h"
+#include "Math.h"
+
+/// Shadow maps packed into one cached depth atlas.
+///
+/// Every shadow (a spot light, or one face of a point light) gets a square tile of the atlas,
+/// sized by how much of the screen its light covers, so lights far away or small on screen
+/// cost few texels. Static casters are rendered once per tile into a cache image of the same
+/// layout and kept until invalidate(); each frame only tiles with moving casters are restored
+/// from the cache and have their dynamic casters drawn on top. Tiles with neither a fresh
+/// static render nor dynamic casters, this frame or last, are left untouched.
+namespace Engine::Daedalus::Shadows
+{
+    struct Config
+    {
+        // Powers of two.
+        u32 atlasSize = 4096;
+        u32 minTile = 64;
+        u32 maxTile = 1024;
+        vk::Format format = vk::Format::eD32Sfloat;
+        // Depth of an empty tile: the far plane, as in Math::Mat4::perspective.
+        float clearDepth = 1.0f;
+    };
+
+    struct Shadow;
+    using ShadowHandle = Handle<Shadow>;
+
+    struct Tile
+    {
+        vk::Rect2D rect;
+        // Atlas UV = tile UV * xy + zw, for shaders sampling the tile.
+        Math::Vec4 uvTransform;
+
+        bool isValid() const { return rect.extent.width != 0; }
+    };
+
+    struct Stats
+    {
+        u32 shadows = 0;
+        // Shadows without a tile, as the atlas was full.
+        u32 unallocated = 0;
+        // In the last record().
+        u32 staticRenders = 0;
+        u32 dynamicRenders = 0;
+        u32 copies = 0;
+        u64 usedTexels = 0;
+    };
+
+    // Draws one shadow's static or dynamic casters, with the viewport and scissor on its tile.
+    using DrawFn = void (*)(vk::CommandBuffer, ShadowHandle, bool staticCasters, void* user);
+
+    // Creates the atlas and cache images. Call after the device is created.
+    Result setup(const Config& = Config());
+    // Call before terminate().
+    void cleanup();
+
+    ShadowHandle create();
+    void destroy(ShadowHandle);
+
+    /// <summary>
+    /// Called every frame the shadow is used, before record(). screenCoverage is the fraction
+    /// of the screen height the light's influence covers; the tile grows at once when that
+    /// asks for more texels, and shrinks only once it asks for a quarter of them, so tiles
+    /// don't flip between sizes. A tile that can't grow for lack of atlas space keeps its
+    /// current size and retries on later frames. Reallocating invalidates the cached static
+    /// depth.
+    /// </summary>
+    void update(ShadowHandle, float screenCoverage, bool hasDynamicCasters);
+    // Re-renders the static casters, e.g. after the light or static geometry moved.
+    void invalidate(ShadowHandle);
+    void invalidateAll();
+    // Invalid when the shadow has no tile; shaders treat it as unshadowed.
+    Tile getTile(ShadowHandle);
+
+    /// <summary>
+    /// Renders the static and dynamic casters that need it and leaves the atlas in
+    /// eDepthStencilReadOnlyOptimal for sampling in fragment shaders. Record outside rendering, on
+    /// the graphics queue, before the passes that sample the atlas.
+    /// </summary>
+    void record(vk::CommandBuffer, DrawFn, void* user);
+
+    vk::ImageView getAtlasView();
+    const Stats& getStats();
+} // namespace Engine::Daedalus::Shadows
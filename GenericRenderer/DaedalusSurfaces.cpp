@@ -0,0 +1,281 @@
+#include "Precompiled.h"
+
+#include "DaedalusSurfaces.h"
+#include "Allocators.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+
+#include <algorithm>
+
+namespace Engine::Daedalus::Surfaces
+{
+    inline bool success(vk::Result res) { return res == vk::Result::eSuccess; }
+
+    vk::SurfaceFormatKHR chooseFormat(vk::PhysicalDevice gpu, vk::SurfaceKHR surface)
+    {
+        auto formats = gpu.getSurfaceFormatsKHR(surface);
+        for (auto preferred : { vk::Format::eB8G8R8A8Srgb, vk::Format::eR8G8B8A8Srgb }) {
+            for (auto& format : formats) {
+                if (format.format == preferred &&
+                    format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) return format;
+            }
+        }
+        return formats.empty() ? vk::SurfaceFormatKHR() : formats[0];
+    }
+
+    void destroySwapchain(Surface& surface)
+    {
+        auto& device = context.device;
+        for (auto view : surface.views)
+            device.destroyImageView(view);
+        for (auto semaphore : surface.rendered)
+            device.destroySemaphore(semaphore);
+        device.destroySwapchainKHR(surface.swapchain);
+        surface.views.clear();
+        surface.rendered.clear();
+        surface.images.clear();
+        surface.swapchain = VK_NULL_HANDLE;
+    }
+
+    void destroySurface(Surface& surface)
+    {
+        destroySwapchain(surface);
+        for (auto semaphore : surface.acquired)
+            context.device.destroySemaphore(semaphore);
+        surface.acquired.clear();
+        context.instance.destroySurfaceKHR(surface.surface);
+        surface.surface = VK_NULL_HANDLE;
+    }
+
+    // False while the window has no area, leaving the surface stale.
+    bool recreate(Surface& surface)
+    {
+        auto& device = context.device;
+        auto gpu = activeProfile().gpu;
+        auto caps = vk::SurfaceCapabilitiesKHR();
+        if (!success(gpu.getSurfaceCapabilitiesKHR(surface.surface, &caps))) return false;
+        if (caps.currentExtent.width == 0 || caps.currentExtent.height == 0) return false;
+
+        // Resizes are rare, and nothing else tracks when the old images leave the present
+        // queue.
+        if (surface.swapchain != VK_NULL_HANDLE) {
+            device.waitIdle();
+        }
+
+        using usage = vk::ImageUsageFlagBits;
+        auto info = vk::SwapchainCreateInfoKHR();
+        info.surface = surface.surface;
+        info.minImageCount = caps.minImageCount + 1;
+        if (caps.maxImageCount > 0) {
+            info.minImageCount = std::min(info.minImageCount, caps.maxImageCount);
+        }
+        info.imageFormat = surface.format.format;
+        info.imageColorSpace = surface.format.colorSpace;
+        info.imageExtent = caps.currentExtent;
+        info.imageArrayLayers = 1;
+        // Transfers for upscaling blits and readback, where the surface allows them.
+        info.imageUsage = usage::eColorAttachment |
+            (caps.supportedUsageFlags & (usage::eTransferDst | usage::eTransferSrc));
+        auto& profile = activeProfile();
+        u32 families[] = { profile.gfxFamilyIdx, surface.presentFamilyIdx };
+        if (surface.presentFamilyIdx != profile.gfxFamilyIdx) {
+            info.imageSharingMode = vk::SharingMode::eConcurrent;
+            info.queueFamilyIndexCount = 2;
+            info.pQueueFamilyIndices = families;
+        }
+        info.preTransform = caps.currentTransform;
+        info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+        if (!(caps.supportedCompositeAlpha & info.compositeAlpha)) {
+            info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eInherit;
+        }
+        // The one mode every surface supports; paced by the display.
+        info.presentMode = vk::PresentModeKHR::eFifo;
+        info.clipped = VK_TRUE;
+        info.oldSwapchain = surface.swapchain;
+
+        auto swapchain = vk::SwapchainKHR();
+        auto result = device.createSwapchainKHR(&info, nullptr, &swapchain);
+        destroySwapchain(surface);
+        if (!success(result)) {
+            Engine::Debug::Log(u"Unable to create a {}x{} swapchain.\n", info.imageExtent.width,
+                info.imageExtent.height);
+            return false;
+        }
+        surface.swapchain = swapchain;
+        surface.extent = info.imageExtent;
+        surface.images = device.getSwapchainImagesKHR(swapchain);
+        for (auto image : surface.images) {
+            auto viewInfo = vk::ImageViewCreateInfo();
+            viewInfo.image = image;
+            viewInfo.viewType = vk::ImageViewType::e2D;
+            viewInfo.format = surface.format.format;
+            viewInfo.subresourceRange = vk::ImageSubresourceRange(
+                vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+            surface.views.push_back(device.createImageView(viewInfo));
+            surface.rendered.push_back(device.createSemaphore(vk::SemaphoreCreateInfo()));
+        }
+        surface.stale = false;
+        return true;
+    }
+
+    SurfaceHandle create(vk::SurfaceKHR handle)
+    {
+        auto surface = Surface();
+        surface.surface = handle;
+        if (context.device == VK_NULL_HANDLE ||
+            !isDeviceExtensionEnabled(vk::KHRSwapchainExtensionName)) {
+            Engine::Debug::Log(u"Surfaces need a device created with a surface.\n");
+            context.instance.destroySurfaceKHR(handle);
+            return SurfaceHandle();
+        }
+
+        // Present support is per surface; prefer presenting from the graphics queue.
+        auto& profile = activeProfile();
+        if (profile.gpu.getSurfaceSupportKHR(profile.gfxFamilyIdx, handle)) {
+            surface.presentFamilyIdx = profile.gfxFamilyIdx;
+            surface.presentQueue = context.gfxQueue;
+        } else if (profile.presentFamilyIdx != UINT32_MAX &&
+            profile.gpu.getSurfaceSupportKHR(profile.presentFamilyIdx, handle)) {
+            surface.presentFamilyIdx = profile.presentFamilyIdx;
+            surface.presentQueue = context.presentQueue;
+        } else {
+            Engine::Debug::Log(u"The device's queues can't present to this surface.\n");
+            context.instance.destroySurfaceKHR(handle);
+            return SurfaceHandle();
+        }
+
+        surface.format = chooseFormat(profile.gpu, handle);
+        for (auto i = 0u; i < Frame::FramesInFlight; i++)
+            surface.acquired.push_back(context.device.createSemaphore(vk::SemaphoreCreateInfo()));
+        // Minimized windows get their swapchain once they have an area.
+        recreate(surface);
+        return context.surfaces.insert(surface);
+    }
+
+    void destroy(SurfaceHandle handle)
+    {
+        auto surface = Surface();
+        if (!context.surfaces.remove(handle, &surface)) return;
+
+        // Its semaphores may still be waited on by frames in flight.
+        context.device.waitIdle();
+        destroySurface(surface);
+    }
+
+    void cleanup()
+    {
+        if (context.surfaces.size() == 0) return;
+
+        context.device.waitIdle();
+        context.surfaces.forEach([](SurfaceHandle, Surface& surface) {
+            destroySurface(surface);
+        });
+        context.surfaces.clear();
+    }
+
+    void invalidate(SurfaceHandle handle)
+    {
+        auto surface = context.surfaces.get(handle);
+        if (surface != nullptr) {
+            surface->stale = true;
+        }
+    }
+
+    u32 getCount()
+    {
+        return context.surfaces.size();
+    }
+
+    Target getTarget(SurfaceHandle handle)
+    {
+        auto target = Target();
+        auto surface = context.surfaces.get(handle);
+        if (surface == nullptr || surface->imageIndex == UINT32_MAX) return target;
+
+        target.image = surface->images[surface->imageIndex];
+        target.view = surface->views[surface->imageIndex];
+        target.format = surface->format.format;
+        target.extent = surface->extent;
+        return target;
+    }
+
+    void acquire(u32 frameSlot)
+    {
+        context.surfaces.forEach([frameSlot](SurfaceHandle, Surface& surface) {
+            surface.imageIndex = UINT32_MAX;
+            // Out of date: recreate and try once more; minimized: skip the frame.
+            for (auto attempt = 0; attempt < 2; attempt++) {
+                if (surface.stale && !recreate(surface)) return;
+
+                auto index = 0u;
+                auto result = context.device.acquireNextImageKHR(surface.swapchain, UINT64_MAX,
+                    surface.acquired[frameSlot], VK_NULL_HANDLE, &index);
+                if (result == vk::Result::eErrorOutOfDateKHR) {
+                    surface.stale = true;
+                    continue;
+                }
+                if (result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR) {
+                    surface.imageIndex = index;
+                    surface.stale = result == vk::Result::eSuboptimalKHR;
+                }
+                return;
+            }
+        });
+    }
+
+    void getSemaphores(PmrList<vk::Semaphore>& waits, PmrList<vk::Semaphore>& signals)
+    {
+        auto slot = Frame::getFrameSlot();
+        context.surfaces.forEach([&](SurfaceHandle, Surface& surface) {
+            if (surface.imageIndex == UINT32_MAX) return;
+            waits.push_back(surface.acquired[slot]);
+            signals.push_back(surface.rendered[surface.imageIndex]);
+        });
+    }
+
+    void present()
+    {
+        auto& arena = Memory::getFrameArena();
+        auto queues = PmrList<vk::Queue>(&arena);
+        context.surfaces.forEach([&](SurfaceHandle, Surface& surface) {
+            if (surface.imageIndex != UINT32_MAX &&
+                std::find(queues.begin(), queues.end(), surface.presentQueue) == queues.end()) {
+                queues.push_back(surface.presentQueue);
+            }
+        });
+
+        // Every surface on a queue goes out in one present.
+        for (auto queue : queues) {
+            auto surfaces = PmrList<Surface*>(&arena);
+            auto swapchains = PmrList<vk::SwapchainKHR>(&arena);
+            auto indices = PmrList<u32>(&arena);
+            auto waits = PmrList<vk::Semaphore>(&arena);
+            context.surfaces.forEach([&](SurfaceHandle, Surface& surface) {
+                if (surface.imageIndex == UINT32_MAX || surface.presentQueue != queue) return;
+                surfaces.push_back(&surface);
+                swapchains.push_back(surface.swapchain);
+                indices.push_back(surface.imageIndex);
+                waits.push_back(surface.rendered[surface.imageIndex]);
+            });
+
+            auto results = PmrList<vk::Result>(swapchains.size(), &arena);
+            auto info = vk::PresentInfoKHR();
+            info.waitSemaphoreCount = (u32)waits.size();
+            info.pWaitSemaphores = waits.data();
+            info.swapchainCount = (u32)swapchains.size();
+            info.pSwapchains = swapchains.data();
+            info.pImageIndices = indices.data();
+            info.pResults = results.data();
+            (void)queue.presentKHR(&info);
+            for (auto i = 0; i < surfaces.size(); i++) {
+                if (results[i] == vk::Result::eErrorOutOfDateKHR ||
+                    results[i] == vk::Result::eSuboptimalKHR) {
+                    surfaces[i]->stale = true;
+                }
+            }
+        }
+        context.surfaces.forEach([](SurfaceHandle, Surface& surface) {
+            surface.imageIndex = UINT32_MAX;
+        });
+    }
+} // namespace Engine::Daedalus::Surfaces
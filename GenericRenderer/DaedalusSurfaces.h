@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "HandleTable.h"
+
+/// Swapchains for any number of windows on the one shared device.
+///
+/// Frame::begin() acquires an image from every surface, Frame::end() submits the frame once,
+/// waiting on all of the acquires and signaling all of the presents, then presents every
+/// surface with one vkQueuePresentKHR per present queue, usually just the graphics queue.
+/// Swapchains are recreated on the acquire after a resize or an out-of-date present, and
+/// skipped while their window is minimized.
+namespace Engine::Daedalus
+{
+    struct Surface;
+    using SurfaceHandle = Handle<Surface>;
+} // namespace Engine::Daedalus
+
+namespace Engine::Daedalus::Surfaces
+{
+    // What to render into for a surface this frame.
+    struct Target
+    {
+        vk::Image image;
+        vk::ImageView view;
+        vk::Format format = vk::Format::eUndefined;
+        vk::Extent2D extent;
+
+        bool isValid() const { return image != VK_NULL_HANDLE; }
+    };
+
+    // Takes ownership of surface, destroying it on failure. Used by createSurface().
+    SurfaceHandle create(vk::SurfaceKHR surface);
+    void destroy(SurfaceHandle);
+    // Destroys every surface. Called by terminate().
+    void cleanup();
+    // Recreates the swapchain at the next acquire, e.g. once the window is resized.
+    void invalidate(SurfaceHandle);
+    u32 getCount();
+
+    /// <summary>
+    /// The image acquired for this frame: invalid while the window is minimized or when the
+    /// acquire failed. Render into it and leave it in ePresentSrcKHR for Frame::end().
+    /// </summary>
+    Target getTarget(SurfaceHandle);
+
+    // Used by Frame: begin() acquires every surface's next image; end() waits on the
+    // acquires and signals the present semaphores in its submit, then presents.
+    void acquire(u32 frameSlot);
+    void getSemaphores(PmrList<vk::Semaphore>& waits, PmrList<vk::Semaphore>& signals);
+    void present();
+} // namespace Engine::Daedalus::Surfaces
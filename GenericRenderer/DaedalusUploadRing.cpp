@@ -0,0 +1,158 @@
+#include "Precompiled.h"
+
+#include "DaedalusUploadRing.h"
+#include "DaedalusCapture.h"
+#include "DaedalusFrame.h"
+#include "DaedalusInternal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+namespace Engine::Daedalus::UploadRing
+{
+    // Every allocation is a multiple of this, so the head stays aligned to it and smaller
+    // alignments never cost padding.
+    const vk::DeviceSize MinAlignment = 16;
+    // Segments start on multiples of this, the largest alignment allocate() can honour.
+    const vk::DeviceSize SegmentAlignment = 4096;
+
+    Resources::BufferHandle handle;
+    vk::Buffer buffer = VK_NULL_HANDLE;
+    u8* mapped = nullptr;
+    vk::DeviceSize segmentSize = 0;
+    // The current segment, and the bytes reserved in it so far.
+    u8* segment = nullptr;
+    vk::DeviceSize segmentOffset = 0;
+    std::atomic<vk::DeviceSize> head = 0;
+    std::atomic<u64> overflows = 0;
+    Stats stats;
+
+    vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    Result setup(vk::DeviceSize segmentSize)
+    {
+        if (mapped != nullptr) {
+            Engine::Debug::Log("Attempting to setup the upload ring twice.\n");
+            return Result::Failed;
+        }
+        UploadRing::segmentSize = alignUp(std::max<vk::DeviceSize>(segmentSize, 1),
+            SegmentAlignment);
+
+        using mem = vk::MemoryPropertyFlagBits;
+        using usage = vk::BufferUsageFlagBits;
+        auto desc = Resources::BufferDesc();
+        desc.size = UploadRing::segmentSize * Frame::FramesInFlight;
+        desc.usage = usage::eUniformBuffer | usage::eStorageBuffer | usage::eVertexBuffer |
+            usage::eIndexBuffer | usage::eIndirectBuffer | usage::eTransferSrc;
+        // Pinned by Resources, so the mapping stays valid.
+        desc.priority = Residency::Priority::Critical;
+        // The GPU reads straight from VRAM through the BAR when it can, else over the bus.
+        desc.properties = mem::eDeviceLocal | mem::eHostVisible | mem::eHostCoherent;
+        handle = Resources::createBuffer(desc);
+        if (!handle.isValid()) {
+            desc.properties = mem::eHostVisible | mem::eHostCoherent;
+            handle = Resources::createBuffer(desc);
+        }
+        auto created = Resources::getBuffer(handle);
+        if (created == nullptr) {
+            Engine::Debug::Log("Upload ring: unable to allocate {} bytes.\n", desc.size);
+            return Result::Failed;
+        }
+
+        buffer = created->buffer;
+        mapped = (u8*)Resources::map(handle);
+        if (mapped == nullptr) {
+            Resources::destroyBuffer(handle);
+            handle = Resources::BufferHandle();
+            return Result::Failed;
+        }
+
+        stats = Stats();
+        stats.segmentSize = UploadRing::segmentSize;
+        stats.deviceLocal = Residency::isDeviceLocal(created->allocation);
+        overflows = 0;
+        begin(0);
+        return Result::Success;
+    }
+
+    void cleanup()
+    {
+        if (mapped == nullptr) return;
+
+        // Freeing the memory drops the mapping.
+        Resources::destroyBuffer(handle);
+        handle = Resources::BufferHandle();
+        buffer = VK_NULL_HANDLE;
+        mapped = nullptr;
+        segment = nullptr;
+    }
+
+    Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+    {
+        auto result = Allocation();
+        if (segment == nullptr) return result;
+
+        // Only alignments beyond the head's own need slack, which covers the worst case
+        // so one add still reserves everything.
+        auto reserved = alignUp(size, MinAlignment) +
+            (alignment > MinAlignment ? alignment - MinAlignment : 0);
+        auto at = head.fetch_add(reserved, std::memory_order_relaxed);
+        if (at + reserved > segmentSize) {
+            overflows.fetch_add(1, std::memory_order_relaxed);
+            return result;
+        }
+        auto offset = alignUp(segmentOffset + at, alignment);
+        result.buffer = buffer;
+        result.offset = offset;
+        result.data = mapped + offset;
+        return result;
+    }
+
+    Allocation push(const void* data, vk::DeviceSize size, vk::DeviceSize alignment)
+    {
+        auto result = allocate(size, alignment);
+        if (result.isValid()) {
+            memcpy(result.data, data, (size_t)size);
+        }
+        return result;
+    }
+
+    vk::Buffer getBuffer()
+    {
+        return buffer;
+    }
+
+    const Stats& getStats()
+    {
+        stats.overflows = overflows.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void begin(u32 slot)
+    {
+        if (mapped == nullptr) return;
+
+        if (segment != nullptr) {
+            stats.lastUsed = std::min(head.load(std::memory_order_relaxed), segmentSize);
+            stats.peakUsed = std::max(stats.peakUsed, stats.lastUsed);
+        }
+        segmentOffset = (vk::DeviceSize)slot * segmentSize;
+        segment = mapped + segmentOffset;
+        head.store(0, std::memory_order_relaxed);
+    }
+
+    void capture()
+    {
+        if (segment == nullptr) return;
+
+        // Reading back is slow on uncached memory, but only happens while capturing.
+        auto used = std::min(head.load(std::memory_order_relaxed), segmentSize);
+        if (used > 0) {
+            Capture::recordUpload(handle, segmentOffset, segment, used);
+        }
+    }
+} // namespace Engine::Daedalus::UploadRing
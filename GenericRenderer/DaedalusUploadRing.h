@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include "DaedalusResources.h"
+
+/// Per-frame linear allocation of GPU-visible memory for data written every frame.
+///
+/// One persistently mapped buffer, in device-local host-visible memory (ReBAR) when the
+/// device has it, split into a segment per frame in flight. Allocating is one atomic add on
+/// the current segment's head, so any job thread can write uniforms, dynamic vertices or
+/// instance data without locks, buffer creation or mapping. Frame::begin() moves to the next
+/// segment once the GPU is done with it, which frees everything allocated there at once.
+/// Allocations are therefore only valid for the frame they were made in.
+namespace Engine::Daedalus::UploadRing
+{
+    const vk::DeviceSize DefaultSegmentSize = 8ull << 20;
+
+    struct Allocation
+    {
+        vk::Buffer buffer;
+        // Into buffer, aligned as requested.
+        vk::DeviceSize offset = 0;
+        // Write-only; the memory may be uncached.
+        void* data = nullptr;
+
+        bool isValid() const { return data != nullptr; }
+    };
+
+    struct Stats
+    {
+        vk::DeviceSize segmentSize = 0;
+        // Bytes allocated in the last finished frame, and the most any frame has allocated.
+        vk::DeviceSize lastUsed = 0;
+        vk::DeviceSize peakUsed = 0;
+        // Allocations refused because their segment was full.
+        u64 overflows = 0;
+        bool deviceLocal = false;
+    };
+
+    Result setup(vk::DeviceSize segmentSize = DefaultSegmentSize);
+    // Call before Frame::cleanup(), which destroys the buffer.
+    void cleanup();
+
+    /// <summary>
+    /// Reserves size bytes in the current frame's segment, at a power-of-two alignment of
+    /// at most 4096. Thread-safe and lock-free. Returns an invalid allocation when the segment
+    /// is full; callers fall back to Resources or skip the work, and getStats() counts it.
+    /// </summary>
+    Allocation allocate(vk::DeviceSize size, vk::DeviceSize alignment = 16);
+    // allocate() and copy data in.
+    Allocation push(const void* data, vk::DeviceSize size, vk::DeviceSize alignment = 16);
+
+    // The whole ring, e.g. to bind once with dynamic offsets.
+    vk::Buffer getBuffer();
+    const Stats& getStats();
+
+    // Starts allocating from the given frame slot's segment. Called by Frame::begin() once
+    // the GPU has finished the frame that last used it; no allocate() may run concurrently.
+    void begin(u32 slot);
+    // Records what the current segment handed out into a running capture, as an upload to
+    // the ring's buffer. Called by Frame::end().
+    void capture();
+} // namespace Engine::Daedalus::UploadRing
@@ -1,17 +1,55 @@
 #pragma once
 
+#if !defined(_WINDOWS)
+#include <cstdio>
+#endif
+
 namespace Engine::Debug
 {
     inline void Log(sstr log)
     {
-#if defined(_DEBUG)
+#if defined(_DEBUG) && defined(_WINDOWS)
         OutputDebugStringA(log);
+#elif defined(_DEBUG)
+        fputs(log, stderr);
 #endif
     }
     inline void Log(ustr log)
     {
-#if defined(_DEBUG)
+#if defined(_DEBUG) && defined(_WINDOWS)
         OutputDebugStringW(reinterpret_cast<wstr>(log));
+#elif defined(_DEBUG)
+        // No debugger output channel off Windows; transcode to stderr in chunks.
+        auto remaining = Format::length(log);
+        char chunk[512];
+        while (remaining > 0) {
+            auto converted = Format::utf16ToUtf8(log, remaining, chunk, sizeof(chunk));
+            fwrite(chunk, 1, converted.written, stderr);
+            log += converted.read;
+            remaining -= converted.read;
+        }
+#endif
+    }
+
+    // Formatted logging; see Format.h. Formats into a stack buffer, so long output truncates.
+    template<class... Args>
+    void Log(std::type_identity_t<Format::FormatString<char, Args...>> fmt, const Args&... args)
+    {
+#if defined(_DEBUG)
+        auto buffer = Format::StackBuffer<char, 1024>();
+        Format::formatTo(buffer, fmt, args...);
+        Log(buffer.c_str());
+#endif
+    }
+    template<class... Args>
+    void Log(
+        std::type_identity_t<Format::FormatString<char16_t, Args...>> fmt,
+        const Args&... args)
+    {
+#if defined(_DEBUG)
+        auto buffer = Format::StackBuffer<char16_t, 1024>();
+        Format::formatTo(buffer, fmt, args...);
+        Log(buffer.c_str());
 #endif
     }
 }
@@ -0,0 +1,110 @@
+#include "Precompiled.h"
+
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Engine
+{
+    u64 field(u32 value, u32 bits, u32 shift)
+    {
+        return ((u64)value & ((1ull << bits) - 1)) << shift;
+    }
+
+    u64 DrawList::makeKey(u32 pass, u32 pipeline, u32 material, u32 mesh, u16 depth)
+    {
+        return field(pass, PassBits, 64 - PassBits) |
+            field(pipeline, PipelineBits, MaterialBits + MeshBits + DepthBits) |
+            field(material, MaterialBits, MeshBits + DepthBits) |
+            field(mesh, MeshBits, DepthBits) |
+            field(depth, DepthBits, 0);
+    }
+
+    u64 DrawList::makeBlendedKey(u32 pass, u16 depth, u32 pipeline, u32 material, u32 mesh)
+    {
+        return field(pass, PassBits, 64 - PassBits) |
+            field(0xFFFFu - depth, DepthBits, PipelineBits + MaterialBits + MeshBits) |
+            field(pipeline, PipelineBits, MaterialBits + MeshBits) |
+            field(material, MaterialBits, MeshBits) |
+            field(mesh, MeshBits, 0);
+    }
+
+    u16 DrawList::quantizeDepth(float viewDepth, float nearZ, float farZ)
+    {
+        auto t = std::log(std::max(viewDepth, nearZ) / nearZ) / std::log(farZ / nearZ);
+        return (u16)(std::clamp(t, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    void DrawList::clear()
+    {
+        keys.clear();
+        order.clear();
+        draws.clear();
+        instances.clear();
+        batchMeshes.clear();
+        batches.clear();
+    }
+
+    void DrawList::add(u64 key, const Draw& draw)
+    {
+        order.push_back((u32)keys.size());
+        keys.push_back(key);
+        draws.push_back(draw);
+    }
+
+    void DrawList::resize(u32 count)
+    {
+        keys.resize(count);
+        order.resize(count);
+        draws.resize(count);
+    }
+
+    void DrawList::build(u32 maxMultiDraw)
+    {
+        auto count = (u32)keys.size();
+        Sort::radixSort(keys, keyScratch, 0, 64, &order, &orderScratch);
+
+        instances.resize(count);
+        Jobs::parallelFor(count, 4096, [this](u32 begin, u32 end) {
+            for (auto i = begin; i < end; i++)
+                instances[i] = draws[order[i]].instance;
+        });
+
+        batches.clear();
+        batchMeshes.clear();
+        for (auto i = 0u; i < count;) {
+            auto& draw = draws[order[i]];
+            auto pass = getPass(keys[i]);
+            // Neighbours in key order with the same state and mesh become one instanced draw.
+            auto end = i + 1;
+            for (; end < count; end++) {
+                auto& next = draws[order[end]];
+                if (getPass(keys[end]) != pass || next.pipeline != draw.pipeline ||
+                    next.material != draw.material || next.mesh != draw.mesh) break;
+            }
+
+            // A lone draw joins the previous batch as one more mesh when only the mesh differs.
+            auto* last = batches.empty() ? nullptr : &batches.back();
+            if (end - i == 1 && last != nullptr && last->instanceCount == 1 &&
+                last->meshCount < maxMultiDraw && last->pass == pass &&
+                last->pipeline == draw.pipeline && last->material == draw.material) {
+                last->meshCount++;
+            } else {
+                auto batch = Batch();
+                batch.pass = pass;
+                batch.pipeline = draw.pipeline;
+                batch.material = draw.material;
+                batch.firstInstance = i;
+                batch.instanceCount = end - i;
+                batch.firstMesh = (u32)batchMeshes.size();
+                batch.meshCount = 1;
+                batches.push_back(batch);
+            }
+            batchMeshes.push_back(draw.mesh);
+            i = end;
+        }
+    }
+} // namespace Engine
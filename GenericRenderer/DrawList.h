@@ -0,0 +1,92 @@
+#pragma once
+
+/// Draw submission front-end: sort keys, sorting and batching.
+///
+/// Every draw gets a 64-bit key packing its pass, pipeline, material, mesh and quantized depth
+/// so that sorting by key minimizes state changes: opaque keys group by state and mesh and go
+/// front to back within a mesh, blended keys go back to front first. build() radix-sorts the
+/// keys across the job workers and merges neighbours that differ in nothing but instance into
+/// instanced batches, and single draws of different meshes with the same state into
+/// multi-draw batches. Daedalus::Draws records the result.
+namespace Engine
+{
+    class DrawList
+    {
+    public:
+        struct Draw
+        {
+            // The ids in the key; batches break wherever one differs.
+            u32 pipeline = 0;
+            u32 material = 0;
+            u32 mesh = 0;
+            // Per-instance data the shader looks up, e.g. the object's scene index.
+            u32 instance = 0;
+        };
+
+        /// <summary>
+        /// Draws sharing pass, pipeline and material. Its instance indices are getInstances()
+        /// from firstInstance, and its meshes getBatchMeshes() from firstMesh. One mesh is
+        /// drawn instanceCount times; several meshes (a multi-draw) are drawn once each, so
+        /// shaders find their instance at gl_InstanceIndex + gl_DrawID either way.
+        /// </summary>
+        struct Batch
+        {
+            u32 pass = 0;
+            u32 pipeline = 0;
+            u32 material = 0;
+            u32 firstInstance = 0;
+            u32 instanceCount = 0;
+            u32 firstMesh = 0;
+            u32 meshCount = 0;
+        };
+
+        // Key fields, most significant first. Ids beyond their width are truncated, so keep
+        // them compact (e.g. a HandleTable index).
+        static const u32 PassBits = 4;
+        static const u32 PipelineBits = 12;
+        static const u32 MaterialBits = 16;
+        static const u32 MeshBits = 16;
+        static const u32 DepthBits = 16;
+
+    private:
+        List<u64> keys;
+        // Draw index per key.
+        List<u32> order;
+        List<Draw> draws;
+        List<u64> keyScratch;
+        List<u32> orderScratch;
+        List<u32> instances;
+        List<u32> batchMeshes;
+        List<Batch> batches;
+
+    public:
+        u32 size() const { return (u32)draws.size(); }
+        // Valid after build(), in key order.
+        const List<Batch>& getBatches() const { return batches; }
+        const List<u32>& getInstances() const { return instances; }
+        const List<u32>& getBatchMeshes() const { return batchMeshes; }
+
+        // State, then mesh, then front to back.
+        static u64 makeKey(u32 pass, u32 pipeline, u32 material, u32 mesh, u16 depth);
+        // Back to front, then state and mesh where depths tie.
+        static u64 makeBlendedKey(u32 pass, u16 depth, u32 pipeline, u32 material, u32 mesh);
+        static u32 getPass(u64 key) { return (u32)(key >> (64 - PassBits)); }
+        // Logarithmic between the planes, so precision follows perspective.
+        static u16 quantizeDepth(float viewDepth, float nearZ, float farZ);
+
+        void clear();
+        void add(u64 key, const Draw&);
+        // For filling from jobs: resize once, then set each index from one thread.
+        void resize(u32 count);
+        void set(u32 index, u64 key, const Draw& draw)
+        {
+            keys[index] = key;
+            order[index] = index;
+            draws[index] = draw;
+        }
+
+        // Sorts and batches. Multi-draw batches hold at most maxMultiDraw meshes; 1 disables
+        // them, e.g. without VK_EXT_multi_draw.
+        void build(u32 maxMultiDraw = 1);
+    };
+} // namespace Engine
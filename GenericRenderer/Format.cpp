@@ -0,0 +1,375 @@
+#include "Precompiled.h"
+
+#include "Format.h"
+
+#include <charconv>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FORMAT_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FORMAT_NEON
+#endif
+
+namespace Engine::Format
+{
+    const char16_t Replacement = 0xFFFD;
+
+    /*
+    * ASCII fast paths. Each returns how many units it converted, stopping at the first
+    * block containing a non-ASCII unit.
+    */
+
+    u64 widenAscii(const char* src, u64 srcLength, char16_t* dst, u64 dstCapacity)
+    {
+        auto count = 0ull;
+#if defined(FORMAT_SSE2)
+        auto zero = _mm_setzero_si128();
+        while (count + 16 <= srcLength && count + 16 <= dstCapacity) {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + count));
+            if (_mm_movemask_epi8(bytes) != 0) break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + count),
+                _mm_unpacklo_epi8(bytes, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + count + 8),
+                _mm_unpackhi_epi8(bytes, zero));
+            count += 16;
+        }
+#elif defined(FORMAT_NEON)
+        while (count + 16 <= srcLength && count + 16 <= dstCapacity) {
+            auto bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(src + count));
+            if (vmaxvq_u8(bytes) >= 0x80) break;
+            auto out = reinterpret_cast<uint16_t*>(dst + count);
+            vst1q_u16(out, vmovl_u8(vget_low_u8(bytes)));
+            vst1q_u16(out + 8, vmovl_u8(vget_high_u8(bytes)));
+            count += 16;
+        }
+#endif
+        return count;
+    }
+
+    u64 narrowAscii(const char16_t* src, u64 srcLength, char* dst, u64 dstCapacity)
+    {
+        auto count = 0ull;
+#if defined(FORMAT_SSE2)
+        auto zero = _mm_setzero_si128();
+        auto highBits = _mm_set1_epi16((short)0xFF80);
+        while (count + 16 <= srcLength && count + 16 <= dstCapacity) {
+            auto lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + count));
+            auto hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + count + 8));
+            auto high = _mm_and_si128(_mm_or_si128(lo, hi), highBits);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF) break;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + count), _mm_packus_epi16(lo, hi));
+            count += 16;
+        }
+#elif defined(FORMAT_NEON)
+        while (count + 16 <= srcLength && count + 16 <= dstCapacity) {
+            auto in = reinterpret_cast<const uint16_t*>(src + count);
+            auto lo = vld1q_u16(in);
+            auto hi = vld1q_u16(in + 8);
+            if (vmaxvq_u16(vorrq_u16(lo, hi)) >= 0x80) break;
+            vst1q_u8(reinterpret_cast<uint8_t*>(dst + count),
+                vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+            count += 16;
+        }
+#endif
+        return count;
+    }
+
+    Converted utf8ToUtf16(const char* src, u64 srcLength, char16_t* dst, u64 dstCapacity)
+    {
+        auto in = reinterpret_cast<const u8*>(src);
+        auto result = Converted();
+        auto& i = result.read;
+        auto& o = result.written;
+        while (i < srcLength && o < dstCapacity) {
+            auto fast = widenAscii(src + i, srcLength - i, dst + o, dstCapacity - o);
+            i += fast;
+            o += fast;
+            if (i >= srcLength || o >= dstCapacity) break;
+
+            auto lead = in[i];
+            auto needed = lead < 0x80 ? 0 : lead < 0xC2 ? -1 : lead < 0xE0 ? 1 :
+                lead < 0xF0 ? 2 : lead < 0xF5 ? 3 : -1;
+            if (needed == 0) {
+                dst[o++] = lead;
+                i++;
+                continue;
+            }
+
+            auto cp = (u32)Replacement;
+            auto consumed = 1ull;
+            if (needed > 0 && i + needed < srcLength) {
+                cp = lead & (0x3F >> needed);
+                auto valid = true;
+                for (auto k = 1; k <= needed; k++) {
+                    auto c = in[i + k];
+                    valid &= (c & 0xC0) == 0x80;
+                    cp = (cp << 6) | (c & 0x3F);
+                }
+                // Reject overlong encodings, surrogates and out-of-range code points.
+                auto minimum = needed == 1 ? 0x80u : needed == 2 ? 0x800u : 0x10000u;
+                valid &= cp >= minimum && cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+                if (valid) {
+                    consumed = needed + 1;
+                } else {
+                    cp = Replacement;
+                }
+            }
+
+            if (cp >= 0x10000) {
+                if (o + 2 > dstCapacity) break;
+                cp -= 0x10000;
+                dst[o++] = (char16_t)(0xD800 + (cp >> 10));
+                dst[o++] = (char16_t)(0xDC00 + (cp & 0x3FF));
+            } else {
+                dst[o++] = (char16_t)cp;
+            }
+            i += consumed;
+        }
+        return result;
+    }
+
+    Converted utf16ToUtf8(const char16_t* src, u64 srcLength, char* dst, u64 dstCapacity)
+    {
+        auto result = Converted();
+        auto& i = result.read;
+        auto& o = result.written;
+        while (i < srcLength && o < dstCapacity) {
+            auto fast = narrowAscii(src + i, srcLength - i, dst + o, dstCapacity - o);
+            i += fast;
+            o += fast;
+            if (i >= srcLength || o >= dstCapacity) break;
+
+            auto cp = (u32)src[i];
+            auto consumed = 1ull;
+            if (cp >= 0xD800 && cp <= 0xDBFF && i + 1 < srcLength &&
+                src[i + 1] >= 0xDC00 && src[i + 1] <= 0xDFFF) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (src[i + 1] - 0xDC00);
+                consumed = 2;
+            } else if (cp >= 0xD800 && cp <= 0xDFFF) {
+                cp = Replacement;
+            }
+
+            auto units = cp < 0x80 ? 1u : cp < 0x800 ? 2u : cp < 0x10000 ? 3u : 4u;
+            if (o + units > dstCapacity) break;
+            if (units == 1) {
+                dst[o++] = (char)cp;
+            } else if (units == 2) {
+                dst[o++] = (char)(0xC0 | (cp >> 6));
+                dst[o++] = (char)(0x80 | (cp & 0x3F));
+            } else if (units == 3) {
+                dst[o++] = (char)(0xE0 | (cp >> 12));
+                dst[o++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                dst[o++] = (char)(0x80 | (cp & 0x3F));
+            } else {
+                dst[o++] = (char)(0xF0 | (cp >> 18));
+                dst[o++] = (char)(0x80 | ((cp >> 12) & 0x3F));
+                dst[o++] = (char)(0x80 | ((cp >> 6) & 0x3F));
+                dst[o++] = (char)(0x80 | (cp & 0x3F));
+            }
+            i += consumed;
+        }
+        return result;
+    }
+
+    void append(Buffer<char>& out, std::string_view str)
+    {
+        out.append(str);
+    }
+
+    void append(Buffer<char>& out, std::u16string_view str)
+    {
+        auto converted = utf16ToUtf8(str.data(), str.size(), out.tail(), out.remaining());
+        out.commit(converted.written, converted.read < str.size());
+    }
+
+    void append(Buffer<char16_t>& out, std::string_view str)
+    {
+        auto converted = utf8ToUtf16(str.data(), str.size(), out.tail(), out.remaining());
+        out.commit(converted.written, converted.read < str.size());
+    }
+
+    void append(Buffer<char16_t>& out, std::u16string_view str)
+    {
+        out.append(str);
+    }
+
+    /*
+    * Argument formatting. Numbers are rendered into a small char scratch array, then
+    * widened and padded into the output.
+    */
+
+    const u64 ScratchSize = 128;
+
+    u64 writeUnsigned(char* end, u64 value, u32 base, bool upper)
+    {
+        auto digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+        auto it = end;
+        do {
+            *--it = digits[value % base];
+            value /= base;
+        } while (value > 0);
+        return (u64)(end - it);
+    }
+
+    template<class Char>
+    void appendScratch(Buffer<Char>& out, const char* str, u64 len, const Spec& spec, Align def)
+    {
+        auto align = spec.align == Align::Default ? def : spec.align;
+        auto padCount = spec.width > len ? spec.width - len : 0;
+        auto left = align == Align::Center ? padCount / 2 :
+            align == Align::Right ? padCount : 0;
+        out.append((Char)spec.fill, left);
+        for (auto i = 0ull; i < len; i++) {
+            out.push((Char)str[i]);
+        }
+        out.append((Char)spec.fill, padCount - left);
+    }
+
+    template<class Char>
+    void formatInteger(Buffer<Char>& out, const Arg& arg, const Spec& spec)
+    {
+        char scratch[ScratchSize];
+        auto end = scratch + ScratchSize;
+        auto negative = arg.kind == ArgKind::Signed && arg.i < 0;
+        auto magnitude = arg.kind == ArgKind::Signed ?
+            (negative ? 0ull - (u64)arg.i : (u64)arg.i) : arg.u;
+
+        auto base = spec.type == 'x' || spec.type == 'X' ? 16u :
+            spec.type == 'b' ? 2u : spec.type == 'o' ? 8u : 10u;
+        auto len = writeUnsigned(end, magnitude, base, spec.type == 'X');
+        if (negative) {
+            *(end - len - 1) = '-';
+            len++;
+        }
+        appendScratch(out, end - len, len, spec, Align::Right);
+    }
+
+    template<class Char>
+    void formatFloat(Buffer<Char>& out, const Arg& arg, const Spec& spec)
+    {
+        char scratch[ScratchSize];
+        auto result = std::to_chars_result();
+        if (spec.type == 0 && spec.precision < 0) {
+            result = std::to_chars(scratch, scratch + ScratchSize, arg.f);
+        } else {
+            auto format = spec.type == 'e' ? std::chars_format::scientific :
+                spec.type == 'g' ? std::chars_format::general : std::chars_format::fixed;
+            auto precision = spec.precision < 0 ? 6 : spec.precision;
+            result = std::to_chars(scratch, scratch + ScratchSize, arg.f, format, precision);
+        }
+        if (result.ec != std::errc()) {
+            appendScratch(out, "?", 1, spec, Align::Right);
+            return;
+        }
+        appendScratch(out, scratch, (u64)(result.ptr - scratch), spec, Align::Right);
+    }
+
+    template<class Char>
+    void formatString(Buffer<Char>& out, const Arg& arg, const Spec& spec)
+    {
+        // Width and precision count source code units, which matches display width for
+        // the text the engine formats.
+        auto length = arg.str.length;
+        if (spec.precision >= 0 && (u64)spec.precision < length) {
+            length = (u64)spec.precision;
+        }
+        auto align = spec.align == Align::Default ? Align::Left : spec.align;
+        auto padCount = spec.width > length ? spec.width - length : 0;
+        auto left = align == Align::Center ? padCount / 2 :
+            align == Align::Right ? padCount : 0;
+
+        out.append((Char)spec.fill, left);
+        if (arg.kind == ArgKind::Narrow) {
+            append(out, std::string_view((const char*)arg.str.data, length));
+        } else {
+            append(out, std::u16string_view((const char16_t*)arg.str.data, length));
+        }
+        out.append((Char)spec.fill, padCount - left);
+    }
+
+    template<class Char>
+    void formatArg(Buffer<Char>& out, const Arg& arg, const Spec& spec)
+    {
+        switch (arg.kind) {
+        case ArgKind::Signed:
+        case ArgKind::Unsigned:
+            if (spec.type == 'c') {
+                auto c = (char16_t)arg.u;
+                auto ch = Arg();
+                ch.kind = ArgKind::Wide;
+                ch.str.data = &c;
+                ch.str.length = 1;
+                formatString(out, ch, spec);
+                return;
+            }
+            formatInteger(out, arg, spec);
+            return;
+        case ArgKind::Float:
+            formatFloat(out, arg, spec);
+            return;
+        case ArgKind::Bool:
+            if (spec.type == 'd') {
+                formatInteger(out, arg, spec);
+                return;
+            }
+            appendScratch(out, arg.u ? "true" : "false", arg.u ? 4 : 5, spec, Align::Left);
+            return;
+        case ArgKind::Char8:
+        case ArgKind::Char16:
+            if (spec.type == 'd' || spec.type == 'x') {
+                auto num = arg;
+                num.kind = ArgKind::Unsigned;
+                formatInteger(out, num, spec);
+                return;
+            } else {
+                auto c = (char16_t)arg.u;
+                auto ch = Arg();
+                ch.kind = ArgKind::Wide;
+                ch.str.data = &c;
+                ch.str.length = 1;
+                formatString(out, ch, spec);
+            }
+            return;
+        case ArgKind::Narrow:
+        case ArgKind::Wide:
+            formatString(out, arg, spec);
+            return;
+        default:
+            return;
+        }
+    }
+
+    template<class Char>
+    void vformatTo(Buffer<Char>& out, std::basic_string_view<Char> fmt, const Arg* args, u64 count)
+    {
+        // The format string was validated at compile time, so parsing here can be lenient.
+        auto argIdx = 0ull;
+        auto it = fmt.data();
+        auto end = fmt.data() + fmt.size();
+        while (it < end) {
+            auto run = it;
+            while (run < end && *run != Char('{') && *run != Char('}')) {
+                run++;
+            }
+            out.append(it, (u64)(run - it));
+            it = run;
+            if (it >= end) break;
+
+            if (it + 1 < end && it[1] == *it) {
+                out.push(*it);
+                it += 2;
+                continue;
+            }
+            auto spec = Spec();
+            auto close = parseSpec(it + 1, end, spec);
+            if (close == nullptr || argIdx >= count) break;
+            formatArg(out, args[argIdx++], spec);
+            it = close + 1;
+        }
+    }
+
+    template void vformatTo<char>(Buffer<char>&, std::string_view, const Arg*, u64);
+    template void vformatTo<char16_t>(Buffer<char16_t>&, std::u16string_view, const Arg*, u64);
+} // namespace Engine::Format
@@ -0,0 +1,445 @@
+#pragma once
+
+#include <string_view>
+#include <type_traits>
+
+/// Allocation-free text formatting and UTF-8/UTF-16 conversion.
+///
+/// Output goes to a Buffer over caller-provided storage (or a StackBuffer). Output that
+/// doesn't fit is dropped and the buffer is flagged as truncated; nothing ever allocates.
+///
+/// Format strings use a std::format-like syntax and are validated at compile time against
+/// the argument types:
+///     {}                              default formatting
+///     {:[fill][align][width][.precision][type]}
+///         align       < left, ^ center, > right
+///         type        integers: d x X b o, floats: f e g, characters: c, strings/bools: s
+///     {{ and }}                       literal braces
+namespace Engine::Format
+{
+    enum class Align : u8
+    {
+        Default,
+        Left,
+        Center,
+        Right
+    };
+
+    enum class ArgKind : u8
+    {
+        None,
+        Signed,
+        Unsigned,
+        Float,
+        Bool,
+        Char8,
+        Char16,
+        Narrow, // UTF-8 string
+        Wide    // UTF-16 string
+    };
+
+    struct Arg
+    {
+        ArgKind kind = ArgKind::None;
+        union
+        {
+            i64 i;
+            u64 u;
+            double f;
+            struct
+            {
+                const void* data;
+                u64 length;
+            } str;
+        };
+
+        // Zeroes the whole union, so a null string formats as an empty one.
+        constexpr Arg() : str{ nullptr, 0 } {}
+    };
+
+    struct Spec
+    {
+        char16_t fill = u' ';
+        Align align = Align::Default;
+        u32 width = 0;
+        i32 precision = -1;
+        char type = 0;
+    };
+
+    /// <summary>
+    /// A view over caller-provided storage. The last unit of storage is reserved so the
+    /// contents can always be null-terminated.
+    /// </summary>
+    template<class Char>
+    class Buffer
+    {
+        Char* storage = nullptr;
+        u64 capacity = 0;
+        u64 length = 0;
+        bool overflowed = false;
+
+    public:
+        const Char* data() const { return storage; }
+        const Char* c_str() const { return storage; }
+        u64 size() const { return length; }
+        u64 remaining() const { return capacity - 1 - length; }
+        bool truncated() const { return overflowed; }
+        std::basic_string_view<Char> view() const { return { storage, length }; }
+
+        void clear()
+        {
+            length = 0;
+            overflowed = false;
+            storage[0] = 0;
+        }
+
+        void push(Char c)
+        {
+            if (length + 1 >= capacity) {
+                overflowed = true;
+                return;
+            }
+            storage[length++] = c;
+            storage[length] = 0;
+        }
+
+        void append(const Char* str, u64 count)
+        {
+            if (count > remaining()) {
+                count = remaining();
+                overflowed = true;
+            }
+            for (auto i = 0ull; i < count; i++) {
+                storage[length + i] = str[i];
+            }
+            length += count;
+            storage[length] = 0;
+        }
+
+        void append(std::basic_string_view<Char> str)
+        {
+            append(str.data(), str.size());
+        }
+
+        // Appends c repeated count times.
+        void append(Char c, u64 count)
+        {
+            if (count > remaining()) {
+                count = remaining();
+                overflowed = true;
+            }
+            for (auto i = 0ull; i < count; i++) {
+                storage[length + i] = c;
+            }
+            length += count;
+            storage[length] = 0;
+        }
+
+        // Direct access to the unused tail, for writers that produce output in place.
+        // Call commit() with the number of units actually written.
+        Char* tail() { return storage + length; }
+
+        void commit(u64 count, bool hitCapacity = false)
+        {
+            length += count;
+            storage[length] = 0;
+            overflowed |= hitCapacity;
+        }
+
+        Buffer(Char* storage, u64 capacity) : storage(storage), capacity(capacity)
+        {
+            storage[0] = 0;
+        }
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+    };
+
+    template<class Char, u64 N>
+    class StackBuffer : public Buffer<Char>
+    {
+        Char storage[N];
+
+    public:
+        StackBuffer() : Buffer<Char>(storage, N) {}
+    };
+
+    /*
+    * UTF conversion. Both directions have a SIMD fast path for runs of ASCII, which is
+    * nearly all of the text an engine logs. Invalid input is replaced with U+FFFD.
+    * A code point is never split across the end of the destination.
+    */
+
+    struct Converted
+    {
+        u64 read = 0;
+        u64 written = 0;
+    };
+
+    Converted utf8ToUtf16(const char* src, u64 srcLength, char16_t* dst, u64 dstCapacity);
+    Converted utf16ToUtf8(const char16_t* src, u64 srcLength, char* dst, u64 dstCapacity);
+
+    // Appends text of either encoding to a buffer of either encoding, transcoding as needed.
+    void append(Buffer<char>&, std::string_view);
+    void append(Buffer<char>&, std::u16string_view);
+    void append(Buffer<char16_t>&, std::string_view);
+    void append(Buffer<char16_t>&, std::u16string_view);
+
+    template<class Char>
+    constexpr u64 length(const Char* str)
+    {
+        auto len = 0ull;
+        while (str[len]) {
+            len++;
+        }
+        return len;
+    }
+
+    // Appends str to out, padded with fill to width code units.
+    template<class Char>
+    void appendPadded(Buffer<Char>& out, std::basic_string_view<Char> str, u64 width,
+        Align align, Char fill = Char(' '))
+    {
+        auto padCount = width > str.size() ? width - str.size() : 0;
+        auto left = align == Align::Center ? padCount / 2 :
+            align == Align::Right ? padCount : 0;
+        out.append(fill, left);
+        out.append(str);
+        out.append(fill, padCount - left);
+    }
+
+    /*
+    * Compile-time format string validation.
+    */
+
+    template<class T>
+    constexpr ArgKind kindOf()
+    {
+        using D = std::remove_cv_t<std::decay_t<T>>;
+        if constexpr (std::is_same_v<D, bool>) {
+            return ArgKind::Bool;
+        } else if constexpr (std::is_same_v<D, char>) {
+            return ArgKind::Char8;
+        } else if constexpr (std::is_same_v<D, char16_t> || std::is_same_v<D, wchar_t>) {
+            return ArgKind::Char16;
+        } else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+            return ArgKind::Signed;
+        } else if constexpr (std::is_integral_v<D>) {
+            return ArgKind::Unsigned;
+        } else if constexpr (std::is_enum_v<D>) {
+            return std::is_signed_v<std::underlying_type_t<D>> ?
+                ArgKind::Signed : ArgKind::Unsigned;
+        } else if constexpr (std::is_floating_point_v<D>) {
+            return ArgKind::Float;
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            return ArgKind::Narrow;
+        } else if constexpr (std::is_convertible_v<const T&, std::u16string_view>) {
+            return ArgKind::Wide;
+        } else {
+            static_assert(sizeof(T) == 0, "Type is not formattable.");
+            return ArgKind::None;
+        }
+    }
+
+    // Not constexpr: reaching it during constant evaluation makes the format string ill-formed,
+    // and the compiler error points here with the message.
+    inline void formatStringError(sstr) {}
+
+    constexpr bool isTypeAllowed(ArgKind kind, char type)
+    {
+        if (type == 0) return true;
+        switch (kind) {
+        case ArgKind::Signed:
+        case ArgKind::Unsigned:
+            return type == 'd' || type == 'x' || type == 'X' || type == 'b' || type == 'o' ||
+                type == 'c';
+        case ArgKind::Float:
+            return type == 'f' || type == 'e' || type == 'g';
+        case ArgKind::Bool:
+            return type == 's' || type == 'd';
+        case ArgKind::Char8:
+        case ArgKind::Char16:
+            return type == 'c' || type == 'd' || type == 'x';
+        case ArgKind::Narrow:
+        case ArgKind::Wide:
+            return type == 's';
+        default:
+            return false;
+        }
+    }
+
+    /// <summary>
+    /// Parses a replacement field's spec, starting just after the ':' (or at the '}').
+    /// Returns a pointer to the closing '}', or nullptr if the spec is malformed.
+    /// </summary>
+    template<class Char>
+    constexpr const Char* parseSpec(const Char* it, const Char* end, Spec& spec)
+    {
+        auto toAlign = [](Char c) {
+            return c == Char('<') ? Align::Left : c == Char('^') ? Align::Center :
+                c == Char('>') ? Align::Right : Align::Default;
+        };
+
+        if (it != end && *it == Char(':')) {
+            it++;
+            // [fill]align
+            if (it + 1 < end && toAlign(it[1]) != Align::Default && *it != Char('}')) {
+                spec.fill = (char16_t)*it;
+                spec.align = toAlign(it[1]);
+                it += 2;
+            } else if (it < end && toAlign(*it) != Align::Default) {
+                spec.align = toAlign(*it);
+                it++;
+            }
+            while (it < end && *it >= Char('0') && *it <= Char('9')) {
+                spec.width = spec.width * 10 + (u32)(*it - Char('0'));
+                it++;
+            }
+            if (it < end && *it == Char('.')) {
+                it++;
+                spec.precision = 0;
+                while (it < end && *it >= Char('0') && *it <= Char('9')) {
+                    spec.precision = spec.precision * 10 + (i32)(*it - Char('0'));
+                    it++;
+                }
+            }
+            if (it < end && *it != Char('}')) {
+                spec.type = (char)*it;
+                it++;
+            }
+        }
+        return (it < end && *it == Char('}')) ? it : nullptr;
+    }
+
+    template<class Char>
+    constexpr void validate(std::basic_string_view<Char> fmt, const ArgKind* kinds, u64 count)
+    {
+        auto argIdx = 0ull;
+        auto it = fmt.data();
+        auto end = fmt.data() + fmt.size();
+        while (it < end) {
+            if (*it == Char('}')) {
+                if (it + 1 < end && it[1] == Char('}')) {
+                    it += 2;
+                    continue;
+                }
+                formatStringError("Unmatched '}' in format string.");
+            }
+            if (*it != Char('{')) {
+                it++;
+                continue;
+            }
+            if (it + 1 < end && it[1] == Char('{')) {
+                it += 2;
+                continue;
+            }
+            auto spec = Spec();
+            auto close = parseSpec(it + 1, end, spec);
+            if (close == nullptr) {
+                formatStringError("Malformed replacement field.");
+                return;
+            }
+            if (argIdx >= count) {
+                formatStringError("More replacement fields than arguments.");
+                return;
+            }
+            if (!isTypeAllowed(kinds[argIdx], spec.type)) {
+                formatStringError("Presentation type doesn't match the argument type.");
+            }
+            if (spec.precision >= 0 && kinds[argIdx] != ArgKind::Float &&
+                kinds[argIdx] != ArgKind::Narrow && kinds[argIdx] != ArgKind::Wide) {
+                formatStringError("Precision is only valid for floats and strings.");
+            }
+            argIdx++;
+            it = close + 1;
+        }
+        if (argIdx != count) {
+            formatStringError("More arguments than replacement fields.");
+        }
+    }
+
+    /// <summary>
+    /// A format string checked against its argument types at compile time.
+    /// </summary>
+    template<class Char, class... Args>
+    class FormatString
+    {
+        std::basic_string_view<Char> str;
+
+    public:
+        std::basic_string_view<Char> get() const { return str; }
+
+        template<class S>
+            requires std::is_convertible_v<const S&, std::basic_string_view<Char>>
+        consteval FormatString(const S& s) : str(s)
+        {
+            constexpr ArgKind kinds[] = { kindOf<Args>()..., ArgKind::None };
+            validate<Char>(str, kinds, sizeof...(Args));
+        }
+    };
+
+    /*
+    * Formatting.
+    */
+
+    template<class T>
+    Arg makeArg(const T& value)
+    {
+        using D = std::remove_cv_t<std::decay_t<T>>;
+        auto arg = Arg();
+        arg.kind = kindOf<T>();
+        switch (arg.kind) {
+        case ArgKind::Signed:
+            if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) arg.i = (i64)value;
+            break;
+        case ArgKind::Unsigned:
+        case ArgKind::Bool:
+        case ArgKind::Char8:
+        case ArgKind::Char16:
+            if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) arg.u = (u64)value;
+            break;
+        case ArgKind::Float:
+            if constexpr (std::is_floating_point_v<D>) arg.f = (double)value;
+            break;
+        case ArgKind::Narrow:
+            if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                if constexpr (std::is_pointer_v<T>) {
+                    if (value == nullptr) break;
+                }
+                auto view = std::string_view(value);
+                arg.str.data = view.data();
+                arg.str.length = view.size();
+            }
+            break;
+        case ArgKind::Wide:
+            if constexpr (std::is_convertible_v<const T&, std::u16string_view>) {
+                if constexpr (std::is_pointer_v<T>) {
+                    if (value == nullptr) break;
+                }
+                auto view = std::u16string_view(value);
+                arg.str.data = view.data();
+                arg.str.length = view.size();
+            }
+            break;
+        default:
+            break;
+        }
+        return arg;
+    }
+
+    template<class Char>
+    void vformatTo(Buffer<Char>&, std::basic_string_view<Char>, const Arg*, u64);
+
+    /// <summary>
+    /// Formats args into out according to fmt. Returns false if the output was truncated.
+    /// </summary>
+    template<class Char, class... Args>
+    bool formatTo(
+        Buffer<Char>& out,
+        std::type_identity_t<FormatString<Char, Args...>> fmt,
+        const Args&... args)
+    {
+        const Arg argArray[] = { makeArg(args)..., Arg() };
+        vformatTo(out, fmt.get(), argArray, sizeof...(Args));
+        return !out.truncated();
+    }
+} // namespace Engine::Format
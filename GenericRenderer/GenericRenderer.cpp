@@ -7,12 +7,14 @@
 #include "framework.h"
 
 #include "DaedalusCore.h"
+#include "JobSystem.h"
 
 #define MAX_LOADSTRING 100
 
 // Global Variables:
 HINSTANCE hInst;                                // current instance
 HWND hWnd;
+Engine::Daedalus::SurfaceHandle surface;       // the window's swapchain
 WCHAR szTitle[MAX_LOADSTRING];                  // The title bar text
 WCHAR szWindowClass[MAX_LOADSTRING];            // the main window class name
 
@@ -41,31 +43,51 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
         return FALSE;
     }
 
+    Engine::Jobs::setup();
     if (Engine::Daedalus::initialize() != Result::Success) {
         OutputDebugString(L"Daedalus failed to initialize.\n");
+        Engine::Jobs::cleanup();
         return FALSE;
     }
-    if (Engine::Daedalus::createSurface(hInstance, hWnd) != Result::Success) {
+    surface = Engine::Daedalus::createSurface(hInstance, hWnd);
+    if (!surface.isValid()) {
         OutputDebugString(L"Daedalus failed to create a surface.\n");
         Engine::Daedalus::terminate();
+        Engine::Jobs::cleanup();
         return FALSE;
     }
 
     HACCEL hAccelTable = LoadAccelerators(hInstance, MAKEINTRESOURCE(IDC_GENERICRENDERER));
 
-    MSG msg;
+    MSG msg = {};
 
-    // Main message loop:
-    while (GetMessage(&msg, nullptr, 0, 0))
+    // Main message loop: renders a frame whenever no messages are waiting.
+    while (msg.message != WM_QUIT)
     {
-        if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg))
+        if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE))
         {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+            if (!TranslateAccelerator(msg.hwnd, hAccelTable, &msg))
+            {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
+            continue;
+        }
+        bool presented = false;
+        if (Engine::Daedalus::renderFrame(presented) != Result::Success)
+        {
+            OutputDebugString(L"Daedalus failed to render a frame.\n");
+            break;
+        }
+        // Nothing to present to, e.g. while minimized: sleep until the window changes.
+        if (!presented)
+        {
+            WaitMessage();
         }
     }
 
     Engine::Daedalus::terminate();
+    Engine::Jobs::cleanup();
 
     return (int) msg.wParam;
 }
@@ -131,7 +153,8 @@ BOOL InitInstance(HINSTANCE hInstance, int nCmdShow)
 //
 //  WM_COMMAND  - process the application menu
 //  WM_PAINT    - Paint the main window
-//  WM_DESTROY  - post a quit message and return
+//  WM_SIZE     - recreate the swapchain at the next frame
+//  WM_DESTROY  - release the surface, post a quit message and return
 //
 //
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -163,7 +186,17 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
             EndPaint(hWnd, &ps);
         }
         break;
+    case WM_SIZE:
+        // Also sent while the window is created, before it has a surface.
+        if (surface.isValid())
+        {
+            Engine::Daedalus::Surfaces::invalidate(surface);
+        }
+        break;
     case WM_DESTROY:
+        // No frame may present to the window once it is gone.
+        Engine::Daedalus::Surfaces::destroy(surface);
+        surface = Engine::Daedalus::SurfaceHandle();
         PostQuitMessage(0);
         break;
     default:
@@ -0,0 +1,120 @@
+#pragma once
+
+/// Generational handles and the slot table that issues them.
+///
+/// A handle is a slot index plus the generation the slot had when the handle was issued.
+/// Freeing a slot bumps its generation, so stale handles are detected instead of silently
+/// aliasing whatever reuses the slot. Lookups are a bounds check, a compare and an index.
+namespace Engine
+{
+    template<class Tag>
+    struct Handle
+    {
+        u32 index = 0;
+        // Odd generations are live; 0 is never issued, so a default handle is invalid.
+        u32 generation = 0;
+
+        bool isValid() const { return generation != 0; }
+
+        bool operator==(const Handle& other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    template<class T, class Tag = T>
+    class HandleTable
+    {
+    public:
+        using HandleType = Handle<Tag>;
+
+    private:
+        List<T> slots;
+        // Per slot: odd while occupied, even while free.
+        List<u32> generations;
+        List<u32> freeSlots;
+        u32 liveCount = 0;
+
+    public:
+        u32 size() const { return liveCount; }
+        u32 capacity() const { return (u32)slots.size(); }
+
+        bool contains(HandleType handle) const
+        {
+            return handle.index < generations.size() &&
+                generations[handle.index] == handle.generation &&
+                (handle.generation & 1) != 0;
+        }
+
+        T* get(HandleType handle)
+        {
+            return contains(handle) ? &slots[handle.index] : nullptr;
+        }
+        const T* get(HandleType handle) const
+        {
+            return contains(handle) ? &slots[handle.index] : nullptr;
+        }
+
+        HandleType insert(T item)
+        {
+            auto index = 0u;
+            if (!freeSlots.empty()) {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+                slots[index] = std::move(item);
+            } else {
+                index = (u32)slots.size();
+                slots.push_back(std::move(item));
+                generations.push_back(0);
+            }
+            // Free slots hold even generations, so this is odd. Wrapping passes through 0 on
+            // the free side, so 0 is never issued.
+            generations[index]++;
+            liveCount++;
+
+            auto handle = HandleType();
+            handle.index = index;
+            handle.generation = generations[index];
+            return handle;
+        }
+
+        /// <summary>
+        /// Frees the slot, moving its item to out if provided. Returns false for stale handles.
+        /// </summary>
+        bool remove(HandleType handle, T* out = nullptr)
+        {
+            if (!contains(handle)) return false;
+
+            if (out != nullptr) {
+                *out = std::move(slots[handle.index]);
+            }
+            slots[handle.index] = T();
+            generations[handle.index]++;
+            freeSlots.push_back(handle.index);
+            liveCount--;
+            return true;
+        }
+
+        // Calls fn(handle, item) for every live item, in slot order.
+        template<class Fn>
+        void forEach(Fn&& fn)
+        {
+            for (auto i = 0u; i < slots.size(); i++) {
+                if ((generations[i] & 1) == 0) continue;
+                auto handle = HandleType();
+                handle.index = i;
+                handle.generation = generations[i];
+                fn(handle, slots[i]);
+            }
+        }
+
+        void clear()
+        {
+            slots.clear();
+            generations.clear();
+            freeSlots.clear();
+            liveCount = 0;
+        }
+    };
+} // namespace Engine
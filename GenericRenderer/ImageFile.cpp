@@ -0,0 +1,235 @@
+#include "Precompiled.h"
+
+#include "ImageFile.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace Engine::ImageFile
+{
+    u32 bytesPerPixel(PixelFormat format)
+    {
+        switch (format) {
+        case PixelFormat::RGBA8:
+        case PixelFormat::BGRA8:
+            return 4;
+        case PixelFormat::RGBA16F:
+            return 8;
+        case PixelFormat::RGBA32F:
+            return 16;
+        }
+        return 0;
+    }
+
+    void encodeRaw(const Pixels& pixels, List<u8>& out)
+    {
+        auto size = (size_t)pixels.width * pixels.height * bytesPerPixel(pixels.format);
+        out.assign(pixels.data, pixels.data + size);
+    }
+
+    // Appends little-endian.
+    template<class T>
+    void put(List<u8>& out, T value)
+    {
+        auto at = out.size();
+        out.resize(at + sizeof(T));
+        memcpy(&out[at], &value, sizeof(T));
+    }
+
+    void putBigEndian(List<u8>& out, u32 value)
+    {
+        out.push_back((u8)(value >> 24));
+        out.push_back((u8)(value >> 16));
+        out.push_back((u8)(value >> 8));
+        out.push_back((u8)value);
+    }
+
+    void putString(List<u8>& out, const char* text)
+    {
+        out.insert(out.end(), text, text + strlen(text) + 1);
+    }
+
+    u32 crc32(const u8* data, size_t size)
+    {
+        static const auto table = []() {
+            auto result = std::array<u32, 256>();
+            for (auto n = 0u; n < 256; n++) {
+                auto c = n;
+                for (auto k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                result[n] = c;
+            }
+            return result;
+        }();
+        auto crc = ~0u;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Appends the length, to be filled in by endChunk(), and the type.
+    size_t beginChunk(List<u8>& out, const char* type)
+    {
+        auto start = out.size();
+        out.insert(out.end(), 4, 0);
+        out.insert(out.end(), type, type + 4);
+        return start;
+    }
+
+    void endChunk(List<u8>& out, size_t start)
+    {
+        auto length = (u32)(out.size() - start - 8);
+        for (auto i = 0u; i < 4; i++)
+            out[start + i] = (u8)(length >> (24 - 8 * i));
+        putBigEndian(out, crc32(&out[start + 4], length + 4));
+    }
+
+    Result encodePng(const Pixels& pixels, List<u8>& out)
+    {
+        if (pixels.format != PixelFormat::RGBA8 && pixels.format != PixelFormat::BGRA8) {
+            return Result::Failed;
+        }
+        auto rowSize = (size_t)pixels.width * 4;
+        // Every row is a filter byte (none) then the row.
+        auto rawSize = (rowSize + 1) * pixels.height;
+        const auto MaxBlock = (size_t)65535;
+        auto blocks = std::max<size_t>((rawSize + MaxBlock - 1) / MaxBlock, 1);
+
+        out.clear();
+        out.reserve(rawSize + blocks * 5 + 128);
+        const u8 signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        out.insert(out.end(), signature, signature + sizeof(signature));
+
+        auto start = beginChunk(out, "IHDR");
+        putBigEndian(out, pixels.width);
+        putBigEndian(out, pixels.height);
+        // 8 bits, RGBA, deflate, standard filters, no interlace.
+        out.insert(out.end(), { 8, 6, 0, 0, 0 });
+        endChunk(out, start);
+
+        // The zlib stream is built in place: header, stored blocks, Adler-32.
+        start = beginChunk(out, "IDAT");
+        out.insert(out.end(), { 0x78, 0x01 });
+        auto raw = List<u8>(rawSize);
+        for (auto y = 0u; y < pixels.height; y++) {
+            auto row = &raw[y * (rowSize + 1)];
+            row[0] = 0;
+            memcpy(row + 1, pixels.data + y * rowSize, rowSize);
+            if (pixels.format == PixelFormat::BGRA8) {
+                for (auto x = 0u; x < pixels.width; x++)
+                    std::swap(row[1 + x * 4], row[3 + x * 4]);
+            }
+        }
+        for (size_t offset = 0, block = 0; block < blocks; block++) {
+            auto size = std::min(MaxBlock, rawSize - offset);
+            out.push_back(block + 1 == blocks ? 1 : 0);
+            put<u16>(out, (u16)size);
+            put<u16>(out, (u16)~size);
+            out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + size);
+            offset += size;
+        }
+        auto a = 1u, b = 0u;
+        for (size_t i = 0; i < rawSize;) {
+            // The largest run whose sums can't overflow before the modulo.
+            auto end = std::min(rawSize, i + 5552);
+            for (; i < end; i++) {
+                a += raw[i];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        putBigEndian(out, (b << 16) | a);
+        endChunk(out, start);
+
+        start = beginChunk(out, "IEND");
+        endChunk(out, start);
+        return Result::Success;
+    }
+
+    void putAttribute(List<u8>& out, const char* name, const char* type, u32 size)
+    {
+        putString(out, name);
+        putString(out, type);
+        put<u32>(out, size);
+    }
+
+    Result encodeExr(const Pixels& pixels, List<u8>& out)
+    {
+        if (pixels.format != PixelFormat::RGBA16F && pixels.format != PixelFormat::RGBA32F) {
+            return Result::Failed;
+        }
+        auto half = pixels.format == PixelFormat::RGBA16F;
+        auto channelSize = half ? 2u : 4u;
+        auto width = pixels.width;
+        auto height = pixels.height;
+
+        out.clear();
+        put<u32>(out, 20000630);
+        // Version 2, single-part scanline.
+        put<u32>(out, 2);
+
+        // Channels are stored in name order, which is ABGR.
+        const char* names[] = { "A", "B", "G", "R" };
+        putAttribute(out, "channels", "chlist", 4 * 18 + 1);
+        for (auto name : names) {
+            putString(out, name);
+            put<u32>(out, half ? 1 : 2);
+            put<u32>(out, 0);
+            put<u32>(out, 1);
+            put<u32>(out, 1);
+        }
+        out.push_back(0);
+        putAttribute(out, "compression", "compression", 1);
+        out.push_back(0);
+        for (auto window : { "dataWindow", "displayWindow" }) {
+            putAttribute(out, window, "box2i", 16);
+            put<i32>(out, 0);
+            put<i32>(out, 0);
+            put<i32>(out, (i32)width - 1);
+            put<i32>(out, (i32)height - 1);
+        }
+        putAttribute(out, "lineOrder", "lineOrder", 1);
+        out.push_back(0);
+        putAttribute(out, "pixelAspectRatio", "float", 4);
+        put<float>(out, 1.0f);
+        putAttribute(out, "screenWindowCenter", "v2f", 8);
+        put<float>(out, 0.0f);
+        put<float>(out, 0.0f);
+        putAttribute(out, "screenWindowWidth", "float", 4);
+        put<float>(out, 1.0f);
+        out.push_back(0);
+
+        // Then an offset per scanline, and the scanlines: y, size, and each channel's row.
+        auto lineSize = (u64)width * 4 * channelSize;
+        auto first = (u64)out.size() + (u64)height * 8;
+        for (auto y = 0u; y < height; y++)
+            put<u64>(out, first + y * (lineSize + 8));
+        out.reserve(out.size() + (size_t)height * (lineSize + 8));
+        auto pixelSize = 4 * channelSize;
+        for (auto y = 0u; y < height; y++) {
+            put<i32>(out, (i32)y);
+            put<u32>(out, (u32)lineSize);
+            auto row = pixels.data + (size_t)y * width * pixelSize;
+            for (auto channel : { 3u, 2u, 1u, 0u }) {
+                auto at = out.size();
+                out.resize(at + (size_t)width * channelSize);
+                for (auto x = 0u; x < width; x++)
+                    memcpy(&out[at + x * channelSize], row + x * pixelSize + channel * channelSize,
+                        channelSize);
+            }
+        }
+        return Result::Success;
+    }
+
+    Result write(const char* path, const List<u8>& bytes)
+    {
+        auto file = fopen(path, "wb");
+        if (file == nullptr) return Result::Failed;
+        auto written = fwrite(bytes.data(), 1, bytes.size(), file);
+        auto closed = fclose(file) == 0;
+        return written == bytes.size() && closed ? Result::Success : Result::Failed;
+    }
+} // namespace Engine::ImageFile
@@ -0,0 +1,38 @@
+#pragma once
+
+/// Encoding pixels into image files: raw, PNG and OpenEXR.
+///
+/// Meant for dumping rendered frames as fast as they arrive rather than for small files:
+/// PNG uses stored (uncompressed) deflate blocks, so encoding is a copy plus checksums, and
+/// EXR is uncompressed scanlines. Any PNG or EXR reader opens the results.
+namespace Engine::ImageFile
+{
+    enum class PixelFormat : u8
+    {
+        RGBA8,
+        BGRA8,
+        // IEEE half floats.
+        RGBA16F,
+        RGBA32F,
+    };
+
+    struct Pixels
+    {
+        // Rows top to bottom, tightly packed.
+        const u8* data = nullptr;
+        u32 width = 0;
+        u32 height = 0;
+        PixelFormat format = PixelFormat::RGBA8;
+    };
+
+    u32 bytesPerPixel(PixelFormat);
+
+    // The pixels as they are.
+    void encodeRaw(const Pixels&, List<u8>& out);
+    // 8-bit RGBA. Fails for float formats.
+    Result encodePng(const Pixels&, List<u8>& out);
+    // Half or float RGBA, matching the source. Fails for 8-bit formats.
+    Result encodeExr(const Pixels&, List<u8>& out);
+
+    Result write(const char* path, const List<u8>& bytes);
+} // namespace Engine::ImageFile
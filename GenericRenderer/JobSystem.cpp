@@ -0,0 +1,164 @@
+#include "Precompiled.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Engine::Jobs
+{
+    struct Job
+    {
+        std::function<void()> fn;
+        Counter* counter = nullptr;
+    };
+
+    List<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    bool stopping = false;
+
+    void run(Job& job)
+    {
+        job.fn();
+        if (job.counter != nullptr) {
+            job.counter->pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    bool tryRunOne()
+    {
+        auto job = Job();
+        {
+            auto lock = std::unique_lock(mutex);
+            if (queue.empty()) return false;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        run(job);
+        return true;
+    }
+
+    void workerLoop()
+    {
+        while (true) {
+            auto job = Job();
+            {
+                auto lock = std::unique_lock(mutex);
+                wake.wait(lock, []() { return stopping || !queue.empty(); });
+                // Drain the queue before stopping, so no counter is left waiting.
+                if (queue.empty()) return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            run(job);
+        }
+    }
+
+    void setup(u32 workerCount)
+    {
+        if (!workers.empty()) {
+            Engine::Debug::Log("Attempting to setup the job system twice.\n");
+            return;
+        }
+        if (workerCount == 0) {
+            workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+        stopping = false;
+        for (auto i = 0u; i < workerCount; i++)
+            workers.emplace_back(workerLoop);
+    }
+
+    void cleanup()
+    {
+        {
+            auto lock = std::unique_lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+        workers.clear();
+    }
+
+    u32 getWorkerCount()
+    {
+        return (u32)workers.size();
+    }
+
+    void submit(std::function<void()> job, Counter* counter)
+    {
+        if (counter != nullptr) {
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        }
+        auto item = Job();
+        item.fn = std::move(job);
+        item.counter = counter;
+        if (workers.empty()) {
+            run(item);
+            return;
+        }
+        {
+            auto lock = std::unique_lock(mutex);
+            queue.push_back(std::move(item));
+        }
+        wake.notify_one();
+    }
+
+    void wait(Counter& counter)
+    {
+        while (counter.pending.load(std::memory_order_acquire) > 0) {
+            if (!tryRunOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    struct ParallelFor
+    {
+        RangeFn fn = nullptr;
+        void* context = nullptr;
+        u32 count = 0;
+        u32 batch = 0;
+        std::atomic<u32> next = 0;
+    };
+
+    // Claims batches until none are left. Run by the caller and by every helper job.
+    void drain(ParallelFor& state)
+    {
+        while (true) {
+            auto begin = state.next.fetch_add(state.batch, std::memory_order_relaxed);
+            if (begin >= state.count) return;
+            state.fn(state.context, begin, std::min(begin + state.batch, state.count));
+        }
+    }
+
+    void parallelFor(u32 count, u32 batch, RangeFn fn, void* context)
+    {
+        batch = std::max(batch, 1u);
+        auto batches = (count + batch - 1) / batch;
+        if (batches <= 1 || workers.empty()) {
+            if (count > 0) {
+                fn(context, 0, count);
+            }
+            return;
+        }
+
+        // Batches are claimed dynamically, so uneven batches still balance out.
+        auto state = ParallelFor();
+        state.fn = fn;
+        state.context = context;
+        state.count = count;
+        state.batch = batch;
+        auto counter = Counter();
+        auto helpers = std::min((u32)workers.size(), batches - 1);
+        for (auto i = 0u; i < helpers; i++)
+            submit([&state]() { drain(state); }, &counter);
+        drain(state);
+        wait(counter);
+    }
+} // namespace Engine::Jobs
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+/// A small thread pool for CPU-side frame work.
+///
+/// Jobs go into one shared queue serviced by setup()'s worker threads. Threads waiting on a
+/// counter run queued jobs instead of blocking, so jobs may themselves submit and wait
+/// (including nested parallelFor) without deadlocking. Without setup(), or with no workers,
+/// everything runs inline on the calling thread.
+namespace Engine::Jobs
+{
+    struct Counter
+    {
+        std::atomic<u32> pending = 0;
+    };
+
+    using RangeFn = void (*)(void* context, u32 begin, u32 end);
+
+    // workerCount 0 uses one worker per hardware thread, minus the calling thread.
+    void setup(u32 workerCount = 0);
+    // Finishes queued jobs, then joins the workers.
+    void cleanup();
+    u32 getWorkerCount();
+
+    // Runs job on a worker. counter, if given, is incremented now and decremented when done.
+    void submit(std::function<void()> job, Counter* counter = nullptr);
+    // Returns once counter reaches zero, running queued jobs meanwhile.
+    void wait(Counter&);
+
+    /// <summary>
+    /// Calls fn(begin, end) over [0, count) in ranges of at most batch items, spread across
+    /// the workers and the calling thread. Returns when every range is done.
+    /// </summary>
+    void parallelFor(u32 count, u32 batch, RangeFn fn, void* context);
+
+    template<class Fn>
+    void parallelFor(u32 count, u32 batch, Fn&& fn)
+    {
+        parallelFor(count, batch, [](void* context, u32 begin, u32 end) {
+            (*(std::remove_reference_t<Fn>*)context)(begin, end);
+        }, (void*)&fn);
+    }
+} // namespace Engine::Jobs
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <cmath>
+
+/// Engine math types.
+///
+/// Matrices are column-major and multiply column vectors (v' = M * v), matching GLSL. Clip
+/// space follows Vulkan: y down, depth in [0, 1]. These are the per-object operations; work
+/// over many objects goes through the batched kernels in MathKernels.h.
+namespace Engine::Math
+{
+    const float Pi = 3.14159265358979323846f;
+
+    struct Vec2
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+    };
+
+    struct Vec3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+
+        Vec3 operator+(Vec3 o) const { return { x + o.x, y + o.y, z + o.z }; }
+        Vec3 operator-(Vec3 o) const { return { x - o.x, y - o.y, z - o.z }; }
+        Vec3 operator*(Vec3 o) const { return { x * o.x, y * o.y, z * o.z }; }
+        Vec3 operator*(float s) const { return { x * s, y * s, z * s }; }
+        Vec3 operator-() const { return { -x, -y, -z }; }
+        Vec3& operator+=(Vec3 o) { return *this = *this + o; }
+        Vec3& operator-=(Vec3 o) { return *this = *this - o; }
+        Vec3& operator*=(float s) { return *this = *this * s; }
+    };
+
+    struct Vec4
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 0.0f;
+
+        Vec4 operator+(Vec4 o) const { return { x + o.x, y + o.y, z + o.z, w + o.w }; }
+        Vec4 operator-(Vec4 o) const { return { x - o.x, y - o.y, z - o.z, w - o.w }; }
+        Vec4 operator*(float s) const { return { x * s, y * s, z * s, w * s }; }
+
+        float operator[](int i) const { return i == 0 ? x : i == 1 ? y : i == 2 ? z : w; }
+
+        Vec3 xyz() const { return { x, y, z }; }
+    };
+
+    inline float dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    inline float dot(Vec4 a, Vec4 b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+    inline Vec3 cross(Vec3 a, Vec3 b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+    inline float length(Vec3 v) { return std::sqrt(dot(v, v)); }
+    inline Vec3 normalize(Vec3 v)
+    {
+        auto len = length(v);
+        return len > 0.0f ? v * (1.0f / len) : v;
+    }
+    inline Vec3 min(Vec3 a, Vec3 b)
+    {
+        return { std::fmin(a.x, b.x), std::fmin(a.y, b.y), std::fmin(a.z, b.z) };
+    }
+    inline Vec3 max(Vec3 a, Vec3 b)
+    {
+        return { std::fmax(a.x, b.x), std::fmax(a.y, b.y), std::fmax(a.z, b.z) };
+    }
+    inline Vec3 abs(Vec3 v) { return { std::fabs(v.x), std::fabs(v.y), std::fabs(v.z) }; }
+    inline Vec3 lerp(Vec3 a, Vec3 b, float t) { return a + (b - a) * t; }
+
+    struct Quat
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+        float w = 1.0f;
+
+        static Quat fromAxisAngle(Vec3 axis, float radians)
+        {
+            auto n = normalize(axis);
+            auto s = std::sin(radians * 0.5f);
+            return { n.x * s, n.y * s, n.z * s, std::cos(radians * 0.5f) };
+        }
+
+        // Applies o first, then this.
+        Quat operator*(Quat o) const
+        {
+            return {
+                w * o.x + x * o.w + y * o.z - z * o.y,
+                w * o.y - x * o.z + y * o.w + z * o.x,
+                w * o.z + x * o.y - y * o.x + z * o.w,
+                w * o.w - x * o.x - y * o.y - z * o.z
+            };
+        }
+
+        Quat conjugate() const { return { -x, -y, -z, w }; }
+
+        Vec3 rotate(Vec3 v) const
+        {
+            // v + 2w(q x v) + 2q x (q x v), without building a matrix.
+            auto q = Vec3{ x, y, z };
+            auto t = cross(q, v) * 2.0f;
+            return v + t * w + cross(q, t);
+        }
+    };
+
+    inline Quat normalize(Quat q)
+    {
+        auto len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        if (len <= 0.0f) return Quat();
+        auto inv = 1.0f / len;
+        return { q.x * inv, q.y * inv, q.z * inv, q.w * inv };
+    }
+
+    // Normalized lerp along the shorter arc. Close enough to slerp for per-frame blending.
+    inline Quat nlerp(Quat a, Quat b, float t)
+    {
+        auto d = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+        auto s = d < 0.0f ? -t : t;
+        return normalize({
+            a.x + (b.x * s - a.x * t), a.y + (b.y * s - a.y * t),
+            a.z + (b.z * s - a.z * t), a.w + (b.w * s - a.w * t) });
+    }
+
+    struct alignas(16) Mat4
+    {
+        Vec4 cols[4] = {
+            { 1.0f, 0.0f, 0.0f, 0.0f },
+            { 0.0f, 1.0f, 0.0f, 0.0f },
+            { 0.0f, 0.0f, 1.0f, 0.0f },
+            { 0.0f, 0.0f, 0.0f, 1.0f }
+        };
+
+        static Mat4 identity() { return Mat4(); }
+
+        static Mat4 translation(Vec3 t)
+        {
+            auto m = Mat4();
+            m.cols[3] = { t.x, t.y, t.z, 1.0f };
+            return m;
+        }
+
+        static Mat4 scale(Vec3 s)
+        {
+            auto m = Mat4();
+            m.cols[0].x = s.x;
+            m.cols[1].y = s.y;
+            m.cols[2].z = s.z;
+            return m;
+        }
+
+        // Translation * rotation * scale.
+        static Mat4 compose(Vec3 t, Quat r, Vec3 s)
+        {
+            auto xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+            auto xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+            auto wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+            auto m = Mat4();
+            m.cols[0] = { (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x,
+                2.0f * (xz - wy) * s.x, 0.0f };
+            m.cols[1] = { 2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y,
+                2.0f * (yz + wx) * s.y, 0.0f };
+            m.cols[2] = { 2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z,
+                (1.0f - 2.0f * (xx + yy)) * s.z, 0.0f };
+            m.cols[3] = { t.x, t.y, t.z, 1.0f };
+            return m;
+        }
+
+        // Right-handed view looking down -z.
+        static Mat4 lookAt(Vec3 eye, Vec3 target, Vec3 up)
+        {
+            auto f = normalize(target - eye);
+            auto s = normalize(cross(f, up));
+            auto u = cross(s, f);
+            auto m = Mat4();
+            m.cols[0] = { s.x, u.x, -f.x, 0.0f };
+            m.cols[1] = { s.y, u.y, -f.y, 0.0f };
+            m.cols[2] = { s.z, u.z, -f.z, 0.0f };
+            m.cols[3] = { -dot(s, eye), -dot(u, eye), dot(f, eye), 1.0f };
+            return m;
+        }
+
+        // Right-handed perspective into Vulkan clip space (y down, depth 0 at near, 1 at far).
+        static Mat4 perspective(float fovY, float aspect, float zNear, float zFar)
+        {
+            auto f = 1.0f / std::tan(fovY * 0.5f);
+            auto m = Mat4();
+            m.cols[0] = { f / aspect, 0.0f, 0.0f, 0.0f };
+            m.cols[1] = { 0.0f, -f, 0.0f, 0.0f };
+            m.cols[2] = { 0.0f, 0.0f, zFar / (zNear - zFar), -1.0f };
+            m.cols[3] = { 0.0f, 0.0f, zNear * zFar / (zNear - zFar), 0.0f };
+            return m;
+        }
+
+        Vec4 operator*(Vec4 v) const
+        {
+            return cols[0] * v.x + cols[1] * v.y + cols[2] * v.z + cols[3] * v.w;
+        }
+
+        Mat4 operator*(const Mat4& o) const
+        {
+            auto m = Mat4();
+            for (auto i = 0; i < 4; i++) {
+                m.cols[i] = *this * o.cols[i];
+            }
+            return m;
+        }
+
+        Vec3 transformPoint(Vec3 p) const { return (*this * Vec4{ p.x, p.y, p.z, 1.0f }).xyz(); }
+        Vec3 transformVector(Vec3 v) const { return (*this * Vec4{ v.x, v.y, v.z, 0.0f }).xyz(); }
+
+        Mat4 transpose() const
+        {
+            auto m = Mat4();
+            m.cols[0] = { cols[0].x, cols[1].x, cols[2].x, cols[3].x };
+            m.cols[1] = { cols[0].y, cols[1].y, cols[2].y, cols[3].y };
+            m.cols[2] = { cols[0].z, cols[1].z, cols[2].z, cols[3].z };
+            m.cols[3] = { cols[0].w, cols[1].w, cols[2].w, cols[3].w };
+            return m;
+        }
+
+        // Inverse of a matrix whose last row is (0, 0, 0, 1).
+        Mat4 inverseAffine() const
+        {
+            auto a = cols[0].xyz(), b = cols[1].xyz(), c = cols[2].xyz();
+            auto r0 = cross(b, c), r1 = cross(c, a), r2 = cross(a, b);
+            auto det = dot(a, r0);
+            auto inv = det != 0.0f ? 1.0f / det : 0.0f;
+            r0 *= inv;
+            r1 *= inv;
+            r2 *= inv;
+            auto t = cols[3].xyz();
+            auto m = Mat4();
+            m.cols[0] = { r0.x, r1.x, r2.x, 0.0f };
+            m.cols[1] = { r0.y, r1.y, r2.y, 0.0f };
+            m.cols[2] = { r0.z, r1.z, r2.z, 0.0f };
+            m.cols[3] = { -dot(r0, t), -dot(r1, t), -dot(r2, t), 1.0f };
+            return m;
+        }
+    };
+
+    struct AABB
+    {
+        Vec3 min;
+        Vec3 max;
+
+        Vec3 center() const { return (min + max) * 0.5f; }
+        Vec3 extents() const { return (max - min) * 0.5f; }
+
+        void expand(Vec3 p)
+        {
+            min = Math::min(min, p);
+            max = Math::max(max, p);
+        }
+
+        // Bounds of this box after transformation by m, without transforming all 8 corners.
+        AABB transform(const Mat4& m) const
+        {
+            auto c = m.transformPoint(center());
+            auto e = extents();
+            auto r = abs(m.cols[0].xyz()) * e.x + abs(m.cols[1].xyz()) * e.y +
+                abs(m.cols[2].xyz()) * e.z;
+            return { c - r, c + r };
+        }
+    };
+
+    struct Sphere
+    {
+        Vec3 center;
+        float radius = 0.0f;
+    };
+
+    // Points p with dot(normal, p) + d >= 0 are on the inside.
+    struct Plane
+    {
+        Vec3 normal;
+        float d = 0.0f;
+
+        float distance(Vec3 p) const { return dot(normal, p) + d; }
+    };
+
+    struct Frustum
+    {
+        enum Side { Left, Right, Bottom, Top, Near, Far, Count };
+
+        Plane planes[Count];
+
+        // Extracts normalized, inward-facing planes from a projection or view-projection.
+        static Frustum fromMatrix(const Mat4& m)
+        {
+            auto row = [&m](int i) {
+                return Vec4{ m.cols[0][i], m.cols[1][i], m.cols[2][i], m.cols[3][i] };
+            };
+            auto r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+            Vec4 eqs[Count] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+
+            auto f = Frustum();
+            for (auto i = 0; i < Count; i++) {
+                auto len = length(eqs[i].xyz());
+                auto inv = len > 0.0f ? 1.0f / len : 0.0f;
+                f.planes[i] = { eqs[i].xyz() * inv, eqs[i].w * inv };
+            }
+            return f;
+        }
+
+        bool intersects(const Sphere& s) const
+        {
+            for (auto& p : planes) {
+                if (p.distance(s.center) < -s.radius) return false;
+            }
+            return true;
+        }
+
+        bool intersects(const AABB& box) const
+        {
+            auto c = box.center();
+            auto e = box.extents();
+            for (auto& p : planes) {
+                if (p.distance(c) < -dot(abs(p.normal), e)) return false;
+            }
+            return true;
+        }
+    };
+} // namespace Engine::Math
@@ -0,0 +1,900 @@
+#include "Precompiled.h"
+
+#include "MathKernels.h"
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MATH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define MATH_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit AVX2/FMA instructions in functions that opt in; MSVC always can.
+#if defined(MATH_X86) && !defined(_MSC_VER)
+#define MATH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MATH_TARGET_AVX2
+#endif
+
+namespace Engine::Math
+{
+    struct Kernels
+    {
+        void (*multiply)(const Mat4*, const Mat4*, Mat4*, u32);
+        void (*multiplyBy)(const Mat4&, const Mat4*, Mat4*, u32);
+        void (*transformBounds)(const Mat4*, const AABB*, const BoundsSoA&, u32);
+        u32 (*cullSpheres)(const Frustum&, const SpheresSoA&, u32, u32*);
+        u32 (*cullBounds)(const Frustum&, const BoundsSoA&, u32, u32*);
+        u32 (*cullCones)(Vec3, const BoundsSoA&, const ConesSoA&, const u32*, u32, u32*);
+    };
+
+    // The SIMD kernels run the scalar ones over the last count % width objects, so the
+    // scalar versions take the index to start at.
+    namespace Scalar
+    {
+        void multiply(const Mat4* a, const Mat4* b, Mat4* out, u32 count)
+        {
+            for (auto i = 0u; i < count; i++)
+                out[i] = a[i] * b[i];
+        }
+
+        void multiplyBy(const Mat4& a, const Mat4* b, Mat4* out, u32 count)
+        {
+            // a is copied in case out aliases it.
+            auto m = a;
+            for (auto i = 0u; i < count; i++)
+                out[i] = m * b[i];
+        }
+
+        void transformBounds(
+            const Mat4* world, const AABB* local, const BoundsSoA& out, u32 first, u32 count)
+        {
+            for (auto i = first; i < count; i++) {
+                auto& m = world[i];
+                auto c = m.transformPoint(local[i].center());
+                auto e = local[i].extents();
+                auto r = abs(m.cols[0].xyz()) * e.x + abs(m.cols[1].xyz()) * e.y +
+                    abs(m.cols[2].xyz()) * e.z;
+                out.centerX[i] = c.x;
+                out.centerY[i] = c.y;
+                out.centerZ[i] = c.z;
+                out.extentX[i] = r.x;
+                out.extentY[i] = r.y;
+                out.extentZ[i] = r.z;
+            }
+        }
+
+        void transformBounds(const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count)
+        {
+            transformBounds(world, local, out, 0, count);
+        }
+
+        u32 cullSpheres(
+            const Frustum& f, const SpheresSoA& s, u32 first, u32 count, u32* visible)
+        {
+            auto n = 0u;
+            for (auto i = first; i < count; i++) {
+                auto inside = true;
+                for (auto& p : f.planes) {
+                    auto d = p.normal.x * s.x[i] + p.normal.y * s.y[i] + p.normal.z * s.z[i] + p.d;
+                    inside = inside && d >= -s.radius[i];
+                }
+                visible[n] = i;
+                n += inside;
+            }
+            return n;
+        }
+
+        u32 cullSpheres(const Frustum& f, const SpheresSoA& s, u32 count, u32* visible)
+        {
+            return cullSpheres(f, s, 0, count, visible);
+        }
+
+        u32 cullBounds(const Frustum& f, const BoundsSoA& b, u32 first, u32 count, u32* visible)
+        {
+            auto n = 0u;
+            for (auto i = first; i < count; i++) {
+                auto inside = true;
+                for (auto& p : f.planes) {
+                    auto d = p.normal.x * b.centerX[i] + p.normal.y * b.centerY[i] +
+                        p.normal.z * b.centerZ[i] + p.d;
+                    auto r = std::fabs(p.normal.x) * b.extentX[i] +
+                        std::fabs(p.normal.y) * b.extentY[i] + std::fabs(p.normal.z) * b.extentZ[i];
+                    inside = inside && d + r >= 0.0f;
+                }
+                visible[n] = i;
+                n += inside;
+            }
+            return n;
+        }
+
+        u32 cullBounds(const Frustum& f, const BoundsSoA& b, u32 count, u32* visible)
+        {
+            return cullBounds(f, b, 0, count, visible);
+        }
+
+        u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+            const u32* indices, u32 first, u32 count, u32* visible)
+        {
+            auto n = 0u;
+            for (auto i = first; i < count; i++) {
+                auto id = indices[i];
+                auto d = Vec3{ b.centerX[id], b.centerY[id], b.centerZ[id] } - eye;
+                auto r = length(Vec3{ b.extentX[id], b.extentY[id], b.extentZ[id] });
+                auto axis = Vec3{ c.axisX[id], c.axisY[id], c.axisZ[id] };
+                visible[n] = id;
+                n += dot(d, axis) < c.cutoff[id] * length(d) + r;
+            }
+            return n;
+        }
+
+        u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+            const u32* indices, u32 count, u32* visible)
+        {
+            return cullCones(eye, b, c, indices, 0, count, visible);
+        }
+
+        const Kernels Table = {
+            multiply, multiplyBy, transformBounds, cullSpheres, cullBounds, cullCones };
+    } // namespace Scalar
+
+    // Appends the indices of the set bits of mask, offset by base, without branching.
+    // visible must have room for width more indices past n.
+    inline u32 compact(u32 mask, u32 width, u32 base, u32* visible, u32 n)
+    {
+        for (auto k = 0u; k < width; k++) {
+            visible[n] = base + k;
+            n += (mask >> k) & 1;
+        }
+        return n;
+    }
+
+    // As compact, appending ids[k] for each set bit k.
+    inline u32 compactIds(u32 mask, u32 width, const u32* ids, u32* visible, u32 n)
+    {
+        for (auto k = 0u; k < width; k++) {
+            visible[n] = ids[k];
+            n += (mask >> k) & 1;
+        }
+        return n;
+    }
+
+#if defined(MATH_X86)
+    namespace Sse
+    {
+        inline __m128 mulColumn(const __m128 a[4], __m128 b)
+        {
+            auto r = _mm_mul_ps(a[0], _mm_shuffle_ps(b, b, 0x00));
+            r = _mm_add_ps(r, _mm_mul_ps(a[1], _mm_shuffle_ps(b, b, 0x55)));
+            r = _mm_add_ps(r, _mm_mul_ps(a[2], _mm_shuffle_ps(b, b, 0xAA)));
+            return _mm_add_ps(r, _mm_mul_ps(a[3], _mm_shuffle_ps(b, b, 0xFF)));
+        }
+
+        inline __m128 mulColumn(const __m128 a[4], const Vec4& col)
+        {
+            return mulColumn(a, _mm_load_ps(&col.x));
+        }
+
+        inline void load(const Mat4& m, __m128 out[4])
+        {
+            for (auto k = 0; k < 4; k++)
+                out[k] = _mm_load_ps(&m.cols[k].x);
+        }
+
+        void multiply(const Mat4* a, const Mat4* b, Mat4* out, u32 count)
+        {
+            __m128 cols[4];
+            for (auto i = 0u; i < count; i++) {
+                load(a[i], cols);
+                for (auto k = 0; k < 4; k++)
+                    _mm_store_ps(&out[i].cols[k].x, mulColumn(cols, b[i].cols[k]));
+            }
+        }
+
+        void multiplyBy(const Mat4& a, const Mat4* b, Mat4* out, u32 count)
+        {
+            __m128 cols[4];
+            load(a, cols);
+            for (auto i = 0u; i < count; i++) {
+                for (auto k = 0; k < 4; k++)
+                    _mm_store_ps(&out[i].cols[k].x, mulColumn(cols, b[i].cols[k]));
+            }
+        }
+
+        // Transposes four xyzw vectors into x, y and z vectors.
+        inline void transpose3(const __m128 r[4], __m128& x, __m128& y, __m128& z)
+        {
+            auto t0 = _mm_unpacklo_ps(r[0], r[1]);
+            auto t1 = _mm_unpacklo_ps(r[2], r[3]);
+            auto t2 = _mm_unpackhi_ps(r[0], r[1]);
+            auto t3 = _mm_unpackhi_ps(r[2], r[3]);
+            x = _mm_shuffle_ps(t0, t1, 0x44);
+            y = _mm_shuffle_ps(t0, t1, 0xEE);
+            z = _mm_shuffle_ps(t2, t3, 0x44);
+        }
+
+        void transformBounds(const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count)
+        {
+            const auto half = _mm_set1_ps(0.5f);
+            const auto sign = _mm_set1_ps(-0.0f);
+            auto end = count & ~3u;
+            __m128 centers[4];
+            __m128 extents[4];
+            __m128 m[4];
+            for (auto i = 0u; i < end; i += 4) {
+                for (auto k = 0u; k < 4; k++) {
+                    auto& box = local[i + k];
+                    auto lo = _mm_setr_ps(box.min.x, box.min.y, box.min.z, 0.0f);
+                    auto hi = _mm_setr_ps(box.max.x, box.max.y, box.max.z, 0.0f);
+                    // w = 1 for the center picks up the translation column.
+                    auto c = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+                    c = _mm_add_ps(c, _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f));
+                    auto e = _mm_mul_ps(_mm_sub_ps(hi, lo), half);
+
+                    load(world[i + k], m);
+                    centers[k] = mulColumn(m, c);
+                    auto ex = _mm_shuffle_ps(e, e, 0x00);
+                    auto ey = _mm_shuffle_ps(e, e, 0x55);
+                    auto ez = _mm_shuffle_ps(e, e, 0xAA);
+                    auto r = _mm_mul_ps(_mm_andnot_ps(sign, m[0]), ex);
+                    r = _mm_add_ps(r, _mm_mul_ps(_mm_andnot_ps(sign, m[1]), ey));
+                    extents[k] = _mm_add_ps(r, _mm_mul_ps(_mm_andnot_ps(sign, m[2]), ez));
+                }
+                __m128 x, y, z;
+                transpose3(centers, x, y, z);
+                _mm_storeu_ps(out.centerX + i, x);
+                _mm_storeu_ps(out.centerY + i, y);
+                _mm_storeu_ps(out.centerZ + i, z);
+                transpose3(extents, x, y, z);
+                _mm_storeu_ps(out.extentX + i, x);
+                _mm_storeu_ps(out.extentY + i, y);
+                _mm_storeu_ps(out.extentZ + i, z);
+            }
+            Scalar::transformBounds(world, local, out, end, count);
+        }
+
+        struct Planes
+        {
+            __m128 nx[Frustum::Count];
+            __m128 ny[Frustum::Count];
+            __m128 nz[Frustum::Count];
+            __m128 d[Frustum::Count];
+        };
+
+        inline Planes broadcast(const Frustum& f, bool absNormals)
+        {
+            auto planes = Planes();
+            for (auto p = 0; p < Frustum::Count; p++) {
+                auto n = absNormals ? abs(f.planes[p].normal) : f.planes[p].normal;
+                planes.nx[p] = _mm_set1_ps(n.x);
+                planes.ny[p] = _mm_set1_ps(n.y);
+                planes.nz[p] = _mm_set1_ps(n.z);
+                planes.d[p] = _mm_set1_ps(f.planes[p].d);
+            }
+            return planes;
+        }
+
+        u32 cullSpheres(const Frustum& f, const SpheresSoA& s, u32 count, u32* visible)
+        {
+            auto planes = broadcast(f, false);
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                auto x = _mm_loadu_ps(s.x + i);
+                auto y = _mm_loadu_ps(s.y + i);
+                auto z = _mm_loadu_ps(s.z + i);
+                auto r = _mm_loadu_ps(s.radius + i);
+                auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (auto p = 0; p < Frustum::Count; p++) {
+                    auto d = _mm_add_ps(_mm_mul_ps(planes.nx[p], x), planes.d[p]);
+                    d = _mm_add_ps(d, _mm_mul_ps(planes.ny[p], y));
+                    d = _mm_add_ps(d, _mm_mul_ps(planes.nz[p], z));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+                }
+                n = compact((u32)_mm_movemask_ps(inside), 4, i, visible, n);
+            }
+            return n + Scalar::cullSpheres(f, s, end, count, visible + n);
+        }
+
+        u32 cullBounds(const Frustum& f, const BoundsSoA& b, u32 count, u32* visible)
+        {
+            auto planes = broadcast(f, false);
+            auto absPlanes = broadcast(f, true);
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                auto cx = _mm_loadu_ps(b.centerX + i);
+                auto cy = _mm_loadu_ps(b.centerY + i);
+                auto cz = _mm_loadu_ps(b.centerZ + i);
+                auto ex = _mm_loadu_ps(b.extentX + i);
+                auto ey = _mm_loadu_ps(b.extentY + i);
+                auto ez = _mm_loadu_ps(b.extentZ + i);
+                auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (auto p = 0; p < Frustum::Count; p++) {
+                    auto d = _mm_add_ps(_mm_mul_ps(planes.nx[p], cx), planes.d[p]);
+                    d = _mm_add_ps(d, _mm_mul_ps(planes.ny[p], cy));
+                    d = _mm_add_ps(d, _mm_mul_ps(planes.nz[p], cz));
+                    d = _mm_add_ps(d, _mm_mul_ps(absPlanes.nx[p], ex));
+                    d = _mm_add_ps(d, _mm_mul_ps(absPlanes.ny[p], ey));
+                    d = _mm_add_ps(d, _mm_mul_ps(absPlanes.nz[p], ez));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+                }
+                n = compact((u32)_mm_movemask_ps(inside), 4, i, visible, n);
+            }
+            return n + Scalar::cullBounds(f, b, end, count, visible + n);
+        }
+
+        inline __m128 gather(const float* base, const u32 ids[4])
+        {
+            return _mm_setr_ps(base[ids[0]], base[ids[1]], base[ids[2]], base[ids[3]]);
+        }
+
+        inline __m128 length(__m128 x, __m128 y, __m128 z)
+        {
+            return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                _mm_mul_ps(z, z)));
+        }
+
+        u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+            const u32* indices, u32 count, u32* visible)
+        {
+            auto eyeX = _mm_set1_ps(eye.x);
+            auto eyeY = _mm_set1_ps(eye.y);
+            auto eyeZ = _mm_set1_ps(eye.z);
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                // Copied first, since visible may alias indices.
+                u32 ids[4] = { indices[i], indices[i + 1], indices[i + 2], indices[i + 3] };
+                auto dx = _mm_sub_ps(gather(b.centerX, ids), eyeX);
+                auto dy = _mm_sub_ps(gather(b.centerY, ids), eyeY);
+                auto dz = _mm_sub_ps(gather(b.centerZ, ids), eyeZ);
+                auto r = length(gather(b.extentX, ids), gather(b.extentY, ids),
+                    gather(b.extentZ, ids));
+                auto d = _mm_mul_ps(dx, gather(c.axisX, ids));
+                d = _mm_add_ps(d, _mm_mul_ps(dy, gather(c.axisY, ids)));
+                d = _mm_add_ps(d, _mm_mul_ps(dz, gather(c.axisZ, ids)));
+                auto limit = _mm_add_ps(_mm_mul_ps(gather(c.cutoff, ids), length(dx, dy, dz)), r);
+                n = compactIds((u32)_mm_movemask_ps(_mm_cmplt_ps(d, limit)), 4, ids, visible, n);
+            }
+            return n + Scalar::cullCones(eye, b, c, indices, end, count, visible + n);
+        }
+
+        const Kernels Table = {
+            multiply, multiplyBy, transformBounds, cullSpheres, cullBounds, cullCones };
+    } // namespace Sse
+
+    namespace Avx2
+    {
+        // Computes columns k and k + 1 of a * b at once: a's columns are repeated in both halves.
+        MATH_TARGET_AVX2 inline __m256 mulColumns(const __m256 a[4], const Vec4* cols)
+        {
+            auto b = _mm256_loadu_ps(&cols[0].x);
+            auto r = _mm256_mul_ps(a[0], _mm256_permute_ps(b, 0x00));
+            r = _mm256_fmadd_ps(a[1], _mm256_permute_ps(b, 0x55), r);
+            r = _mm256_fmadd_ps(a[2], _mm256_permute_ps(b, 0xAA), r);
+            return _mm256_fmadd_ps(a[3], _mm256_permute_ps(b, 0xFF), r);
+        }
+
+        MATH_TARGET_AVX2 inline void load(const Mat4& m, __m256 out[4])
+        {
+            for (auto k = 0; k < 4; k++)
+                out[k] = _mm256_broadcast_ps((const __m128*)&m.cols[k].x);
+        }
+
+        MATH_TARGET_AVX2 void multiply(const Mat4* a, const Mat4* b, Mat4* out, u32 count)
+        {
+            __m256 cols[4];
+            for (auto i = 0u; i < count; i++) {
+                load(a[i], cols);
+                auto lo = mulColumns(cols, &b[i].cols[0]);
+                auto hi = mulColumns(cols, &b[i].cols[2]);
+                _mm256_storeu_ps(&out[i].cols[0].x, lo);
+                _mm256_storeu_ps(&out[i].cols[2].x, hi);
+            }
+        }
+
+        MATH_TARGET_AVX2 void multiplyBy(const Mat4& a, const Mat4* b, Mat4* out, u32 count)
+        {
+            __m256 cols[4];
+            load(a, cols);
+            for (auto i = 0u; i < count; i++) {
+                auto lo = mulColumns(cols, &b[i].cols[0]);
+                auto hi = mulColumns(cols, &b[i].cols[2]);
+                _mm256_storeu_ps(&out[i].cols[0].x, lo);
+                _mm256_storeu_ps(&out[i].cols[2].x, hi);
+            }
+        }
+
+        MATH_TARGET_AVX2 inline __m256 pair(const Vec4& lo, const Vec4& hi)
+        {
+            return _mm256_insertf128_ps(
+                _mm256_castps128_ps256(_mm_load_ps(&lo.x)), _mm_load_ps(&hi.x), 1);
+        }
+
+        // Per 128-bit half: transposes four xyzw vectors into x, y and z vectors.
+        MATH_TARGET_AVX2 inline void transpose3(const __m256 r[4], __m256& x, __m256& y, __m256& z)
+        {
+            auto t0 = _mm256_unpacklo_ps(r[0], r[1]);
+            auto t1 = _mm256_unpacklo_ps(r[2], r[3]);
+            auto t2 = _mm256_unpackhi_ps(r[0], r[1]);
+            auto t3 = _mm256_unpackhi_ps(r[2], r[3]);
+            x = _mm256_shuffle_ps(t0, t1, 0x44);
+            y = _mm256_shuffle_ps(t0, t1, 0xEE);
+            z = _mm256_shuffle_ps(t2, t3, 0x44);
+        }
+
+        MATH_TARGET_AVX2 void transformBounds(
+            const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count)
+        {
+            const auto half = _mm256_set1_ps(0.5f);
+            const auto sign = _mm256_set1_ps(-0.0f);
+            const auto one = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+            auto end = count & ~7u;
+            __m256 centers[4];
+            __m256 extents[4];
+            for (auto i = 0u; i < end; i += 8) {
+                // Object i + k in the low half and i + k + 4 in the high half, so the
+                // per-half transpose below yields 8 consecutive objects per component.
+                for (auto k = 0u; k < 4; k++) {
+                    auto& l = local[i + k];
+                    auto& h = local[i + k + 4];
+                    auto lo = _mm256_setr_ps(
+                        l.min.x, l.min.y, l.min.z, 0.0f, h.min.x, h.min.y, h.min.z, 0.0f);
+                    auto hi = _mm256_setr_ps(
+                        l.max.x, l.max.y, l.max.z, 0.0f, h.max.x, h.max.y, h.max.z, 0.0f);
+                    auto c = _mm256_fmadd_ps(_mm256_add_ps(lo, hi), half, one);
+                    auto e = _mm256_mul_ps(_mm256_sub_ps(hi, lo), half);
+
+                    auto& ml = world[i + k];
+                    auto& mh = world[i + k + 4];
+                    auto m0 = pair(ml.cols[0], mh.cols[0]);
+                    auto m1 = pair(ml.cols[1], mh.cols[1]);
+                    auto m2 = pair(ml.cols[2], mh.cols[2]);
+                    auto m3 = pair(ml.cols[3], mh.cols[3]);
+
+                    auto r = _mm256_mul_ps(m0, _mm256_permute_ps(c, 0x00));
+                    r = _mm256_fmadd_ps(m1, _mm256_permute_ps(c, 0x55), r);
+                    r = _mm256_fmadd_ps(m2, _mm256_permute_ps(c, 0xAA), r);
+                    centers[k] = _mm256_fmadd_ps(m3, _mm256_permute_ps(c, 0xFF), r);
+
+                    r = _mm256_mul_ps(_mm256_andnot_ps(sign, m0), _mm256_permute_ps(e, 0x00));
+                    r = _mm256_fmadd_ps(_mm256_andnot_ps(sign, m1), _mm256_permute_ps(e, 0x55), r);
+                    extents[k] =
+                        _mm256_fmadd_ps(_mm256_andnot_ps(sign, m2), _mm256_permute_ps(e, 0xAA), r);
+                }
+                __m256 x, y, z;
+                transpose3(centers, x, y, z);
+                _mm256_storeu_ps(out.centerX + i, x);
+                _mm256_storeu_ps(out.centerY + i, y);
+                _mm256_storeu_ps(out.centerZ + i, z);
+                transpose3(extents, x, y, z);
+                _mm256_storeu_ps(out.extentX + i, x);
+                _mm256_storeu_ps(out.extentY + i, y);
+                _mm256_storeu_ps(out.extentZ + i, z);
+            }
+            Scalar::transformBounds(world, local, out, end, count);
+        }
+
+        struct Planes
+        {
+            __m256 nx[Frustum::Count];
+            __m256 ny[Frustum::Count];
+            __m256 nz[Frustum::Count];
+            __m256 d[Frustum::Count];
+        };
+
+        MATH_TARGET_AVX2 inline void broadcast(const Frustum& f, bool absNormals, Planes& planes)
+        {
+            for (auto p = 0; p < Frustum::Count; p++) {
+                auto n = absNormals ? abs(f.planes[p].normal) : f.planes[p].normal;
+                planes.nx[p] = _mm256_set1_ps(n.x);
+                planes.ny[p] = _mm256_set1_ps(n.y);
+                planes.nz[p] = _mm256_set1_ps(n.z);
+                planes.d[p] = _mm256_set1_ps(f.planes[p].d);
+            }
+        }
+
+        MATH_TARGET_AVX2 u32 cullSpheres(
+            const Frustum& f, const SpheresSoA& s, u32 count, u32* visible)
+        {
+            Planes planes;
+            broadcast(f, false, planes);
+            auto end = count & ~7u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 8) {
+                auto x = _mm256_loadu_ps(s.x + i);
+                auto y = _mm256_loadu_ps(s.y + i);
+                auto z = _mm256_loadu_ps(s.z + i);
+                auto r = _mm256_loadu_ps(s.radius + i);
+                auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (auto p = 0; p < Frustum::Count; p++) {
+                    auto d = _mm256_fmadd_ps(planes.nx[p], x, planes.d[p]);
+                    d = _mm256_fmadd_ps(planes.ny[p], y, d);
+                    d = _mm256_fmadd_ps(planes.nz[p], z, d);
+                    auto test = _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_GE_OQ);
+                    inside = _mm256_and_ps(inside, test);
+                }
+                n = compact((u32)_mm256_movemask_ps(inside), 8, i, visible, n);
+            }
+            return n + Scalar::cullSpheres(f, s, end, count, visible + n);
+        }
+
+        MATH_TARGET_AVX2 u32 cullBounds(
+            const Frustum& f, const BoundsSoA& b, u32 count, u32* visible)
+        {
+            Planes planes;
+            Planes absPlanes;
+            broadcast(f, false, planes);
+            broadcast(f, true, absPlanes);
+            auto end = count & ~7u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 8) {
+                auto cx = _mm256_loadu_ps(b.centerX + i);
+                auto cy = _mm256_loadu_ps(b.centerY + i);
+                auto cz = _mm256_loadu_ps(b.centerZ + i);
+                auto ex = _mm256_loadu_ps(b.extentX + i);
+                auto ey = _mm256_loadu_ps(b.extentY + i);
+                auto ez = _mm256_loadu_ps(b.extentZ + i);
+                auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+                for (auto p = 0; p < Frustum::Count; p++) {
+                    auto d = _mm256_fmadd_ps(planes.nx[p], cx, planes.d[p]);
+                    d = _mm256_fmadd_ps(planes.ny[p], cy, d);
+                    d = _mm256_fmadd_ps(planes.nz[p], cz, d);
+                    d = _mm256_fmadd_ps(absPlanes.nx[p], ex, d);
+                    d = _mm256_fmadd_ps(absPlanes.ny[p], ey, d);
+                    d = _mm256_fmadd_ps(absPlanes.nz[p], ez, d);
+                    auto test = _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ);
+                    inside = _mm256_and_ps(inside, test);
+                }
+                n = compact((u32)_mm256_movemask_ps(inside), 8, i, visible, n);
+            }
+            return n + Scalar::cullBounds(f, b, end, count, visible + n);
+        }
+
+        MATH_TARGET_AVX2 inline __m256 length(__m256 x, __m256 y, __m256 z)
+        {
+            auto sum = _mm256_fmadd_ps(x, x, _mm256_fmadd_ps(y, y, _mm256_mul_ps(z, z)));
+            return _mm256_sqrt_ps(sum);
+        }
+
+        MATH_TARGET_AVX2 u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+            const u32* indices, u32 count, u32* visible)
+        {
+            auto eyeX = _mm256_set1_ps(eye.x);
+            auto eyeY = _mm256_set1_ps(eye.y);
+            auto eyeZ = _mm256_set1_ps(eye.z);
+            auto end = count & ~7u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 8) {
+                // Copied first, since visible may alias indices.
+                alignas(32) u32 ids[8];
+                auto idx = _mm256_loadu_si256((const __m256i*)(indices + i));
+                _mm256_store_si256((__m256i*)ids, idx);
+                auto dx = _mm256_sub_ps(_mm256_i32gather_ps(b.centerX, idx, 4), eyeX);
+                auto dy = _mm256_sub_ps(_mm256_i32gather_ps(b.centerY, idx, 4), eyeY);
+                auto dz = _mm256_sub_ps(_mm256_i32gather_ps(b.centerZ, idx, 4), eyeZ);
+                auto r = length(_mm256_i32gather_ps(b.extentX, idx, 4),
+                    _mm256_i32gather_ps(b.extentY, idx, 4), _mm256_i32gather_ps(b.extentZ, idx, 4));
+                auto d = _mm256_mul_ps(dx, _mm256_i32gather_ps(c.axisX, idx, 4));
+                d = _mm256_fmadd_ps(dy, _mm256_i32gather_ps(c.axisY, idx, 4), d);
+                d = _mm256_fmadd_ps(dz, _mm256_i32gather_ps(c.axisZ, idx, 4), d);
+                auto cutoff = _mm256_i32gather_ps(c.cutoff, idx, 4);
+                auto limit = _mm256_fmadd_ps(cutoff, length(dx, dy, dz), r);
+                auto mask = (u32)_mm256_movemask_ps(_mm256_cmp_ps(d, limit, _CMP_LT_OQ));
+                n = compactIds(mask, 8, ids, visible, n);
+            }
+            return n + Scalar::cullCones(eye, b, c, indices, end, count, visible + n);
+        }
+
+        const Kernels Table = {
+            multiply, multiplyBy, transformBounds, cullSpheres, cullBounds, cullCones };
+    } // namespace Avx2
+#endif // MATH_X86
+
+#if defined(MATH_NEON)
+    namespace Neon
+    {
+        inline float32x4_t mulColumn(const float32x4_t a[4], const Vec4& col)
+        {
+            auto b = vld1q_f32(&col.x);
+            auto r = vmulq_laneq_f32(a[0], b, 0);
+            r = vfmaq_laneq_f32(r, a[1], b, 1);
+            r = vfmaq_laneq_f32(r, a[2], b, 2);
+            return vfmaq_laneq_f32(r, a[3], b, 3);
+        }
+
+        inline void load(const Mat4& m, float32x4_t out[4])
+        {
+            for (auto k = 0; k < 4; k++)
+                out[k] = vld1q_f32(&m.cols[k].x);
+        }
+
+        void multiply(const Mat4* a, const Mat4* b, Mat4* out, u32 count)
+        {
+            float32x4_t cols[4];
+            for (auto i = 0u; i < count; i++) {
+                load(a[i], cols);
+                for (auto k = 0; k < 4; k++)
+                    vst1q_f32(&out[i].cols[k].x, mulColumn(cols, b[i].cols[k]));
+            }
+        }
+
+        void multiplyBy(const Mat4& a, const Mat4* b, Mat4* out, u32 count)
+        {
+            float32x4_t cols[4];
+            load(a, cols);
+            for (auto i = 0u; i < count; i++) {
+                for (auto k = 0; k < 4; k++)
+                    vst1q_f32(&out[i].cols[k].x, mulColumn(cols, b[i].cols[k]));
+            }
+        }
+
+        inline void transpose3(
+            const float32x4_t r[4], float32x4_t& x, float32x4_t& y, float32x4_t& z)
+        {
+            // t0 = (x0 x1 z0 z1), (y0 y1 w0 w1); t1 likewise for r[2], r[3].
+            auto t0 = vtrnq_f32(r[0], r[1]);
+            auto t1 = vtrnq_f32(r[2], r[3]);
+            x = vcombine_f32(vget_low_f32(t0.val[0]), vget_low_f32(t1.val[0]));
+            y = vcombine_f32(vget_low_f32(t0.val[1]), vget_low_f32(t1.val[1]));
+            z = vcombine_f32(vget_high_f32(t0.val[0]), vget_high_f32(t1.val[0]));
+        }
+
+        void transformBounds(const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count)
+        {
+            auto end = count & ~3u;
+            float32x4_t centers[4];
+            float32x4_t extents[4];
+            float32x4_t m[4];
+            for (auto i = 0u; i < end; i += 4) {
+                for (auto k = 0u; k < 4; k++) {
+                    auto& box = local[i + k];
+                    auto c = Vec4{ (box.min.x + box.max.x) * 0.5f, (box.min.y + box.max.y) * 0.5f,
+                        (box.min.z + box.max.z) * 0.5f, 1.0f };
+                    auto e = box.extents();
+                    load(world[i + k], m);
+                    centers[k] = mulColumn(m, c);
+                    auto r = vmulq_n_f32(vabsq_f32(m[0]), e.x);
+                    r = vfmaq_n_f32(r, vabsq_f32(m[1]), e.y);
+                    extents[k] = vfmaq_n_f32(r, vabsq_f32(m[2]), e.z);
+                }
+                float32x4_t x, y, z;
+                transpose3(centers, x, y, z);
+                vst1q_f32(out.centerX + i, x);
+                vst1q_f32(out.centerY + i, y);
+                vst1q_f32(out.centerZ + i, z);
+                transpose3(extents, x, y, z);
+                vst1q_f32(out.extentX + i, x);
+                vst1q_f32(out.extentY + i, y);
+                vst1q_f32(out.extentZ + i, z);
+            }
+            Scalar::transformBounds(world, local, out, end, count);
+        }
+
+        inline u32 movemask(uint32x4_t mask)
+        {
+            const uint32_t bits[4] = { 1, 2, 4, 8 };
+            return vaddvq_u32(vandq_u32(mask, vld1q_u32(bits)));
+        }
+
+        u32 cullSpheres(const Frustum& f, const SpheresSoA& s, u32 count, u32* visible)
+        {
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                auto x = vld1q_f32(s.x + i);
+                auto y = vld1q_f32(s.y + i);
+                auto z = vld1q_f32(s.z + i);
+                auto r = vld1q_f32(s.radius + i);
+                auto inside = vdupq_n_u32(UINT32_MAX);
+                for (auto& p : f.planes) {
+                    auto d = vfmaq_n_f32(vaddq_f32(r, vdupq_n_f32(p.d)), x, p.normal.x);
+                    d = vfmaq_n_f32(d, y, p.normal.y);
+                    d = vfmaq_n_f32(d, z, p.normal.z);
+                    inside = vandq_u32(inside, vcgezq_f32(d));
+                }
+                n = compact(movemask(inside), 4, i, visible, n);
+            }
+            return n + Scalar::cullSpheres(f, s, end, count, visible + n);
+        }
+
+        u32 cullBounds(const Frustum& f, const BoundsSoA& b, u32 count, u32* visible)
+        {
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                auto cx = vld1q_f32(b.centerX + i);
+                auto cy = vld1q_f32(b.centerY + i);
+                auto cz = vld1q_f32(b.centerZ + i);
+                auto ex = vld1q_f32(b.extentX + i);
+                auto ey = vld1q_f32(b.extentY + i);
+                auto ez = vld1q_f32(b.extentZ + i);
+                auto inside = vdupq_n_u32(UINT32_MAX);
+                for (auto& p : f.planes) {
+                    auto an = abs(p.normal);
+                    auto d = vfmaq_n_f32(vdupq_n_f32(p.d), cx, p.normal.x);
+                    d = vfmaq_n_f32(d, cy, p.normal.y);
+                    d = vfmaq_n_f32(d, cz, p.normal.z);
+                    d = vfmaq_n_f32(d, ex, an.x);
+                    d = vfmaq_n_f32(d, ey, an.y);
+                    d = vfmaq_n_f32(d, ez, an.z);
+                    inside = vandq_u32(inside, vcgezq_f32(d));
+                }
+                n = compact(movemask(inside), 4, i, visible, n);
+            }
+            return n + Scalar::cullBounds(f, b, end, count, visible + n);
+        }
+
+        inline float32x4_t gather(const float* base, const u32 ids[4])
+        {
+            const float values[4] = { base[ids[0]], base[ids[1]], base[ids[2]], base[ids[3]] };
+            return vld1q_f32(values);
+        }
+
+        inline float32x4_t length(float32x4_t x, float32x4_t y, float32x4_t z)
+        {
+            return vsqrtq_f32(vfmaq_f32(vfmaq_f32(vmulq_f32(z, z), y, y), x, x));
+        }
+
+        u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+            const u32* indices, u32 count, u32* visible)
+        {
+            auto end = count & ~3u;
+            auto n = 0u;
+            for (auto i = 0u; i < end; i += 4) {
+                // Copied first, since visible may alias indices.
+                u32 ids[4] = { indices[i], indices[i + 1], indices[i + 2], indices[i + 3] };
+                auto dx = vsubq_f32(gather(b.centerX, ids), vdupq_n_f32(eye.x));
+                auto dy = vsubq_f32(gather(b.centerY, ids), vdupq_n_f32(eye.y));
+                auto dz = vsubq_f32(gather(b.centerZ, ids), vdupq_n_f32(eye.z));
+                auto r = length(gather(b.extentX, ids), gather(b.extentY, ids),
+                    gather(b.extentZ, ids));
+                auto d = vmulq_f32(dx, gather(c.axisX, ids));
+                d = vfmaq_f32(d, dy, gather(c.axisY, ids));
+                d = vfmaq_f32(d, dz, gather(c.axisZ, ids));
+                auto limit = vfmaq_f32(r, gather(c.cutoff, ids), length(dx, dy, dz));
+                n = compactIds(movemask(vcltq_f32(d, limit)), 4, ids, visible, n);
+            }
+            return n + Scalar::cullCones(eye, b, c, indices, end, count, visible + n);
+        }
+
+        const Kernels Table = {
+            multiply, multiplyBy, transformBounds, cullSpheres, cullBounds, cullCones };
+    } // namespace Neon
+#endif // MATH_NEON
+
+    std::atomic<const Kernels*> active = nullptr;
+    std::atomic<SimdLevel> activeLevel = SimdLevel::Scalar;
+
+    bool hasAvx2()
+    {
+#if defined(MATH_X86) && defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        // OSXSAVE, AVX and FMA, then whether the OS saves the YMM registers.
+        auto ecx = (u32)regs[2];
+        if ((ecx & (1u << 27)) == 0 || (ecx & (1u << 28)) == 0 || (ecx & (1u << 12)) == 0) {
+            return false;
+        }
+        if ((_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(regs, 7, 0);
+        return (regs[1] & (1 << 5)) != 0;
+#elif defined(MATH_X86)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+        return false;
+#endif
+    }
+
+    SimdLevel detectSimdLevel()
+    {
+#if defined(MATH_X86)
+        static const auto level = hasAvx2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+        return level;
+#elif defined(MATH_NEON)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    void setSimdLevel(SimdLevel level)
+    {
+        auto best = detectSimdLevel();
+        auto supported = level == SimdLevel::Scalar || level == best ||
+            (level == SimdLevel::SSE2 && best == SimdLevel::AVX2);
+        if (!supported) {
+            level = best;
+        }
+
+        auto table = &Scalar::Table;
+        switch (level) {
+#if defined(MATH_X86)
+        case SimdLevel::SSE2:
+            table = &Sse::Table;
+            break;
+        case SimdLevel::AVX2:
+            table = &Avx2::Table;
+            break;
+#endif
+#if defined(MATH_NEON)
+        case SimdLevel::NEON:
+            table = &Neon::Table;
+            break;
+#endif
+        default:
+            break;
+        }
+        activeLevel.store(level, std::memory_order_relaxed);
+        active.store(table, std::memory_order_release);
+    }
+
+    const Kernels& kernels()
+    {
+        auto table = active.load(std::memory_order_acquire);
+        if (table == nullptr) {
+            setSimdLevel(detectSimdLevel());
+            table = active.load(std::memory_order_acquire);
+        }
+        return *table;
+    }
+
+    SimdLevel getSimdLevel()
+    {
+        kernels();
+        return activeLevel.load(std::memory_order_relaxed);
+    }
+
+    sstr to_sstr(SimdLevel level)
+    {
+        switch (level) {
+        case SimdLevel::SSE2:
+            return "sse2";
+        case SimdLevel::AVX2:
+            return "avx2";
+        case SimdLevel::NEON:
+            return "neon";
+        default:
+            return "scalar";
+        }
+    }
+
+    void multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* out, u32 count)
+    {
+        kernels().multiply(a, b, out, count);
+    }
+
+    void multiplyMatrices(const Mat4& a, const Mat4* b, Mat4* out, u32 count)
+    {
+        kernels().multiplyBy(a, b, out, count);
+    }
+
+    void transformBounds(const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count)
+    {
+        kernels().transformBounds(world, local, out, count);
+    }
+
+    u32 cullSpheres(const Frustum& f, const SpheresSoA& s, u32 count, u32* visible)
+    {
+        return kernels().cullSpheres(f, s, count, visible);
+    }
+
+    u32 cullBounds(const Frustum& f, const BoundsSoA& b, u32 count, u32* visible)
+    {
+        return kernels().cullBounds(f, b, count, visible);
+    }
+
+    u32 cullCones(Vec3 eye, const BoundsSoA& b, const ConesSoA& c,
+        const u32* indices, u32 count, u32* visible)
+    {
+        return kernels().cullCones(eye, b, c, indices, count, visible);
+    }
+} // namespace Engine::Math
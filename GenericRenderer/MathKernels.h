@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Math.h"
+
+/// Batched math kernels over many objects at once.
+///
+/// Each operation has scalar, SSE2, AVX2 (+FMA) and NEON implementations; the best one the
+/// CPU supports is picked at runtime on first use. Per-object data that is read many times a
+/// frame (bounds, spheres) is kept as structures of arrays, so the SIMD paths process 4 or 8
+/// objects per instruction instead of the lanes of one vector.
+namespace Engine::Math
+{
+    enum class SimdLevel : u8
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+        NEON
+    };
+
+    // The best level this CPU and OS support.
+    SimdLevel detectSimdLevel();
+    SimdLevel getSimdLevel();
+    // Selects kernels, e.g. to compare levels in benchmarks. Unsupported levels fall back to
+    // the detected one.
+    void setSimdLevel(SimdLevel);
+    sstr to_sstr(SimdLevel);
+
+    // World-space bounds as centers and half-extents, one array per component.
+    struct BoundsSoA
+    {
+        float* centerX = nullptr;
+        float* centerY = nullptr;
+        float* centerZ = nullptr;
+        float* extentX = nullptr;
+        float* extentY = nullptr;
+        float* extentZ = nullptr;
+    };
+
+    struct SpheresSoA
+    {
+        float* x = nullptr;
+        float* y = nullptr;
+        float* z = nullptr;
+        float* radius = nullptr;
+    };
+
+    // Per-object normal cones for backface culling, with the apex at the bounds center.
+    // A cutoff of 1 or more disables culling for that object.
+    struct ConesSoA
+    {
+        float* axisX = nullptr;
+        float* axisY = nullptr;
+        float* axisZ = nullptr;
+        // Culled when dot(center - eye, axis) >= cutoff * |center - eye| + radius.
+        float* cutoff = nullptr;
+    };
+
+    // out[i] = a[i] * b[i]. out may alias a or b.
+    void multiplyMatrices(const Mat4* a, const Mat4* b, Mat4* out, u32 count);
+    // out[i] = a * b[i], e.g. view-projection times each world matrix. out may alias b.
+    void multiplyMatrices(const Mat4& a, const Mat4* b, Mat4* out, u32 count);
+
+    // Writes the world bounds of local[i] under world[i] to element i of out.
+    void transformBounds(const Mat4* world, const AABB* local, const BoundsSoA& out, u32 count);
+
+    /// <summary>
+    /// Frustum tests. Writes the indices of the objects that intersect the frustum to visible,
+    /// in ascending order, and returns how many were written. visible must hold count indices.
+    /// </summary>
+    u32 cullSpheres(const Frustum&, const SpheresSoA&, u32 count, u32* visible);
+    u32 cullBounds(const Frustum&, const BoundsSoA&, u32 count, u32* visible);
+    // Keeps the objects in indices[0, count) that may show front faces to eye, i.e. whose
+    // cone doesn't face away from it. visible may alias indices.
+    u32 cullCones(Vec3 eye, const BoundsSoA&, const ConesSoA&,
+        const u32* indices, u32 count, u32* visible);
+} // namespace Engine::Math
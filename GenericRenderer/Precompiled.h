@@ -2,4 +2,5 @@
 
 #include "Types.h"
 #include "stdinc.h"
+#include "Format.h"
 #include "Debug.h"
\ No newline at end of file
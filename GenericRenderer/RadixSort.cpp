@@ -0,0 +1,79 @@
+#include "Precompiled.h"
+
+#include "RadixSort.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Engine::Sort
+{
+    // Keys per block; each block is one job per pass.
+    const u32 BlockSize = 1 << 16;
+    const u32 Buckets = 256;
+
+    void radixSort(List<u64>& keys, List<u64>& keyScratch, u32 beginBit, u32 endBit,
+        List<u32>* values, List<u32>* valueScratch)
+    {
+        auto count = (u32)keys.size();
+        keyScratch.resize(count);
+        if (values != nullptr) {
+            valueScratch->resize(count);
+        }
+        if (count < 2 || beginBit >= endBit) return;
+
+        auto blockCount = (count + BlockSize - 1) / BlockSize;
+        auto blockEnd = [count](u32 block) { return std::min(count, (block + 1) * BlockSize); };
+
+        // Bits that differ from the first key anywhere; digits without any are already sorted.
+        auto first = keys[0];
+        auto differing = std::atomic<u64>(0);
+        Jobs::parallelFor(blockCount, 1, [&](u32 begin, u32 end) {
+            auto bits = (u64)0;
+            for (auto i = begin * BlockSize; i < blockEnd(end - 1); i++)
+                bits |= keys[i] ^ first;
+            differing.fetch_or(bits, std::memory_order_relaxed);
+        });
+
+        auto offsets = List<u32>((size_t)blockCount * Buckets);
+        for (auto shift = beginBit; shift < endBit; shift += 8) {
+            auto mask = (u64)(1u << std::min(8u, endBit - shift)) - 1;
+            if (((differing.load(std::memory_order_relaxed) >> shift) & mask) == 0) continue;
+
+            Jobs::parallelFor(blockCount, 1, [&](u32 begin, u32 end) {
+                for (auto block = begin; block < end; block++) {
+                    auto counts = &offsets[(size_t)block * Buckets];
+                    std::fill(counts, counts + Buckets, 0u);
+                    for (auto i = block * BlockSize; i < blockEnd(block); i++)
+                        counts[(keys[i] >> shift) & mask]++;
+                }
+            });
+            // Bucket-major, then block order: every block gets its own range in each bucket.
+            auto total = 0u;
+            for (auto bucket = 0u; bucket < Buckets; bucket++) {
+                for (auto block = 0u; block < blockCount; block++) {
+                    auto& offset = offsets[(size_t)block * Buckets + bucket];
+                    auto inBlock = offset;
+                    offset = total;
+                    total += inBlock;
+                }
+            }
+            Jobs::parallelFor(blockCount, 1, [&](u32 begin, u32 end) {
+                for (auto block = begin; block < end; block++) {
+                    auto next = &offsets[(size_t)block * Buckets];
+                    for (auto i = block * BlockSize; i < blockEnd(block); i++) {
+                        auto at = next[(keys[i] >> shift) & mask]++;
+                        keyScratch[at] = keys[i];
+                        if (values != nullptr) {
+                            (*valueScratch)[at] = (*values)[i];
+                        }
+                    }
+                }
+            });
+            keys.swap(keyScratch);
+            if (values != nullptr) {
+                values->swap(*valueScratch);
+            }
+        }
+    }
+} // namespace Engine::Sort
@@ -0,0 +1,18 @@
+#pragma once
+
+/// Parallel LSD radix sort of 64-bit keys.
+///
+/// Keys are sorted 8 bits per pass over a bit range, optionally carrying a u32 value each.
+/// Each pass histograms and scatters fixed-size blocks across the job workers; blocks scatter
+/// into disjoint ranges in block order, so the sort is stable. Digits that are the same in
+/// every key are found up front and skipped, which makes sparse keys (few passes, pipelines
+/// or materials in use) cost only the passes that actually order something.
+namespace Engine::Sort
+{
+    /// <summary>
+    /// Sorts keys by bits [beginBit, endBit), reordering values alongside when given. Scratch
+    /// lists are resized as needed and hold garbage afterwards; results are in keys and values.
+    /// </summary>
+    void radixSort(List<u64>& keys, List<u64>& keyScratch, u32 beginBit = 0, u32 endBit = 64,
+        List<u32>* values = nullptr, List<u32>* valueScratch = nullptr);
+} // namespace Engine::Sort
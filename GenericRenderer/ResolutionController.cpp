@@ -0,0 +1,41 @@
+#include "Precompiled.h"
+
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Engine
+{
+    void ResolutionController::reset(const Config& config)
+    {
+        this->config = config;
+        scale = config.maxScale;
+        stepped = config.maxScale;
+        lastError = 0.0f;
+        lastDelta = 0.0f;
+    }
+
+    float ResolutionController::update(float gpuMs)
+    {
+        if (!(gpuMs > 0.0f)) return stepped;
+
+        // Positive when there is time to spare.
+        auto error = std::sqrt(config.targetMs / gpuMs) - 1.0f;
+        if (std::abs(error) < config.deadband) {
+            error = 0.0f;
+        }
+        auto delta = error - lastError;
+        auto change = config.kp * delta + config.ki * error + config.kd * (delta - lastDelta);
+        lastDelta = delta;
+        lastError = error;
+        scale = std::clamp(scale + change * scale, config.minScale, config.maxScale);
+
+        // Round towards the current step unless a whole step away, so noise can't flip it.
+        if (std::abs(scale - stepped) >= config.step) {
+            stepped = std::round(scale / config.step) * config.step;
+            stepped = std::clamp(stepped, config.minScale, config.maxScale);
+        }
+        return stepped;
+    }
+} // namespace Engine
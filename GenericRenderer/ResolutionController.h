@@ -0,0 +1,46 @@
+#pragma once
+
+/// Render scale control towards a target GPU frame time.
+///
+/// A PID controller in velocity form: each frame nudges the scale by the change in error
+/// (proportional), the error itself (integral) and its change in slope (derivative), which
+/// can't wind up while the scale sits at a limit. The error is the relative scale that would
+/// have hit the target, sqrt(target / measured) - 1, as GPU time follows the pixel count,
+/// the square of the scale. A deadband ignores noise around the target, and the reported
+/// scale moves in steps so small corrections don't change the render size every frame.
+namespace Engine
+{
+    class ResolutionController
+    {
+    public:
+        struct Config
+        {
+            float targetMs = 16.0f;
+            float minScale = 0.5f;
+            float maxScale = 1.0f;
+            float kp = 0.2f;
+            float ki = 0.3f;
+            float kd = 0.05f;
+            // Relative errors within this are treated as on target.
+            float deadband = 0.03f;
+            float step = 1.0f / 32.0f;
+        };
+
+    private:
+        Config config;
+        float scale = 1.0f;
+        float stepped = 1.0f;
+        float lastError = 0.0f;
+        float lastDelta = 0.0f;
+
+    public:
+        const Config& getConfig() const { return config; }
+        // A multiple of Config::step, within the limits.
+        float getScale() const { return stepped; }
+
+        // Starts at the maximum scale.
+        void reset(const Config&);
+        // Feeds one frame's GPU time and returns the scale for the next frame.
+        float update(float gpuMs);
+    };
+} // namespace Engine
@@ -0,0 +1,347 @@
+#include "Precompiled.h"
+
+#include "Scene.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Engine
+{
+    Scene::Scene()
+    {
+        levelStarts.push_back(0);
+    }
+
+    Math::BoundsSoA Scene::getWorldBounds()
+    {
+        auto bounds = Math::BoundsSoA();
+        bounds.centerX = worldBounds[0].data();
+        bounds.centerY = worldBounds[1].data();
+        bounds.centerZ = worldBounds[2].data();
+        bounds.extentX = worldBounds[3].data();
+        bounds.extentY = worldBounds[4].data();
+        bounds.extentZ = worldBounds[5].data();
+        return bounds;
+    }
+
+    u32 Scene::indexOf(NodeHandle handle) const
+    {
+        auto index = indices.get(handle);
+        return index ? *index : NoParent;
+    }
+
+    NodeHandle Scene::create(const Transform& transform, NodeHandle parent)
+    {
+        auto parentIdx = NoParent;
+        if (parent.isValid()) {
+            parentIdx = indexOf(parent);
+            if (parentIdx == NoParent) return NodeHandle();
+        }
+
+        // Appended out of depth order; update() sorts it into place.
+        auto index = size();
+        auto handle = indices.insert(index);
+        handles.push_back(handle);
+        parents.push_back(parentIdx);
+        transforms.push_back(transform);
+        locals.push_back(Math::Mat4());
+        worlds.push_back(Math::Mat4());
+        localBounds.push_back(Math::AABB());
+        for (auto& component : worldBounds)
+            component.push_back(0.0f);
+        renderData.push_back(RenderData());
+        flags.push_back(LocalDirty);
+        layoutDirty = true;
+        return handle;
+    }
+
+    void Scene::destroy(NodeHandle handle)
+    {
+        auto index = indexOf(handle);
+        if (index == NoParent) return;
+
+        // Descendants keep valid handles until the next update() drops them.
+        flags[index] |= Removed;
+        indices.remove(handle);
+        layoutDirty = true;
+    }
+
+    bool Scene::setParent(NodeHandle node, NodeHandle parent)
+    {
+        auto index = indexOf(node);
+        auto parentIdx = parent.isValid() ? indexOf(parent) : NoParent;
+        if (index == NoParent || (parent.isValid() && parentIdx == NoParent)) return false;
+
+        for (auto i = parentIdx; i != NoParent; i = parents[i]) {
+            if (i == index) return false;
+        }
+        parents[index] = parentIdx;
+        flags[index] |= LocalDirty;
+        layoutDirty = true;
+        return true;
+    }
+
+    void Scene::setTransform(NodeHandle handle, const Transform& transform)
+    {
+        auto index = indexOf(handle);
+        if (index == NoParent) return;
+        transforms[index] = transform;
+        markDirty(index);
+    }
+
+    const Transform* Scene::getTransform(NodeHandle handle) const
+    {
+        auto index = indexOf(handle);
+        return index != NoParent ? &transforms[index] : nullptr;
+    }
+
+    const Math::Mat4* Scene::getWorldMatrix(NodeHandle handle) const
+    {
+        auto index = indexOf(handle);
+        return index != NoParent ? &worlds[index] : nullptr;
+    }
+
+    void Scene::setLocalBounds(NodeHandle handle, const Math::AABB& bounds)
+    {
+        auto index = indexOf(handle);
+        if (index == NoParent) return;
+        localBounds[index] = bounds;
+        markDirty(index);
+    }
+
+    void Scene::setRenderData(NodeHandle handle, const RenderData& data)
+    {
+        auto index = indexOf(handle);
+        if (index == NoParent) return;
+        renderData[index] = data;
+    }
+
+    void Scene::markDirty(u32 index)
+    {
+        flags[index] |= LocalDirty;
+        // Marks are recounted after a re-sort; new nodes have no level until then.
+        if (!layoutDirty) {
+            levelMarked[levelOf(index)] = 1;
+        }
+    }
+
+    u32 Scene::levelOf(u32 index) const
+    {
+        auto it = std::upper_bound(levelStarts.begin(), levelStarts.end(), index);
+        return (u32)(it - levelStarts.begin()) - 1;
+    }
+
+    void Scene::update()
+    {
+        if (layoutDirty) {
+            relayout();
+        }
+        propagate();
+    }
+
+    void Scene::relayout()
+    {
+        auto count = size();
+
+        // Depth of every node, and whether it is removed with a destroyed ancestor. Walks up
+        // to the nearest resolved ancestor, then resolves the path on the way back down.
+        const auto Unresolved = UINT32_MAX;
+        auto depths = List<u32>(count, Unresolved);
+        auto path = List<u32>();
+        auto maxDepth = 0u;
+        for (auto i = 0u; i < count; i++) {
+            auto node = i;
+            while (node != NoParent && depths[node] == Unresolved) {
+                path.push_back(node);
+                node = parents[node];
+            }
+            while (!path.empty()) {
+                auto current = path.back();
+                path.pop_back();
+                auto parent = parents[current];
+                depths[current] = parent == NoParent ? 0 : depths[parent] + 1;
+                if (parent != NoParent && (flags[parent] & Removed)) {
+                    flags[current] |= Removed;
+                }
+                maxDepth = std::max(maxDepth, depths[current]);
+            }
+        }
+
+        // Bucket by depth, keeping the current order within a depth.
+        auto levelCounts = List<u32>(count > 0 ? maxDepth + 2 : 1, 0);
+        for (auto i = 0u; i < count; i++) {
+            if (flags[i] & Removed) {
+                // The destroyed node's own handle is already gone.
+                indices.remove(handles[i]);
+                continue;
+            }
+            levelCounts[depths[i] + 1]++;
+        }
+        for (auto d = 1u; d < levelCounts.size(); d++)
+            levelCounts[d] += levelCounts[d - 1];
+        auto order = List<u32>(levelCounts.back());
+        auto cursor = levelCounts;
+        for (auto i = 0u; i < count; i++) {
+            if (flags[i] & Removed) continue;
+            order[cursor[depths[i]]++] = i;
+        }
+
+        // Within a depth, order children by their parent's new position (a counting sort over
+        // the previous depth), so siblings are contiguous and parent reads during propagation
+        // walk forward through memory.
+        auto newIndex = List<u32>(count, NoParent);
+        auto siblings = List<u32>();
+        auto sorted = List<u32>();
+        for (auto d = 0u; d + 1 < levelCounts.size(); d++) {
+            auto begin = levelCounts[d];
+            auto end = levelCounts[d + 1];
+            if (d > 0) {
+                auto parentBegin = levelCounts[d - 1];
+                siblings.assign(begin - parentBegin + 1, 0);
+                for (auto i = begin; i < end; i++)
+                    siblings[newIndex[parents[order[i]]] - parentBegin + 1]++;
+                for (auto k = 1u; k < siblings.size(); k++)
+                    siblings[k] += siblings[k - 1];
+                sorted.resize(end - begin);
+                for (auto i = begin; i < end; i++)
+                    sorted[siblings[newIndex[parents[order[i]]] - parentBegin]++] = order[i];
+                std::copy(sorted.begin(), sorted.end(), order.begin() + begin);
+            }
+            for (auto i = begin; i < end; i++)
+                newIndex[order[i]] = i;
+        }
+
+        auto permute = [&order](auto& list) {
+            // The previous buffer is kept for the next re-sort, which then doesn't have to
+            // allocate (and fault in) a fresh copy of the whole scene.
+            thread_local std::remove_reference_t<decltype(list)> sorted;
+            sorted.resize(order.size());
+            for (auto k = 0u; k < order.size(); k++)
+                sorted[k] = list[order[k]];
+            list.swap(sorted);
+        };
+        for (auto& parent : parents) {
+            if (parent != NoParent) {
+                parent = newIndex[parent];
+            }
+        }
+        permute(handles);
+        permute(parents);
+        permute(transforms);
+        permute(locals);
+        permute(worlds);
+        permute(localBounds);
+        for (auto& component : worldBounds)
+            permute(component);
+        permute(renderData);
+        permute(flags);
+        for (auto i = 0u; i < size(); i++)
+            *indices.get(handles[i]) = i;
+
+        while (levelCounts.size() > 1 && levelCounts[levelCounts.size() - 2] == levelCounts.back())
+            levelCounts.pop_back();
+        levelStarts = levelCounts;
+        levelMarked.assign(getLevelCount(), 0);
+        for (auto d = 0u; d < getLevelCount(); d++) {
+            for (auto i = getLevelBegin(d); i < getLevelEnd(d); i++) {
+                if (flags[i] & LocalDirty) {
+                    levelMarked[d] = 1;
+                    break;
+                }
+            }
+        }
+        layoutDirty = false;
+        layoutVersion++;
+    }
+
+    void Scene::propagate()
+    {
+        // Changed flags describe the last update() only.
+        if (changedCount > 0) {
+            Jobs::parallelFor(size(), ChunkSize * 16, [this](u32 begin, u32 end) {
+                for (auto i = begin; i < end; i++)
+                    flags[i] &= ~Changed;
+            });
+        }
+        changedCount = 0;
+
+        // Levels past the last marked one only need work while changes keep propagating.
+        auto levelEnd = 0u;
+        for (auto d = 0u; d < getLevelCount(); d++) {
+            if (levelMarked[d]) {
+                levelEnd = d + 1;
+            }
+        }
+
+        auto parentLevelChanged = false;
+        for (auto d = 0u; d < getLevelCount() && (d < levelEnd || parentLevelChanged); d++) {
+            if (!levelMarked[d] && !parentLevelChanged) continue;
+
+            auto levelBegin = getLevelBegin(d);
+            auto root = d == 0;
+            auto levelChanged = std::atomic<u32>(0);
+            Jobs::parallelFor(getLevelEnd(d) - levelBegin, ChunkSize, [&](u32 first, u32 last) {
+                auto begin = levelBegin + first;
+                auto end = levelBegin + last;
+                auto dirtyCount = 0u;
+                for (auto i = begin; i < end; i++) {
+                    auto f = flags[i];
+                    auto dirty = (f & LocalDirty) || (!root && (flags[parents[i]] & Changed));
+                    if (!dirty) continue;
+                    if (f & LocalDirty) {
+                        auto& t = transforms[i];
+                        locals[i] = Math::Mat4::compose(t.position, t.rotation, t.scale);
+                    }
+                    flags[i] = (u8)((f & ~LocalDirty) | Changed);
+                    dirtyCount++;
+                }
+                if (dirtyCount == 0) return;
+
+                // Mostly-dirty chunks go through the batched kernels, recomputing the few
+                // clean nodes along the way; sparse ones are updated node by node.
+                auto n = end - begin;
+                if (dirtyCount * 4 < n) {
+                    for (auto i = begin; i < end; i++) {
+                        if (!(flags[i] & Changed)) continue;
+                        worlds[i] = root ? locals[i] : worlds[parents[i]] * locals[i];
+                        auto box = localBounds[i].transform(worlds[i]);
+                        auto c = box.center();
+                        auto e = box.extents();
+                        worldBounds[0][i] = c.x;
+                        worldBounds[1][i] = c.y;
+                        worldBounds[2][i] = c.z;
+                        worldBounds[3][i] = e.x;
+                        worldBounds[4][i] = e.y;
+                        worldBounds[5][i] = e.z;
+                    }
+                } else {
+                    if (root) {
+                        std::copy(&locals[begin], &locals[begin] + n, &worlds[begin]);
+                    } else {
+                        thread_local List<Math::Mat4> parentWorlds;
+                        parentWorlds.resize(n);
+                        for (auto k = 0u; k < n; k++)
+                            parentWorlds[k] = worlds[parents[begin + k]];
+                        Math::multiplyMatrices(
+                            parentWorlds.data(), &locals[begin], &worlds[begin], n);
+                    }
+                    auto bounds = getWorldBounds();
+                    bounds.centerX += begin;
+                    bounds.centerY += begin;
+                    bounds.centerZ += begin;
+                    bounds.extentX += begin;
+                    bounds.extentY += begin;
+                    bounds.extentZ += begin;
+                    Math::transformBounds(&worlds[begin], &localBounds[begin], bounds, n);
+                }
+                levelChanged.fetch_add(dirtyCount, std::memory_order_relaxed);
+            });
+
+            levelMarked[d] = 0;
+            auto levelCount = levelChanged.load(std::memory_order_relaxed);
+            parentLevelChanged = levelCount > 0;
+            changedCount += levelCount;
+        }
+    }
+} // namespace Engine
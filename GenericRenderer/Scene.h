@@ -0,0 +1,120 @@
+#pragma once
+
+#include "HandleTable.h"
+#include "MathKernels.h"
+
+/// Data-oriented scene store.
+///
+/// Nodes live in parallel arrays (one per field) ordered by hierarchy depth, so every parent
+/// precedes its children and each depth is one contiguous range. Transform changes only set
+/// dirty flags; update() walks the depths in order, recomputing world matrices and bounds for
+/// dirty nodes and their descendants, with each depth split into chunks across the job system.
+/// Structural changes (create, destroy, reparent) are batched into one re-sort per update().
+namespace Engine
+{
+    struct SceneNode;
+    using NodeHandle = Handle<SceneNode>;
+
+    struct Transform
+    {
+        Math::Vec3 position;
+        Math::Quat rotation;
+        Math::Vec3 scale = { 1.0f, 1.0f, 1.0f };
+    };
+
+    struct RenderData
+    {
+        u32 mesh = UINT32_MAX;
+        u32 material = UINT32_MAX;
+        // Bitmask of views (main, shadow cascades, etc) the node is drawn in.
+        u32 viewMask = UINT32_MAX;
+    };
+
+    class Scene
+    {
+    public:
+        // Nodes per job when propagating transforms; also the granularity of dirty skipping.
+        static const u32 ChunkSize = 512;
+        static const u32 NoParent = UINT32_MAX;
+
+        enum Flags : u8
+        {
+            // Local transform changed since the last update().
+            LocalDirty = 1 << 0,
+            // World matrix and bounds were recomputed by the last update().
+            Changed = 1 << 1,
+            // Destroyed; dropped with its subtree on the next update().
+            Removed = 1 << 2
+        };
+
+    private:
+        HandleTable<u32, SceneNode> indices;
+
+        // Per node, indexed by dense index.
+        List<NodeHandle> handles;
+        List<u32> parents;
+        List<Transform> transforms;
+        List<Math::Mat4> locals;
+        List<Math::Mat4> worlds;
+        List<Math::AABB> localBounds;
+        List<float> worldBounds[6];
+        List<RenderData> renderData;
+        List<u8> flags;
+
+        // Dense index where each depth starts, plus the end of the last depth.
+        List<u32> levelStarts;
+        // Per depth: whether any node at that depth has LocalDirty set.
+        List<u8> levelMarked;
+        bool layoutDirty = false;
+        u32 layoutVersion = 0;
+        u32 changedCount = 0;
+
+    public:
+        u32 size() const { return (u32)handles.size(); }
+        u32 getLevelCount() const { return (u32)levelStarts.size() - 1; }
+        u32 getLevelBegin(u32 depth) const { return levelStarts[depth]; }
+        u32 getLevelEnd(u32 depth) const { return levelStarts[depth + 1]; }
+        // Nodes whose world matrix or bounds were recomputed by the last update().
+        u32 getChangedCount() const { return changedCount; }
+        // Bumped whenever update() re-sorts, invalidating dense indices held elsewhere.
+        u32 getLayoutVersion() const { return layoutVersion; }
+
+        // Dense views, valid until the next update(). Indices are dense indices.
+        const NodeHandle* getHandles() const { return handles.data(); }
+        const u32* getParents() const { return parents.data(); }
+        const Math::Mat4* getWorldMatrices() const { return worlds.data(); }
+        const RenderData* getRenderData() const { return renderData.data(); }
+        const u8* getFlags() const { return flags.data(); }
+        Math::BoundsSoA getWorldBounds();
+
+        // Dense index of the node, or NoParent for stale handles. Valid until the next update().
+        u32 indexOf(NodeHandle) const;
+        bool contains(NodeHandle handle) const { return indices.contains(handle); }
+
+        NodeHandle create(const Transform& = Transform(), NodeHandle parent = NodeHandle());
+        // Destroys the node and every descendant.
+        void destroy(NodeHandle);
+        // Fails (returning false) for stale handles and when parent is a descendant of node.
+        bool setParent(NodeHandle node, NodeHandle parent);
+
+        void setTransform(NodeHandle, const Transform&);
+        const Transform* getTransform(NodeHandle) const;
+        // World matrix as of the last update().
+        const Math::Mat4* getWorldMatrix(NodeHandle) const;
+        void setLocalBounds(NodeHandle, const Math::AABB&);
+        void setRenderData(NodeHandle, const RenderData&);
+
+        // Applies structural changes, then recomputes world matrices and bounds for everything
+        // under a changed transform.
+        void update();
+
+    private:
+        void markDirty(u32 index);
+        u32 levelOf(u32 index) const;
+        void relayout();
+        void propagate();
+
+    public:
+        Scene();
+    };
+} // namespace Engine
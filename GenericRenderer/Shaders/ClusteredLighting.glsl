@@ -0,0 +1,97 @@
+// Clustered forward lighting: the buffers written by ClusterBinning.comp, and the cluster
+// lookup and light loop for lit shaders. The layouts mirror DaedalusClusters.cpp.
+//
+// Define CLUSTER_SET to the descriptor set Clusters::getSet() is bound at (default 0).
+
+#ifndef CLUSTERED_LIGHTING_GLSL
+#define CLUSTERED_LIGHTING_GLSL
+
+#ifndef CLUSTER_SET
+#define CLUSTER_SET 0
+#endif
+#ifndef CLUSTER_LIST_ACCESS
+#define CLUSTER_LIST_ACCESS readonly
+#endif
+
+const uint LightPoint = 0;
+const uint LightSpot = 1;
+
+// View space.
+struct ClusterLight
+{
+    vec3 position;
+    float range;
+    vec3 color;
+    uint type;
+    vec3 direction;
+    float cosOuter;
+    float cosInner;
+    float pad0;
+    float pad1;
+    float pad2;
+};
+
+layout(set = CLUSTER_SET, binding = 0, std430) readonly buffer ClusterLights
+{
+    // x, y and z cluster counts, and the capacity of each cluster's list.
+    uvec4 clusterGrid;
+    // Tangents of the half field of view, and the near and far planes.
+    vec4 clusterView;
+    // Viewport size, and the scale and bias taking log(depth) to a depth slice.
+    vec4 clusterScreen;
+    // x: the number of lights.
+    uvec4 clusterLightCount;
+    ClusterLight clusterLights[];
+};
+
+layout(set = CLUSTER_SET, binding = 1, std430) CLUSTER_LIST_ACCESS buffer ClusterCounts
+{
+    uint clusterListCounts[];
+};
+
+// clusterGrid.w light indices per cluster.
+layout(set = CLUSTER_SET, binding = 2, std430) CLUSTER_LIST_ACCESS buffer ClusterLists
+{
+    uint clusterLists[];
+};
+
+// viewDepth is positive in front of the camera.
+uint clusterIndex(vec2 fragCoord, float viewDepth)
+{
+    uvec3 grid = clusterGrid.xyz;
+    uvec2 tile = min(uvec2(fragCoord / clusterScreen.xy * vec2(grid.xy)), grid.xy - 1);
+    float slice = log(max(viewDepth, clusterView.z)) * clusterScreen.z + clusterScreen.w;
+    uint z = min(uint(max(slice, 0.0)), grid.z - 1);
+    return (z * grid.y + tile.y) * grid.x + tile.x;
+}
+
+// Radiance arriving at viewPos from the light, times n.l: inverse square falloff windowed to
+// reach zero at the range, and a smooth edge between a spot's cone angles.
+vec3 clusterLightRadiance(ClusterLight light, vec3 viewPos, vec3 normal)
+{
+    vec3 toLight = light.position - viewPos;
+    float distance2 = max(dot(toLight, toLight), 1e-4);
+    vec3 l = toLight * inversesqrt(distance2);
+    float ratio = distance2 / (light.range * light.range);
+    float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+    float attenuation = window * window / distance2;
+    if (light.type == LightSpot) {
+        attenuation *= smoothstep(light.cosOuter, light.cosInner, dot(-l, light.direction));
+    }
+    return light.color * (attenuation * max(dot(normal, l), 0.0));
+}
+
+// Diffuse lighting from every light in the fragment's cluster. Shaders with other BRDFs
+// loop over clusterLists the same way.
+vec3 shadeClustered(vec2 fragCoord, vec3 viewPos, vec3 normal)
+{
+    uint cluster = clusterIndex(fragCoord, -viewPos.z);
+    uint count = clusterListCounts[cluster];
+    uint base = cluster * clusterGrid.w;
+    vec3 result = vec3(0.0);
+    for (uint i = 0; i < count; i++)
+        result += clusterLightRadiance(clusterLights[clusterLists[base + i]], viewPos, normal);
+    return result;
+}
+
+#endif // CLUSTERED_LIGHTING_GLSL
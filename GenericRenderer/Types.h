@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cstdint>
+
 /*
 * Modern integer type naming (c.2025), for brevity and legibility.
 */
+using u8 = unsigned char;
+using i8 = signed char;
 using u16 = unsigned short;
 using i16 = short;
 using u32 = unsigned int;
 using i32 = int;
-using u64 = unsigned long;
-using i64 = long;
+// 64-bit types use the fixed-width aliases; long is only 32 bits wide on Windows.
+using u64 = std::uint64_t;
+using i64 = std::int64_t;
 
 /*
 * Convenient types for brevity, legibility, and to ascertain unicode-16-ness.
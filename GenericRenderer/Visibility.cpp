@@ -0,0 +1,430 @@
+#include "Precompiled.h"
+
+#include "Visibility.h"
+#include "JobSystem.h"
+#include "RadixSort.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+namespace Engine::Visibility
+{
+    using namespace Engine::Math;
+
+    // Smallest subtree cull() hands to a job.
+    const u32 MinSubtreeSize = 1024;
+
+    View View::fromCamera(
+        const Mat4& view, const Mat4& proj, Vec3 eye, float viewportHeight, float errorThreshold)
+    {
+        auto result = View();
+        result.frustum = Frustum::fromMatrix(proj * view);
+        result.eye = eye;
+        // proj[1][1] is 1 / tan(fovY / 2), negated for Vulkan's y-down clip space.
+        result.projectionScale = std::fabs(proj.cols[1].y) * viewportHeight * 0.5f;
+        result.errorThreshold = errorThreshold;
+        return result;
+    }
+
+    Objects Objects::fromScene(Scene& scene, const LodChain* chains, u32 chainCount)
+    {
+        auto objects = Objects();
+        objects.count = scene.size();
+        objects.bounds = scene.getWorldBounds();
+        objects.worlds = scene.getWorldMatrices();
+        objects.renderData = scene.getRenderData();
+        objects.chains = chains;
+        objects.chainCount = chainCount;
+        return objects;
+    }
+
+    // Spreads the low 10 bits of v out to every third bit.
+    u32 spreadBits(u32 v)
+    {
+        v &= 0x3ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // Nodes in the tree over count items; splits are always at the median.
+    u32 nodeCount(u32 count)
+    {
+        if (count <= Bvh::MaxLeafSize) return 1;
+        return 1 + nodeCount(count / 2) + nodeCount(count - count / 2);
+    }
+
+    float surfaceArea(const Bvh::Node& node)
+    {
+        auto e = node.max - node.min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    // Largest axis scale of the object's world matrix, which LOD errors are scaled by.
+    float worldScale(const Objects& objects, u32 object)
+    {
+        if (objects.worlds == nullptr) return 1.0f;
+        auto& m = objects.worlds[object];
+        auto x = m.cols[0].xyz(), y = m.cols[1].xyz(), z = m.cols[2].xyz();
+        return std::sqrt(std::max(dot(x, x), std::max(dot(y, y), dot(z, z))));
+    }
+
+    // The coarsest LOD whose projected error stays within the view's threshold.
+    u32 selectLod(const View& view, Vec3 center, Vec3 extent, float scale, const LodChain& chain)
+    {
+        auto distance = length(center - view.eye) - length(extent);
+        if (distance <= 0.0f || chain.count <= 1) return 0;
+
+        // Screen-space error is error * scale * projectionScale / distance.
+        auto pixelsPerUnit = scale * view.projectionScale;
+        auto limit = view.errorThreshold * distance;
+        for (auto k = std::min(chain.count, MaxLods) - 1; k > 0; k--) {
+            if (chain.error[k] * pixelsPerUnit <= limit) return k;
+        }
+        return 0;
+    }
+
+    void Bvh::build(const Objects& objects)
+    {
+        auto count = objects.count;
+        nodes.assign(count > 0 ? nodeCount(count) : 0, Node());
+        dirty.assign(nodes.size(), 0);
+        items.resize(count);
+        slots.resize(count);
+        leafOf.resize(count);
+        for (auto& component : slotBounds)
+            component.resize(count);
+        hasCones = objects.cones.axisX != nullptr;
+        for (auto& component : slotCones)
+            component.resize(hasCones ? count : 0);
+        slotScales.resize(count);
+        slotMasks.resize(count);
+        slotMeshes.resize(count);
+        leaves.clear();
+        subtrees.clear();
+        builtCost = cost = 0.0f;
+        if (count == 0) return;
+
+        // Sorting along a Morton curve puts nearby objects in nearby slots, so splitting each
+        // range at its median gives a spatially coherent tree without partitioning per node.
+        auto& b = objects.bounds;
+        auto lo = Vec3{ FLT_MAX, FLT_MAX, FLT_MAX };
+        auto hi = Vec3{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (auto i = 0u; i < count; i++) {
+            auto c = Vec3{ b.centerX[i], b.centerY[i], b.centerZ[i] };
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+        auto spread = hi - lo;
+        auto quantize = Vec3{ spread.x > 0.0f ? 1023.0f / spread.x : 0.0f,
+            spread.y > 0.0f ? 1023.0f / spread.y : 0.0f,
+            spread.z > 0.0f ? 1023.0f / spread.z : 0.0f };
+        buildKeys.resize(count);
+        buildScratch.resize(count);
+        Jobs::parallelFor(count, 16384, [&](u32 begin, u32 end) {
+            for (auto i = begin; i < end; i++) {
+                auto x = (u32)((b.centerX[i] - lo.x) * quantize.x);
+                auto y = (u32)((b.centerY[i] - lo.y) * quantize.y);
+                auto z = (u32)((b.centerZ[i] - lo.z) * quantize.z);
+                auto code = spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+                buildKeys[i] = ((u64)code << 32) | i;
+            }
+        });
+        // By the 30 code bits; the sort is stable, so equal codes stay in index order.
+        Sort::radixSort(buildKeys, buildScratch, 32, 62);
+        buildRange(0, 0, count);
+
+        for (auto s = 0u; s < count; s++) {
+            items[s] = (u32)buildKeys[s];
+            slots[items[s]] = s;
+        }
+        // One array at a time, so each gather reads from a single source.
+        auto& c = objects.cones;
+        const float* sources[] = { b.centerX, b.centerY, b.centerZ, b.extentX, b.extentY,
+            b.extentZ, c.axisX, c.axisY, c.axisZ, c.cutoff };
+        for (auto k = 0u; k < (hasCones ? 10u : 6u); k++) {
+            auto source = sources[k];
+            auto target = k < 6 ? slotBounds[k].data() : slotCones[k - 6].data();
+            Jobs::parallelFor(count, 16384, [this, source, target](u32 begin, u32 end) {
+                for (auto s = begin; s < end; s++)
+                    target[s] = source[items[s]];
+            });
+        }
+        Jobs::parallelFor(count, 16384, [this, &objects](u32 begin, u32 end) {
+            for (auto s = begin; s < end; s++) {
+                slotScales[s] = worldScale(objects, items[s]);
+                copyRenderData(objects, items[s], s);
+            }
+        });
+        for (auto i = 0u; i < nodes.size(); i++) {
+            if (nodes[i].count > MaxLeafSize) continue;
+            leaves.push_back(i);
+            for (auto s = nodes[i].first; s < nodes[i].first + nodes[i].count; s++)
+                leafOf[s] = i;
+        }
+        Jobs::parallelFor((u32)leaves.size(), 1024, [this](u32 begin, u32 end) {
+            for (auto l = begin; l < end; l++)
+                fitLeaf(leaves[l]);
+        });
+        for (auto i = (u32)nodes.size(); i-- > 0;)
+            cost += nodes[i].count > MaxLeafSize ? fitInterior(i) : surfaceArea(nodes[i]);
+        builtCost = cost;
+
+        // Split until subtrees are small enough to balance across the workers.
+        auto grain = std::max(count / 64, MinSubtreeSize);
+        auto stack = List<u32>{ 0 };
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            auto& n = nodes[node];
+            if (n.count <= grain || n.count <= MaxLeafSize) {
+                subtrees.push_back(node);
+                continue;
+            }
+            stack.push_back(n.right);
+            stack.push_back(node + 1);
+        }
+        partials.resize(subtrees.size());
+    }
+
+    void Bvh::buildRange(u32 node, u32 begin, u32 end)
+    {
+        auto& n = nodes[node];
+        n.first = begin;
+        n.count = end - begin;
+        if (n.count <= MaxLeafSize) return;
+
+        auto mid = begin + n.count / 2;
+        n.right = node + 1 + nodeCount(mid - begin);
+        buildRange(node + 1, begin, mid);
+        buildRange(n.right, mid, end);
+    }
+
+    void Bvh::copySlot(const Objects& objects, u32 object, u32 slot)
+    {
+        auto& b = objects.bounds;
+        slotBounds[0][slot] = b.centerX[object];
+        slotBounds[1][slot] = b.centerY[object];
+        slotBounds[2][slot] = b.centerZ[object];
+        slotBounds[3][slot] = b.extentX[object];
+        slotBounds[4][slot] = b.extentY[object];
+        slotBounds[5][slot] = b.extentZ[object];
+        if (hasCones) {
+            auto& c = objects.cones;
+            slotCones[0][slot] = c.axisX[object];
+            slotCones[1][slot] = c.axisY[object];
+            slotCones[2][slot] = c.axisZ[object];
+            slotCones[3][slot] = c.cutoff[object];
+        }
+        slotScales[slot] = worldScale(objects, object);
+        copyRenderData(objects, object, slot);
+    }
+
+    void Bvh::copyRenderData(const Objects& objects, u32 object, u32 slot)
+    {
+        auto data = objects.renderData != nullptr ? objects.renderData[object] : RenderData();
+        slotMasks[slot] = data.viewMask;
+        slotMeshes[slot] = data.mesh;
+    }
+
+    void Bvh::fitLeaf(u32 node)
+    {
+        auto& n = nodes[node];
+        n.min = { FLT_MAX, FLT_MAX, FLT_MAX };
+        n.max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for (auto s = n.first; s < n.first + n.count; s++) {
+            auto c = Vec3{ slotBounds[0][s], slotBounds[1][s], slotBounds[2][s] };
+            auto e = Vec3{ slotBounds[3][s], slotBounds[4][s], slotBounds[5][s] };
+            n.min = min(n.min, c - e);
+            n.max = max(n.max, c + e);
+        }
+    }
+
+    float Bvh::fitInterior(u32 node)
+    {
+        auto& n = nodes[node];
+        auto& left = nodes[node + 1];
+        auto& right = nodes[n.right];
+        n.min = min(left.min, right.min);
+        n.max = max(left.max, right.max);
+        return surfaceArea(n);
+    }
+
+    void Bvh::refit(const Objects& objects, const u8* flags, u8 mask)
+    {
+        if (objects.count != items.size() || (objects.cones.axisX != nullptr) != hasCones) {
+            Engine::Debug::Log("Refitting a BVH over a different object set; rebuilding.\n");
+            build(objects);
+            return;
+        }
+
+        // Scanned in object order, so only moved objects are touched in the slot arrays.
+        // Objects sharing a leaf may mark it from different jobs, hence the atomic stores.
+        if (flags != nullptr) {
+            Jobs::parallelFor(objects.count, 16384, [&](u32 begin, u32 end) {
+                for (auto i = begin; i < end; i++) {
+                    if (!(flags[i] & mask)) continue;
+                    copySlot(objects, i, slots[i]);
+                    std::atomic_ref(dirty[leafOf[slots[i]]]).store(1, std::memory_order_relaxed);
+                }
+            });
+        } else {
+            Jobs::parallelFor(objects.count, 16384, [&](u32 begin, u32 end) {
+                for (auto s = begin; s < end; s++)
+                    copySlot(objects, items[s], s);
+            });
+            std::fill(dirty.begin(), dirty.end(), 1);
+        }
+        Jobs::parallelFor((u32)leaves.size(), 1024, [this](u32 begin, u32 end) {
+            for (auto l = begin; l < end; l++) {
+                if (dirty[leaves[l]]) {
+                    fitLeaf(leaves[l]);
+                }
+            }
+        });
+
+        // Children follow their parent, so one reverse pass refits every child first.
+        cost = 0.0f;
+        for (auto i = (u32)nodes.size(); i-- > 0;) {
+            auto& n = nodes[i];
+            if (n.count > MaxLeafSize && (dirty[i + 1] || dirty[n.right])) {
+                fitInterior(i);
+                dirty[i] = 1;
+                dirty[i + 1] = 0;
+                dirty[n.right] = 0;
+            }
+            cost += surfaceArea(n);
+        }
+        if (!nodes.empty()) {
+            dirty[0] = 0;
+        }
+    }
+
+    u32 Bvh::cull(const View& view, const Objects& objects, VisibleList& out)
+    {
+        Jobs::parallelFor((u32)subtrees.size(), 1, [&](u32 begin, u32 end) {
+            for (auto i = begin; i < end; i++)
+                cullSubtree(subtrees[i], view, objects, partials[i]);
+        });
+
+        // Subtrees are in depth-first order, so the result is too.
+        auto offsets = List<u32>(partials.size() + 1, 0);
+        for (auto i = 0u; i < partials.size(); i++)
+            offsets[i + 1] = offsets[i] + partials[i].size();
+        out.objects.resize(offsets.back());
+        out.lods.resize(offsets.back());
+        Jobs::parallelFor((u32)partials.size(), 1, [&](u32 begin, u32 end) {
+            for (auto i = begin; i < end; i++) {
+                auto& partial = partials[i];
+                std::copy(partial.objects.begin(), partial.objects.end(),
+                    out.objects.begin() + offsets[i]);
+                std::copy(partial.lods.begin(), partial.lods.end(), out.lods.begin() + offsets[i]);
+            }
+        });
+        return out.size();
+    }
+
+    Math::BoundsSoA Bvh::getSlotBounds(u32 first)
+    {
+        auto bounds = BoundsSoA();
+        bounds.centerX = slotBounds[0].data() + first;
+        bounds.centerY = slotBounds[1].data() + first;
+        bounds.centerZ = slotBounds[2].data() + first;
+        bounds.extentX = slotBounds[3].data() + first;
+        bounds.extentY = slotBounds[4].data() + first;
+        bounds.extentZ = slotBounds[5].data() + first;
+        return bounds;
+    }
+
+    void Bvh::cullSubtree(u32 root, const View& view, const Objects& objects, VisibleList& out)
+    {
+        struct Entry
+        {
+            u32 node;
+            // Planes the node still straddles; the rest it is entirely inside of.
+            u32 planes;
+        };
+
+        // Collects slots; finish() turns them into objects.
+        out.objects.clear();
+        out.lods.clear();
+        thread_local List<Entry> stack;
+        stack.clear();
+        stack.push_back({ root, (1u << Frustum::Count) - 1 });
+        while (!stack.empty()) {
+            auto entry = stack.back();
+            stack.pop_back();
+            auto& n = nodes[entry.node];
+            auto c = (n.min + n.max) * 0.5f;
+            auto e = (n.max - n.min) * 0.5f;
+            auto outside = false;
+            for (auto p = 0u; p < Frustum::Count && !outside; p++) {
+                if (!(entry.planes & (1u << p))) continue;
+                auto& plane = view.frustum.planes[p];
+                auto d = plane.distance(c);
+                auto r = dot(abs(plane.normal), e);
+                outside = d < -r;
+                if (d >= r) {
+                    entry.planes &= ~(1u << p);
+                }
+            }
+            if (outside) continue;
+
+            auto begin = (u32)out.objects.size();
+            if (entry.planes == 0) {
+                out.objects.resize(begin + n.count);
+                for (auto k = 0u; k < n.count; k++)
+                    out.objects[begin + k] = n.first + k;
+            } else if (n.count <= MaxLeafSize) {
+                u32 visible[MaxLeafSize];
+                auto count = cullBounds(view.frustum, getSlotBounds(n.first), n.count, visible);
+                for (auto k = 0u; k < count; k++)
+                    out.objects.push_back(n.first + visible[k]);
+            } else {
+                stack.push_back({ n.right, entry.planes });
+                stack.push_back({ entry.node + 1, entry.planes });
+                continue;
+            }
+            finish(view, objects, out, begin);
+        }
+    }
+
+    // Applies the per-object tests to the slots in out.objects[begin, end), replacing them
+    // with the objects that pass, and picks their LODs.
+    void Bvh::finish(const View& view, const Objects& objects, VisibleList& out, u32 begin)
+    {
+        auto ids = out.objects.data() + begin;
+        auto count = (u32)out.objects.size() - begin;
+        auto bounds = getSlotBounds(0);
+        if (hasCones) {
+            auto cones = ConesSoA{ slotCones[0].data(), slotCones[1].data(),
+                slotCones[2].data(), slotCones[3].data() };
+            count = cullCones(view.eye, bounds, cones, ids, count, ids);
+        }
+
+        out.lods.resize(begin + count);
+        auto kept = 0u;
+        for (auto i = 0u; i < count; i++) {
+            auto slot = ids[i];
+            if (!(slotMasks[slot] & view.viewMask)) continue;
+            auto lod = 0u;
+            auto mesh = slotMeshes[slot];
+            if (mesh < objects.chainCount) {
+                auto center = Vec3{
+                    bounds.centerX[slot], bounds.centerY[slot], bounds.centerZ[slot] };
+                auto extent = Vec3{
+                    bounds.extentX[slot], bounds.extentY[slot], bounds.extentZ[slot] };
+                lod = selectLod(view, center, extent, slotScales[slot], objects.chains[mesh]);
+            }
+            ids[kept] = items[slot];
+            out.lods[begin + kept] = (u8)lod;
+            kept++;
+        }
+        out.objects.resize(begin + kept);
+        out.lods.resize(begin + kept);
+    }
+} // namespace Engine::Visibility
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "MathKernels.h"
+#include "Scene.h"
+
+/// CPU visibility: BVH frustum culling, normal cone culling and LOD selection.
+///
+/// The fallback for devices (and tools) without GPU-driven culling, and the reference the GPU
+/// path is checked against. A Bvh is built once over an object set and refit as objects move;
+/// cull() walks it in parallel subtrees, tests partially visible leaves with the batched
+/// kernels in MathKernels.h, and writes a compact list of visible objects with a chosen LOD
+/// each. Objects are identified by index, e.g. a Scene's dense index.
+namespace Engine::Visibility
+{
+    static const u32 MaxLods = 8;
+
+    // Per mesh: the geometric error of each LOD in mesh units, finest (LOD 0) first.
+    struct LodChain
+    {
+        u32 count = 1;
+        float error[MaxLods] = {};
+    };
+
+    struct View
+    {
+        Math::Frustum frustum;
+        Math::Vec3 eye;
+        // Pixels per world unit at a distance of 1, i.e. viewport height / (2 tan(fovY / 2)).
+        float projectionScale = 1.0f;
+        // Largest screen-space error, in pixels, a LOD may have to be picked.
+        float errorThreshold = 1.0f;
+        // Objects whose RenderData::viewMask shares no bit with this are skipped.
+        u32 viewMask = UINT32_MAX;
+
+        static View fromCamera(const Math::Mat4& view, const Math::Mat4& proj, Math::Vec3 eye,
+            float viewportHeight, float errorThreshold = 1.0f);
+    };
+
+    // Per-object inputs, indexed by object. Only bounds is required. Everything but the LOD
+    // chains is copied into the Bvh by build() and refit(), so edits need a refit to show.
+    struct Objects
+    {
+        u32 count = 0;
+        Math::BoundsSoA bounds;
+        // World matrices, for the scale applied to LOD errors.
+        const Math::Mat4* worlds = nullptr;
+        // View masks, and the mesh whose LOD chain is used.
+        const RenderData* renderData = nullptr;
+        const LodChain* chains = nullptr;
+        u32 chainCount = 0;
+        // Normal cones; skipped when axisX is null.
+        Math::ConesSoA cones;
+
+        static Objects fromScene(Scene&, const LodChain* chains = nullptr, u32 chainCount = 0);
+    };
+
+    struct VisibleList
+    {
+        List<u32> objects;
+        // LOD per entry in objects.
+        List<u8> lods;
+
+        u32 size() const { return (u32)objects.size(); }
+    };
+
+    class Bvh
+    {
+    public:
+        static const u32 MaxLeafSize = 16;
+
+        struct Node
+        {
+            Math::Vec3 min;
+            // Every node covers the contiguous item slots [first, first + count).
+            u32 first = 0;
+            Math::Vec3 max;
+            // Nodes with at most MaxLeafSize items are leaves.
+            u32 count = 0;
+            // Right child of interior nodes; the left child directly follows its parent.
+            u32 right = 0;
+        };
+
+    private:
+        // Depth-first, so children always come after their parent.
+        List<Node> nodes;
+        List<u32> leaves;
+        // Object per item slot, and the reverse.
+        List<u32> items;
+        List<u32> slots;
+        // Leaf node per slot.
+        List<u32> leafOf;
+        // Per-object data in slot order, so leaves are contiguous ranges for the kernels and
+        // visible objects aren't gathered from all over the object arrays.
+        List<float> slotBounds[6];
+        List<float> slotCones[4];
+        List<float> slotScales;
+        List<u32> slotMasks;
+        List<u32> slotMeshes;
+        // Morton code << 32 | object, sorted by build().
+        List<u64> buildKeys;
+        List<u64> buildScratch;
+        bool hasCones = false;
+        List<u8> dirty;
+        // Roots of the subtrees cull() spreads across jobs.
+        List<u32> subtrees;
+        List<VisibleList> partials;
+        // Summed node surface area, after build() and after the last refit().
+        float builtCost = 0.0f;
+        float cost = 0.0f;
+
+    public:
+        u32 getNodeCount() const { return (u32)nodes.size(); }
+        u32 getObjectCount() const { return (u32)items.size(); }
+        const Node* getNodes() const { return nodes.data(); }
+        // Refits loosen the tree; past some point a rebuild culls faster than it costs.
+        bool needsRebuild() const { return cost > builtCost * 1.5f; }
+
+        // Orders objects along a Morton curve and splits ranges at their median, so building
+        // is a radix sort plus linear passes.
+        void build(const Objects&);
+        /// <summary>
+        /// Updates bounds after objects moved. With flags, only objects with a bit of mask set
+        /// (e.g. Scene::Changed) are read. The object set must match the last build(); rebuild
+        /// when it changes, e.g. when Scene::getLayoutVersion() moves.
+        /// </summary>
+        void refit(const Objects&, const u8* flags = nullptr, u8 mask = 0);
+        // Replaces out with the visible objects and returns how many there are.
+        u32 cull(const View&, const Objects&, VisibleList& out);
+
+    private:
+        void buildRange(u32 node, u32 begin, u32 end);
+        void copySlot(const Objects&, u32 object, u32 slot);
+        void copyRenderData(const Objects&, u32 object, u32 slot);
+        void fitLeaf(u32 node);
+        float fitInterior(u32 node);
+        void cullSubtree(u32 root, const View&, const Objects&, VisibleList& out);
+        Math::BoundsSoA getSlotBounds(u32 first);
+        void finish(const View&, const Objects&, VisibleList& out, u32 begin);
+    };
+} // namespace Engine::Visibility
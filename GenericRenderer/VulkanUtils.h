@@ -1,12 +1,16 @@
 ﻿#pragma once
 
-#include "Utils.h"
+#include <algorithm>
+#include <iterator>
 
 #include <vulkan/vulkan.hpp>
 
 namespace Engine::Daedalus::VkUtil
 {
-    inline String horizontalLine(
+    using TextBuffer = Format::Buffer<char16_t>;
+
+    inline void horizontalLine(
+        TextBuffer& out,
         char16_t lc, // left cross
         char16_t mc, // middle cross
         char16_t rc, // right cross
@@ -14,53 +18,58 @@ namespace Engine::Daedalus::VkUtil
         u64 cwidth,
         u64 ccount)
     {
-        String str = String(1, lc);
-
+        out.push(lc);
         for (auto i = 0u; i < ccount; i++) {
-            str += String(cwidth, span) + String(1, mc);
+            out.append(span, cwidth);
+            out.push(i + 1 < ccount ? mc : rc);
         }
-        str[str.size() - 1] = rc;
-        str.push_back(u'\n');
-        return str;
+        out.push(u'\n');
     }
 
-    String getQueueFamilyPropertiesPrettyString(
-        vk::PhysicalDevice gpu,
-        vk::SurfaceKHR surface = VK_NULL_HANDLE)
+    inline ustr to_ustr(vk::PhysicalDeviceType type)
     {
-        using namespace StrUtil;
+        switch (type) {
+        case vk::PhysicalDeviceType::eIntegratedGpu:
+            return u"IntegratedGpu";
+        case vk::PhysicalDeviceType::eDiscreteGpu:
+            return u"DiscreteGpu";
+        case vk::PhysicalDeviceType::eVirtualGpu:
+            return u"VirtualGpu";
+        case vk::PhysicalDeviceType::eCpu:
+            return u"Cpu";
+        default:
+            return u"Other";
+        }
+    }
 
-        String str;
-        // Begin queue family table.
-        auto props = gpu.getQueueFamilyProperties();
+    inline void writeQueueFamilyTable(
+        TextBuffer& out,
+        const List<vk::QueueFamilyProperties>& props,
+        const vk::Bool32* supportsPresent = nullptr)
+    {
+        using Format::Align;
+        using Format::appendPadded;
 
         // Setup header labels.
-        List<ustr> labelLiterals;
-        labelLiterals.push_back(u"idx");
-        labelLiterals.push_back(u"Graphics");
-        labelLiterals.push_back(u"Compute");
-        labelLiterals.push_back(u"Transfer");
-        labelLiterals.push_back(u"SparseBind");
-        labelLiterals.push_back(u"Protected");
-        labelLiterals.push_back(u"Vid-Dec");
-        labelLiterals.push_back(u"Vid-Enc");
-        labelLiterals.push_back(u"OpticalNV");
-        if (surface != VK_NULL_HANDLE) {
-            labelLiterals.push_back(u"Present");
+        ustr labels[] = {
+            u"idx",
+            u"Graphics",
+            u"Compute",
+            u"Transfer",
+            u"SparseBind",
+            u"Protected",
+            u"Vid-Dec",
+            u"Vid-Enc",
+            u"OpticalNV",
+            u"Present",
+        };
+        auto colCount = (u64)std::size(labels) - (supportsPresent != nullptr ? 0 : 1);
+        auto maxlen = (u64)0;
+        for (auto i = 0u; i < colCount; i++) {
+            maxlen = std::max(maxlen, Format::length(labels[i]));
         }
-        auto maxlen = 0u;
-        for (auto& literal : labelLiterals) {
-            auto cur = len(literal);
-            if (cur > maxlen) {
-                maxlen = cur;
-            }
-        }
-        List<String> labelStrings;
-        auto spanWidth = maxlen + 2;
-        for(auto& literal : labelLiterals) {
-            labelStrings.push_back(pad(String(literal), spanWidth, Alignment::Center));
-        }
-        
+        auto colWidth = maxlen + 2;
+
         auto tl = u'┌';
         auto tc = u'┬';
         auto tr = u'┐';
@@ -72,83 +81,96 @@ namespace Engine::Daedalus::VkUtil
         auto br = u'┘';
         auto v = u'│';
         auto h = u'─';
-        auto y = u'●';
-        auto n = u'‐';
-
-        auto yea = pad(String(1, y), spanWidth, Alignment::Center);
-        auto nay = pad(String(1, n), spanWidth, Alignment::Center);
+        auto y = std::u16string_view(u"●");
+        auto n = std::u16string_view(u"‐");
 
         // Top edge.
-        auto colWidth = (u64)labelStrings[0].length();
-        auto colCount = (u64)labelStrings.size();
-        str += horizontalLine(tl, tc, tr, h, colWidth, colCount);
+        horizontalLine(out, tl, tc, tr, h, colWidth, colCount);
 
         // Header labels.
-        for (auto& column : labelStrings) {
-            str.push_back(v);
-            str += column;
+        for (auto i = 0u; i < colCount; i++) {
+            out.push(v);
+            appendPadded<char16_t>(out, labels[i], colWidth, Align::Center);
         }
-        str.push_back(v);
-        str.push_back(u'\n');
+        out.push(v);
+        out.push(u'\n');
 
         // Middle edge.
-        str += horizontalLine(lc, t, rc, h, colWidth, colCount);
+        horizontalLine(out, lc, t, rc, h, colWidth, colCount);
 
         // Add a row for each queue family on the GPU.
-        for (auto i = 0; i < props.size(); i++) {
+        for (auto i = 0u; i < props.size(); i++) {
             using flags = vk::QueueFlagBits;
-            auto& prop = props[i];
-            auto idxStr = Convert::atou(Convert::itoa(i));
-
-            str += String(1, v) + pad(String(idxStr), spanWidth, Alignment::Center);
-            str += String(1, v) + ((prop.queueFlags & flags::eGraphics) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eCompute) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eTransfer) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eSparseBinding) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eProtected) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eVideoDecodeKHR) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eVideoEncodeKHR) ? yea : nay);
-            str += String(1, v) + ((prop.queueFlags & flags::eOpticalFlowNV) ? yea : nay);
-            if (surface != VK_NULL_HANDLE) {
-                auto surfaceSupport = gpu.getSurfaceSupportKHR(i, surface);
-                str += String(1, v) + ((surfaceSupport) ? yea : nay);
+            auto& queueFlags = props[i].queueFlags;
+            auto cell = [&](bool set) {
+                out.push(v);
+                appendPadded(out, set ? y : n, colWidth, Align::Center);
+            };
+
+            out.push(v);
+            auto idx = Format::StackBuffer<char16_t, 16>();
+            Format::formatTo(idx, u"{}", i);
+            appendPadded(out, idx.view(), colWidth, Align::Center);
+            cell((bool)(queueFlags & flags::eGraphics));
+            cell((bool)(queueFlags & flags::eCompute));
+            cell((bool)(queueFlags & flags::eTransfer));
+            cell((bool)(queueFlags & flags::eSparseBinding));
+            cell((bool)(queueFlags & flags::eProtected));
+            cell((bool)(queueFlags & flags::eVideoDecodeKHR));
+            cell((bool)(queueFlags & flags::eVideoEncodeKHR));
+            cell((bool)(queueFlags & flags::eOpticalFlowNV));
+            if (supportsPresent != nullptr) {
+                cell(supportsPresent[i]);
             }
-            str.push_back(v);
-            str.push_back(u'\n');
+            out.push(v);
+            out.push(u'\n');
 
             // Middle or bottom edge.
-            auto l = i == props.size() - 1 ? bl : lc;
-            auto c = i == props.size() - 1 ? bc : t;
-            auto r = i == props.size() - 1 ? br : rc;
-            str += horizontalLine(l, c, r, h, colWidth, colCount);
+            auto last = i == props.size() - 1;
+            horizontalLine(out, last ? bl : lc, last ? bc : t, last ? br : rc, h,
+                colWidth, colCount);
         }
-
-        return str;
     }
 
     /// <summary>
-    /// Builds a pretty string describing physical device properties.
+    /// Writes a pretty description of physical device properties into out.
     /// 
     /// QueueFamily flags are displayed in a neat table.
     /// 
-    /// If a Surface is provided, the returned string will also display whether or not
-    /// the queue families also support present.
+    /// If per-family present support is provided, the table will also display
+    /// whether or not the queue families also support present.
+    /// Takes already-queried properties so printing doesn't repeat device queries.
     /// </summary>
-    /// <param name="gpu">A vk::PhysicalDevice object.</param>
-    /// <param name="surface">(Optional) A vk::SurfaceKHR to test for Queue support.</param>
-    /// <returns></returns>
-    String to_prettyString(vk::PhysicalDevice gpu, vk::SurfaceKHR surface = VK_NULL_HANDLE)
+    /// <param name="out">The buffer to write into.</param>
+    /// <param name="props">The physical device's properties.</param>
+    /// <param name="families">The physical device's queue family properties.</param>
+    /// <param name="supportsPresent">(Optional) Per-family present support for a surface.</param>
+    inline void writePrettyString(
+        TextBuffer& out,
+        const vk::PhysicalDeviceProperties& props,
+        const List<vk::QueueFamilyProperties>& families,
+        const vk::Bool32* supportsPresent = nullptr)
     {
-            auto props = gpu.getProperties();
-
-            auto name = String(Convert::atou(props.deviceName));
-            auto type = String(Convert::atou(vk::to_string(props.deviceType)));
-
-            auto str = String(u"");
-            str += String(u"Physical Device: ") + name + String(u"\n");
-            str += String(u"Device Type: ") + type + String(u"\n");
+        Format::formatTo(out, u"Physical Device: {}\nDevice Type: {}\n",
+            props.deviceName.data(), to_ustr(props.deviceType));
+        writeQueueFamilyTable(out, families, supportsPresent);
+    }
 
-            str += getQueueFamilyPropertiesPrettyString(gpu, surface);
-            return str;
+    /// <summary>
+    /// Finds a memory type index allowed by typeBits which has all of the requested properties.
+    /// </summary>
+    /// <returns>The memory type index, or UINT32_MAX if no type qualifies.</returns>
+    inline u32 findMemoryType(
+        const vk::PhysicalDeviceMemoryProperties& memProps,
+        u32 typeBits,
+        vk::MemoryPropertyFlags props)
+    {
+        for (auto i = 0u; i < memProps.memoryTypeCount; i++) {
+            auto allowed = (typeBits & (1u << i)) != 0;
+            if (allowed && (memProps.memoryTypes[i].propertyFlags & props) == props) {
+                return i;
+            }
+        }
+        return UINT32_MAX;
     }
-}
+}
\ No newline at end of file
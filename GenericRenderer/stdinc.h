@@ -4,10 +4,15 @@
 /// external dependencies.
 
 #include <array>
+#include <memory_resource>
 #include <vector>
 #include <string>
 
 #if defined(_WINDOWS)
+// Keeps Windows.h from defining min and max macros, which break std::min and std::max.
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
 #include <Windows.h>
 #endif
 
@@ -16,8 +21,8 @@
 */
 
 // List instead of Vec to avoid confusion with the glm type.
-template<class T>
-using List = std::vector<T>;
+template<class T, class Allocator = std::allocator<T>>
+using List = std::vector<T, Allocator>;
 
 // Simple character string class.
 using SString = std::string;
@@ -25,6 +30,12 @@ using SString = std::string;
 // Unicode-16 string class. The preferred class for strings in this project.
 using String = std::u16string;
 
+// Lists and strings allocating from a std::pmr::memory_resource, such as a Memory::Arena.
+template<class T>
+using PmrList = std::pmr::vector<T>;
+using PmrSString = std::pmr::string;
+using PmrString = std::pmr::u16string;
+
 enum Result
 {
     Success,